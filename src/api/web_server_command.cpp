@@ -44,6 +44,10 @@ namespace CEG {
 
 		int64_t begin_time = utils::Timestamp::HighResolution();
 		const Json::Value &json_items = body["items"];
+		std::vector<protocol::TransactionEnv> tran_envs(json_items.size());
+		std::vector<Result> item_results;
+		std::vector<const protocol::TransactionEnv *> submit_envs;
+		std::vector<size_t> submit_items;
 		for (size_t j = 0; j < json_items.size() && running; j++) {
 			const Json::Value &json_item = json_items[j];
 			Json::Value &result_item = results[results.size()];
@@ -53,7 +57,7 @@ namespace CEG {
 			result.set_code(protocol::ERRCODE_SUCCESS);
 			result.set_desc("");
 
-			protocol::TransactionEnv tran_env;
+			protocol::TransactionEnv &tran_env = tran_envs[j];
 			do {
 				if (json_item.isMember("transaction_blob")) {
 					if (!json_item.isMember("signatures")) {
@@ -137,15 +141,29 @@ namespace CEG {
 					result_item["hash"] = utils::String::BinToHexString(HashWrapper::Crypto(content));
 				}
 
-				TransactionFrm::pointer ptr = std::make_shared<TransactionFrm>(tran_env);
-				GlueManager::Instance().OnTransaction(ptr, result);
+				submit_envs.push_back(&tran_env);
+				submit_items.push_back(j);
+			} while (false);
 
-				// do not broadcast if OnTransaction failed
-				if (result.code() == protocol::ERRCODE_SUCCESS) {
-					PeerManager::Instance().Broadcast(protocol::OVERLAY_MSGTYPE_TRANSACTION, ptr->GetFullData());
-				}
+			item_results.push_back(result);
+		}
 
-			} while (false);
+		//The signatures of all the submitted transactions are verified in one batch
+		std::vector<TransactionFrm::pointer> tran_ptrs;
+		TransactionFrm::CreateBatch(submit_envs, tran_ptrs, true);
+		for (size_t i = 0; i < tran_ptrs.size(); i++) {
+			Result &result = item_results[submit_items[i]];
+			GlueManager::Instance().OnTransaction(tran_ptrs[i], result);
+
+			// do not broadcast if OnTransaction failed
+			if (result.code() == protocol::ERRCODE_SUCCESS) {
+				PeerManager::Instance().Broadcast(protocol::OVERLAY_MSGTYPE_TRANSACTION, tran_ptrs[i]->GetFullData());
+			}
+		}
+
+		for (size_t j = 0; j < item_results.size(); j++) {
+			Result &result = item_results[j];
+			Json::Value &result_item = results[(Json::UInt)j];
 
 			//Force to exit successfully
 			if (result.code() == protocol::ERRCODE_SUCCESS || result.code() == protocol::ERRCODE_ALREADY_EXIST) {
@@ -170,6 +170,8 @@ namespace CEG {
 		ret["ret"] = CEG::Proto2Json(x);
 		ret["NEW"] = NodeFrm::NEWCOUNT;
 		ret["DEL"] = NodeFrm::DELCOUNT;
+		ret["ARENA_LIVE"] = LedgerManager::Instance().tree_->Arena().LiveCount();
+		ret["ARENA_BYTES"] = LedgerManager::Instance().tree_->Arena().BytesReserved();
 
 		reply = ret.toStyledString();
 	}
@@ -371,21 +373,28 @@ namespace CEG {
 				result["total_count"] = list.entry_size();
 			}
 
+			//Read the whole page at once
+			std::vector<std::string> hashes;
 			for (int32_t i = start_int;
 				i < list.entry_size() &&
-				error_code == protocol::ERRCODE_SUCCESS &&
 				i < start_int + limit_int;
 			i++) {
-				TransactionFrm txfrm;
-				if (txfrm.LoadFromDb(list.entry(i)) > 0) {
-					result["total_count"] = 0;
-					error_code = protocol::ERRCODE_NOT_EXIST;
-					break;
-				}
+				hashes.push_back(list.entry(i));
+			}
+
+			std::vector<TransactionFrm::pointer> txfrms;
+			uint32_t load_code = TransactionFrm::LoadFromDb(hashes, txfrms);
+			for (size_t i = 0; i < txfrms.size(); i++) {
 				Json::Value m;
-				txfrm.ToJson(m);
+				txfrms[i]->ToJson(m);
 				txs[txs.size()] = m;
 			}
+
+			if (load_code > 0) {
+				result["total_count"] = 0;
+				error_code = protocol::ERRCODE_NOT_EXIST;
+				break;
+			}
 		} while (false);
 
 		reply_json["error_code"] = error_code;
@@ -49,51 +49,166 @@ namespace CEG {
 		return true;
 	}
 
-	bool WsPeer::Filter(const protocol::TransactionEnvStore &tx_msg) {
-		if (tx_filter_address_.empty()) {
-			return true;
+	const std::set<std::string> &WsPeer::GetFilterAddress() const {
+		return tx_filter_address_;
+	}
+
+	WsSubscription::WsSubscription() :flush_pending_(false), sent_count_(0), frame_count_(0), evicted_count_(0) {}
+
+	WsSubscription::~WsSubscription() {}
+
+	void WsSubscription::Unindex(int64_t conn_id, const Subscriber &subscriber) {
+		if (subscriber.addresses_.empty()) {
+			unfiltered_.erase(conn_id);
+			return;
 		}
 
-		const protocol::Transaction &trans = tx_msg.transaction_env().transaction();
-		if (tx_filter_address_.find(trans.source_address()) != tx_filter_address_.end()) {
-			return true;
+		for (auto iter = subscriber.addresses_.begin(); iter != subscriber.addresses_.end(); iter++) {
+			auto index_iter = address_index_.find(*iter);
+			if (index_iter != address_index_.end()) {
+				index_iter->second.erase(conn_id);
+				if (index_iter->second.empty()) {
+					address_index_.erase(index_iter);
+				}
+			}
 		}
+	}
 
-		for (int32_t i = 0; i < trans.operations_size(); i++) {
-			const protocol::Operation &ope = trans.operations(i);
-			if (!ope.source_address().empty() && tx_filter_address_.find(ope.source_address()) != tx_filter_address_.end()) {
-				return true;
+	void WsSubscription::AddSubscriber(int64_t conn_id) {
+		utils::MutexGuard guard(mutex_);
+		if (subscribers_.find(conn_id) == subscribers_.end()) {
+			subscribers_[conn_id] = Subscriber();
+			unfiltered_.insert(conn_id);
+		}
+	}
+
+	void WsSubscription::RemoveSubscriber(int64_t conn_id) {
+		utils::MutexGuard guard(mutex_);
+		SubscriberMap::iterator iter = subscribers_.find(conn_id);
+		if (iter != subscribers_.end()) {
+			Unindex(conn_id, iter->second);
+			subscribers_.erase(iter);
+		}
+	}
+
+	void WsSubscription::SetAddresses(int64_t conn_id, const std::set<std::string> &addresses) {
+		utils::MutexGuard guard(mutex_);
+		Subscriber &subscriber = subscribers_[conn_id];
+		Unindex(conn_id, subscriber);
+		subscriber.addresses_ = addresses;
+		if (addresses.empty()) {
+			unfiltered_.insert(conn_id);
+			return;
+		}
+
+		for (auto iter = addresses.begin(); iter != addresses.end(); iter++) {
+			address_index_[*iter].insert(conn_id);
+		}
+	}
+
+	void WsSubscription::GetSubscribers(std::vector<int64_t> &conn_ids) {
+		utils::MutexGuard guard(mutex_);
+		for (SubscriberMap::const_iterator iter = subscribers_.begin(); iter != subscribers_.end(); iter++) {
+			if (!iter->second.evicted_) {
+				conn_ids.push_back(iter->first);
 			}
+		}
+	}
 
-			switch (ope.type()) {
-			case protocol::Operation_Type_CREATE_ACCOUNT:{
-				if (tx_filter_address_.find(ope.create_account().dest_address()) != tx_filter_address_.end()) {
-					return true;
-				}
-				break;
+	void WsSubscription::GetSubscribers(const std::set<std::string> &addresses, std::vector<int64_t> &conn_ids) {
+		utils::MutexGuard guard(mutex_);
+		std::set<int64_t> ids = unfiltered_;
+		for (auto iter = addresses.begin(); iter != addresses.end(); iter++) {
+			auto index_iter = address_index_.find(*iter);
+			if (index_iter != address_index_.end()) {
+				ids.insert(index_iter->second.begin(), index_iter->second.end());
 			}
-			case protocol::Operation_Type_PAY_COIN:{
-				if (tx_filter_address_.find(ope.pay_coin().dest_address()) != tx_filter_address_.end()) {
-					return true;
-				}
-				break;
+		}
+		conn_ids.assign(ids.begin(), ids.end());
+	}
+
+	bool WsSubscription::Enqueue(const std::vector<int64_t> &conn_ids, const Frame &frame, size_t max_queue_size) {
+		utils::MutexGuard guard(mutex_);
+		frame_count_++;
+		for (size_t i = 0; i < conn_ids.size(); i++) {
+			SubscriberMap::iterator iter = subscribers_.find(conn_ids[i]);
+			if (iter == subscribers_.end() || iter->second.evicted_) {
+				continue;
 			}
-			case protocol::Operation_Type_PAY_ASSET:{
-				if (tx_filter_address_.find(ope.pay_asset().dest_address()) != tx_filter_address_.end()) {
-					return true;
-				}
-				break;
+
+			Subscriber &subscriber = iter->second;
+			if (subscriber.queue_.size() >= max_queue_size) {
+				//The websocket thread closes it at the next flush
+				subscriber.evicted_ = true;
+				subscriber.queue_.clear();
+				subscriber.queued_bytes_ = 0;
+				evicted_count_++;
+				continue;
 			}
-	
-			default:
-				break;
+
+			subscriber.queue_.push_back(frame);
+			subscriber.queued_bytes_ += frame->size();
+		}
+
+		bool schedule = !flush_pending_;
+		flush_pending_ = true;
+		return schedule;
+	}
+
+	void WsSubscription::TakeQueues(SubscriberMap &queues) {
+		utils::MutexGuard guard(mutex_);
+		flush_pending_ = false;
+		for (SubscriberMap::iterator iter = subscribers_.begin(); iter != subscribers_.end(); iter++) {
+			Subscriber &subscriber = iter->second;
+			if (subscriber.queue_.empty() && !subscriber.evicted_) {
+				continue;
 			}
+
+			Subscriber &taken = queues[iter->first];
+			taken.queue_.swap(subscriber.queue_);
+			taken.queued_bytes_ = subscriber.queued_bytes_;
+			taken.evicted_ = subscriber.evicted_;
+			subscriber.queued_bytes_ = 0;
+		}
+	}
+
+	void WsSubscription::ReturnQueue(int64_t conn_id, std::deque<Frame> &queue, size_t queued_bytes) {
+		utils::MutexGuard guard(mutex_);
+		SubscriberMap::iterator iter = subscribers_.find(conn_id);
+		if (iter == subscribers_.end() || iter->second.evicted_) {
+			return;
+		}
+
+		Subscriber &subscriber = iter->second;
+		queue.insert(queue.end(), subscriber.queue_.begin(), subscriber.queue_.end());
+		subscriber.queue_.swap(queue);
+		subscriber.queued_bytes_ += queued_bytes;
+	}
+
+	void WsSubscription::OnSent(int64_t count) {
+		utils::MutexGuard guard(mutex_);
+		sent_count_ += count;
+	}
+
+	void WsSubscription::GetModuleStatus(Json::Value &data) {
+		utils::MutexGuard guard(mutex_);
+		size_t queued = 0;
+		size_t queued_bytes = 0;
+		for (SubscriberMap::const_iterator iter = subscribers_.begin(); iter != subscribers_.end(); iter++) {
+			queued += iter->second.queue_.size();
+			queued_bytes += iter->second.queued_bytes_;
 		}
 
-		return false;
+		data["subscribers"] = (Json::UInt64)subscribers_.size();
+		data["indexed_addresses"] = (Json::UInt64)address_index_.size();
+		data["queued"] = (Json::UInt64)queued;
+		data["queued_bytes"] = (Json::UInt64)queued_bytes;
+		data["frames"] = frame_count_;
+		data["sent"] = sent_count_;
+		data["evicted"] = evicted_count_;
 	}
 
-	WebSocketServer::WebSocketServer() : Network(SslParameter()) {
+	WebSocketServer::WebSocketServer() : Network(SslParameter()), flush_timer_(io_), flush_timer_waiting_(false) {
 		connect_interval_ = 120 * utils::MICRO_UNITS_PER_SEC;
 		last_connect_time_ = 0;
 
@@ -169,27 +284,126 @@ namespace CEG {
 		return true;
 	}
 
-	void WebSocketServer::BroadcastMsg(int64_t type, const std::string &data) {
-		utils::MutexGuard guard(conns_list_lock_);
+	WsSubscription::Frame WebSocketServer::MakeFrame(int64_t type, const std::string &data) {
+		//The sequence of a request is only echoed by its response, and the pushed messages have none.
+		//So every client gets the same bytes.
+		protocol::WsMessage message;
+		message.set_type(type);
+		message.set_request(true);
+		message.set_data(data);
+		return std::make_shared<const std::string>(message.SerializeAsString());
+	}
+
+	void WebSocketServer::GetTransactionAddresses(const protocol::TransactionEnvStore &tx_msg, std::set<std::string> &addresses) {
+		const protocol::Transaction &trans = tx_msg.transaction_env().transaction();
+		addresses.insert(trans.source_address());
+
+		for (int32_t i = 0; i < trans.operations_size(); i++) {
+			const protocol::Operation &ope = trans.operations(i);
+			if (!ope.source_address().empty()) {
+				addresses.insert(ope.source_address());
+			}
 
-		for (ConnectionMap::iterator iter = connections_.begin();
-			iter != connections_.end();
-			iter++) {
-			std::error_code ec;
-			iter->second->SendRequest(type, data, ec);
+			switch (ope.type()) {
+			case protocol::Operation_Type_CREATE_ACCOUNT:
+				addresses.insert(ope.create_account().dest_address());
+				break;
+			case protocol::Operation_Type_PAY_COIN:
+				addresses.insert(ope.pay_coin().dest_address());
+				break;
+			case protocol::Operation_Type_PAY_ASSET:
+				addresses.insert(ope.pay_asset().dest_address());
+				break;
+			default:
+				break;
+			}
 		}
 	}
 
-	void WebSocketServer::BroadcastChainTxMsg(const protocol::TransactionEnvStore& tx_msg) {
-		utils::MutexGuard guard(conns_list_lock_);
+	void WebSocketServer::Deliver(const std::vector<int64_t> &conn_ids, const WsSubscription::Frame &frame) {
+		size_t max_queue_size = (size_t)Configure::Instance().wsserver_configure_.send_queue_size_;
+		if (subscription_.Enqueue(conn_ids, frame, max_queue_size)) {
+			io_.post(std::bind(&WebSocketServer::FlushQueues, this));
+		}
+	}
+
+	void WebSocketServer::FlushQueues() {
+		WsSubscription::SubscriberMap queues;
+		subscription_.TakeQueues(queues);
 
-		for (auto iter = connections_.begin(); iter != connections_.end(); iter++) {
-			WsPeer *peer = (WsPeer *)iter->second;
-			if (peer->Filter(tx_msg)) {
-				std::error_code ec;
-				std::string str = tx_msg.SerializeAsString();
-				peer->SendRequest(protocol::CHAIN_TX_ENV_STORE, str, ec);
+		size_t max_buffered = (size_t)Configure::Instance().wsserver_configure_.send_buffer_size_;
+		std::vector<int64_t> closed_ids;
+		int64_t sent = 0;
+		do {
+			utils::MutexGuard guard(conns_list_lock_);
+			for (auto iter = queues.begin(); iter != queues.end(); iter++) {
+				Connection *conn = GetConnection(iter->first);
+				if (conn == NULL) {
+					closed_ids.push_back(iter->first);
+					continue;
+				}
+
+				if (iter->second.evicted_) {
+					LOG_WARN("Disconnected the websocket client(%s), it does not read its messages", conn->GetPeerAddress().ToIpPort().c_str());
+					RemoveConnection(conn);
+					closed_ids.push_back(iter->first);
+					continue;
+				}
+
+				//Leave the rest in the queue while the socket of a slow client is full
+				std::deque<WsSubscription::Frame> &queue = iter->second.queue_;
+				while (!queue.empty() && conn->GetBufferedAmount() < max_buffered) {
+					std::error_code ec;
+					conn->SendByteMessage(*queue.front(), ec);
+					iter->second.queued_bytes_ -= queue.front()->size();
+					queue.pop_front();
+					sent++;
+				}
 			}
+		} while (false);
+
+		for (size_t i = 0; i < closed_ids.size(); i++) {
+			subscription_.RemoveSubscriber(closed_ids[i]);
+			queues.erase(closed_ids[i]);
+		}
+
+		bool pending = false;
+		for (auto iter = queues.begin(); iter != queues.end(); iter++) {
+			if (!iter->second.queue_.empty()) {
+				subscription_.ReturnQueue(iter->first, iter->second.queue_, iter->second.queued_bytes_);
+				pending = true;
+			}
+		}
+		subscription_.OnSent(sent);
+
+		if (pending && !flush_timer_waiting_) {
+			flush_timer_waiting_ = true;
+			flush_timer_.expires_from_now(std::chrono::milliseconds(10));
+			flush_timer_.async_wait([this](const asio::error_code &ec) {
+				flush_timer_waiting_ = false;
+				if (!ec) {
+					FlushQueues();
+				}
+			});
+		}
+	}
+
+	void WebSocketServer::BroadcastMsg(int64_t type, const std::string &data) {
+		std::vector<int64_t> conn_ids;
+		subscription_.GetSubscribers(conn_ids);
+		if (!conn_ids.empty()) {
+			Deliver(conn_ids, MakeFrame(type, data));
+		}
+	}
+
+	void WebSocketServer::BroadcastChainTxMsg(const protocol::TransactionEnvStore& tx_msg) {
+		std::set<std::string> addresses;
+		GetTransactionAddresses(tx_msg, addresses);
+
+		std::vector<int64_t> conn_ids;
+		subscription_.GetSubscribers(addresses, conn_ids);
+		if (!conn_ids.empty()) {
+			Deliver(conn_ids, MakeFrame(protocol::CHAIN_TX_ENV_STORE, tx_msg.SerializeAsString()));
 		}
 	}
 
@@ -263,6 +477,7 @@ namespace CEG {
 				LOG_ERROR("Failed to set the subscription message.%s", default_response.error_desc().c_str());
 				break;
 			} 
+			subscription_.SetAddresses(conn_id, conn->GetFilterAddress());
 		} while (false);
 
 		std::error_code ec;
@@ -273,6 +488,7 @@ namespace CEG {
 	void WebSocketServer::GetModuleStatus(Json::Value &data) {
 		data["name"] = "websocket_server";
 		data["listen_port"] = GetListenPort();
+		subscription_.GetModuleStatus(data["subscription"]);
 		Json::Value &peers = data["clients"];
 		int32_t active_size = 0;
 		utils::MutexGuard guard(conns_list_lock_);
@@ -284,6 +500,11 @@ namespace CEG {
 	Connection *WebSocketServer::CreateConnectObject(server *server_h, client *client_,
 		tls_server *tls_server_h, tls_client *tls_client_h,
 		connection_hdl con, const std::string &uri, int64_t id) {
+		subscription_.AddSubscriber(id);
 		return new WsPeer(server_h, client_, tls_server_h, tls_client_h, con, uri, id);
 	}
+
+	void WebSocketServer::OnDisconnect(Connection *conn) {
+		subscription_.RemoveSubscriber(conn->GetId());
+	}
 }
@@ -16,6 +16,9 @@
 #ifndef WEBSOCKET_SERVER_H_
 #define WEBSOCKET_SERVER_H_
 
+#include <deque>
+#include <unordered_map>
+#include <asio/steady_timer.hpp>
 #include <proto/cpp/chain.pb.h>
 #include <common/network.h>
 #include <monitor/system_manager.h>
@@ -32,7 +35,60 @@ namespace CEG {
 		virtual ~WsPeer();
 
 		bool Set(const protocol::ChainSubscribeTx &sub);
-		bool Filter(const protocol::TransactionEnvStore &tx_msg);
+		const std::set<std::string> &GetFilterAddress() const;
+	};
+
+	//Fan-out of the chain messages to the websocket clients.
+	//A message is serialized once into a frame shared by the queues of its subscribers, which are found
+	//through an index of the subscribed addresses. The queues are sent on the websocket thread, so the
+	//ledger close does not wait for the clients. A client whose queue grows over send_queue_size is disconnected.
+	class WsSubscription {
+		DISALLOW_COPY_AND_ASSIGN(WsSubscription);
+	public:
+		typedef std::shared_ptr<const std::string> Frame;
+
+		struct Subscriber {
+			Subscriber() :queued_bytes_(0), evicted_(false) {}
+			std::set<std::string> addresses_;   //Empty for all the transactions
+			std::deque<Frame> queue_;
+			size_t queued_bytes_;
+			bool evicted_;
+		};
+		typedef std::map<int64_t, Subscriber> SubscriberMap;
+
+		WsSubscription();
+		~WsSubscription();
+
+		void AddSubscriber(int64_t conn_id);
+		void RemoveSubscriber(int64_t conn_id);
+		void SetAddresses(int64_t conn_id, const std::set<std::string> &addresses);
+
+		//The subscribers of all the messages, or of the transactions touching one of the addresses
+		void GetSubscribers(std::vector<int64_t> &conn_ids);
+		void GetSubscribers(const std::set<std::string> &addresses, std::vector<int64_t> &conn_ids);
+
+		//Return true if the queues were empty, then the caller schedules a flush
+		bool Enqueue(const std::vector<int64_t> &conn_ids, const Frame &frame, size_t max_queue_size);
+		//Move out the queued frames
+		void TakeQueues(SubscriberMap &queues);
+		//Put back the frames which were not sent, in front of the new ones
+		void ReturnQueue(int64_t conn_id, std::deque<Frame> &queue, size_t queued_bytes);
+		void OnSent(int64_t count);
+
+		void GetModuleStatus(Json::Value &data);
+
+	private:
+		utils::Mutex mutex_;
+		SubscriberMap subscribers_;
+		std::unordered_map<std::string, std::set<int64_t>> address_index_;
+		std::set<int64_t> unfiltered_;
+		bool flush_pending_;
+
+		int64_t sent_count_;
+		int64_t frame_count_;
+		int64_t evicted_count_;
+
+		void Unindex(int64_t conn_id, const Subscriber &subscriber);
 	};
 
 	class WebSocketServer :public utils::Singleton<WebSocketServer>,
@@ -62,6 +118,8 @@ namespace CEG {
 		virtual Connection *CreateConnectObject(server *server_h, client *client_,
 			tls_server *tls_server_h, tls_client *tls_client_h,
 			connection_hdl con, const std::string &uri, int64_t id);
+		//A subscriber whose filter never matches would otherwise stay until a flush finds its connection gone
+		virtual void OnDisconnect(Connection *conn);
 
 		virtual void GetModuleStatus(Json::Value &data);
 	protected:
@@ -70,6 +128,16 @@ namespace CEG {
 	private:
 		utils::Thread *thread_ptr_;
 
+		WsSubscription subscription_;
+		asio::steady_timer flush_timer_;
+		bool flush_timer_waiting_;
+
+		static WsSubscription::Frame MakeFrame(int64_t type, const std::string &data);
+		static void GetTransactionAddresses(const protocol::TransactionEnvStore &tx_msg, std::set<std::string> &addresses);
+		void Deliver(const std::vector<int64_t> &conn_ids, const WsSubscription::Frame &frame);
+		//Runs on the websocket thread
+		void FlushQueues();
+
 		uint64_t last_connect_time_;
 		uint64_t connect_interval_;
 	};
@@ -19,6 +19,31 @@
 #include "configure_base.h"
 
 namespace CEG {
+	DbOptionsConfigure::DbOptionsConfigure() {
+		block_size_ = 4;
+		bloom_bits_per_key_ = 10;
+		whole_key_filtering_ = true;
+		prefix_extractor_ = false;
+		write_buffer_size_ = 4;
+		max_background_compactions_ = 1;
+	}
+
+	DbOptionsConfigure::~DbOptionsConfigure() {}
+
+	bool DbOptionsConfigure::Load(const Json::Value &value) {
+		ConfigureBase::GetValue(value, "block_size", block_size_);
+		ConfigureBase::GetValue(value, "bloom_bits_per_key", bloom_bits_per_key_);
+		ConfigureBase::GetValue(value, "whole_key_filtering", whole_key_filtering_);
+		ConfigureBase::GetValue(value, "prefix_extractor", prefix_extractor_);
+		ConfigureBase::GetValue(value, "write_buffer_size", write_buffer_size_);
+		ConfigureBase::GetValue(value, "max_background_compactions", max_background_compactions_);
+		if (value.isMember("compression_per_level")) {
+			compression_per_level_.clear();
+			ConfigureBase::GetValue(value, "compression_per_level", compression_per_level_);
+		}
+		return true;
+	}
+
 	DbConfigure::DbConfigure() {
 		keyvalue_db_path_ = General::DEFAULT_KEYVALUE_DB_PATH;
 		ledger_db_path_ = General::DEFAULT_LEDGER_DB_PATH;
@@ -26,6 +51,22 @@ namespace CEG {
 		tmp_path_ = "tmp";
 		async_write_sql_ = false; //default sync write sql
 		async_write_kv_ = false; //default sync write kv
+		block_cache_size_ = 256;
+		compaction_rate_limit_ = 64;
+
+		//Account trie nodes are random point lookups. The keys of both databases are composed by ComposePrefix,
+		//so a memtable prefix bloom is kept on the tag unless prefix_extractor is set to false.
+		account_options_.bloom_bits_per_key_ = 10;
+		account_options_.prefix_extractor_ = true;
+		account_options_.write_buffer_size_ = 64;
+		account_options_.max_background_compactions_ = 2;
+
+		//Ledgers and transactions are written once and mostly read by sequence or hash
+		ledger_options_.block_size_ = 16;
+		ledger_options_.prefix_extractor_ = true;
+		ledger_options_.write_buffer_size_ = 32;
+		const char *ledger_compression[] = { "none", "none", "zlib", "zlib", "zlib", "zlib", "zlib" };
+		ledger_options_.compression_per_level_.assign(ledger_compression, ledger_compression + sizeof(ledger_compression) / sizeof(ledger_compression[0]));
 	}
 
 	DbConfigure::~DbConfigure() {}
@@ -40,6 +81,17 @@ namespace CEG {
 		ConfigureBase::GetValue(value, "tmp_path", tmp_path_);
 		ConfigureBase::GetValue(value, "async_write_sql", async_write_sql_);
 		ConfigureBase::GetValue(value, "async_write_kv", async_write_kv_);
+		ConfigureBase::GetValue(value, "block_cache_size", block_cache_size_);
+		ConfigureBase::GetValue(value, "compaction_rate_limit", compaction_rate_limit_);
+		if (value.isMember("keyvalue_options")) {
+			keyvalue_options_.Load(value["keyvalue_options"]);
+		}
+		if (value.isMember("ledger_options")) {
+			ledger_options_.Load(value["ledger_options"]);
+		}
+		if (value.isMember("account_options")) {
+			account_options_.Load(value["account_options"]);
+		}
 
 
 		std::string rational_decode;
@@ -82,6 +134,8 @@ namespace CEG {
 		time_capacity_ = 30;
 		size_capacity_ = 100;
 		expire_days_ = 10;
+		async_ = false;
+		async_buffer_size_ = 1024;
 	}
 
 	LoggerConfigure::~LoggerConfigure() {}
@@ -93,9 +147,12 @@ namespace CEG {
 		ConfigureBase::GetValue(value, "time_capacity", time_capacity_);
 		ConfigureBase::GetValue(value, "size_capacity", size_capacity_);
 		ConfigureBase::GetValue(value, "expire_days", expire_days_);
+		ConfigureBase::GetValue(value, "async", async_);
+		ConfigureBase::GetValue(value, "async_buffer_size", async_buffer_size_);
 
 		time_capacity_ *= (3600 * 24);
 		size_capacity_ *= utils::BYTES_PER_MEGA;
+		async_buffer_size_ *= utils::BYTES_PER_KILO;
 
 		//Parse the type string
 		utils::StringVector dests, levels;
@@ -37,6 +37,24 @@ namespace CEG {
 		uint32_t dest_;
 		uint32_t level_;
 		int32_t expire_days_;
+		bool async_;                        //Write the lines on a flusher thread
+		int64_t async_buffer_size_;         //KB of pending lines per thread, the lines over it are dropped
+		bool Load(const Json::Value &value);
+	};
+
+	//Tuning profile of one key value database
+	class DbOptionsConfigure {
+	public:
+		DbOptionsConfigure();
+		~DbOptionsConfigure();
+
+		int32_t block_size_;                //KB
+		int32_t bloom_bits_per_key_;        //0 disables the bloom filter
+		bool whole_key_filtering_;
+		bool prefix_extractor_;             //Prefix of the keys composed by ComposePrefix
+		int32_t write_buffer_size_;         //MB
+		int32_t max_background_compactions_;
+		utils::StringList compression_per_level_; //none, snappy, zlib, bzip2, lz4, lz4hc
 		bool Load(const Json::Value &value);
 	};
 
@@ -53,6 +71,12 @@ namespace CEG {
 		std::string tmp_path_;
 		bool async_write_sql_;
 		bool async_write_kv_;
+
+		int64_t block_cache_size_;          //MB, shared by all the databases
+		int64_t compaction_rate_limit_;     //MB per second, 0 means no limit
+		DbOptionsConfigure keyvalue_options_;
+		DbOptionsConfigure ledger_options_;
+		DbOptionsConfigure account_options_;
 		bool Load(const Json::Value &value);
 	};
 
@@ -79,6 +79,7 @@ namespace CEG {
 	const char *General::TRANSACTION_PREFIX = "tx";
 	const char *General::LEDGER_TRANSACTION_PREFIX = "lgtx";
 	const char *General::CONSENSUS_VALUE_PREFIX = "cosv";
+	const char *General::CODE_CACHE_PREFIX = "code";
 
 	const char *General::ACCOUNT_PREFIX = "acc";
 	const char *General::ASSET_PREFIX = "ast";
@@ -182,7 +183,112 @@ namespace CEG {
 
 	std::list<TimerNotify *> TimerNotify::notifys_;
 
-	SlowTimer::SlowTimer(){
+	LatencyHistogram::LatencyHistogram() :count_(0), total_(0), max_(0) {
+		memset(buckets_, 0, sizeof(buckets_));
+	}
+
+	LatencyHistogram::~LatencyHistogram() {}
+
+	void LatencyHistogram::Add(int64_t latency) {
+		if (latency < 0) {
+			latency = 0;
+		}
+
+		size_t index = 0;
+		while (index < BUCKET_COUNT - 1 && latency >= ((int64_t)1 << index)) {
+			index++;
+		}
+
+		buckets_[index]++;
+		count_++;
+		total_ += latency;
+		if (latency > max_) {
+			max_ = latency;
+		}
+	}
+
+	int64_t LatencyHistogram::Percentile(int64_t percent) const {
+		int64_t rank = (count_ * percent + 99) / 100;
+		int64_t seen = 0;
+		for (size_t i = 0; i < BUCKET_COUNT - 1; i++) {
+			seen += buckets_[i];
+			if (seen >= rank) {
+				return (int64_t)1 << i;
+			}
+		}
+		return max_;
+	}
+
+	void LatencyHistogram::ToJson(Json::Value &data) const {
+		data["count"] = count_;
+		data["average_us"] = count_ > 0 ? total_ / count_ : 0;
+		data["p50_us"] = Percentile(50);
+		data["p99_us"] = Percentile(99);
+		data["max_us"] = max_;
+
+		Json::Value &buckets = data["buckets"];
+		buckets = Json::Value(Json::objectValue);
+		for (size_t i = 0; i < BUCKET_COUNT; i++) {
+			if (buckets_[i] == 0) {
+				continue;
+			}
+
+			std::string key = (i < BUCKET_COUNT - 1) ? utils::String::Format("<" FMT_I64, (int64_t)1 << i) : "more";
+			buckets[key] = buckets_[i];
+		}
+	}
+
+	TimerScheduler::Entry::Entry(asio::io_service &io_service, int64_t interval, const Handler &handler) :
+		timer_(io_service), interval_(interval), handler_(handler) {}
+
+	TimerScheduler::TimerScheduler(asio::io_service &io_service) :io_service_(io_service) {}
+
+	TimerScheduler::~TimerScheduler() {
+		Cancel();
+	}
+
+	void TimerScheduler::Add(int64_t interval, const Handler &handler) {
+		Entry *entry = new Entry(io_service_, interval, handler);
+		entries_.push_back(entry);
+		entry->timer_.expires_from_now(std::chrono::microseconds(interval));
+		Wait(entry);
+	}
+
+	void TimerScheduler::Wait(Entry *entry) {
+		entry->timer_.async_wait([this, entry](const asio::error_code &ec) {
+			if (ec) {
+				return;
+			}
+
+			asio::steady_timer::time_point now = asio::steady_timer::clock_type::now();
+			lateness_.Add(std::chrono::duration_cast<std::chrono::microseconds>(now - entry->timer_.expires_at()).count());
+
+			entry->handler_(utils::Timestamp::HighResolution());
+
+			//Keep the period from the due time, but do not run again at once to catch up a slow handler
+			asio::steady_timer::time_point next = entry->timer_.expires_at() + std::chrono::microseconds(entry->interval_);
+			now = asio::steady_timer::clock_type::now();
+			entry->timer_.expires_at(next > now ? next : now);
+			Wait(entry);
+		});
+	}
+
+	void TimerScheduler::Cancel() {
+		//The cancelled handlers may still be queued, they find the error code and return before touching the entry
+		for (size_t i = 0; i < entries_.size(); i++) {
+			asio::error_code ec;
+			entries_[i]->timer_.cancel(ec);
+			delete entries_[i];
+		}
+		entries_.clear();
+	}
+
+	void TimerScheduler::GetModuleStatus(Json::Value &data) {
+		data["timer_count"] = (Json::UInt64)entries_.size();
+		lateness_.ToJson(data["lateness"]);
+	}
+
+	SlowTimer::SlowTimer() :scheduler_(io_service_) {
 	}
 
 	SlowTimer::~SlowTimer(){}
@@ -211,38 +317,41 @@ namespace CEG {
 				thread_p = NULL;
 			}
 		}
+		scheduler_.Cancel();
 		LOG_INFO("SlowTimer stop [OK]");
 		return true;
 	}
 
-	void SlowTimer::Run(utils::Thread *thread){
-		asio::io_service::work work(io_service_);
-		while (!io_service_.stopped()){
-			asio::error_code err;
-			io_service_.poll(err);
-
-			for (auto item : TimerNotify::notifys_){
-				item->SlowTimerWrapper(utils::Timestamp::HighResolution());
+	void SlowTimer::Start() {
+		//The modules register their timers while they initialize, the scheduler runs on the slow timer thread
+		std::list<TimerNotify *> notifys = TimerNotify::notifys_;
+		io_service_.post([this, notifys]() {
+			for (auto item : notifys) {
+				scheduler_.Add(item->GetCheckInterval(), [item](int64_t current_time) {
+					item->SlowTimerWrapper(current_time);
 
-				if (item->IsSlowExpire(5 * utils::MICRO_UNITS_PER_SEC)){
-					LOG_WARN("The execution time(%s) (" FMT_I64 " us) is expired after 5s elapse", item->GetTimerName().c_str(), item->GetSlowLastExecuteTime());
-				}
+					if (item->IsSlowExpire(5 * utils::MICRO_UNITS_PER_SEC)){
+						LOG_WARN("The execution time(%s) (" FMT_I64 " us) is expired after 5s elapse", item->GetTimerName().c_str(), item->GetSlowLastExecuteTime());
+					}
+				});
 			}
+		});
+	}
 
-			utils::Sleep(1);
-		}
+	void SlowTimer::Run(utils::Thread *thread){
+		asio::io_service::work work(io_service_);
+		asio::error_code err;
+		io_service_.run(err);
 	}
 
-	Global::Global() : work_(io_service_), main_thread_id_(0){
+	Global::Global() : work_(io_service_), main_thread_id_(0), scheduler_(io_service_){
 	}
 
 	Global::~Global(){
 	}
 
 	bool Global::Initialize(){
-		timer_name_ = "Global";
 		main_thread_id_ = utils::Thread::current_thread_id();
-		TimerNotify::RegisterModule(this);
 		return true;
 	}
 
@@ -252,12 +361,6 @@ namespace CEG {
 		return true;
 	}
 
-	void Global::OnTimer(int64_t current_time){
-		//clock_.crank(false);
-		asio::error_code err;
-		io_service_.poll(err);
-	}
-
 	asio::io_service &Global::GetIoService(){
 		return io_service_;
 	}
@@ -265,6 +368,33 @@ namespace CEG {
 	int64_t Global::GetMainThreadId(){
 		return main_thread_id_;
 	}
+
+	void Global::Post(const std::function<void()> &task) {
+		int64_t post_time = utils::Timestamp::HighResolution();
+		io_service_.post([this, task, post_time]() {
+			dispatch_latency_.Add(utils::Timestamp::HighResolution() - post_time);
+			task();
+		});
+	}
+
+	void Global::AddTimer(int64_t interval, const TimerScheduler::Handler &handler) {
+		scheduler_.Add(interval, handler);
+	}
+
+	void Global::Run() {
+		asio::error_code err;
+		io_service_.run(err);
+		scheduler_.Cancel();
+	}
+
+	void Global::Stop() {
+		io_service_.stop();
+	}
+
+	void Global::GetModuleStatus(Json::Value &data) {
+		dispatch_latency_.ToJson(data["dispatch"]);
+		scheduler_.GetModuleStatus(data["timer"]);
+	}
 	
 	static int32_t ledger_type_ = HashWrapper::HASH_TYPE_SHA256;
 	HashWrapper::HashWrapper(){
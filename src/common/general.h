@@ -17,6 +17,7 @@
 #define GENERAL_H_
 
 #include <asio.hpp>
+#include <asio/steady_timer.hpp>
 #include <utils/headers.h>
 #include <json/value.h>
 #include <utils/sm3.h>
@@ -80,6 +81,7 @@ namespace CEG {
 		const static char *TRANSACTION_PREFIX;
 		const static char *LEDGER_TRANSACTION_PREFIX;
 		const static char *CONSENSUS_VALUE_PREFIX;
+		const static char *CODE_CACHE_PREFIX;
 		const static char *PEERS_TABLE;
 		const static char *LAST_TX_HASHS;
 		const static char *LAST_PROOF;
@@ -175,6 +177,8 @@ namespace CEG {
 		int64_t last_slow_execute_complete_time_;
 		std::string timer_name_;
 	public:
+		static const int64_t DEFAULT_CHECK_INTERVAL = 100 * utils::MICRO_UNITS_PER_MILLI;
+
 		static std::list<TimerNotify *> notifys_;
 		static bool RegisterModule(TimerNotify *module) { notifys_.push_back(module); return true; };
 
@@ -185,24 +189,27 @@ namespace CEG {
 			last_slow_execute_complete_time_(0) {};
 		~TimerNotify() {};
 
+		//Called by a TimerScheduler every GetCheckInterval()
 		void TimerWrapper(int64_t current_time) {
-			last_execute_complete_time_ = 0; //clear first
-			if (current_time > last_check_time_ + check_interval_) {
-				last_check_time_ = current_time;
-				OnTimer(current_time);
-				last_execute_complete_time_ = utils::Timestamp::HighResolution();
-			}
+			last_check_time_ = current_time;
+			OnTimer(current_time);
+			last_execute_complete_time_ = utils::Timestamp::HighResolution();
 		};
 
 		void SlowTimerWrapper(int64_t current_time) {
-			last_slow_execute_complete_time_ = 0;//clear first
-			if (current_time > last_slow_check_time_ + check_interval_) {
-				last_slow_check_time_ = current_time;
-				OnSlowTimer(current_time);
-				last_slow_execute_complete_time_ = utils::Timestamp::HighResolution();
-			}
+			last_slow_check_time_ = current_time;
+			OnSlowTimer(current_time);
+			last_slow_execute_complete_time_ = utils::Timestamp::HighResolution();
 		};
 
+		//The modules without an interval throttle their timers themselves
+		int64_t GetCheckInterval() const {
+			if (check_interval_ > 0) {
+				return check_interval_;
+			}
+			return DEFAULT_CHECK_INTERVAL;
+		}
+
 		bool IsSlowExpire(int64_t time_out) {
 			return last_slow_execute_complete_time_ - last_slow_check_time_ > time_out;
 		}
@@ -241,6 +248,53 @@ namespace CEG {
 		virtual void GetModuleStatus(Json::Value &nData) = 0;
 	};
 
+	//Histogram of latencies in microseconds, the bucket i counts the values below 2^i us and the last one the others.
+	//It is not locked, add and read the values on the same thread.
+	class LatencyHistogram {
+		static const size_t BUCKET_COUNT = 22;
+		int64_t buckets_[BUCKET_COUNT];
+		int64_t count_;
+		int64_t total_;
+		int64_t max_;
+	public:
+		LatencyHistogram();
+		~LatencyHistogram();
+
+		void Add(int64_t latency);
+		//Upper bound of the bucket holding the given ratio of the values
+		int64_t Percentile(int64_t percent) const;
+		void ToJson(Json::Value &data) const;
+	};
+
+	//Periodic handlers on steady timers of an io_service, so that the thread running it sleeps until the next one is due.
+	//The handlers run on that thread, add them from it or before it runs.
+	class TimerScheduler {
+	public:
+		typedef std::function<void(int64_t current_time)> Handler;
+	private:
+		struct Entry {
+			Entry(asio::io_service &io_service, int64_t interval, const Handler &handler);
+			asio::steady_timer timer_;
+			int64_t interval_;
+			Handler handler_;
+		};
+
+		asio::io_service &io_service_;
+		std::vector<Entry *> entries_;
+		//How late the handlers run after their due time
+		LatencyHistogram lateness_;
+
+		void Wait(Entry *entry);
+	public:
+		TimerScheduler(asio::io_service &io_service);
+		~TimerScheduler();
+
+		//Call the handler every interval in microseconds, the first time after one interval
+		void Add(int64_t interval, const Handler &handler);
+		void Cancel();
+		void GetModuleStatus(Json::Value &data);
+	};
+
 	class SlowTimer : public utils::Singleton<CEG::SlowTimer>, public utils::Runnable {
 	public:
 		SlowTimer();
@@ -252,23 +306,40 @@ namespace CEG {
 		asio::io_service io_service_;
 		//utils::Thread *thread_ptr_;
 		std::vector<utils::Thread *> thread_ptrs_;
+	private:
+		TimerScheduler scheduler_;
+	public:
 		virtual void Run(utils::Thread *thread) override;
+		//Schedule the slow timers of the modules registered so far
+		void Start();
 		void Stop();
 	};
 
-	class Global : public utils::Singleton<CEG::Global>, public TimerNotify {
+	//The io_service of the main thread. Run() blocks in io_service::run, the posted tasks run as soon as they
+	//are queued and the timers of the modules are steady timers, instead of polling and sleeping 1 ms.
+	class Global : public utils::Singleton<CEG::Global> {
 		asio::io_service io_service_;
 		asio::io_service::work work_;
 		int64_t main_thread_id_;
+		TimerScheduler scheduler_;
+		//How long the posted tasks wait before they run
+		LatencyHistogram dispatch_latency_;
 	public:
 		Global();
 		~Global();
 		bool Initialize();
 		bool Exit();
-		virtual void OnTimer(int64_t current_time) override;
-		virtual void OnSlowTimer(int64_t current_time) override {};
 		asio::io_service &GetIoService();
 		int64_t GetMainThreadId();
+
+		//Run the task on the main thread
+		void Post(const std::function<void()> &task);
+		//Call the handler on the main thread every interval
+		void AddTimer(int64_t interval, const TimerScheduler::Handler &handler);
+		//Run the main thread until Stop
+		void Run();
+		void Stop();
+		void GetModuleStatus(Json::Value &data);
 	};
 
 #define  ASSERT_MAIN_THREAD assert(utils::Thread::current_thread_id() == Global::Instance().GetMainThreadId());
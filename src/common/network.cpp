@@ -126,6 +126,40 @@ namespace CEG {
 		return ec;
 	}
 
+	size_t Connection::GetBufferedAmount() const {
+		std::error_code ec;
+		if (in_bound_) {
+			if (server_) {
+				server::connection_ptr con = server_->get_con_from_hdl(handle_, ec);
+				if (!ec) {
+					return con->get_buffered_amount();
+				}
+			}
+			else {
+				tls_server::connection_ptr con = tls_server_->get_con_from_hdl(handle_, ec);
+				if (!ec) {
+					return con->get_buffered_amount();
+				}
+			}
+		}
+		else {
+			if (client_) {
+				client::connection_ptr con = client_->get_con_from_hdl(handle_, ec);
+				if (!ec) {
+					return con->get_buffered_amount();
+				}
+			}
+			else {
+				tls_client::connection_ptr con = tls_client_->get_con_from_hdl(handle_, ec);
+				if (!ec) {
+					return con->get_buffered_amount();
+				}
+			}
+		}
+
+		return 0;
+	}
+
 	bool Connection::InBound() const {
 		return in_bound_;
 	}
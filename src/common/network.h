@@ -91,6 +91,8 @@ namespace CEG {
 		int64_t GetId() const;
 		connection_hdl GetHandle() const;
 		websocketpp::lib::error_code GetErrorCode() const;
+		//Bytes handed to the socket layer and not written yet
+		size_t GetBufferedAmount() const;
 		bool InBound() const;
 
 		//Get status
@@ -295,6 +295,234 @@ namespace CEG {
 		return false;
 	}
 
+	bool PublicKey::Verify(const SignatureItem &item) {
+		if (item.signature_->size() != 64) {
+			return false;
+		}
+
+		if (item.type_ == SIGNTYPE_ED25519) {
+			if (item.raw_public_key_.size() != ED25519_PUBLICKEY_LENGTH) {
+				return false;
+			}
+			return ed25519_sign_open((const unsigned char *)item.data_->c_str(), item.data_->size(),
+				(const unsigned char *)item.raw_public_key_.c_str(), (const unsigned char *)item.signature_->c_str()) == 0;
+		}
+		else if (item.type_ == SIGNTYPE_CFCASM2) {
+			return utils::EccSm2::verify(utils::EccSm2::GetCFCAGroup(), item.raw_public_key_, "1234567812345678", *item.data_, *item.signature_) == 1;
+		}
+		else {
+			LOG_ERROR("Failed to verify. Unknown signature type(%d)", item.type_);
+		}
+		return false;
+	}
+
+	bool PublicKey::IsBatchable(const SignatureItem &item) {
+		//The order of the group, little endian
+		static const unsigned char order[32] = {
+			0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+		};
+		//The y of the points of order 1, 2, 4 and 8, the sign bit of x is masked
+		static const unsigned char small_orders[][32] = {
+			{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+			  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+			{ 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+			  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+			{ 0xec, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f },
+			{ 0x26, 0xe8, 0x95, 0x8f, 0xc2, 0xb2, 0x27, 0xb0, 0x45, 0xc3, 0xf4, 0x89, 0xf2, 0xef, 0x98, 0xf0,
+			  0xd5, 0xdf, 0xac, 0x05, 0xd3, 0xc6, 0x33, 0x39, 0xb1, 0x38, 0x02, 0x88, 0x6d, 0x53, 0xfc, 0x05 },
+			{ 0xc7, 0x17, 0x6a, 0x70, 0x3d, 0x4d, 0xd8, 0x4f, 0xba, 0x3c, 0x0b, 0x76, 0x0d, 0x10, 0x67, 0x0f,
+			  0x2a, 0x20, 0x53, 0xfa, 0x2c, 0x39, 0xcc, 0xc6, 0x4e, 0xc7, 0xfd, 0x77, 0x92, 0xac, 0x03, 0x7a }
+		};
+
+		const unsigned char *points[2] = {
+			(const unsigned char *)item.raw_public_key_.c_str(),
+			(const unsigned char *)item.signature_->c_str()
+		};
+		for (size_t i = 0; i < 2; i++) {
+			const unsigned char *point = points[i];
+			//y must be below p = 2^255 - 19
+			bool below_p = (point[31] & 0x7f) != 0x7f || point[0] < 0xed;
+			for (size_t j = 1; j < 31 && !below_p; j++) {
+				below_p = (point[j] != 0xff);
+			}
+			if (!below_p) {
+				return false;
+			}
+
+			for (size_t j = 0; j < sizeof(small_orders) / sizeof(small_orders[0]); j++) {
+				if (memcmp(point, small_orders[j], 31) == 0 && (point[31] & 0x7f) == small_orders[j][31]) {
+					return false;
+				}
+			}
+		}
+
+		//S must be below the order
+		const unsigned char *s = (const unsigned char *)item.signature_->c_str() + 32;
+		for (int32_t i = 31; i >= 0; i--) {
+			if (s[i] != order[i]) {
+				return s[i] < order[i];
+			}
+		}
+		return false;
+	}
+
+	void PublicKey::VerifyBatch(const std::vector<SignatureItem> &items, std::vector<bool> &results) {
+		results.assign(items.size(), false);
+
+		std::vector<const unsigned char *> messages, public_keys, signatures;
+		std::vector<size_t> message_lens, indexes;
+		for (size_t i = 0; i < items.size(); i++) {
+			const SignatureItem &item = items[i];
+			if (item.signature_->size() != 64) {
+				continue;
+			}
+
+			if (item.type_ == SIGNTYPE_ED25519) {
+				if (item.raw_public_key_.size() != ED25519_PUBLICKEY_LENGTH) {
+					continue;
+				}
+
+				if (!IsBatchable(item)) {
+					results[i] = Verify(item);
+					continue;
+				}
+				messages.push_back((const unsigned char *)item.data_->c_str());
+				message_lens.push_back(item.data_->size());
+				public_keys.push_back((const unsigned char *)item.raw_public_key_.c_str());
+				signatures.push_back((const unsigned char *)item.signature_->c_str());
+				indexes.push_back(i);
+			}
+			else {
+				results[i] = Verify(item);
+			}
+		}
+
+		if (indexes.empty()) {
+			return;
+		}
+
+		std::vector<int> valid(indexes.size(), 0);
+		ed25519_sign_open_batch(&messages[0], &message_lens[0], &public_keys[0], &signatures[0], indexes.size(), &valid[0]);
+		for (size_t j = 0; j < indexes.size(); j++) {
+			results[indexes[j]] = (valid[j] == 1);
+		}
+	}
+
+	utils::Mutex VerifiedSignatureCache::mutex_;
+	std::unordered_set<VerifiedSignatureCache::Entry, VerifiedSignatureCache::EntryHash> VerifiedSignatureCache::entries_;
+	std::deque<VerifiedSignatureCache::Entry> VerifiedSignatureCache::order_;
+	int64_t VerifiedSignatureCache::hit_count_ = 0;
+	int64_t VerifiedSignatureCache::miss_count_ = 0;
+	int64_t VerifiedSignatureCache::failed_count_ = 0;
+
+	VerifiedSignatureCache::Entry VerifiedSignatureCache::Digest(SignatureType type, const std::string &raw_public_key, const std::string &signature, const std::string &data) {
+		struct Key {
+			unsigned char bytes_[utils::SipHash::KEY_SIZE];
+			Key() {
+				std::string random;
+				if (!utils::GetStrongRandBytes(random) || random.size() < sizeof(bytes_)) {
+					random = utils::Sha256::Crypto(utils::String::ToString(utils::Timestamp::HighResolution()));
+				}
+				memcpy(bytes_, random.c_str(), sizeof(bytes_));
+			}
+		};
+		static const Key key;
+
+		//Hash the data first, so that a large message is not copied
+		uint64_t data_digest[2];
+		utils::SipHash::Hash128(key.bytes_, data.c_str(), data.size(), data_digest);
+
+		std::string input;
+		input.reserve(1 + raw_public_key.size() + signature.size() + sizeof(data_digest));
+		input.push_back((char)type);
+		input.append(raw_public_key);
+		input.append(signature);
+		input.append((const char *)data_digest, sizeof(data_digest));
+
+		uint64_t out[2];
+		utils::SipHash::Hash128(key.bytes_, input.c_str(), input.size(), out);
+		Entry entry;
+		entry.low_ = out[0];
+		entry.high_ = out[1];
+		return entry;
+	}
+
+	bool VerifiedSignatureCache::Find(const Entry &entry) {
+		utils::MutexGuard guard(mutex_);
+		if (entries_.find(entry) != entries_.end()) {
+			hit_count_++;
+			return true;
+		}
+		miss_count_++;
+		return false;
+	}
+
+	void VerifiedSignatureCache::Insert(const Entry &entry) {
+		utils::MutexGuard guard(mutex_);
+		if (!entries_.insert(entry).second) {
+			return;
+		}
+
+		order_.push_back(entry);
+		while (order_.size() > MAX_SIZE) {
+			entries_.erase(order_.front());
+			order_.pop_front();
+		}
+	}
+
+	bool VerifiedSignatureCache::Verify(const std::string &data, const std::string &signature, const std::string &encode_public_key) {
+		PrivateKeyPrefix prefix;
+		SignatureType sign_type;
+		std::string raw_pubkey;
+		bool valid = GetPublicKeyElement(encode_public_key, prefix, sign_type, raw_pubkey);
+		if (!valid || prefix != PUBLICKEY_PREFIX) {
+			return false;
+		}
+
+		Entry entry = Digest(sign_type, raw_pubkey, signature, data);
+		if (Find(entry)) {
+			return true;
+		}
+
+		if (!PublicKey::Verify(data, signature, encode_public_key)) {
+			utils::MutexGuard guard(mutex_);
+			failed_count_++;
+			return false;
+		}
+
+		Insert(entry);
+		return true;
+	}
+
+	void VerifiedSignatureCache::Verify(const std::vector<SignatureItem> &items, std::vector<bool> &results) {
+		results.assign(items.size(), false);
+		for (size_t i = 0; i < items.size(); i++) {
+			const SignatureItem &item = items[i];
+			Entry entry = Digest(item.type_, item.raw_public_key_, *item.signature_, *item.data_);
+			if (Find(entry)) {
+				results[i] = true;
+			}
+			else if (PublicKey::Verify(item)) {
+				results[i] = true;
+				Insert(entry);
+			}
+			else {
+				utils::MutexGuard guard(mutex_);
+				failed_count_++;
+			}
+		}
+	}
+
+	void VerifiedSignatureCache::GetModuleStatus(Json::Value &data) {
+		utils::MutexGuard guard(mutex_);
+		data["size"] = (Json::UInt64)entries_.size();
+		data["hit"] = hit_count_;
+		data["miss"] = miss_count_;
+		data["failed"] = failed_count_;
+	}
+
 	//Generate keypair according to signature type.
 	PrivateKey::PrivateKey(SignatureType type) {
 		std::string raw_pub_key = "";
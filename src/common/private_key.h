@@ -19,6 +19,9 @@
 #include <utils/headers.h>
 #include <3rd/ed25519-donna/ed25519.h>
 #include <utils/ecc_sm2.h>
+#include <json/value.h>
+#include <unordered_set>
+#include <deque>
 
 namespace CEG {
 	typedef unsigned char sm2_public_key[65];
@@ -62,6 +65,14 @@ namespace CEG {
 	SignatureType GetSignTypeByDesc(const std::string &desc);
 	
 
+	//A signature waiting for PublicKey::VerifyBatch
+	struct SignatureItem {
+		const std::string *data_;
+		const std::string *signature_;
+		SignatureType type_;
+		std::string raw_public_key_;
+	};
+
 	class PublicKey {
 		DISALLOW_COPY_AND_ASSIGN(PublicKey);
 		friend class PrivateKey;
@@ -84,13 +95,62 @@ namespace CEG {
 		SignatureType GetSignType() { return type_; };
 
 		static bool Verify(const std::string &data, const std::string &signature, const std::string &encode_public_key);
+		//Same as the above, for a decoded public key
+		static bool Verify(const SignatureItem &item);
+
+		//Ed25519 signatures are verified in batches and checked one by one only when a batch fails.
+		//results[i] is the result of items[i].
+		//The batch equation has no cofactor, so a signature whose points have a small order part may pass it
+		//where Verify rejects it. Such results must not decide the consensus, the ledgers verify one by one.
+		static void VerifyBatch(const std::vector<SignatureItem> &items, std::vector<bool> &results);
 		static bool IsAddressValid(const std::string &encode_address);
 	private:
+		//The signatures with a non canonical S, A or R, or a small order A or R are left out of the batches
+		static bool IsBatchable(const SignatureItem &item);
+
 		std::string raw_pub_key_;
 		bool valid_;
 		SignatureType type_;
 	};
 
+	//Bounded cache of the signatures which passed the verification, shared by the consensus and the ledger sync.
+	//The commits of the validators are verified when they arrive, so the proofs of the closed and synced ledgers hit here.
+	//An entry is the keyed SipHash-128 of the signature type, the raw public key, the signature and the data digest,
+	//with a random key for each process. Failed signatures are never cached.
+	class VerifiedSignatureCache {
+		struct Entry {
+			uint64_t low_;
+			uint64_t high_;
+			bool operator==(const Entry &other) const {
+				return low_ == other.low_ && high_ == other.high_;
+			}
+		};
+		struct EntryHash {
+			size_t operator()(const Entry &entry) const { return (size_t)entry.low_; }
+		};
+
+		static const size_t MAX_SIZE = 64 * 1024;
+
+		static utils::Mutex mutex_;
+		static std::unordered_set<Entry, EntryHash> entries_;
+		//Insertion order, the oldest entry is evicted first
+		static std::deque<Entry> order_;
+		static int64_t hit_count_;
+		static int64_t miss_count_;
+		static int64_t failed_count_;
+
+		static Entry Digest(SignatureType type, const std::string &raw_public_key, const std::string &signature, const std::string &data);
+		static bool Find(const Entry &entry);
+		static void Insert(const Entry &entry);
+	public:
+		//Same as PublicKey::Verify
+		static bool Verify(const std::string &data, const std::string &signature, const std::string &encode_public_key);
+		//The misses are verified one by one with PublicKey::Verify, the batch equation accepts a different set
+		//of signatures and is not used on the consensus paths
+		static void Verify(const std::vector<SignatureItem> &items, std::vector<bool> &results);
+		static void GetModuleStatus(Json::Value &data);
+	};
+
 	class PrivateKey {
 		DISALLOW_COPY_AND_ASSIGN(PrivateKey);
 	public:
@@ -19,6 +19,14 @@
 #include <utils/file.h>
 #include "storage.h"
 #include "general.h"
+#ifndef WIN32
+#include <rocksdb/cache.h>
+#include <rocksdb/filter_policy.h>
+#include <rocksdb/rate_limiter.h>
+#include <rocksdb/slice_transform.h>
+#include <rocksdb/statistics.h>
+#include <rocksdb/table.h>
+#endif
 #define CEG_ROCKSDB_MAX_OPEN_FILES 5000
 
 namespace CEG {
@@ -90,6 +98,19 @@ namespace CEG {
 		return ret;
 	}
 
+	bool LevelDbDriver::MultiGet(const std::vector<std::string> &keys, std::vector<std::string> &values, std::vector<int32_t> &results) {
+		values.assign(keys.size(), std::string());
+		results.assign(keys.size(), 0);
+		bool ret = true;
+		for (size_t i = 0; i < keys.size(); i++) {
+			results[i] = Get(keys[i], values[i]);
+			if (results[i] < 0) {
+				ret = false;
+			}
+		}
+		return ret;
+	}
+
 	bool LevelDbDriver::Put(const std::string &key, const std::string &value) {
 		assert(db_ != NULL);
 		leveldb::WriteOptions opt;
@@ -133,7 +154,73 @@ namespace CEG {
 
 #else
 
-	RocksDbDriver::RocksDbDriver() {
+	//Prefix of the keys composed by ComposePrefix, which is the tag up to the first '_'.
+	//Keys without a tag, such as the nodes of the account trie, use their first bytes.
+	class ComposePrefixTransform : public rocksdb::SliceTransform {
+	public:
+		static const size_t MAX_PREFIX_SIZE = 8;
+
+		virtual const char* Name() const override {
+			return "CEG.ComposePrefix";
+		}
+
+		virtual rocksdb::Slice Transform(const rocksdb::Slice& src) const override {
+			size_t size = src.size();
+			if (size > MAX_PREFIX_SIZE) {
+				size = MAX_PREFIX_SIZE;
+			}
+			for (size_t i = 0; i < size; i++) {
+				if (src[i] == '_') {
+					return rocksdb::Slice(src.data(), i + 1);
+				}
+			}
+			return rocksdb::Slice(src.data(), size);
+		}
+
+		virtual bool InDomain(const rocksdb::Slice& src) const override {
+			return true;
+		}
+
+		virtual bool InRange(const rocksdb::Slice& dst) const override {
+			return false;
+		}
+	};
+
+	static rocksdb::CompressionType CompressionFromString(const std::string &name) {
+		if (name == "snappy") return rocksdb::kSnappyCompression;
+		if (name == "zlib") return rocksdb::kZlibCompression;
+		if (name == "bzip2") return rocksdb::kBZip2Compression;
+		if (name == "lz4") return rocksdb::kLZ4Compression;
+		if (name == "lz4hc") return rocksdb::kLZ4HCCompression;
+		return rocksdb::kNoCompression;
+	}
+
+	std::shared_ptr<rocksdb::Cache> RocksDbDriver::block_cache_;
+	std::shared_ptr<rocksdb::RateLimiter> RocksDbDriver::rate_limiter_;
+
+	void RocksDbDriver::InitSharedResources(const DbConfigure &db_config) {
+		if (db_config.block_cache_size_ > 0) {
+			block_cache_ = rocksdb::NewLRUCache((size_t)db_config.block_cache_size_ * utils::BYTES_PER_MEGA);
+		}
+
+		if (db_config.compaction_rate_limit_ > 0) {
+			rate_limiter_.reset(rocksdb::NewGenericRateLimiter(db_config.compaction_rate_limit_ * utils::BYTES_PER_MEGA));
+		}
+
+		//The databases share the compaction threads of the default env
+		int32_t compaction_threads = db_config.keyvalue_options_.max_background_compactions_;
+		if (db_config.ledger_options_.max_background_compactions_ > compaction_threads) {
+			compaction_threads = db_config.ledger_options_.max_background_compactions_;
+		}
+		if (db_config.account_options_.max_background_compactions_ > compaction_threads) {
+			compaction_threads = db_config.account_options_.max_background_compactions_;
+		}
+		if (compaction_threads > 1) {
+			rocksdb::Env::Default()->SetBackgroundThreads(compaction_threads, rocksdb::Env::LOW);
+		}
+	}
+
+	RocksDbDriver::RocksDbDriver(const DbOptionsConfigure &profile) :profile_(profile) {
 		db_ = NULL;
 	}
 
@@ -151,6 +238,41 @@ namespace CEG {
 			options.max_open_files = max_open_files;
 		}
 		options.create_if_missing = true;
+
+		rocksdb::BlockBasedTableOptions table_options;
+		if (block_cache_) {
+			table_options.block_cache = block_cache_;
+		}
+		if (profile_.block_size_ > 0) {
+			table_options.block_size = (size_t)profile_.block_size_ * utils::BYTES_PER_KILO;
+		}
+		if (profile_.bloom_bits_per_key_ > 0) {
+			table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(profile_.bloom_bits_per_key_, false));
+		}
+		table_options.whole_key_filtering = profile_.whole_key_filtering_;
+		options.table_factory.reset(rocksdb::NewBlockBasedTableFactory(table_options));
+
+		if (profile_.prefix_extractor_) {
+			options.prefix_extractor.reset(new ComposePrefixTransform());
+			options.memtable_prefix_bloom_bits = 100000;
+		}
+
+		if (profile_.write_buffer_size_ > 0) {
+			options.write_buffer_size = (size_t)profile_.write_buffer_size_ * utils::BYTES_PER_MEGA;
+		}
+		if (profile_.max_background_compactions_ > 0) {
+			options.max_background_compactions = profile_.max_background_compactions_;
+		}
+		if (!profile_.compression_per_level_.empty()) {
+			for (auto it = profile_.compression_per_level_.begin(); it != profile_.compression_per_level_.end(); it++) {
+				options.compression_per_level.push_back(CompressionFromString(*it));
+			}
+		}
+
+		options.rate_limiter = rate_limiter_;
+		statistics_ = rocksdb::CreateDBStatistics();
+		options.statistics = statistics_;
+
 		rocksdb::Status status = rocksdb::DB::Open(options, db_path, &db_);
 		if (!status.ok()) {
 			utils::MutexGuard guard(mutex_);
@@ -181,6 +303,35 @@ namespace CEG {
 		}
 	}
 
+	bool RocksDbDriver::MultiGet(const std::vector<std::string> &keys, std::vector<std::string> &values, std::vector<int32_t> &results) {
+		assert(db_ != NULL);
+		std::vector<rocksdb::Slice> slices;
+		slices.reserve(keys.size());
+		for (size_t i = 0; i < keys.size(); i++) {
+			slices.push_back(rocksdb::Slice(keys[i]));
+		}
+
+		values.clear();
+		std::vector<rocksdb::Status> status = db_->MultiGet(rocksdb::ReadOptions(), slices, &values);
+		results.assign(keys.size(), 0);
+		bool ret = true;
+		for (size_t i = 0; i < status.size(); i++) {
+			if (status[i].ok()) {
+				results[i] = 1;
+			}
+			else if (status[i].IsNotFound()) {
+				results[i] = 0;
+			}
+			else {
+				results[i] = -1;
+				ret = false;
+				utils::MutexGuard guard(mutex_);
+				error_desc_ = status[i].ToString();
+			}
+		}
+		return ret;
+	}
+
 	bool RocksDbDriver::Put(const std::string &key, const std::string &value) {
 		assert(db_ != NULL);
 		rocksdb::WriteOptions opt;
@@ -218,11 +369,44 @@ namespace CEG {
 	}
 
 	void* RocksDbDriver::NewIterator() {
-		return db_->NewIterator(rocksdb::ReadOptions());
+		//Iterate over all the keys even though a prefix extractor is set
+		rocksdb::ReadOptions read_options;
+		read_options.total_order_seek = true;
+		return db_->NewIterator(read_options);
 	}
 
 	bool RocksDbDriver::GetOptions(Json::Value &options) {
+		Json::Value &profile = options["profile"];
+		profile["block_size"] = profile_.block_size_;
+		profile["bloom_bits_per_key"] = profile_.bloom_bits_per_key_;
+		profile["whole_key_filtering"] = profile_.whole_key_filtering_;
+		profile["prefix_extractor"] = profile_.prefix_extractor_;
+		profile["write_buffer_size"] = profile_.write_buffer_size_;
+		profile["max_background_compactions"] = profile_.max_background_compactions_;
+		for (auto it = profile_.compression_per_level_.begin(); it != profile_.compression_per_level_.end(); it++) {
+			profile["compression_per_level"].append(*it);
+		}
+
+		if (block_cache_) {
+			options["block_cache"]["capacity"] = (Json::UInt64)block_cache_->GetCapacity();
+			options["block_cache"]["usage"] = (Json::UInt64)block_cache_->GetUsage();
+		}
+
+		if (statistics_) {
+			options["block_cache"]["hit"] = (Json::UInt64)statistics_->getTickerCount(rocksdb::BLOCK_CACHE_HIT);
+			options["block_cache"]["miss"] = (Json::UInt64)statistics_->getTickerCount(rocksdb::BLOCK_CACHE_MISS);
+			options["bloom_filter_useful"] = (Json::UInt64)statistics_->getTickerCount(rocksdb::BLOOM_FILTER_USEFUL);
+			options["compaction"]["read_bytes"] = (Json::UInt64)statistics_->getTickerCount(rocksdb::COMPACT_READ_BYTES);
+			options["compaction"]["write_bytes"] = (Json::UInt64)statistics_->getTickerCount(rocksdb::COMPACT_WRITE_BYTES);
+		}
+
 		std::string out;
+		db_->GetProperty("rocksdb.compaction-pending", &out);
+		options["compaction"]["pending"] = out;
+
+		db_->GetProperty("rocksdb.estimate-num-keys", &out);
+		options["rocksdb.estimate-num-keys"] = out;
+
 		db_->GetProperty("rocksdb.estimate-table-readers-mem", &out);
 		options["rocksdb.estimate-table-readers-mem"] = out;
 
@@ -269,7 +453,7 @@ namespace CEG {
 				do {
 					//Check only for linux or mac whether the account db can be opened.
 #ifndef WIN32
-					KeyValueDb *account_db = NewKeyValueDb(db_config);
+					KeyValueDb *account_db = NewKeyValueDb(db_config, db_config.account_options_);
 					if (!account_db->Open(db_config.account_db_path_, -1)) {
 						LOG_ERROR("Failed to drop db.Error description(%s)", account_db->error_desc().c_str());
 						delete account_db;
@@ -334,21 +518,24 @@ namespace CEG {
 			LOG_INFO("Assigned number of file handles in mac os, max :%d, keyvaule used:%d, ledger used:%d, account used:%d:",
 				max_open_files, keyvaule_max_open_files, ledger_max_open_files, account_max_open_files);
 #endif
-			keyvalue_db_ = NewKeyValueDb(db_config);
+#ifndef WIN32
+			RocksDbDriver::InitSharedResources(db_config);
+#endif
+			keyvalue_db_ = NewKeyValueDb(db_config, db_config.keyvalue_options_);
 			if (!keyvalue_db_->Open(db_config.keyvalue_db_path_, keyvaule_max_open_files)) {
 				LOG_ERROR("Failed to open keyvalue db path(%s), the reason is(%s)\n",
 					db_config.keyvalue_db_path_.c_str(), keyvalue_db_->error_desc().c_str());
 				break;
 			}
 
-			ledger_db_ = NewKeyValueDb(db_config);
+			ledger_db_ = NewKeyValueDb(db_config, db_config.ledger_options_);
 			if (!ledger_db_->Open(db_config.ledger_db_path_, ledger_max_open_files)) {
 				LOG_ERROR("Failed to open ledger db path(%s), the reason is(%s)\n",
 					db_config.ledger_db_path_.c_str(), ledger_db_->error_desc().c_str());
 				break;
 			}
 
-			account_db_ = NewKeyValueDb(db_config);
+			account_db_ = NewKeyValueDb(db_config, db_config.account_options_);
 			if (!account_db_->Open(db_config.account_db_path_, account_max_open_files)) {
 				LOG_ERROR("Failed to open account db path(%s), the reason is(%s)\n",
 					db_config.account_db_path_.c_str(), account_db_->error_desc().c_str());
@@ -407,12 +594,12 @@ namespace CEG {
 		return account_db_;
 	}
 
-	KeyValueDb *Storage::NewKeyValueDb(const DbConfigure &db_config) {
+	KeyValueDb *Storage::NewKeyValueDb(const DbConfigure &db_config, const DbOptionsConfigure &profile) {
 		KeyValueDb *db = NULL;
 #ifdef WIN32
 		db = new LevelDbDriver();
 #else
-		db = new RocksDbDriver();
+		db = new RocksDbDriver(profile);
 #endif
 
 		return db;
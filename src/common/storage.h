@@ -48,10 +48,12 @@ namespace CEG {
 		std::string error_desc_;
 	public:
 		KeyValueDb();
-		~KeyValueDb();
+		virtual ~KeyValueDb();
 		virtual bool Open(const std::string &db_path, int max_open_files) = 0;
 		virtual bool Close() = 0;
 		virtual int32_t Get(const std::string &key, std::string &value) = 0;
+		//Read the keys in one call, results[i] is what Get would return for keys[i]. Return false if any read failed.
+		virtual bool MultiGet(const std::vector<std::string> &keys, std::vector<std::string> &values, std::vector<int32_t> &results) = 0;
 		virtual bool Put(const std::string &key, const std::string &value) = 0;
 		virtual bool Delete(const std::string &key) = 0;
 		virtual bool GetOptions(Json::Value &options) = 0;
@@ -75,6 +77,7 @@ namespace CEG {
 		bool Open(const std::string &db_path, int max_open_files);
 		bool Close();
 		int32_t Get(const std::string &key, std::string &value);
+		bool MultiGet(const std::vector<std::string> &keys, std::vector<std::string> &values, std::vector<int32_t> &results);
 		bool Put(const std::string &key, const std::string &value);
 		bool Delete(const std::string &key);
 		bool GetOptions(Json::Value &options);
@@ -86,14 +89,24 @@ namespace CEG {
 	class RocksDbDriver : public KeyValueDb {
 	private:
 		rocksdb::DB* db_;
+		DbOptionsConfigure profile_;
+		std::shared_ptr<rocksdb::Statistics> statistics_;
+
+		//Shared by all the databases of the process
+		static std::shared_ptr<rocksdb::Cache> block_cache_;
+		static std::shared_ptr<rocksdb::RateLimiter> rate_limiter_;
 
 	public:
-		RocksDbDriver();
+		RocksDbDriver(const DbOptionsConfigure &profile = DbOptionsConfigure());
 		~RocksDbDriver();
 
+		//Create the block cache and the compaction rate limiter before opening the databases
+		static void InitSharedResources(const DbConfigure &db_config);
+
 		bool Open(const std::string &db_path, int max_open_files);
 		bool Close();
 		int32_t Get(const std::string &key, std::string &value);
+		bool MultiGet(const std::vector<std::string> &keys, std::vector<std::string> &values, std::vector<int32_t> &results);
 		bool Put(const std::string &key, const std::string &value);
 		bool Delete(const std::string &key);
 		bool GetOptions(Json::Value &options);
@@ -116,9 +129,10 @@ namespace CEG {
 		bool CloseDb();
 		bool DescribeTable(const std::string &name, const std::string &sql_create_table);
 		bool ManualDescribeTables();
-
-		KeyValueDb *NewKeyValueDb(const DbConfigure &db_config);
 	public:
+		//Create a database driver, the caller opens and deletes it
+		KeyValueDb *NewKeyValueDb(const DbConfigure &db_config, const DbOptionsConfigure &profile);
+
 		bool Initialize(const DbConfigure &db_config, bool bdropdb);
 		bool Exit();
 
@@ -24,7 +24,9 @@ namespace CEG {
 		fault_number_(0),
 		view_active_(true),
 		new_view_repond_timer_(0),
-		last_check_time_(utils::Timestamp::HighResolution()) {
+		last_check_time_(utils::Timestamp::HighResolution()),
+		validator_keys_limit_(0),
+		validator_keys_version_(0) {
 		name_ = "pbft";
 
 		//Load from the configuration.
@@ -166,6 +168,7 @@ namespace CEG {
 			}
 
 			Consensus::UpdateValidators(proto_validators);
+			ResetValidatorKeys();
 		} while (false);
 
 		return 1;
@@ -354,23 +357,54 @@ namespace CEG {
 		return pbft.type();
 	}
 
-	bool Pbft::CheckMessageItem(const protocol::PbftEnv &env) {
-		return CheckMessageItem(env, validators_);
+	void Pbft::ResetValidatorKeys() {
+		utils::MutexGuard guard(validator_keys_lock_);
+		validator_keys_.clear();
+		validator_keys_version_++;
+		//The same key may come in a few encodings, keep room for them but do not let the peers grow the table
+		validator_keys_limit_ = validators_.size() * 2;
+		if (replica_id_ >= 0) {
+			validator_keys_[private_key_.GetEncPublicKey()] = replica_id_;
+		}
 	}
 
-	bool Pbft::CheckMessageItem(const protocol::PbftEnv &env, const ValidatorMap &validators) {
-		//This function should output the error log
-		const protocol::Pbft &pbft = env.pbft();
-		const protocol::Signature &sig = env.signature();
+	int64_t Pbft::ResolveReplicaId(const std::string &encode_public_key) {
+		int64_t version = 0;
+		do {
+			utils::MutexGuard guard(validator_keys_lock_);
+			std::unordered_map<std::string, int64_t>::const_iterator iter = validator_keys_.find(encode_public_key);
+			if (iter != validator_keys_.end()) {
+				return iter->second;
+			}
+			version = validator_keys_version_;
+		} while (false);
 
-		if (pbft.chain_id() != General::GetSelfChainId()){
-			LOG_TRACE("Failed to check same chain, node self id(" FMT_I64 ") is not eq (" FMT_I64 ")",
-				General::GetSelfChainId(), pbft.chain_id());
+		PublicKey public_key(encode_public_key);
+		int64_t replica_id = GetValidatorIndex(public_key.GetEncAddress(), validators_);
+		if (replica_id >= 0) {
+			utils::MutexGuard guard(validator_keys_lock_);
+			if (version == validator_keys_version_ && validator_keys_.size() < validator_keys_limit_) {
+				validator_keys_[encode_public_key] = replica_id;
+			}
+		}
+
+		return replica_id;
+	}
+
+	bool Pbft::CheckMessageItem(const protocol::PbftEnv &env) {
+		int64_t should_replica_id = ResolveReplicaId(env.signature().public_key());
+		if (should_replica_id < 0) {
+			PublicKey public_key(env.signature().public_key());
+			LOG_ERROR("Unable to find validator(%s) from list", public_key.GetEncAddress().c_str());
 			return false;
 		}
 
+		return CheckMessageItem(env, should_replica_id, validators_, true);
+	}
+
+	bool Pbft::CheckMessageItem(const protocol::PbftEnv &env, const ValidatorMap &validators, bool check_signature) {
 		//Get the node address
-		PublicKey public_key(sig.public_key());
+		PublicKey public_key(env.signature().public_key());
 
 		//Check the node id to see if it exists in the validator' list
 		int64_t should_replica_id = GetValidatorIndex(public_key.GetEncAddress(), validators);
@@ -379,6 +413,20 @@ namespace CEG {
 			return false;
 		}
 
+		return CheckMessageItem(env, should_replica_id, validators, check_signature);
+	}
+
+	bool Pbft::CheckMessageItem(const protocol::PbftEnv &env, int64_t should_replica_id, const ValidatorMap &validators, bool check_signature) {
+		//This function should output the error log
+		const protocol::Pbft &pbft = env.pbft();
+		const protocol::Signature &sig = env.signature();
+
+		if (pbft.chain_id() != General::GetSelfChainId()){
+			LOG_TRACE("Failed to check same chain, node self id(" FMT_I64 ") is not eq (" FMT_I64 ")",
+				General::GetSelfChainId(), pbft.chain_id());
+			return false;
+		}
+
 		//Check pbft type is no larger than max
 		int64_t replica_id = -1;
 		switch (pbft.type()) {
@@ -457,7 +505,7 @@ namespace CEG {
 		}
 
 		//Check the signature
-		if (!PublicKey::Verify(pbft.SerializeAsString(), sig.sign_data(), sig.public_key())) {
+		if (check_signature && !VerifiedSignatureCache::Verify(pbft.SerializeAsString(), sig.sign_data(), sig.public_key())) {
 			LOG_ERROR("Failed to check received message's signature, desc(%s)", PbftDesc::GetPbft(pbft).c_str());
 			return false;
 		}
@@ -576,13 +624,14 @@ namespace CEG {
 		LOG_INFO("Received trace out commit message from replica(" FMT_I64 "): view number(" FMT_I64 "), sequence(" FMT_I64 "), round number(%u)",
 			commit.replica_id(), commit.view_number(), commit.sequence(), pbft.round_number());
 		instance_exist.commits_.insert(std::make_pair(commit.replica_id(), commit));
+		instance_exist.commit_votes_.Add(commit.replica_id());
 		TryDoTraceOut(index, instance_exist);
 
 		return true;
 	}
 
 	void Pbft::TryDoTraceOut(const PbftInstanceIndex &index, const PbftInstance &instance) {
-		if (instance.commits_.size() >= GetQuorumSize() + 1 /*&& instance.pre_prepare_.has_value()*/) {
+		if (instance.commit_votes_.Count() >= GetQuorumSize() + 1 /*&& instance.pre_prepare_.has_value()*/) {
 			LOG_INFO("commited trace out pbft, vn(" FMT_I64 "), seq(" FMT_I64 ")", index.view_number_, index.sequence_);
 			if (index.sequence_ - last_exe_seq_ >= ckp_interval_) {
 				LOG_INFO("The trace out pbft's sequence(" FMT_I64 ") is larger than the last execution sequence(" FMT_I64 ") for checkpoint interval(" FMT_I64 "),then try to move watermark.",
@@ -841,16 +890,14 @@ namespace CEG {
 		LOG_INFO("Received prepare message from replica id(" FMT_I64 "): view number(" FMT_I64 "),sequence(" FMT_I64 "), round number(" FMT_I64 ")",
 			prepare.replica_id(), prepare.view_number(), prepare.sequence(), pbft.round_number());
 
-		bool exist = false;
-		PbftPrepareMap::iterator iter_prepare = pinstance.prepares_.find(prepare.replica_id());
-		if (iter_prepare != pinstance.prepares_.end()) {
+		bool exist = !pinstance.prepare_votes_.Add(prepare.replica_id());
+		if (exist) {
 			LOG_INFO("The prepare message(view number:" FMT_I64 ", sequence:" FMT_I64 ", round number: %u) has been received duplicated, desc(%s)",
 				prepare.view_number(), prepare.sequence(), pbft.round_number(), PbftDesc::GetPbft(pbft).c_str());
-			exist = true;
 		}
 
 		pinstance.prepares_.insert(std::make_pair(prepare.replica_id(), prepare));
-		if (pinstance.prepares_.size() >= GetQuorumSize()) {
+		if (pinstance.prepare_votes_.Count() >= GetQuorumSize()) {
 
 			if (pinstance.phase_ < PBFT_PHASE_PREPARED) {  //Detect and receive again
 				pinstance.phase_ = PBFT_PHASE_PREPARED;
@@ -882,8 +929,7 @@ namespace CEG {
 			return false;
 		}
 
-		PbftCommitMap::iterator iter_commit = pinstance.commits_.find(commit.replica_id());
-		if (iter_commit != pinstance.commits_.end()) {
+		if (!pinstance.commit_votes_.Add(commit.replica_id())) {
 			LOG_INFO("The prepare message(view number:" FMT_I64 ", sequence:" FMT_I64 ") has been received and duplicated",
 				commit.view_number(), commit.sequence());
 			return true;
@@ -892,7 +938,7 @@ namespace CEG {
 		LOG_INFO("Received commit message from replica(" FMT_I64 "): view number(" FMT_I64 "), sequence(" FMT_I64 "), round number(%u)",
 			commit.replica_id(), commit.view_number(), commit.sequence(), pbft.round_number());
 		pinstance.commits_.insert(std::make_pair(commit.replica_id(), commit));
-		if (pinstance.commits_.size() >= GetQuorumSize() + 1 && pinstance.phase_ < PBFT_PHASE_COMMITED) {
+		if (pinstance.commit_votes_.Count() >= GetQuorumSize() + 1 && pinstance.phase_ < PBFT_PHASE_COMMITED) {
 			pinstance.phase_ = PBFT_PHASE_COMMITED;
 			pinstance.phase_item_ = 0;
 			pinstance.end_time_ = utils::Timestamp::HighResolution();
@@ -1556,6 +1602,11 @@ namespace CEG {
 		data["validator_address"] = private_key_.GetEncAddress();
 		data["validator_address_random"] = validation_random;
 		data["leader"] = CurrentLeader();
+		VerifiedSignatureCache::GetModuleStatus(data["signature_cache"]);
+		do {
+			utils::MutexGuard guard(validator_keys_lock_);
+			data["validator_keys"] = (Json::UInt64)validator_keys_.size();
+		} while (false);
 		Json::Value &instances = data["instances"];
 		for (PbftInstanceMap::const_iterator iter = instances_.begin(); iter != instances_.end(); iter++) {
 			const PbftInstance &instance = iter->second;
@@ -1712,6 +1763,7 @@ namespace CEG {
 		if (validator_changed ){
 			//Update the validators
 			Consensus::UpdateValidators(validators);
+			ResetValidatorKeys();
 
 			if (validators_.size() < 4) {
 				LOG_WARN("Pbft couldn't tolerate fault node when validator size =" FMT_SIZE ".", validators_.size());
@@ -1789,10 +1841,13 @@ namespace CEG {
 			return false;
 		}
 
+		//The signatures are verified at the end, most of them were cached when the commits arrived
+		std::vector<std::string> datas(pbft_evidence.commits_size());
+		std::vector<SignatureItem> items;
 		for (int32_t i = 0; i < pbft_evidence.commits_size(); i++) {
 			const protocol::PbftEnv &env = pbft_evidence.commits(i);
 			const protocol::Pbft &pbft = env.pbft();
-			if (!CheckMessageItem(env, temp_vs)) {
+			if (!CheckMessageItem(env, temp_vs, false)) {
 				LOG_ERROR("Failed to check proof message item: validators:(%s), hash(%s), proof(%s), total_size(" FMT_SIZE "), qsize(" FMT_SIZE "), counter(" FMT_I64 ")", 
 					Proto2Json(validators).toFastString().c_str(), utils::String::BinToHexString(previous_value_hash).c_str(), 
 					Proto2Json(pbft_evidence).toFastString().c_str(),
@@ -1822,6 +1877,23 @@ namespace CEG {
 			}
 
 			temp_vs.erase(address);
+
+			datas[i] = pbft.SerializeAsString();
+			SignatureItem item;
+			item.data_ = &datas[i];
+			item.signature_ = &sign.sign_data();
+			item.type_ = pub_key.GetSignType();
+			item.raw_public_key_ = pub_key.GetRawPublicKey();
+			items.push_back(item);
+		}
+
+		std::vector<bool> results;
+		VerifiedSignatureCache::Verify(items, results);
+		for (size_t i = 0; i < results.size(); i++) {
+			if (!results[i]) {
+				LOG_ERROR("Failed to check proof, because the signature of commit(" FMT_SIZE ") is not valid", i);
+				return false;
+			}
 		}
 
 		if (total_size - temp_vs.size() >= qsize) {
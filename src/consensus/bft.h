@@ -54,6 +54,17 @@ namespace CEG {
 		//For abnormal records
 		std::unordered_map<std::string, int64_t> abnormal_records_;
 
+		//Encoded public key of the signatures => replica id, so the address of the sender is not derived for every message.
+		//Only the addresses are on the chain, so it is rebuilt with the own key when the validators change
+		//and the other keys are added as their senders are resolved.
+		std::unordered_map<std::string, int64_t> validator_keys_;
+		size_t validator_keys_limit_;
+		//Bumped by each rebuild, so a key resolved against the old validators is not added
+		int64_t validator_keys_version_;
+		utils::Mutex validator_keys_lock_;
+		void ResetValidatorKeys();
+		int64_t ResolveReplicaId(const std::string &encode_public_key);
+
 		PbftEnvPointer NewPrePrepare(const std::string &value, int64_t sequence);
 		protocol::PbftEnv NewPrePrepare(const protocol::PbftPrePrepare &pre_prepare);
 		PbftEnvPointer NewPrepare(const protocol::PbftPrePrepare &pre_prepare, int64_t round_number);
@@ -76,7 +87,9 @@ namespace CEG {
 		bool TryExecuteValue();
 		static protocol::PbftMessageType GetMessageType(const protocol::PbftEnv &env);
 		bool CheckMessageItem(const protocol::PbftEnv &env);
-		static bool CheckMessageItem(const protocol::PbftEnv &env, const ValidatorMap &validators);
+		//The signature may be left to the caller, to verify it after the other checks of several messages
+		static bool CheckMessageItem(const protocol::PbftEnv &env, const ValidatorMap &validators, bool check_signature = true);
+		static bool CheckMessageItem(const protocol::PbftEnv &env, int64_t should_replica_id, const ValidatorMap &validators, bool check_signature);
 		bool TraceOutPbftCommit(const protocol::PbftEnv &env);
 		bool TraceOutPbftPrePrepare(const protocol::PbftEnv &env);
 		void TryDoTraceOut(const PbftInstanceIndex &index, const PbftInstance &instance);
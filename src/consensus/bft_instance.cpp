@@ -52,6 +52,33 @@ namespace CEG {
 		return false;
 	}
 
+	PbftVoteSet::PbftVoteSet() :count_(0) {}
+
+	PbftVoteSet::~PbftVoteSet() {}
+
+	bool PbftVoteSet::Add(int64_t replica_id) {
+		if (replica_id < 0 || Has(replica_id)) {
+			return false;
+		}
+
+		size_t word = (size_t)replica_id / 64;
+		if (word >= bits_.size()) {
+			bits_.resize(word + 1, 0);
+		}
+		bits_[word] |= (uint64_t)1 << (replica_id % 64);
+		count_++;
+		return true;
+	}
+
+	bool PbftVoteSet::Has(int64_t replica_id) const {
+		if (replica_id < 0) {
+			return false;
+		}
+
+		size_t word = (size_t)replica_id / 64;
+		return word < bits_.size() && (bits_[word] & ((uint64_t)1 << (replica_id % 64))) != 0;
+	}
+
 	PbftInstance::PbftInstance() {
 		phase_ = PBFT_PHASE_NONE;
 		phase_item_ = 0;
@@ -59,6 +59,21 @@ namespace CEG {
 		bool operator < (const PbftInstanceIndex &index) const;
 	};
 
+	//Replica ids which voted in a phase, one bit per validator, so the duplicate and quorum checks are O(1)
+	class PbftVoteSet {
+	public:
+		PbftVoteSet();
+		~PbftVoteSet();
+
+		//Return false if the replica has voted already
+		bool Add(int64_t replica_id);
+		bool Has(int64_t replica_id) const;
+		size_t Count() const { return count_; }
+	private:
+		std::vector<uint64_t> bits_;
+		size_t count_;
+	};
+
 	class Pbft;
 	class PbftInstance {
 	public:
@@ -70,6 +85,8 @@ namespace CEG {
 		protocol::PbftPrePrepare pre_prepare_;
 		PbftPrepareMap prepares_;
 		PbftCommitMap commits_;
+		PbftVoteSet prepare_votes_;
+		PbftVoteSet commit_votes_;
 
 		PbftPhaseVector2 msg_buf_;
 		protocol::PbftEnv pre_prepare_msg_;
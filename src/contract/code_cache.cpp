@@ -0,0 +1,194 @@
+/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <utils/crypto.h>
+#include <utils/logger.h>
+#include <common/general.h>
+#include <common/storage.h>
+#include "code_cache.h"
+
+namespace CEG {
+
+	CodeCache::CodeCache() :
+		lru_(0),
+		capacity_(0),
+		persist_(false),
+		hits_(0),
+		misses_(0),
+		rejected_(0),
+		saved_time_(0) {}
+
+	CodeCache::~CodeCache() {}
+
+	void CodeCache::Initialize(size_t capacity, bool persist) {
+		utils::MutexGuard guard(mutex_);
+		capacity_ = capacity;
+		persist_ = persist;
+		lru_ = cache::lru_cache<std::string, EntryPointer>(capacity);
+	}
+
+	bool CodeCache::Find(const std::string &key, EntryPointer &entry) {
+		do {
+			utils::MutexGuard guard(mutex_);
+			if (lru_.get(key, entry)) {
+				return true;
+			}
+		} while (false);
+
+		if (!LoadFromDb(key, entry)) {
+			return false;
+		}
+
+		utils::MutexGuard guard(mutex_);
+		lru_.put(key, entry);
+		return true;
+	}
+
+	bool CodeCache::LoadFromDb(const std::string &key, EntryPointer &entry) {
+		if (!persist_) {
+			return false;
+		}
+
+		std::string value;
+		KeyValueDb *db = Storage::Instance().keyvalue_db();
+		if (db->Get(ComposePrefix(General::CODE_CACHE_PREFIX, utils::String::BinToHexString(key)), value) <= 0) {
+			return false;
+		}
+
+		//Version tag of V8, compile time, code
+		uint32_t tag = 0;
+		int64_t compile_time = 0;
+		if (value.size() <= sizeof(tag) + sizeof(compile_time)) {
+			return false;
+		}
+		memcpy(&tag, value.data(), sizeof(tag));
+		memcpy(&compile_time, value.data() + sizeof(tag), sizeof(compile_time));
+		if (tag != v8::ScriptCompiler::CachedDataVersionTag()) {
+			return false;
+		}
+
+		entry = std::make_shared<Entry>();
+		entry->data_ = value.substr(sizeof(tag) + sizeof(compile_time));
+		entry->compile_time_ = compile_time;
+		entry->stored_ = true;
+		return true;
+	}
+
+	void CodeCache::StoreToDb(const std::string &key, const Entry &entry) {
+		uint32_t tag = v8::ScriptCompiler::CachedDataVersionTag();
+		std::string value;
+		value.append((const char *)&tag, sizeof(tag));
+		value.append((const char *)&entry.compile_time_, sizeof(entry.compile_time_));
+		value.append(entry.data_);
+
+		KeyValueDb *db = Storage::Instance().keyvalue_db();
+		if (!db->Put(ComposePrefix(General::CODE_CACHE_PREFIX, utils::String::BinToHexString(key)), value)) {
+			LOG_ERROR("Failed to store the compiled code, error desc(%s)", db->error_desc().c_str());
+		}
+	}
+
+	void CodeCache::Remove(const std::string &key) {
+		do {
+			utils::MutexGuard guard(mutex_);
+			lru_.erase_if_exists(key);
+		} while (false);
+
+		if (persist_) {
+			Storage::Instance().keyvalue_db()->Delete(ComposePrefix(General::CODE_CACHE_PREFIX, utils::String::BinToHexString(key)));
+		}
+	}
+
+	v8::MaybeLocal<v8::Script> CodeCache::Compile(v8::Local<v8::Context> context, const std::string &source, const std::string &origin_name) {
+		v8::Isolate *isolate = context->GetIsolate();
+		v8::Local<v8::String> v8src = v8::String::NewFromUtf8(isolate, source.c_str(), v8::NewStringType::kNormal).ToLocalChecked();
+		//An empty name is no origin at all
+		v8::Local<v8::Value> resource_name = v8::Undefined(isolate);
+		if (!origin_name.empty()) {
+			resource_name = v8::String::NewFromUtf8(isolate, origin_name.c_str(), v8::NewStringType::kNormal).ToLocalChecked();
+		}
+		v8::ScriptOrigin origin(resource_name);
+		if (capacity_ == 0) {
+			return v8::Script::Compile(context, v8src, &origin);
+		}
+
+		//The origin is part of the key, the check time calls are only inserted for some origins
+		std::string key = utils::Sha256::Crypto(origin_name + '\0' + source);
+		EntryPointer entry;
+		if (Find(key, entry)) {
+			//The source owns the cached data but not its buffer, the entry outlives both
+			v8::ScriptCompiler::CachedData *cached_data = new v8::ScriptCompiler::CachedData((const uint8_t *)entry->data_.data(), (int)entry->data_.size());
+			v8::ScriptCompiler::Source script_source(v8src, origin, cached_data);
+
+			int64_t begin_time = utils::Timestamp::HighResolution();
+			v8::MaybeLocal<v8::Script> script = v8::ScriptCompiler::Compile(context, &script_source, v8::ScriptCompiler::kConsumeCodeCache);
+			int64_t compile_time = utils::Timestamp::HighResolution() - begin_time;
+
+			//V8 compiles the source again when it rejects the code
+			if (cached_data->rejected) {
+				do {
+					utils::MutexGuard guard(mutex_);
+					rejected_++;
+				} while (false);
+				Remove(key);
+				return script;
+			}
+
+			bool store = false;
+			do {
+				utils::MutexGuard guard(mutex_);
+				hits_++;
+				saved_time_ += entry->compile_time_ - compile_time;
+				if (persist_ && !entry->stored_) {
+					entry->stored_ = true;
+					store = true;
+				}
+			} while (false);
+
+			//Only the sources compiled more than once are written
+			if (store) {
+				StoreToDb(key, *entry);
+			}
+			return script;
+		}
+
+		v8::ScriptCompiler::Source script_source(v8src, origin);
+		int64_t begin_time = utils::Timestamp::HighResolution();
+		v8::MaybeLocal<v8::Script> script = v8::ScriptCompiler::Compile(context, &script_source, v8::ScriptCompiler::kProduceCodeCache);
+		int64_t compile_time = utils::Timestamp::HighResolution() - begin_time;
+
+		const v8::ScriptCompiler::CachedData *cached_data = script_source.GetCachedData();
+		utils::MutexGuard guard(mutex_);
+		misses_++;
+		if (!script.IsEmpty() && cached_data != NULL && cached_data->length > 0) {
+			entry = std::make_shared<Entry>();
+			entry->data_.assign((const char *)cached_data->data, cached_data->length);
+			entry->compile_time_ = compile_time;
+			lru_.put(key, entry);
+		}
+
+		return script;
+	}
+
+	void CodeCache::GetModuleStatus(Json::Value &data) {
+		utils::MutexGuard guard(mutex_);
+		data["capacity"] = (Json::UInt64)capacity_;
+		data["size"] = (Json::UInt64)lru_.size();
+		data["persist"] = persist_;
+		data["hits"] = hits_;
+		data["misses"] = misses_;
+		data["rejected"] = rejected_;
+		data["saved_time"] = saved_time_;
+	}
+}
@@ -0,0 +1,67 @@
+/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTRACT_CODE_CACHE_H_
+#define CONTRACT_CODE_CACHE_H_
+
+#include <v8.h>
+#include <json/json.h>
+#include <utils/thread.h>
+#include <utils/lrucache.hpp>
+
+namespace CEG {
+
+	//Compiled code of contract sources and jslib includes, keyed by the hash of the source.
+	//V8 produces the code on the first compile of a source and consumes it on the next ones,
+	//so hot contracts skip parsing and compiling. Entries are bounded in memory, and an entry
+	//which has been hit is also written to the keyvalue db, so it survives a restart.
+	class CodeCache : public utils::NonCopyable {
+		struct Entry {
+			Entry() :compile_time_(0), stored_(false) {}
+			std::string data_;
+			//Microseconds spent to produce the code
+			int64_t compile_time_;
+			bool stored_;
+		};
+		typedef std::shared_ptr<Entry> EntryPointer;
+
+		utils::Mutex mutex_;
+		cache::lru_cache<std::string, EntryPointer> lru_;
+		size_t capacity_;
+		bool persist_;
+
+		int64_t hits_;
+		int64_t misses_;
+		int64_t rejected_;
+		int64_t saved_time_;
+
+		bool Find(const std::string &key, EntryPointer &entry);
+		bool LoadFromDb(const std::string &key, EntryPointer &entry);
+		void StoreToDb(const std::string &key, const Entry &entry);
+		void Remove(const std::string &key);
+	public:
+		CodeCache();
+		~CodeCache();
+
+		void Initialize(size_t capacity, bool persist);
+
+		//Compile the source in the context like v8::Script::Compile, errors are thrown to the caller's TryCatch
+		v8::MaybeLocal<v8::Script> Compile(v8::Local<v8::Context> context, const std::string &source, const std::string &origin_name);
+
+		void GetModuleStatus(Json::Value &data);
+	};
+}
+
+#endif
@@ -22,18 +22,68 @@
 #include "contract_manager.h"
 
 namespace CEG{
-	ContractManager::ContractManager() {}
+	ContractManager::ContractManager() :watchdog_thread_(NULL), watchdog_cancel_count_(0) {}
 	ContractManager::~ContractManager() {}
 
 	bool ContractManager::Initialize(int argc, char** argv) {
 		V8Contract::Initialize(argc, argv);
+
+		watchdog_thread_ = new utils::Thread(this);
+		if (!watchdog_thread_->Start("contract-watchdog")) {
+			LOG_ERROR("Failed to start the contract watchdog thread");
+			return false;
+		}
 		return true;
 	}
 
 	bool ContractManager::Exit() {
+		if (watchdog_thread_) {
+			watchdog_thread_->JoinWithStop();
+			delete watchdog_thread_;
+			watchdog_thread_ = NULL;
+		}
 		return true;
 	}
 
+	void ContractManager::AddDeadline(Contract *contract) {
+		LedgerContext *ledger_context = contract->GetParameter().ledger_context_;
+		if (ledger_context == NULL || ledger_context->transaction_stack_.empty()) {
+			return;
+		}
+
+		//Zero if the transaction is not checked, as in following the consensus value
+		int64_t end_time = ledger_context->GetBottomTx()->GetMaxEndTime();
+		if (end_time != 0) {
+			deadlines_[contract->GetId()] = end_time;
+		}
+	}
+
+	void ContractManager::Run(utils::Thread *thread) {
+		while (thread->enabled()) {
+			int64_t now = utils::Timestamp::HighResolution();
+			do {
+				utils::MutexGuard guard(contracts_lock_);
+				for (std::map<int64_t, int64_t>::iterator iter = deadlines_.begin(); iter != deadlines_.end();) {
+					if (now <= iter->second) {
+						iter++;
+						continue;
+					}
+
+					//The transaction is then expired by its end time, as if a step had found it
+					ContractMap::iterator contract_iter = contracts_.find(iter->first);
+					if (contract_iter != contracts_.end()) {
+						LOG_TRACE("Cancel contract(" FMT_I64 "), the execution time is expired", iter->first);
+						contract_iter->second->Cancel();
+						watchdog_cancel_count_++;
+					}
+					iter = deadlines_.erase(iter);
+				}
+			} while (false);
+
+			utils::Sleep(WATCHDOG_INTERVAL);
+		}
+	}
+
 	Result ContractManager::SourceCodeCheck(int32_t type, const std::string &code, uint32_t ldcontext_stack_size) {
 		ContractParameter parameter;
 		parameter.code_ = code;
@@ -87,6 +137,7 @@ namespace CEG{
 				contract = new V8Contract(false, paramter);
 				//Add the contract id. Use this ID when cancelling the contract in the future. 
 				contracts_[contract->GetId()] = contract;
+				AddDeadline(contract);
 			}
 			else {
 				ret.set_code(protocol::ERRCODE_CONTRACT_EXECUTE_FAIL);
@@ -104,6 +155,7 @@ namespace CEG{
 				//Delete the contract from map
 				utils::MutexGuard guard(contracts_lock_);
 				contracts_.erase(contract->GetId());
+				deadlines_.erase(contract->GetId());
 				delete contract;
 			} while (false);
 
@@ -130,6 +182,7 @@ namespace CEG{
 				contract = new V8Contract(true, paramter);
 				//Add the contract id. Use this ID when cancelling the contract in the future.
 				contracts_[contract->GetId()] = contract;
+				AddDeadline(contract);
 			}
 			else {
 				LOG_ERROR("Contract type(%d) not supported", type);
@@ -146,6 +199,7 @@ namespace CEG{
 				//Delete the contract from map
 				utils::MutexGuard guard(contracts_lock_);
 				contracts_.erase(contract->GetId());
+				deadlines_.erase(contract->GetId());
 				delete contract;
 			} while (false);
 
@@ -156,18 +210,12 @@ namespace CEG{
 
 	bool ContractManager::Cancel(int64_t contract_id) {
 		//Start another thread to delete the contract sandbox after running the contract.
-		Contract *contract = NULL;
-		do {
-			utils::MutexGuard guard(contracts_lock_);
-			ContractMap::iterator iter = contracts_.find(contract_id);
-			if (iter!= contracts_.end()) {
-				contract = iter->second;
-			} 
-		} while (false);
-
-		if (contract){
-			contract->Cancel();
-		} 
+		//Cancel under the lock, the isolate of a deleted contract may already run another one
+		utils::MutexGuard guard(contracts_lock_);
+		ContractMap::iterator iter = contracts_.find(contract_id);
+		if (iter != contracts_.end()) {
+			iter->second->Cancel();
+		}
 
 		return true;
 	}
@@ -183,4 +231,11 @@ namespace CEG{
 		return NULL;
 	}
 
+	void ContractManager::GetModuleStatus(Json::Value &data) {
+		V8Contract::GetModuleStatus(data["v8_isolate"]);
+		V8Contract::GetCodeCacheStatus(data["code_cache"]);
+
+		utils::MutexGuard guard(contracts_lock_);
+		data["watchdog_cancel"] = watchdog_cancel_count_;
+	}
 }
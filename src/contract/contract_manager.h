@@ -21,11 +21,22 @@
 namespace CEG{
 
 	class ContractManager :
-		public utils::Singleton<ContractManager>{
+		public utils::Singleton<ContractManager>,
+		public utils::Runnable {
 		friend class utils::Singleton<ContractManager>;
 
 		utils::Mutex contracts_lock_;
 		ContractMap contracts_;
+
+		//Watchdog of the execution time. A contract still running after the end time of its
+		//transaction is cancelled, the steps only sample the time.
+		std::map<int64_t, int64_t> deadlines_;
+		utils::Thread *watchdog_thread_;
+		int64_t watchdog_cancel_count_;
+		static const int64_t WATCHDOG_INTERVAL = 10; //Milliseconds
+
+		void AddDeadline(Contract *contract);
+		virtual void Run(utils::Thread *thread) override;
 	public:
 		ContractManager();
 		~ContractManager();
@@ -38,6 +49,7 @@ namespace CEG{
 		bool Cancel(int64_t contract_id);
 		Result SourceCodeCheck(int32_t type, const std::string &code, uint32_t ldcontext_stack_size);
 		Contract *GetContract(int64_t contract_id);
+		void GetModuleStatus(Json::Value &data);
 	};
 }
 #endif
@@ -37,27 +37,114 @@ namespace CEG {
 	//for check source
 	const std::string V8Contract::call_jslint_ = "callJslint";
 
-	utils::Mutex V8Contract::isolate_to_contract_mutex_;
-	std::unordered_map<v8::Isolate*, V8Contract *> V8Contract::isolate_to_contract_;
 
 	v8::Platform* V8Contract::platform_ = nullptr;
 	v8::Isolate::CreateParams V8Contract::create_params_;
+	CodeCache V8Contract::code_cache_;
 
-	V8Contract::V8Contract(bool readonly, const ContractParameter &parameter) : Contract(readonly, parameter) {
-		type_ = TYPE_V8;
-		isolate_ = v8::Isolate::New(create_params_);
+	utils::Mutex V8Contract::idle_isolates_mutex_;
+	std::vector<V8Contract::PooledIsolate *> V8Contract::idle_isolates_;
+	int64_t V8Contract::isolate_created_count_ = 0;
+	int64_t V8Contract::isolate_reused_count_ = 0;
+	int64_t V8Contract::isolate_disposed_count_ = 0;
 
-		utils::MutexGuard guard(isolate_to_contract_mutex_);
-		isolate_to_contract_[isolate_] = this;
+	V8Contract::V8Contract(bool readonly, const ContractParameter &parameter) : Contract(readonly, parameter), cancelled_(false) {
+		type_ = TYPE_V8;
+		pooled_ = CheckOutIsolate();
+		isolate_ = pooled_->isolate_;
+		isolate_->SetData(CONTRACT_DATA_SLOT, this);
 	}
 
 	V8Contract::~V8Contract() {
-		utils::MutexGuard guard(isolate_to_contract_mutex_);
-		isolate_to_contract_.erase(isolate_);
-		isolate_->Dispose();
+		isolate_->SetData(CONTRACT_DATA_SLOT, NULL);
+		CheckInIsolate(pooled_, cancelled_);
+		pooled_ = NULL;
 		isolate_ = NULL;
 	}
 
+	V8Contract::MeterScope::MeterScope(V8Contract *contract) :contract_(contract) {
+		Meter &meter = contract_->meter_;
+		LedgerContext *ledger_context = contract_->parameter_.ledger_context_;
+		if (ledger_context && !ledger_context->transaction_stack_.empty()) {
+			meter.tx_ = ledger_context->GetBottomTx();
+		}
+		meter.steps_ = 0;
+	}
+
+	V8Contract::MeterScope::~MeterScope() {
+		Meter &meter = contract_->meter_;
+		//Take the heap allocated after the last sample into account
+		if (meter.tx_ && meter.steps_ % METER_SAMPLE_STEPS != 0) {
+			SampleMeter(contract_->isolate_, &meter, false);
+		}
+		meter.tx_.reset();
+	}
+
+	V8Contract::PooledIsolate *V8Contract::CheckOutIsolate() {
+		do {
+			utils::MutexGuard guard(idle_isolates_mutex_);
+			if (idle_isolates_.empty()) {
+				break;
+			}
+
+			PooledIsolate *pooled = idle_isolates_.back();
+			idle_isolates_.pop_back();
+			isolate_reused_count_++;
+			return pooled;
+		} while (false);
+
+		utils::AtomicInc(&isolate_created_count_);
+		PooledIsolate *pooled = new PooledIsolate();
+		pooled->isolate_ = v8::Isolate::New(create_params_);
+		return pooled;
+	}
+
+	void V8Contract::CheckInIsolate(PooledIsolate *pooled, bool cancelled) {
+		v8::Isolate *isolate = pooled->isolate_;
+		pooled->uses_++;
+
+		//A terminated isolate is never reused, the termination may still be pending
+		bool reusable = !cancelled && pooled->uses_ < MAX_ISOLATE_USES;
+		if (reusable) {
+			v8::Locker locker(isolate);
+			v8::Isolate::Scope isolate_scope(isolate);
+			reusable = !isolate->IsExecutionTerminating();
+			if (reusable) {
+				//The heap is charged to the next contract as a whole, so the garbage of this one is collected now
+				isolate->ContextDisposedNotification();
+				isolate->LowMemoryNotification();
+				v8::HeapStatistics stats;
+				isolate->GetHeapStatistics(&stats);
+				reusable = stats.used_heap_size() <= MAX_ISOLATE_HEAP_SIZE;
+			}
+		}
+
+		if (reusable) {
+			utils::MutexGuard guard(idle_isolates_mutex_);
+			if (idle_isolates_.size() < MAX_IDLE_ISOLATES) {
+				idle_isolates_.push_back(pooled);
+				return;
+			}
+		}
+
+		//The eternal handles of the templates go with the isolate
+		delete pooled;
+		isolate->Dispose();
+		utils::AtomicInc(&isolate_disposed_count_);
+	}
+
+	void V8Contract::GetModuleStatus(Json::Value &data) {
+		utils::MutexGuard guard(idle_isolates_mutex_);
+		data["idle"] = (Json::UInt64)idle_isolates_.size();
+		data["created"] = isolate_created_count_;
+		data["reused"] = isolate_reused_count_;
+		data["disposed"] = isolate_disposed_count_;
+	}
+
+	void V8Contract::GetCodeCacheStatus(Json::Value &data) {
+		code_cache_.GetModuleStatus(data);
+	}
+
 	bool V8Contract::LoadJsFuncList() {
 		JsFuncList init_obj;
 		js_obj_[ORIGIN_OBJ] = init_obj;
@@ -213,21 +300,24 @@ namespace CEG {
 		}
 		create_params_.array_buffer_allocator =
 			v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+		code_cache_.Initialize(Configure::Instance().ledger_configure_.code_cache_size_,
+			Configure::Instance().ledger_configure_.code_cache_persist_);
 
 		return true;
 	}
 
 	bool V8Contract::ExecuteCode() {
+		v8::Locker locker(isolate_);
 		v8::Isolate::Scope isolate_scope(isolate_);
+		MeterScope meter_scope(this);
 		v8::HandleScope handle_scope(isolate_);
 		v8::TryCatch try_catch(isolate_);
 
-		v8::Local<v8::Context> context = CreateContext(isolate_, false);
+		v8::Local<v8::Context> context = CreateContext(isolate_, pooled_->templates_, false);
 		v8::Context::Scope context_scope(context);
 		SetV8InterfaceFunc(context, false);
 		CreateJsObject(context, false);
 
-		v8::Local<v8::String> v8src = ToV8String(parameter_.code_.c_str());
 		v8::Local<v8::Script> compiled_script;
 
 		std::string fn_name = parameter_.init_ ? init_name_ : main_name_;
@@ -244,9 +334,7 @@ namespace CEG {
 				break;
 			}
 
-			v8::ScriptOrigin origin_check_time_name(ToV8String("__enable_check_time__"));
-
-			if (!v8::Script::Compile(context, v8src, &origin_check_time_name).ToLocal(&compiled_script)) {
+			if (!code_cache_.Compile(context, parameter_.code_, "__enable_check_time__").ToLocal(&compiled_script)) {
 				//"VERSION CHECKING condition" may be removed after version 1002
 				if (CHECK_VERSION_GT_1001) {
 					result_.set_code(protocol::ERRCODE_CONTRACT_EXECUTE_FAIL);
@@ -315,16 +403,18 @@ namespace CEG {
 	}
 
 	bool V8Contract::Cancel() {
+		cancelled_ = true;
 		v8::V8::TerminateExecution(isolate_);
 		return true;
 	}
 
 	bool V8Contract::SourceCodeCheck() {
+		v8::Locker locker(isolate_);
 		v8::Isolate::Scope isolate_scope(isolate_);
 		v8::HandleScope handle_scope(isolate_);
 		v8::TryCatch try_catch(isolate_);
 
-		v8::Local<v8::Context> context = CreateContext(isolate_, false);
+		v8::Local<v8::Context> context = CreateContext(isolate_, pooled_->templates_, false);
 		v8::Context::Scope context_scope(context);
 
 		std::string jslint_file = "jslint.js";
@@ -338,9 +428,8 @@ namespace CEG {
 			return false;
 		}
 
-		v8::Local<v8::String> v8src = ToV8String(find_jslint_source->second.c_str());
 		v8::Local<v8::Script> compiled_script;
-		if (!v8::Script::Compile(context, v8src).ToLocal(&compiled_script)) {
+		if (!code_cache_.Compile(context, find_jslint_source->second, "").ToLocal(&compiled_script)) {
 			result_.set_code(protocol::ERRCODE_CONTRACT_SYNTAX_ERROR);
 			result_.set_desc(ReportException(isolate_, &try_catch).toFastString());
 			LOG_ERROR("%s", result_.desc().c_str());
@@ -414,15 +503,16 @@ namespace CEG {
 	}
 
 	bool V8Contract::Query(Json::Value& js_result) {
+		v8::Locker locker(isolate_);
 		v8::Isolate::Scope isolate_scope(isolate_);
+		MeterScope meter_scope(this);
 		v8::HandleScope    handle_scope(isolate_);
 		v8::TryCatch       try_catch(isolate_);
 
-		v8::Local<v8::Context> context = CreateContext(isolate_, true);
+		v8::Local<v8::Context> context = CreateContext(isolate_, pooled_->templates_, true);
 		v8::Context::Scope context_scope(context);
 		SetV8InterfaceFunc(context, true);
 		CreateJsObject(context, true);
-		v8::Local<v8::String> v8src = ToV8String(parameter_.code_.c_str());
 		v8::Local<v8::Script> compiled_script;
 
 		Json::Value error_desc_f;
@@ -432,9 +522,7 @@ namespace CEG {
 				break;
 			}
 
-			v8::ScriptOrigin origin_check_time_name(ToV8String("__enable_check_time__"));
-
-			if (!v8::Script::Compile(context, v8src, &origin_check_time_name).ToLocal(&compiled_script)) {
+			if (!code_cache_.Compile(context, parameter_.code_, "__enable_check_time__").ToLocal(&compiled_script)) {
 				error_desc_f = ReportException(isolate_, &try_catch);
 				break;
 			}
@@ -528,24 +616,25 @@ namespace CEG {
 
 		//blockchain.function
 		block_chain_obj->Set(ToV8String("thisAddress"), ToV8String(parameter_.this_address_.c_str()));
-		SetV8ObjectFunc(block_chain_obj, js_obj_[BLOCKCHAIN_OBJ].read_);
+		SetV8ObjectFunc(context, block_chain_obj, BLOCKCHAIN_OBJ, js_obj_[BLOCKCHAIN_OBJ].read_);
 		if (!readonly) {
-			SetV8ObjectFunc(block_chain_obj, js_obj_[BLOCKCHAIN_OBJ].write_);
+			SetV8ObjectFunc(context, block_chain_obj, BLOCKCHAIN_OBJ, js_obj_[BLOCKCHAIN_OBJ].write_);
 		}
 		context->Global()->Set(context, ToV8String(BLOCKCHAIN_OBJ), block_chain_obj);
 
 		//for Utils
 		v8::Local<v8::Object> utils_obj = v8::Object::New(isolate_);
-		SetV8ObjectFunc(utils_obj, js_obj_[UTILS_OBJ].read_);
+		SetV8ObjectFunc(context, utils_obj, UTILS_OBJ, js_obj_[UTILS_OBJ].read_);
 		if (!readonly) {
-			SetV8ObjectFunc(utils_obj, js_obj_[UTILS_OBJ].write_);
+			SetV8ObjectFunc(context, utils_obj, UTILS_OBJ, js_obj_[UTILS_OBJ].write_);
 		}
 		context->Global()->Set(context, ToV8String(UTILS_OBJ), utils_obj);
 	}
 
-	void V8Contract::SetV8ObjectFunc(v8::Local<v8::Object> object, JsFunctions &js_functions){
+	void V8Contract::SetV8ObjectFunc(v8::Local<v8::Context> context, v8::Local<v8::Object> object, const std::string &obj_name, JsFunctions &js_functions){
 		for (JsFunctions::iterator itr = js_functions.begin(); itr != js_functions.end(); itr++) {
-			object->Set(ToV8String(itr->first.c_str()), v8::Function::New(isolate_, itr->second));
+			v8::Local<v8::FunctionTemplate> func_template = GetFunctionTemplate(isolate_, pooled_->templates_, obj_name, itr->first, itr->second);
+			object->Set(ToV8String(itr->first.c_str()), func_template->GetFunction(context).ToLocalChecked());
 		}
 	}
 
@@ -576,13 +665,7 @@ namespace CEG {
 	}
 
 	V8Contract *V8Contract::GetContractFrom(v8::Isolate* isolate) {
-		utils::MutexGuard guard(isolate_to_contract_mutex_);
-		std::unordered_map<v8::Isolate*, V8Contract *>::iterator iter = isolate_to_contract_.find(isolate);
-		if (iter != isolate_to_contract_.end()) {
-			return iter->second;
-		}
-
-		return NULL;
+		return (V8Contract *)isolate->GetData(CONTRACT_DATA_SLOT);
 	}
 
 	bool V8Contract::RemoveRandom(v8::Isolate* isolate, Json::Value &error_msg) {
@@ -607,20 +690,34 @@ namespace CEG {
 		return true;
 	}
 
-	v8::Local<v8::Context> V8Contract::CreateContext(v8::Isolate* isolate, bool readonly) {
-		// Create a template for the global object.
-		v8::Local<v8::ObjectTemplate> global = v8::ObjectTemplate::New(isolate);
-		JsFunctions &read_funcs = js_obj_[ORIGIN_OBJ].read_;
-		for (JsFunctions::iterator itr = read_funcs.begin(); itr != read_funcs.end(); itr++) {
-			global->Set(ToV8StringStatic(isolate, itr->first.c_str()), v8::FunctionTemplate::New(isolate, itr->second));
+	v8::Local<v8::FunctionTemplate> V8Contract::GetFunctionTemplate(v8::Isolate* isolate, ContextTemplates &templates,
+		const std::string &obj_name, const std::string &func_name, v8::FunctionCallback callback) {
+		v8::Eternal<v8::FunctionTemplate> &func_template = templates.functions_[obj_name + "." + func_name];
+		if (func_template.IsEmpty()) {
+			func_template.Set(isolate, v8::FunctionTemplate::New(isolate, callback));
 		}
-		if (!readonly) {
-			JsFunctions &writer_funcs = js_obj_[ORIGIN_OBJ].write_;
-			for (JsFunctions::iterator itr = writer_funcs.begin(); itr != writer_funcs.end(); itr++) {
+		return func_template.Get(isolate);
+	}
+
+	v8::Local<v8::Context> V8Contract::CreateContext(v8::Isolate* isolate, ContextTemplates &templates, bool readonly) {
+		// Create a template for the global object, once per isolate.
+		v8::Eternal<v8::ObjectTemplate> &global_template = templates.global_[readonly ? 1 : 0];
+		if (global_template.IsEmpty()) {
+			v8::Local<v8::ObjectTemplate> global = v8::ObjectTemplate::New(isolate);
+			JsFunctions &read_funcs = js_obj_[ORIGIN_OBJ].read_;
+			for (JsFunctions::iterator itr = read_funcs.begin(); itr != read_funcs.end(); itr++) {
 				global->Set(ToV8StringStatic(isolate, itr->first.c_str()), v8::FunctionTemplate::New(isolate, itr->second));
 			}
+			if (!readonly) {
+				JsFunctions &writer_funcs = js_obj_[ORIGIN_OBJ].write_;
+				for (JsFunctions::iterator itr = writer_funcs.begin(); itr != writer_funcs.end(); itr++) {
+					global->Set(ToV8StringStatic(isolate, itr->first.c_str()), v8::FunctionTemplate::New(isolate, itr->second));
+				}
+			}
+			global_template.Set(isolate, global);
 		}
-		return v8::Context::New(isolate, NULL, global);
+
+		return v8::Context::New(isolate, NULL, global_template.Get(isolate));
 	}
 
 	Json::Value V8Contract::ReportException(v8::Isolate* isolate, v8::TryCatch* try_catch) {
@@ -733,14 +830,8 @@ namespace CEG {
 			}
 
 			v8::TryCatch try_catch(args.GetIsolate());
-			std::string js_file = find_source->second; //load_file(*str);
-
-			v8::Local<v8::String> source = ToV8StringStatic(args.GetIsolate(), js_file.c_str());
 			v8::Local<v8::Script> script;
-
-			v8::ScriptOrigin origin_check_time_name(ToV8StringStatic(args.GetIsolate()->GetCurrentContext()->GetIsolate(), "__enable_check_time__"));
-
-			if (!v8::Script::Compile(args.GetIsolate()->GetCurrentContext(), source, &origin_check_time_name).ToLocal(&script)) {
+			if (!code_cache_.Compile(args.GetIsolate()->GetCurrentContext(), find_source->second, "__enable_check_time__").ToLocal(&script)) {
 				ReportException(args.GetIsolate(), &try_catch);
 				break;
 			}
@@ -753,31 +844,41 @@ namespace CEG {
 		//return v8::Undefined(args.GetIsolate());
 	}
 
-	void V8Contract::InternalCheckTime(const v8::FunctionCallbackInfo<v8::Value>& args) {
-		CEG::AccountFrm::pointer account_frm = nullptr;
-		V8Contract *v8_contract = GetContractFrom(args.GetIsolate());
+	void V8Contract::SampleMeter(v8::Isolate *isolate, Meter *meter, bool with_stack) {
+		//Check the storage
+		v8::HeapStatistics stats;
+		isolate->GetHeapStatistics(&stats);
+		meter->tx_->SetMemoryUsage(stats.used_heap_size());
 
-		if (v8_contract && v8_contract->GetParameter().ledger_context_) {
-			LedgerContext *ledger_context = v8_contract->GetParameter().ledger_context_;
-			TransactionFrm::pointer ptr = ledger_context->GetBottomTx();
-			ptr->ContractStepInc(1);
+		//Check the stack. The usage is the one of the last sample, so it is not sampled out of the code.
+		if (with_stack) {
+			v8::V8InternalInfo internal_info;
+			isolate->GetV8InternalInfo(internal_info);
+			meter->tx_->SetStackRemain(internal_info.remain_stack_size);
+		}
+	}
 
-			//Check the storage
-			v8::HeapStatistics stats;
-			args.GetIsolate()->GetHeapStatistics(&stats);
-			ptr->SetMemoryUsage(stats.used_heap_size());
+	void V8Contract::InternalCheckTime(const v8::FunctionCallbackInfo<v8::Value>& args) {
+		v8::Isolate *isolate = args.GetIsolate();
+		V8Contract *v8_contract = GetContractFrom(isolate);
+		if (v8_contract == NULL || !v8_contract->meter_.tx_) {
+			return;
+		}
 
-			//Check the stack
-			v8::V8InternalInfo internal_info;
-			args.GetIsolate()->GetV8InternalInfo(internal_info);
+		Meter *meter = &v8_contract->meter_;
 
-			ptr->SetStackRemain(internal_info.remain_stack_size);
-			//LOG_INFO("v8 remain stack:%d, now step:%d\n", internal_info.remain_stack_size, ptr->GetContractStep());
+		TransactionFrm *tx = meter->tx_.get();
+		tx->ContractStepInc(1);
+		meter->steps_++;
+		if (meter->steps_ % METER_SAMPLE_STEPS != 0 && tx->GetContractStep() <= General::CONTRACT_STEP_LIMIT) {
+			return;
+		}
 
-			std::string error_info;
-			if (ptr->IsExpire(error_info)) {
-				args.GetIsolate()->ThrowException(ToV8StringStatic(args.GetIsolate(), error_info.c_str()));
-			}
+		//The time is also enforced by the watchdog of the contract manager
+		SampleMeter(isolate, meter, true);
+		std::string error_info;
+		if (tx->IsExpire(error_info)) {
+			isolate->ThrowException(ToV8StringStatic(isolate, error_info.c_str()));
 		}
 	}
 
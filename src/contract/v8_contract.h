@@ -2,6 +2,7 @@
 #define V8_CONTRACT_H_
 
 #include "contract.h"
+#include "code_cache.h"
 
 #include <v8.h>
 #include <libplatform/libplatform.h>
@@ -9,8 +10,43 @@
 
 
 namespace CEG {
+	class TransactionFrm;
 	class V8Contract : public Contract {
+		//Templates of the built-in functions, built once per isolate and kept while it is pooled.
+		//Each property has its own template, so that no two properties share a function.
+		struct ContextTemplates {
+			v8::Eternal<v8::ObjectTemplate> global_[2];
+			std::map<std::string, v8::Eternal<v8::FunctionTemplate>> functions_;
+		};
+
+		struct PooledIsolate {
+			PooledIsolate() :isolate_(NULL), uses_(0) {}
+			v8::Isolate *isolate_;
+			//Executions the isolate has run
+			int64_t uses_;
+			ContextTemplates templates_;
+		};
+
+		//Metering of the running execution, so that counting a step takes no lock
+		struct Meter {
+			Meter() :steps_(0) {}
+			std::shared_ptr<TransactionFrm> tx_;
+			//Steps run by this execution, the steps of the transaction are counted on tx_
+			int64_t steps_;
+		};
+
+		//Meters the bottom transaction for the lifetime of the scope
+		class MeterScope {
+			V8Contract *contract_;
+		public:
+			MeterScope(V8Contract *contract);
+			~MeterScope();
+		};
+
+		PooledIsolate *pooled_;
 		v8::Isolate* isolate_;
+		bool cancelled_;
+		Meter meter_;
 	public:
 		V8Contract(bool readonly, const ContractParameter &parameter);
 		virtual ~V8Contract();
@@ -20,6 +56,8 @@ namespace CEG {
 		virtual bool Query(Json::Value& jsResult);
 		virtual bool SourceCodeCheck();
 		static bool Initialize(int argc, char** argv);
+		static void GetModuleStatus(Json::Value &data);
+		static void GetCodeCacheStatus(Json::Value &data);
 
 	private:
 		static bool LoadJsFuncList();
@@ -57,15 +95,41 @@ namespace CEG {
 		//for check source
 		static const std::string call_jslint_;
 
-		static utils::Mutex isolate_to_contract_mutex_;
-		static std::unordered_map<v8::Isolate*, V8Contract *> isolate_to_contract_;
+		//An isolate runs one contract at a time, the contract is kept in its data slot.
+		//Callbacks find it without a lock, the contract manager cancels it by id.
+		static const uint32_t CONTRACT_DATA_SLOT = 0;
 
 		static v8::Platform* 	platform_;
 		static v8::Isolate::CreateParams create_params_;
+		static CodeCache code_cache_;
+
+		//Idle isolates shared by all threads. Contexts run on new threads, so an isolate is
+		//entered under a v8::Locker and may be checked out by another thread than its creator.
+		//Every execution creates a new context, nothing of a previous one is reachable from it,
+		//and a full collection at check-in leaves the next contract none of its garbage to be metered.
+		static utils::Mutex idle_isolates_mutex_;
+		static std::vector<PooledIsolate *> idle_isolates_;
+		static const size_t MAX_IDLE_ISOLATES = 32;
+		//An isolate is disposed after so many executions or when its heap grows over the limit
+		static const int64_t MAX_ISOLATE_USES = 1024;
+		static const size_t MAX_ISOLATE_HEAP_SIZE = 16 * 1024 * 1024;
+
+		static int64_t isolate_created_count_;
+		static int64_t isolate_reused_count_;
+		static int64_t isolate_disposed_count_;
+
+		//The step limit is checked at every step, the heap and the stack once per so many steps
+		static const int64_t METER_SAMPLE_STEPS = 64;
+		static void SampleMeter(v8::Isolate *isolate, Meter *meter, bool with_stack);
+
+		static PooledIsolate *CheckOutIsolate();
+		static void CheckInIsolate(PooledIsolate *pooled, bool cancelled);
 
 		static protocol::AssetKey GetAssetFromJsObject(v8::Isolate* isolate, v8::Local<v8::Object> js_object);
 		static bool RemoveRandom(v8::Isolate* isolate, Json::Value &error_msg);
-		static v8::Local<v8::Context> CreateContext(v8::Isolate* isolate, bool readonly);
+		static v8::Local<v8::Context> CreateContext(v8::Isolate* isolate, ContextTemplates &templates, bool readonly);
+		static v8::Local<v8::FunctionTemplate> GetFunctionTemplate(v8::Isolate* isolate, ContextTemplates &templates,
+			const std::string &obj_name, const std::string &func_name, v8::FunctionCallback callback);
 		static V8Contract *GetContractFrom(v8::Isolate* isolate);
 		static Json::Value ReportException(v8::Isolate* isolate, v8::TryCatch* try_catch);
 		static const char* ToCString(const v8::String::Utf8Value& value);
@@ -152,7 +216,7 @@ namespace CEG {
 
 		void SetV8InterfaceFunc(v8::Local<v8::Context> context, bool readonly);
 		void CreateJsObject(v8::Local<v8::Context> context, bool readonly);
-		void SetV8ObjectFunc(v8::Local<v8::Object> object, JsFunctions &js_functions);
+		void SetV8ObjectFunc(v8::Local<v8::Context> context, v8::Local<v8::Object> object, const std::string &obj_name, JsFunctions &js_functions);
 	};
 }
 
@@ -35,6 +35,9 @@ namespace CEG {
 	bool GlueManager::Initialize() {
 
 		tx_pool_ = std::make_shared<TransactionQueue>(Configure::Instance().ledger_configure_.queue_limit_,  Configure::Instance().ledger_configure_.queue_per_account_txs_limit_);
+		if (!admission_.Initialize(tx_pool_, Configure::Instance().ledger_configure_.admission_thread_count_, Configure::Instance().ledger_configure_.admission_queue_limit_)) {
+			return false;
+		}
 		process_uptime_ = time(NULL);
 		consensus_ = ConsensusManager::Instance().GetConsensus();
 		consensus_->SetNotify(this);
@@ -74,6 +77,7 @@ namespace CEG {
 	}
 
 	bool GlueManager::Exit() {
+		admission_.Exit();
 		return true;
 	}
 
@@ -112,7 +116,9 @@ namespace CEG {
 
 		// Get previous block proof
 		std::string proof;
-		Storage::Instance().account_db()->Get(General::LAST_PROOF, proof);
+		if (!LedgerManager::Instance().PendingGet(General::LAST_PROOF, proof)) {
+			Storage::Instance().account_db()->Get(General::LAST_PROOF, proof);
+		}
 
 		protocol::ConsensusValue propose_value;
 		do {
@@ -187,6 +193,12 @@ namespace CEG {
 				and the number of transactions that were pre-executed incorrectly is %d.) ",
 				propose_result.cons_validation_.expire_tx_ids_size(), propose_result.cons_validation_.error_tx_ids_size());
 
+			//The result stands for the proposed value unless some transactions are dropped, expired or failed
+			if (propose_result.exec_result_ && propose_result.need_dropped_tx_.empty() && !propose_result.value_hash_.empty() &&
+				!propose_value.has_validation()) {
+				LedgerManager::Instance().context_manager_.ReuseProposal(propose_result.value_hash_, propose_value);
+			}
+
 			break;
 		} while (true);
 
@@ -201,24 +213,9 @@ namespace CEG {
 		std::string address = tx->GetSourceAddress();
 
 		do {
-			if (tx_pool_->IsExist(tx->GetContentHash())){
-				//Break when a transaction is replayed;
-				err.set_code(protocol::ERRCODE_ALREADY_EXIST);
-				err.set_desc(utils::String::Format("Received duplicate transaction message. The transaction's source address is %s, and hash is %s", address.c_str(), utils::String::Bin4ToHexString(hash_value).c_str()));
-				LOG_TRACE("Received duplicate transation message. The transaction's source address is %s, and hash is %s.", address.c_str(), utils::String::Bin4ToHexString(hash_value).c_str());
-				break;
-			}
-
-			//Validate a transaction upon received.
+			utils::MutexGuard guard(admission_.GetAccountLock(address));
 			int64_t nonce = 0;
-			if (!tx->CheckValid(/*high_sequence*/ -1, true, nonce)) {
-				err = tx->GetResult();
-				Json::Value js;
-				js["action"] = "apply";
-				js["error_code"] = err.code();
-				js["desc"] = err.desc();
-				LOG_ERROR("Transaction verification failed. The transaction's source address: %s, nonce: (" FMT_I64 "), hash: %s, return value: %s.",
-					address.c_str(), tx->GetNonce(), utils::String::Bin4ToHexString(hash_value).c_str(), js.toFastString().c_str());
+			if (!admission_.PreCheck(tx, nonce, err)) {
 				break;
 			}
 
@@ -233,6 +230,10 @@ namespace CEG {
 		return err.code() == protocol::ERRCODE_SUCCESS;
 	}
 
+	bool GlueManager::SubmitTransactions(std::vector<AdmissionItem> &items) {
+		return admission_.Submit(items);
+	}
+
 	bool GlueManager::OnConsensus(const ConsensusMsg &msg) {
 		return consensus_->OnRecv(msg);
 	}
@@ -297,7 +298,7 @@ namespace CEG {
 		int64_t next_timestamp = next_interval + req.close_time();
 		int64_t seq = req.ledger_seq();
 
-		Global::Instance().GetIoService().post([next_timestamp, time_use, seq, this]() {
+		Global::Instance().Post([next_timestamp, time_use, seq, this]() {
 			int64_t waiting_time = next_timestamp - utils::Timestamp::Now().timestamp();
 			if (waiting_time <= 0)  waiting_time = 1;
 
@@ -327,7 +328,7 @@ namespace CEG {
 		StartLedgerCloseTimer();
 	}
 
-	bool GlueManager::CheckValueAndProof(const std::string &consensus_value, const std::string &proof) {
+	bool GlueManager::CheckValueAndProof(const std::string &consensus_value, const std::string &proof, const std::string &checked_validators) {
 		protocol::ConsensusValue proto_value;
 		if (!proto_value.ParseFromString(consensus_value)) {
 			LOG_ERROR("Failed to parse consensus value.");
@@ -344,11 +345,17 @@ namespace CEG {
 		//If a hardfork point is found on a node, we ignore the proof of the block before the fork point.
 		std::string consensus_value_hash = HashWrapper::Crypto(consensus_value);
 		std::set<std::string>::const_iterator iter = hardfork_points_.find(consensus_value_hash);
+		bool proof_checked = !checked_validators.empty() && checked_validators == set.SerializeAsString();
 		return CheckValueHelper(proto_value, -1) == Consensus::CHECK_VALUE_VALID &&   //-1 not check time
-			(consensus_->CheckProof(set, HashWrapper::Crypto(consensus_value), proof)
+			(proof_checked
+			|| consensus_->CheckProof(set, consensus_value_hash, proof)
 			|| iter != hardfork_points_.end());
 	}
 
+	bool GlueManager::CheckProof(const protocol::ValidatorSet &validators, const std::string &value_hash, const std::string &proof) {
+		return consensus_->CheckProof(validators, value_hash, proof);
+	}
+
 	int32_t GlueManager::CheckValue(const std::string &value) {
 		protocol::ConsensusValue consensus_value;
 		if (!consensus_value.ParseFromString(value)) {
@@ -466,7 +473,7 @@ namespace CEG {
 	}
 
 	void GlueManager::SendConsensusMessage(const std::string &message) {
-		Global::Instance().GetIoService().post([this, message] (){
+		Global::Instance().Post([this, message] (){
 			PeerManager::Instance().Broadcast(protocol::OVERLAY_MSGTYPE_PBFT, message);
 
 			protocol::PbftEnv env;
@@ -492,8 +499,12 @@ namespace CEG {
 		utils::Timestamp process_time_stamp(process_uptime_ * utils::MICRO_UNITS_PER_SEC);
 		system_json["process_uptime"] = process_time_stamp.ToFormatString(false);
 		system_json["current_time"] = utils::Timestamp::Now().ToFormatString(false);
+		system_json["log_async"] = utils::Logger::Instance().IsAsync();
+		system_json["log_dropped"] = utils::Logger::Instance().GetDroppedCount();
+		Global::Instance().GetModuleStatus(data["main_loop"]);
 		 
 		ledger_upgrade_.GetModuleStatus(data["ledger_upgrade"]);
+		admission_.GetModuleStatus(data["admission"]);
 	}
 
 	int64_t GlueManager::GetIntervalTime(bool empty_block) {
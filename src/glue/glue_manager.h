@@ -22,6 +22,7 @@
 #include <overlay/peer.h>
 #include <consensus/consensus_manager.h>
 #include "transaction_queue.h"
+#include "transaction_admission.h"
 #include "ledger_upgrade.h"
 
 namespace CEG {
@@ -33,6 +34,7 @@ namespace CEG {
 
 		utils::Mutex lock_;
 		std::shared_ptr<TransactionQueue> tx_pool_;
+		TransactionAdmission admission_;
 
 		int64_t time_start_consenus_;
 		std::shared_ptr<Consensus> consensus_;
@@ -63,6 +65,8 @@ namespace CEG {
 		int64_t GetIntervalTime(bool empty_block);
 
 		bool OnTransaction(TransactionFrm::pointer tx, Result &err);
+		//Hand a batch of peer transactions to the admission workers, false if the batch is dropped
+		bool SubmitTransactions(std::vector<AdmissionItem> &items);
 		bool OnConsensus(const ConsensusMsg &msg);
 		void NotifyErrTx(std::vector<TransactionFrm::pointer> &txs);
 
@@ -75,7 +79,10 @@ namespace CEG {
 		protocol::Signature SignConsensusData(const std::string &data);
 
 		//Should be called by the ledger manager.
-		bool CheckValueAndProof( const std::string &consensus_value, const std::string &proof);
+		//The proof is not checked again if it has been verified with the validators serialized in checked_validators.
+		bool CheckValueAndProof( const std::string &consensus_value, const std::string &proof, const std::string &checked_validators = "");
+		//Check the proof only, it does not depend on the last closed ledger
+		bool CheckProof(const protocol::ValidatorSet &validators, const std::string &value_hash, const std::string &proof);
 		int32_t CheckValueHelper(const protocol::ConsensusValue &consensus_value, int64_t now);
 		size_t GetTransactionCacheSize();
 		void QueryTransactionCache(const uint32_t& num, std::vector<TransactionFrm::pointer>& txs);
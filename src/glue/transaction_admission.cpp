@@ -0,0 +1,201 @@
+/*
+CEG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CEG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <utils/logger.h>
+#include <common/general.h>
+#include "transaction_admission.h"
+
+namespace CEG {
+
+	class TransactionAdmission::AdmissionTask : public utils::Runnable {
+	public:
+		TransactionAdmission *admission_;
+		std::vector<AdmissionItem> items_;
+
+		AdmissionTask(TransactionAdmission *admission, std::vector<AdmissionItem> &items) :admission_(admission) {
+			items_.swap(items);
+		}
+
+		virtual void Run(utils::Thread *this_thread) override {
+			admission_->Process(items_);
+			delete this;
+		}
+	};
+
+	TransactionAdmission::TransactionAdmission() :
+		enabled_(false),
+		queue_limit_(0),
+		queued_(0),
+		received_(0),
+		admitted_(0),
+		rejected_(0),
+		dropped_(0) {}
+
+	TransactionAdmission::~TransactionAdmission() {}
+
+	bool TransactionAdmission::Initialize(std::shared_ptr<TransactionQueue> tx_pool, uint32_t thread_count, uint32_t queue_limit) {
+		tx_pool_ = tx_pool;
+		queue_limit_ = queue_limit;
+		if (thread_count == 0) {
+			thread_count = 1;
+		}
+
+		if (!pool_.Init("tx-admission", thread_count)) {
+			LOG_ERROR("Failed to start the transaction admission thread pool");
+			return false;
+		}
+
+		enabled_ = true;
+		return true;
+	}
+
+	bool TransactionAdmission::Exit() {
+		enabled_ = false;
+		return pool_.Exit();
+	}
+
+	bool TransactionAdmission::Submit(std::vector<AdmissionItem> &items) {
+		if (items.empty()) {
+			return true;
+		}
+
+		int64_t size = items.size();
+		do {
+			utils::MutexGuard guard(counter_lock_);
+			received_ += size;
+			if (!enabled_ || queued_ + size > queue_limit_) {
+				dropped_ += size;
+				return false;
+			}
+			queued_ += size;
+		} while (false);
+
+		pool_.AddTask(new AdmissionTask(this, items));
+		return true;
+	}
+
+	size_t TransactionAdmission::GetAccountStripe(const std::string &address) {
+		return std::hash<std::string>()(address) % ACCOUNT_LOCK_STRIPES;
+	}
+
+	utils::Mutex &TransactionAdmission::GetAccountLock(const std::string &address) {
+		return account_locks_[GetAccountStripe(address)];
+	}
+
+	bool TransactionAdmission::PreCheck(TransactionFrm::pointer tx, int64_t &nonce, Result &err) {
+		std::string hash_value = tx->GetContentHash();
+		std::string address = tx->GetSourceAddress();
+
+		if (tx_pool_->IsExist(hash_value)) {
+			//Break when a transaction is replayed;
+			err.set_code(protocol::ERRCODE_ALREADY_EXIST);
+			err.set_desc(utils::String::Format("Received duplicate transaction message. The transaction's source address is %s, and hash is %s", address.c_str(), utils::String::Bin4ToHexString(hash_value).c_str()));
+			LOG_TRACE("Received duplicate transation message. The transaction's source address is %s, and hash is %s.", address.c_str(), utils::String::Bin4ToHexString(hash_value).c_str());
+			return false;
+		}
+
+		//Validate a transaction upon received.
+		if (!tx->CheckValid(/*high_sequence*/ -1, true, nonce)) {
+			err = tx->GetResult();
+			Json::Value js;
+			js["action"] = "apply";
+			js["error_code"] = err.code();
+			js["desc"] = err.desc();
+			LOG_ERROR("Transaction verification failed. The transaction's source address: %s, nonce: (" FMT_I64 "), hash: %s, return value: %s.",
+				address.c_str(), tx->GetNonce(), utils::String::Bin4ToHexString(hash_value).c_str(), js.toFastString().c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	void TransactionAdmission::Process(std::vector<AdmissionItem> &items) {
+		//Hash and verify the signatures of the whole batch
+		std::vector<const protocol::TransactionEnv *> envs;
+		envs.reserve(items.size());
+		for (size_t i = 0; i < items.size(); i++) {
+			envs.push_back(&items[i].env_);
+		}
+
+		std::vector<TransactionFrm::pointer> txs;
+		TransactionFrm::CreateBatch(envs, txs, true);
+
+		//Lock the source accounts until the batch is imported, in ascending order so the workers never wait in a cycle
+		std::set<size_t> stripes;
+		for (size_t i = 0; i < txs.size(); i++) {
+			stripes.insert(GetAccountStripe(txs[i]->GetSourceAddress()));
+		}
+		for (std::set<size_t>::const_iterator iter = stripes.begin(); iter != stripes.end(); iter++) {
+			account_locks_[*iter].Lock();
+		}
+
+		//Pre-check the source accounts
+		std::vector<Result> results(txs.size());
+		std::vector<TransactionFrm::pointer> import_txs;
+		std::vector<int64_t> import_nonces;
+		std::vector<size_t> import_indexes;
+		for (size_t i = 0; i < txs.size(); i++) {
+			int64_t nonce = 0;
+			if (!PreCheck(txs[i], nonce, results[i])) {
+				continue;
+			}
+			import_txs.push_back(txs[i]);
+			import_nonces.push_back(nonce);
+			import_indexes.push_back(i);
+		}
+
+		//Import the checked transactions under one lock of the queue
+		std::vector<Result> import_results;
+		tx_pool_->ImportBatch(import_txs, import_nonces, import_results);
+		for (size_t i = 0; i < import_indexes.size(); i++) {
+			Result &result = import_results[i];
+			if (result.code() != protocol::ERRCODE_SUCCESS) {
+				LOG_ERROR("Failed to insert transaction into transaction queue. The transaction's source address: %s, hash: %s.",
+					import_txs[i]->GetSourceAddress().c_str(), utils::String::Bin4ToHexString(import_txs[i]->GetContentHash()).c_str());
+			}
+			results[import_indexes[i]] = result;
+		}
+
+		for (std::set<size_t>::const_reverse_iterator iter = stripes.rbegin(); iter != stripes.rend(); iter++) {
+			account_locks_[*iter].Unlock();
+		}
+
+		int64_t admitted = 0;
+		for (size_t i = 0; i < items.size(); i++) {
+			if (results[i].code() == protocol::ERRCODE_SUCCESS) {
+				admitted++;
+			}
+			if (items[i].notify_) {
+				items[i].notify_(txs[i], results[i]);
+			}
+		}
+
+		utils::MutexGuard guard(counter_lock_);
+		queued_ -= items.size();
+		admitted_ += admitted;
+		rejected_ += items.size() - admitted;
+	}
+
+	void TransactionAdmission::GetModuleStatus(Json::Value &data) {
+		utils::MutexGuard guard(counter_lock_);
+		data["thread_count"] = (Json::UInt64)pool_.Size();
+		data["queue_limit"] = queue_limit_;
+		data["queued"] = queued_;
+		data["received"] = received_;
+		data["admitted"] = admitted_;
+		data["rejected"] = rejected_;
+		data["dropped"] = dropped_;
+	}
+}
@@ -0,0 +1,79 @@
+/*
+CEG is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CEG is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSACTION_ADMISSION_
+#define TRANSACTION_ADMISSION_
+
+#include <utils/thread.h>
+#include <json/json.h>
+#include <ledger/transaction_frm.h>
+#include "transaction_queue.h"
+
+namespace CEG {
+
+	//A received transaction waiting for admission into the transaction queue
+	struct AdmissionItem {
+		protocol::TransactionEnv env_;
+		//Called on an admission worker once the transaction is imported or rejected
+		std::function<void(TransactionFrm::pointer tx, const Result &result)> notify_;
+	};
+
+	//Admission pipeline for transactions received from peers. Worker threads hash and
+	//verify the signatures of a batch, pre-check the source accounts and import the
+	//batch into the transaction queue, so the main thread is not loaded by a tx flood.
+	class TransactionAdmission {
+		DISALLOW_COPY_AND_ASSIGN(TransactionAdmission);
+
+		class AdmissionTask;
+
+		std::shared_ptr<TransactionQueue> tx_pool_;
+		utils::ThreadPool pool_;
+		bool enabled_;
+
+		//Transactions of one account are checked and imported one at a time
+		static const size_t ACCOUNT_LOCK_STRIPES = 64;
+		static size_t GetAccountStripe(const std::string &address);
+		utils::Mutex account_locks_[ACCOUNT_LOCK_STRIPES];
+
+		//Backpressure counters
+		utils::Mutex counter_lock_;
+		int64_t queue_limit_;
+		int64_t queued_;
+		int64_t received_;
+		int64_t admitted_;
+		int64_t rejected_;
+		int64_t dropped_;
+
+		void Process(std::vector<AdmissionItem> &items);
+	public:
+		TransactionAdmission();
+		~TransactionAdmission();
+
+		bool Initialize(std::shared_ptr<TransactionQueue> tx_pool, uint32_t thread_count, uint32_t queue_limit);
+		bool Exit();
+
+		//Return false and drop the whole batch when the pipeline is full
+		bool Submit(std::vector<AdmissionItem> &items);
+
+		//Duplicate check and account check of a transaction, nonce is the account nonce.
+		//Hold the lock of the source account from the check to the import into the queue.
+		bool PreCheck(TransactionFrm::pointer tx, int64_t &nonce, Result &err);
+		utils::Mutex &GetAccountLock(const std::string &address);
+
+		void GetModuleStatus(Json::Value &data);
+	};
+}
+
+#endif
@@ -81,6 +81,18 @@ namespace CEG {
 
 	bool TransactionQueue::Import(TransactionFrm::pointer tx, const int64_t& cur_source_nonce,Result &result){
 		utils::WriteLockGuard g(lock_);
+		return ImportUnlocked(tx, cur_source_nonce, result);
+	}
+
+	void TransactionQueue::ImportBatch(const std::vector<TransactionFrm::pointer> &txs, const std::vector<int64_t> &cur_source_nonces, std::vector<Result> &results) {
+		results.resize(txs.size());
+		utils::WriteLockGuard g(lock_);
+		for (size_t i = 0; i < txs.size(); i++) {
+			ImportUnlocked(txs[i], cur_source_nonces[i], results[i]);
+		}
+	}
+
+	bool TransactionQueue::ImportUnlocked(TransactionFrm::pointer tx, const int64_t& cur_source_nonce, Result &result){
 		bool inserted = false;
 		bool replace = false;
 		uint32_t account_txs_size = 0;
@@ -33,6 +33,8 @@ namespace CEG {
 		~TransactionQueue();
 
 		bool Import(TransactionFrm::pointer tx, const int64_t& cur_source_nonce, Result &result);
+		//Import many transactions under one write lock, results[i] is set for txs[i]
+		void ImportBatch(const std::vector<TransactionFrm::pointer> &txs, const std::vector<int64_t> &cur_source_nonces, std::vector<Result> &results);
 		protocol::TransactionEnvSet TopTransaction(uint32_t limit);
 		uint32_t RemoveTxs(const protocol::TransactionEnvSet& set, bool close_ledger = false);
 		void RemoveTxs(std::vector<TransactionFrm::pointer>& txs, bool close_ledger = false);
@@ -92,6 +94,7 @@ namespace CEG {
 		std::pair<bool, TransactionFrm::pointer> Remove(const std::string& account_address,const int64_t& nonce);
 		std::pair<bool, TransactionFrm::pointer> Remove(QueueByAddressAndNonce::iterator& account_it, QueueByNonce::iterator& tx_it, bool del_empty = true);
 		void Insert(TransactionFrm::pointer const& tx);
+		bool ImportUnlocked(TransactionFrm::pointer tx, const int64_t& cur_source_nonce, Result &result);
 
 		utils::ReadWriteLock lock_;
 	};
@@ -36,6 +36,30 @@ namespace CEG {
 		account_info_.CopyFrom(account->ProtocolAccount());
 		assets_ = account->assets_;
 		metadata_ = account->metadata_;
+		CountCopy();
+	}
+
+	AccountFrm::AccountFrm(const AccountFrm &account) :
+		assets_(account.assets_),
+		metadata_(account.metadata_),
+		account_info_(account.account_info_) {
+		CountCopy();
+	}
+
+	int64_t AccountFrm::copy_count_ = 0;
+	int64_t AccountFrm::entry_copy_count_ = 0;
+	int64_t AccountFrm::entry_share_count_ = 0;
+
+	void AccountFrm::CountCopy() {
+		utils::AtomicInc(&copy_count_);
+		utils::AtomicAdd(&entry_copy_count_, assets_.CopiedSize() + metadata_.CopiedSize());
+		utils::AtomicAdd(&entry_share_count_, assets_.SharedSize() + metadata_.SharedSize());
+	}
+
+	void AccountFrm::GetCopyStatus(Json::Value &data) {
+		data["frame_copies"] = copy_count_;
+		data["entry_copies"] = entry_copy_count_;
+		data["entry_shares"] = entry_share_count_;
 	}
 
 	AccountFrm::~AccountFrm() {
@@ -211,12 +235,12 @@ namespace CEG {
 
 	bool AccountFrm::GetAsset(const protocol::AssetKey &asset_key, protocol::AssetStore& asset){
 		//LOG_INFO("%p GetAsset", this);
-		auto it = assets_.find(asset_key);
-		if (it != assets_.end()){
-			if (it->second.action_ == utils::DEL){
+		auto cached = assets_.Find(asset_key);
+		if (cached != nullptr){
+			if (cached->action_ == utils::DEL){
 				return false;
 			}
-			asset.CopyFrom(it->second.data_);
+			asset.CopyFrom(cached->data_);
 			return true;
 		}
 
@@ -239,7 +263,7 @@ namespace CEG {
 			PROCESS_EXIT("fatal error,Asset ParseFromString fail, data may damaged");
 		}
 		Rec.data_.CopyFrom(asset);
-		assets_.insert({ asset_key, Rec });
+		assets_.Insert(asset_key, Rec);
 		return true;
 	}
 
@@ -247,18 +271,18 @@ namespace CEG {
 		DataCache<protocol::AssetStore> Rec;
 		Rec.action_ = utils::ADD;
 		Rec.data_.CopyFrom(data_ptr);
-		assets_[data_ptr.key()] = Rec;
+		assets_.Set(data_ptr.key(), Rec);
 	}
 
 	//
 	bool AccountFrm::GetMetaData(const std::string& binkey, protocol::KeyPair& keypair_ptr){
 		//return assets_->GetEntry(asset_property, asset);
-		auto it = metadata_.find(binkey);
-		if (it != metadata_.end()){
-			if (it->second.action_ == utils::DEL){
+		auto cached = metadata_.Find(binkey);
+		if (cached != nullptr){
+			if (cached->action_ == utils::DEL){
 				return false;
 			}
-			keypair_ptr = it->second.data_;
+			keypair_ptr = cached->data_;
 			return true;
 		}
 
@@ -278,7 +302,7 @@ namespace CEG {
 		DataCache<protocol::KeyPair> Rec;
 		Rec.action_ = utils::MOD;
 		Rec.data_.CopyFrom(keypair_ptr);
-		metadata_.insert({ binkey, Rec });
+		metadata_.Insert(binkey, Rec);
 
 		return true;
 	}
@@ -287,14 +311,14 @@ namespace CEG {
 		DataCache<protocol::KeyPair> Rec;
 		Rec.action_ = utils::ADD;
 		Rec.data_.CopyFrom(dataptr);
-		metadata_[dataptr.key()] = Rec;
+		metadata_.Set(dataptr.key(), Rec);
 	}
 
 	bool AccountFrm::DeleteMetaData(const protocol::KeyPair& dataptr){		
 		DataCache<protocol::KeyPair> Rec;
 		Rec.action_ = utils::DEL;
 		Rec.data_.CopyFrom(dataptr);
-		metadata_[dataptr.key()] = Rec;
+		metadata_.Set(dataptr.key(), Rec);
 		return true;
 	}
 
@@ -307,12 +331,9 @@ namespace CEG {
 		std::string meta_prefix = ComposePrefix(General::METADATA_PREFIX, DecodeAddress(account_info_.address()));
 		trie_metadata.Init(Storage::Instance().account_db(), batch, meta_prefix, 1);
 
-		auto& map = assets_;
-		for (auto it = map.begin(); it != map.end(); it++){
-			auto action = it->second.action_;
-			auto asset = it->second.data_;
-			Json::Value tmp = Proto2Json(asset);
-			switch (action)
+		assets_.ForEach([&trie_asset](const protocol::AssetKey &key, const DataCache<protocol::AssetStore> &cache){
+			const protocol::AssetStore &asset = cache.data_;
+			switch (cache.action_)
 			{
 			case utils::ADD:
 			case utils::MOD:
@@ -328,28 +349,25 @@ namespace CEG {
 			default:
 				break;
 			}
-		}
+		});
 		trie_asset.UpdateHash();
 		account_info_.set_assets_hash(trie_asset.GetRootHash());
 		
-		for (auto it = metadata_.begin(); it != metadata_.end(); it++){
-			auto action = it->second.action_;
-			auto kp = it->second.data_;
-
-			switch (action)
+		metadata_.ForEach([&trie_metadata](const std::string &key, const DataCache<protocol::KeyPair> &cache){
+			switch (cache.action_)
 			{
 			case utils::ADD:
 			case utils::MOD:
-				trie_metadata.Set(it->first, kp.SerializeAsString());
+				trie_metadata.Set(key, cache.data_.SerializeAsString());
 				break;
 			case utils::DEL:
-				trie_metadata.Delete(it->first);
+				trie_metadata.Delete(key);
 				break;
 
 			default:
 				break;
 			}
-		}
+		});
 		trie_metadata.UpdateHash();
 		account_info_.set_metadatas_hash(trie_metadata.GetRootHash());
 	}
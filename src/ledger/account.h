@@ -23,6 +23,7 @@
 #include "proto/cpp/merkeltrie.pb.h"
 #include <common/storage.h>
 #include "utils/atom_map.h"
+#include "utils/cow_map.h"
 #include "kv_trie.h"
 namespace CEG {
 
@@ -48,6 +49,7 @@ namespace CEG {
 		//AccountFrm();
 		AccountFrm(protocol::Account account);
 		AccountFrm(std::shared_ptr< AccountFrm> account);
+		AccountFrm(const AccountFrm &account);
 
 		~AccountFrm();
 
@@ -109,6 +111,9 @@ namespace CEG {
 		int64_t GetAccountBalance() const;
 		bool AddBalance(int64_t amount);
 		static AccountFrm::pointer CreatAccountFrm(const std::string& account_address, int64_t balance);
+
+		//Counters of the frame copies made by the environments
+		static void GetCopyStatus(Json::Value &data);
 	public:
 
 		template <class T>
@@ -117,10 +122,16 @@ namespace CEG {
 			T data_;
 		};
 
-		std::map<protocol::AssetKey, DataCache<protocol::AssetStore>, AssetSort> assets_;
-		std::map<std::string, DataCache<protocol::KeyPair>> metadata_;
+		//Copies of a frame share the cached entries, only the changed ones are copied
+		utils::CowMap<protocol::AssetKey, DataCache<protocol::AssetStore>, AssetSort> assets_;
+		utils::CowMap<std::string, DataCache<protocol::KeyPair>> metadata_;
 	private:
 		protocol::Account	account_info_;
+
+		static int64_t copy_count_;
+		static int64_t entry_copy_count_;
+		static int64_t entry_share_count_;
+		void CountCopy();
 	};
 
 }
@@ -49,8 +49,8 @@ namespace CEG{
 		std::string buff;
 
 		{
-			utils::WriteLockGuard guard(LedgerManager::Instance().GetTreeMutex());
-			if (!LedgerManager::Instance().tree_->Get(index, buff)){
+			utils::ReadLockGuard guard(LedgerManager::Instance().GetTreeMutex());
+			if (!LedgerManager::Instance().tree_->Find(index, buff)){
 				return false;
 			}
 		}
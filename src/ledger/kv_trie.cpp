@@ -17,6 +17,187 @@
 
 namespace CEG{
 
+	TrieNodeCache::TrieNodeCache(size_t capacity) :capacity_(0){
+		SetCapacity(capacity);
+	}
+
+	TrieNodeCache::~TrieNodeCache(){
+	}
+
+	void TrieNodeCache::SetCapacity(size_t capacity){
+		capacity_ = capacity;
+		for (int i = 0; i < SHARD_COUNT; i++){
+			utils::MutexGuard guard(shards_[i].mutex_);
+			shards_[i].lru_ = cache::lru_cache<std::string, NodePointer>(capacity / SHARD_COUNT);
+		}
+	}
+
+	TrieNodeCache::Shard& TrieNodeCache::GetShard(const std::string& key){
+		return shards_[std::hash<std::string>()(key) % SHARD_COUNT];
+	}
+
+	bool TrieNodeCache::Get(const std::string& key, NodeInfo& info, int64_t& generation){
+		Shard& shard = GetShard(key);
+		NodePointer node;
+		do {
+			utils::MutexGuard guard(shard.mutex_);
+			if (!shard.lru_.get(key, node)){
+				shard.misses_++;
+				generation = shard.generation_;
+				return false;
+			}
+			shard.hits_++;
+		} while (false);
+
+		info = *node;
+		return true;
+	}
+
+	void TrieNodeCache::Put(const std::string& key, const NodeInfo& info, int64_t generation){
+		if (capacity_ < SHARD_COUNT){
+			return;
+		}
+
+		Shard& shard = GetShard(key);
+		NodePointer node = std::make_shared<NodeInfo>(info);
+		utils::MutexGuard guard(shard.mutex_);
+		//A commit happened after the node was read from the database
+		if (generation != shard.generation_ || shard.pending_.find(key) != shard.pending_.end()){
+			return;
+		}
+		shard.lru_.put(key, node);
+	}
+
+	void TrieNodeCache::Invalidate(const std::string& key){
+		Shard& shard = GetShard(key);
+		utils::MutexGuard guard(shard.mutex_);
+		shard.lru_.erase_if_exists(key);
+		shard.pending_.insert(key);
+	}
+
+	void TrieNodeCache::Commit(){
+		for (int i = 0; i < SHARD_COUNT; i++){
+			Shard& shard = shards_[i];
+			utils::MutexGuard guard(shard.mutex_);
+			if (shard.pending_.empty()){
+				continue;
+			}
+			for (auto it = shard.pending_.begin(); it != shard.pending_.end(); it++){
+				shard.lru_.erase_if_exists(*it);
+			}
+			shard.pending_.clear();
+			shard.generation_++;
+		}
+	}
+
+	void TrieNodeCache::Clear(){
+		for (int i = 0; i < SHARD_COUNT; i++){
+			Shard& shard = shards_[i];
+			utils::MutexGuard guard(shard.mutex_);
+			shard.lru_ = cache::lru_cache<std::string, NodePointer>(capacity_ / SHARD_COUNT);
+			shard.pending_.clear();
+			shard.generation_++;
+		}
+	}
+
+	void TrieNodeCache::GetModuleStatus(Json::Value &data){
+		int64_t hits = 0, misses = 0, size = 0;
+		for (int i = 0; i < SHARD_COUNT; i++){
+			Shard& shard = shards_[i];
+			utils::MutexGuard guard(shard.mutex_);
+			hits += shard.hits_;
+			misses += shard.misses_;
+			size += shard.lru_.size();
+		}
+		data["capacity"] = (Json::UInt64)capacity_;
+		data["size"] = size;
+		data["hits"] = hits;
+		data["misses"] = misses;
+	}
+
+	class TriePendingBatch::Indexer : public WRITE_BATCH::Handler{
+	public:
+		RecordMap& records_;
+
+		Indexer(RecordMap& records) :records_(records){}
+
+		virtual void Put(const SLICE& key, const SLICE& value) override{
+			records_[key.ToString()] = std::make_pair(true, value.ToString());
+		}
+
+		virtual void Delete(const SLICE& key) override{
+			records_[key.ToString()] = std::make_pair(false, std::string());
+		}
+	};
+
+	TriePendingBatch::TriePendingBatch() :db_(NULL), hits_(0){
+	}
+
+	TriePendingBatch::~TriePendingBatch(){
+	}
+
+	void TriePendingBatch::Set(KeyValueDb* db, const WRITE_BATCH& batch){
+		RecordMap records;
+		Indexer indexer(records);
+		batch.Iterate(&indexer);
+
+		utils::WriteLockGuard guard(mutex_);
+		db_ = db;
+		records_.swap(records);
+	}
+
+	void TriePendingBatch::Clear(){
+		RecordMap records;
+		do {
+			utils::WriteLockGuard guard(mutex_);
+			db_ = NULL;
+			records_.swap(records);
+		} while (false);
+	}
+
+	int32_t TriePendingBatch::Get(KeyValueDb* db, const std::string& key, std::string& value){
+		utils::ReadLockGuard guard(mutex_);
+		if (db != db_){
+			return -1;
+		}
+
+		RecordMap::const_iterator iter = records_.find(key);
+		if (iter == records_.end()){
+			return -1;
+		}
+
+		utils::AtomicInc(&hits_);
+		if (!iter->second.first){
+			return 0;
+		}
+		value = iter->second.second;
+		return 1;
+	}
+
+	void TriePendingBatch::GetModuleStatus(Json::Value &data){
+		utils::ReadLockGuard guard(mutex_);
+		data["records"] = (Json::UInt64)records_.size();
+		data["hits"] = hits_;
+	}
+
+	TrieNodeCache& KVTrie::NodeCache(){
+		static TrieNodeCache node_cache(20000);
+		return node_cache;
+	}
+
+	TriePendingBatch& KVTrie::PendingBatch(){
+		static TriePendingBatch pending_batch;
+		return pending_batch;
+	}
+
+	int32_t KVTrie::StorageRead(const std::string& key, std::string& value){
+		int32_t stat = PendingBatch().Get(mdb_, key, value);
+		if (stat < 0){
+			stat = mdb_->Get(key, value);
+		}
+		return stat;
+	}
+
 	KVTrie::KVTrie(){
 		//leafcount_ = 0;
 	}
@@ -32,11 +213,9 @@ namespace CEG{
 		batch_ = batch;
 		Location location;
 		location.push_back(0);
-		root_ = std::make_shared< NodeFrm>(location);
+		root_ = arena_.New(location);
 
-		protocol::Node info;
-		if (storage_load(location, info)){
-			root_->info_.CopyFrom(info);
+		if (storage_load(location, root_->info_)){
 			Load(root_, depth);
 		}
 		return true;
@@ -61,34 +240,45 @@ namespace CEG{
 	bool KVTrie::AddToDB(){
 		bool b = mdb_->WriteBatch(*batch_);
 		batch_->Clear();
+		NodeCache().Commit();
 		return b;
 	}
 
-	void KVTrie::StorageSaveNode(NodeFrm::POINTER node) {
-		std::string buff = node->info_.SerializeAsString();
+	void KVTrie::StorageSaveNode(NodeFrm::POINTER node, const std::string& buff) {
 		std::string key = Location2DBkey(node->location_, false);
+		NodeCache().Invalidate(key);
 		batch_->Put(key, buff);
 		//LOG_DEBUG("save INNER(%s)", utils::String::BinToHexString(key).c_str());
 	}
 
 	void  KVTrie::StorageSaveLeaf(NodeFrm::POINTER node){
 		std::string key = Location2DBkey(node->location_, true);
-		batch_->Put(key, *node->leaf_);
+		batch_->Put(key, node->leaf_);
 		//LOG_DEBUG("save LEAF(%s)", utils::String::BinToHexString(key).c_str());
 	}
 
-	bool KVTrie::storage_load(const Location& location, protocol::Node& info)  {
+	bool KVTrie::storage_load(const Location& location, NodeInfo& info)  {
 		int64_t t1 = utils::Timestamp::HighResolution();
+		bool found = StorageFindNode(location, info);
+		time_ += (utils::Timestamp::HighResolution() - t1);
+		return found;
+	}
+
+	bool KVTrie::StorageFindNode(const Location& location, NodeInfo& info){
 		std::string key = Location2DBkey(location, false);
+		int64_t generation = 0;
+		if (NodeCache().Get(key, info, generation)){
+			return true;
+		}
+
 		std::string buff;
 		//LOG_DEBUG("LOAD INNER:%s", utils::String::BinToHexString(key).c_str());
-		int32_t stat = mdb_->Get(key, buff);
-		int64_t t2 = utils::Timestamp::HighResolution();
-
-		time_ += (t2 - t1);
-
+		int32_t stat = StorageRead(key, buff);
 		if (stat == 1){
-			info.ParseFromString(buff);
+			if (!info.ParseFrom(buff)){
+				PROCESS_EXIT("Failed to parse trie node(%s)", utils::String::BinToHexString(key).c_str());
+			}
+			NodeCache().Put(key, info, generation);
 			return true;
 		}
 		else if (stat == 0)
@@ -100,6 +290,7 @@ namespace CEG{
 
 	void KVTrie::StorageDeleteNode(NodeFrm::POINTER node) {
 		std::string key = Location2DBkey(node->location_, false);
+		NodeCache().Invalidate(key);
 		//LOG_DEBUG("DELETE INNER %s", utils::String::BinToHexString(key).c_str());
 		batch_->Delete(key);
 	}
@@ -113,7 +304,7 @@ namespace CEG{
 	bool KVTrie::StorageGetLeaf(const Location& location, std::string& value) {
 		std::string key = Location2DBkey(location, true);
 		//LOG_DEBUG("GET LEAF %s", utils::String::BinToHexString(key).c_str());
-		int32_t stat = mdb_->Get(key, value);
+		int32_t stat = StorageRead(key, value);
 		if (stat == 1){
 			return true;
 		}
@@ -125,6 +316,106 @@ namespace CEG{
 		}
 	}
 
+	void KVTrie::StorageLoadBatch(const std::vector<Location>& locations, std::vector<NodeInfo>& infos, std::vector<bool>& found){
+		int64_t t1 = utils::Timestamp::HighResolution();
+		infos.resize(locations.size());
+		found.assign(locations.size(), false);
+
+		//Nodes missed by the cache are read together
+		std::vector<size_t> indexes;
+		std::vector<std::string> keys;
+		std::vector<int64_t> generations;
+		for (size_t i = 0; i < locations.size(); i++){
+			std::string key = Location2DBkey(locations[i], false);
+			int64_t generation = 0;
+			if (NodeCache().Get(key, infos[i], generation)){
+				found[i] = true;
+				continue;
+			}
+
+			std::string buff;
+			int32_t stat = PendingBatch().Get(mdb_, key, buff);
+			if (stat >= 0){
+				if (stat == 1 && !infos[i].ParseFrom(buff)){
+					PROCESS_EXIT("Failed to parse trie node(%s)", utils::String::BinToHexString(key).c_str());
+				}
+				found[i] = stat == 1;
+				continue;
+			}
+			indexes.push_back(i);
+			keys.push_back(key);
+			generations.push_back(generation);
+		}
+
+		for (size_t begin = 0; begin < keys.size(); begin += MULTI_GET_SIZE){
+			size_t end = begin + MULTI_GET_SIZE;
+			if (end > keys.size()){
+				end = keys.size();
+			}
+
+			std::vector<std::string> chunk_keys(keys.begin() + begin, keys.begin() + end);
+			std::vector<std::string> values;
+			std::vector<int32_t> results;
+			if (!mdb_->MultiGet(chunk_keys, values, results)){
+				PROCESS_EXIT("Failed to read database. %s", mdb_->error_desc().c_str());
+			}
+
+			for (size_t i = 0; i < chunk_keys.size(); i++){
+				if (results[i] != 1){
+					continue;
+				}
+
+				size_t index = indexes[begin + i];
+				if (!infos[index].ParseFrom(values[i])){
+					PROCESS_EXIT("Failed to parse trie node(%s)", utils::String::BinToHexString(chunk_keys[i]).c_str());
+				}
+				NodeCache().Put(chunk_keys[i], infos[index], generations[begin + i]);
+				found[index] = true;
+			}
+		}
+
+		time_ += (utils::Timestamp::HighResolution() - t1);
+	}
+
+	void KVTrie::StorageGetLeafBatch(const std::vector<Location>& locations, std::vector<std::string>& values){
+		values.clear();
+		values.reserve(locations.size());
+		for (size_t begin = 0; begin < locations.size(); begin += MULTI_GET_SIZE){
+			size_t end = begin + MULTI_GET_SIZE;
+			if (end > locations.size()){
+				end = locations.size();
+			}
+
+			//Leaves in the pending batch are taken from it, the others are read together
+			std::vector<std::string> chunk_values(end - begin);
+			std::vector<std::string> keys;
+			std::vector<size_t> indexes;
+			for (size_t i = begin; i < end; i++){
+				std::string key = Location2DBkey(locations[i], true);
+				if (PendingBatch().Get(mdb_, key, chunk_values[i - begin]) < 0){
+					keys.push_back(key);
+					indexes.push_back(i - begin);
+				}
+			}
+
+			std::vector<std::string> db_values;
+			std::vector<int32_t> results;
+			if (!keys.empty() && !mdb_->MultiGet(keys, db_values, results)){
+				PROCESS_EXIT("Failed to read storage. %s", mdb_->error_desc().c_str());
+			}
+
+			for (size_t i = 0; i < keys.size(); i++){
+				if (results[i] == 1){
+					chunk_values[indexes[i]] = std::move(db_values[i]);
+				}
+			}
+
+			for (size_t i = 0; i < chunk_values.size(); i++){
+				values.push_back(std::move(chunk_values[i]));
+			}
+		}
+	}
+
 	std::string KVTrie::HashCrypto(const std::string& input){
 		return HashWrapper::Crypto(input);
 	}
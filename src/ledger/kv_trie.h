@@ -16,12 +16,84 @@
 #ifndef KV_TRIE_H_
 #define KV_TRIE_H_
 
+#include <unordered_set>
 #include <common/storage.h>
+#include <utils/lrucache.hpp>
 #include "trie.h"
 
 namespace CEG{
 
+	//Decoded inner nodes shared by all KVTrie instances, keyed by database key (prefix + location).
+	//Keys written into a batch stay uncached until the batch is committed.
+	class TrieNodeCache : public utils::NonCopyable{
+		static const int SHARD_COUNT = 16;
+		typedef std::shared_ptr<const NodeInfo> NodePointer;
+
+		struct Shard{
+			Shard() :lru_(0), generation_(0), hits_(0), misses_(0){}
+			utils::Mutex mutex_;
+			cache::lru_cache<std::string, NodePointer> lru_;
+			std::unordered_set<std::string> pending_;
+			int64_t generation_;
+			int64_t hits_;
+			int64_t misses_;
+		};
+		Shard shards_[SHARD_COUNT];
+		size_t capacity_;
+
+		Shard& GetShard(const std::string& key);
+	public:
+		TrieNodeCache(size_t capacity);
+		~TrieNodeCache();
+
+		void SetCapacity(size_t capacity);
+
+		//Return the shard generation on a miss, it must be passed back to Put
+		bool Get(const std::string& key, NodeInfo& info, int64_t& generation);
+		void Put(const std::string& key, const NodeInfo& info, int64_t generation);
+
+		//The key is modified in a batch which has not been written yet
+		void Invalidate(const std::string& key);
+
+		//Called after the pending batches are written into the database
+		void Commit();
+
+		//Drop every node, called after the database has been rewritten as a whole
+		void Clear();
+
+		void GetModuleStatus(Json::Value &data);
+	};
+
+	//Records of the account-db batch which the commit thread is writing. The tries read them before the database,
+	//so the state of a closed ledger is read while its batch is still being written.
+	class TriePendingBatch : public utils::NonCopyable{
+		class Indexer;
+		//A deleted key has false
+		typedef std::unordered_map<std::string, std::pair<bool, std::string> > RecordMap;
+
+		utils::ReadWriteLock mutex_;
+		KeyValueDb* db_;
+		RecordMap records_;
+		volatile int64_t hits_;
+	public:
+		TriePendingBatch();
+		~TriePendingBatch();
+
+		//The records are copied, the batch may be changed afterwards
+		void Set(KeyValueDb* db, const WRITE_BATCH& batch);
+		//Called once the batch is in the database
+		void Clear();
+
+		//1 if the batch puts the key, 0 if it deletes the key, -1 if the key is not in the batch
+		int32_t Get(KeyValueDb* db, const std::string& key, std::string& value);
+
+		void GetModuleStatus(Json::Value &data);
+	};
+
 	class KVTrie :public Trie{
+		//Keys per MultiGet of the batched reads
+		static const size_t MULTI_GET_SIZE = 4096;
+
 		KeyValueDb* mdb_;
 		std::string prefix_;
 	public:
@@ -34,19 +106,28 @@ namespace CEG{
 
 		//int LeafCount();
 		bool AddToDB();
+
+		static TrieNodeCache& NodeCache();
+		static TriePendingBatch& PendingBatch();
 	private:
 		void Load(NodeFrm::POINTER node, int depth);
+		//The pending batch first, then the database
+		int32_t StorageRead(const std::string& key, std::string& value);
 	    std::string Location2DBkey(const Location& location, bool leaf);
 	protected:
-		virtual void StorageSaveNode(NodeFrm::POINTER node) override;
+		virtual void StorageSaveNode(NodeFrm::POINTER node, const std::string& buff) override;
 		virtual void StorageSaveLeaf(NodeFrm::POINTER node) override;
 		
 		virtual void StorageDeleteNode(NodeFrm::POINTER node) override;
 		virtual void StorageDeleteLeaf(NodeFrm::POINTER node) override;
 
-		virtual bool storage_load(const Location& location, protocol::Node& info) override;
+		virtual bool storage_load(const Location& location, NodeInfo& info) override;
+		virtual bool StorageFindNode(const Location& location, NodeInfo& info) override;
 		virtual bool StorageGetLeaf(const Location& location, std::string& value)override;
 		virtual std::string HashCrypto(const std::string& input) override;
+
+		virtual void StorageLoadBatch(const std::vector<Location>& locations, std::vector<NodeInfo>& infos, std::vector<bool>& found) override;
+		virtual void StorageGetLeafBatch(const std::vector<Location>& locations, std::vector<std::string>& values) override;
 	};
 }
 
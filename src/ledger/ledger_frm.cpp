@@ -22,6 +22,7 @@
 #include "ledger_manager.h"
 #include "ledger_frm.h"
 #include "ledgercontext_manager.h"
+#include "parallel_apply.h"
 #include <contract/contract_manager.h>
 
 namespace CEG {
@@ -57,7 +58,12 @@ namespace CEG {
 
 		CEG::KeyValueDb *db = CEG::Storage::Instance().ledger_db();
 		std::string ledger_header;
-		int32_t ret = db->Get(ComposePrefix(General::LEDGER_PREFIX, ledger_seq), ledger_header);
+		std::string key = ComposePrefix(General::LEDGER_PREFIX, ledger_seq);
+		if (LedgerManager::Instance().PendingGet(key, ledger_header)) {
+			return ledger_.mutable_header()->ParseFromString(ledger_header);
+		}
+
+		int32_t ret = db->Get(key, ledger_header);
 		if (ret > 0) {
 			ledger_.mutable_header()->ParseFromString(ledger_header);
 			return true;
@@ -71,6 +77,16 @@ namespace CEG {
 	}
 
 	bool LedgerFrm::AddToDb(WRITE_BATCH &batch) {
+		PrepareDbBatch(batch);
+
+		KeyValueDb *db = Storage::Instance().ledger_db();
+		if (!db->WriteBatch(batch)){
+			PROCESS_EXIT("Failed to write ledger and transaction to database(%s)", db->error_desc().c_str());
+		}
+		return true;
+	}
+
+	void LedgerFrm::PrepareDbBatch(WRITE_BATCH &batch) {
 		KeyValueDb *db = Storage::Instance().ledger_db();
 
 		batch.Put(CEG::General::KEY_LEDGER_SEQ, utils::String::ToString(ledger_.header().seq()));
@@ -155,11 +171,6 @@ namespace CEG {
 
 			batch.Put(General::LAST_TX_HASHS, new_last_hashs.SerializeAsString());
 		}
-
-		if (!db->WriteBatch(batch)){
-			PROCESS_EXIT("Failed to write ledger and transaction to database(%s)", db->error_desc().c_str());
-		}
-		return true;
 	}
 
 	bool LedgerFrm::Cancel() {
@@ -249,56 +260,41 @@ namespace CEG {
 			return false;
 		}
 
+		std::vector<TransactionFrm::pointer> tx_frms;
+		TransactionFrm::CreateBatch(request.txset(), tx_frms);
+		ParallelApplier applier(this, APPLY_MODE_PROPOSE, tx_frms, std::set<int32_t>());
+		applier.Speculate();
 		for (int i = 0; i < request.txset().txs_size() && enabled_; i++) {
 			const protocol::TransactionEnv &txproto = request.txset().txs(i);
 
-			TransactionFrm::pointer tx_frm = std::make_shared<TransactionFrm>(txproto);
+			TransactionFrm::pointer tx_frm = tx_frms[i];
+			TX_STATUS status = TX_STATUS_SUCCESS;
+			if (!applier.Adopt(i, tx_frm, status)) {
+				if (!tx_frm->ValidForApply(environment_, !IsTestMode())) {
+					dropped_tx_frms_.push_back(tx_frm);
+					proposed_result.need_dropped_tx_.insert(i); //for drop
+					continue;
+				}
 
-			if (!tx_frm->ValidForApply(environment_, !IsTestMode())) {
-				dropped_tx_frms_.push_back(tx_frm);
-				proposed_result.need_dropped_tx_.insert(i); //for drop
-				continue;
-			}
+				//pay fee
+				if (!tx_frm->PayFee(environment_, total_fee_)) {
+					dropped_tx_frms_.push_back(tx_frm);
+					proposed_result.need_dropped_tx_.insert(i);//for drop
+					continue;
+				}
 
-			//pay fee
-			if (!tx_frm->PayFee(environment_, total_fee_)) {
-				dropped_tx_frms_.push_back(tx_frm);
-				proposed_result.need_dropped_tx_.insert(i);//for drop
-				continue;
+				status = ExecuteTransaction(tx_frm, ledger_context, environment_, total_fee_, APPLY_MODE_PROPOSE, false);
 			}
 
-			ledger_context->transaction_stack_.push_back(tx_frm);
-			tx_frm->NonceIncrease(this, environment_);
-			environment_->Commit();
-
-			tx_frm->EnableChecked();
-			tx_frm->SetMaxEndTime(utils::Timestamp::HighResolution() + General::TX_EXECUTE_TIME_OUT);
-
-			bool ret = tx_frm->Apply(this, environment_);
-			//Calculate the required minimum fee by calculating the bytes of the transaction. Do not store the transaction when the user-specified fee is less than this fee. 
-			std::string error_info;
-			if (tx_frm->IsExpire(error_info)) {
-				LOG_ERROR("Failed to apply transaction(%s): %s, %s",
-					utils::String::BinToHexString(tx_frm->GetContentHash()).c_str(), tx_frm->GetResult().desc().c_str(),
-					error_info.c_str());
+			if (status == TX_STATUS_EXPIRED) {
 				expire_txs.insert(i - proposed_result.need_dropped_tx_.size());//for check
 			}
-			else {
-				if (!ret) {
-					LOG_ERROR("Failed to apply transaction(%s): %s",
-						utils::String::BinToHexString(tx_frm->GetContentHash()).c_str(), tx_frm->GetResult().desc().c_str());
-					error_txs.insert(i - proposed_result.need_dropped_tx_.size());//for check
-				}
-				else {
-					tx_frm->ReturnFee(total_fee_);
-					tx_frm->environment_->Commit();
-				}
+			else if (status == TX_STATUS_FAILED) {
+				error_txs.insert(i - proposed_result.need_dropped_tx_.size());//for check
 			}
 
-			environment_->ClearChangeBuf();
 			apply_tx_frms_.push_back(tx_frm);
 			ledger_.add_transaction_envs()->CopyFrom(txproto);
-			ledger_context->transaction_stack_.pop_back();
 
 			if ( utils::Timestamp::HighResolution() - start_time > General::BLOCK_EXECUTE_TIME_OUT) {
 				LOG_ERROR("Applying block timeout(" FMT_I64 ") ", utils::Timestamp::HighResolution() - start_time);
@@ -333,54 +329,39 @@ namespace CEG {
 			return false;
 		}
 
+		std::vector<TransactionFrm::pointer> tx_frms;
+		TransactionFrm::CreateBatch(request.txset(), tx_frms);
+		ParallelApplier applier(this, APPLY_MODE_CHECK, tx_frms, std::set<int32_t>());
+		applier.Speculate();
 		for (int i = 0; i < request.txset().txs_size() && enabled_; i++) {
-			auto txproto = request.txset().txs(i);
+			const protocol::TransactionEnv &txproto = request.txset().txs(i);
 
-			TransactionFrm::pointer tx_frm = std::make_shared<TransactionFrm>(txproto);
+			TransactionFrm::pointer tx_frm = tx_frms[i];
+			TX_STATUS status = TX_STATUS_SUCCESS;
+			if (!applier.Adopt(i, tx_frm, status)) {
+				if (!tx_frm->ValidForApply(environment_, !IsTestMode())) {
+					LOG_ERROR("Validition for application failed: consensus value sequence(" FMT_I64 ")", request.ledger_seq());
+					return false;
+				}
 
-			if (!tx_frm->ValidForApply(environment_, !IsTestMode())) {
-				LOG_ERROR("Validition for application failed: consensus value sequence(" FMT_I64 ")", request.ledger_seq());
-				return false;
-			}
+				//pay fee
+				if (!tx_frm->PayFee(environment_, total_fee_)) {
+					LOG_ERROR("Failed to pay fee, consensus value sequence(" FMT_I64 ")", request.ledger_seq());
+					return false;
+				}
 
-			//pay fee
-			if (!tx_frm->PayFee(environment_, total_fee_)) {
-				LOG_ERROR("Failed to pay fee, consensus value sequence(" FMT_I64 ")", request.ledger_seq());
-				return false;
+				status = ExecuteTransaction(tx_frm, ledger_context, environment_, total_fee_, APPLY_MODE_CHECK, false);
 			}
 
-			ledger_context->transaction_stack_.push_back(tx_frm);
-			tx_frm->NonceIncrease(this, environment_);
-			environment_->Commit();
-
-			tx_frm->EnableChecked();
-			tx_frm->SetMaxEndTime(utils::Timestamp::HighResolution() + General::TX_EXECUTE_TIME_OUT);
-
-			bool ret = tx_frm->Apply(this, environment_);
-			//Caculate the required mininum fee by calculting the bytes of the transaction. Do not store the transaction when the user-specified fee is less than this fee. 
-			std::string error_info;
-			if (tx_frm->IsExpire(error_info)) {
-				LOG_ERROR("Failed to apply transaction(%s). %s, %s",
-					utils::String::BinToHexString(tx_frm->GetContentHash()).c_str(), tx_frm->GetResult().desc().c_str(),
-					error_info.c_str());
+			if (status == TX_STATUS_EXPIRED) {
 				expire_txs.insert(i);//for check
 			}
-			else {
-				if (!ret) {
-					LOG_ERROR("Failed to apply transaction(%s). %s",
-						utils::String::BinToHexString(tx_frm->GetContentHash()).c_str(), tx_frm->GetResult().desc().c_str());
-					error_txs.insert(i);//for check
-				}
-				else {
-					tx_frm->ReturnFee(total_fee_);
-					tx_frm->environment_->Commit();
-				}
+			else if (status == TX_STATUS_FAILED) {
+				error_txs.insert(i);//for check
 			}
 
-			environment_->ClearChangeBuf();
 			apply_tx_frms_.push_back(tx_frm);
 			ledger_.add_transaction_envs()->CopyFrom(txproto);
-			ledger_context->transaction_stack_.pop_back();
 
 			if (utils::Timestamp::HighResolution() - start_time > General::BLOCK_EXECUTE_TIME_OUT) {
 				LOG_ERROR("Applying block timeout(" FMT_I64 ") ", utils::Timestamp::HighResolution() - start_time);
@@ -418,44 +399,37 @@ namespace CEG {
 			return false;
 		}
 
+		std::vector<TransactionFrm::pointer> tx_frms;
+		if (ledger_context->prepared_tx_frms_.size() == (size_t)request.txset().txs_size()) {
+			tx_frms.swap(ledger_context->prepared_tx_frms_);
+		}
+		else {
+			TransactionFrm::CreateBatch(request.txset(), tx_frms);
+		}
+		ParallelApplier applier(this, APPLY_MODE_FOLLOW, tx_frms, expire_txs_check);
+		applier.Speculate();
 		for (int i = 0; i < request.txset().txs_size() && enabled_; i++) {
-			auto txproto = request.txset().txs(i);
-			
-			TransactionFrm::pointer tx_frm = std::make_shared<TransactionFrm>(txproto);
-
-			//Pay fee
-			if (!tx_frm->PayFee(environment_, total_fee_)) {
-				LOG_WARN("Failed to pay fee.");
-				continue;
-			}
-
-			ledger_context->transaction_stack_.push_back(tx_frm);
-			tx_frm->NonceIncrease(this, environment_);
-			environment_->Commit();
+			const protocol::TransactionEnv &txproto = request.txset().txs(i);
 
+			TransactionFrm::pointer tx_frm = tx_frms[i];
+			TX_STATUS status = TX_STATUS_SUCCESS;
+			if (!applier.Adopt(i, tx_frm, status)) {
+				//Pay fee
+				if (!tx_frm->PayFee(environment_, total_fee_)) {
+					LOG_WARN("Failed to pay fee.");
+					continue;
+				}
 
-			if ( expire_txs_check.find(i) != expire_txs_check.end()) {
-				//Follow the consensus value, and do not apply the transaction set.
-				tx_frm->ApplyExpireResult();
+				status = ExecuteTransaction(tx_frm, ledger_context, environment_, total_fee_, APPLY_MODE_FOLLOW,
+					expire_txs_check.find(i) != expire_txs_check.end());
 			}
-			else {
-				bool ret = tx_frm->Apply(this, environment_);
-				if (!ret) {
-					LOG_ERROR("Failed to apply transaction(%s). %s",
-						utils::String::BinToHexString(tx_frm->GetContentHash()).c_str(), tx_frm->GetResult().desc().c_str());
-					error_txs.insert(i);//for check
-				}
-				else {
-					tx_frm->ReturnFee(total_fee_);
-					tx_frm->environment_->Commit();
-				}
+
+			if (status == TX_STATUS_FAILED) {
+				error_txs.insert(i);//for check
 			}
 
-			environment_->ClearChangeBuf();
-			apply_tx_frms_.push_back(tx_frm);			
+			apply_tx_frms_.push_back(tx_frm);
 			ledger_.add_transaction_envs()->CopyFrom(txproto);
-			ledger_context->transaction_stack_.pop_back();
-
 		}
 		AllocateReward();
 		apply_time_ = utils::Timestamp::HighResolution() - start_time;
@@ -467,6 +441,54 @@ namespace CEG {
 		return true;
 	}
 
+	LedgerFrm::TX_STATUS LedgerFrm::ExecuteTransaction(TransactionFrm::pointer tx_frm,
+		LedgerContext *ledger_context,
+		std::shared_ptr<Environment> environment,
+		int64_t &total_fee,
+		APPLY_MODE mode,
+		bool expired_by_check) {
+
+		TX_STATUS status = TX_STATUS_SUCCESS;
+		ledger_context->transaction_stack_.push_back(tx_frm);
+		tx_frm->NonceIncrease(this, environment);
+		environment->Commit();
+
+		if (expired_by_check) {
+			//Follow the consensus value, and do not apply the transaction set.
+			tx_frm->ApplyExpireResult();
+			status = TX_STATUS_EXPIRED;
+		}
+		else {
+			if (mode != APPLY_MODE_FOLLOW) {
+				tx_frm->EnableChecked();
+				tx_frm->SetMaxEndTime(utils::Timestamp::HighResolution() + General::TX_EXECUTE_TIME_OUT);
+			}
+
+			bool ret = tx_frm->Apply(this, environment);
+			//Calculate the required minimum fee by calculating the bytes of the transaction. Do not store the transaction when the user-specified fee is less than this fee. 
+			std::string error_info;
+			if (tx_frm->IsExpire(error_info)) {
+				LOG_ERROR("Failed to apply transaction(%s): %s, %s",
+					utils::String::BinToHexString(tx_frm->GetContentHash()).c_str(), tx_frm->GetResult().desc().c_str(),
+					error_info.c_str());
+				status = TX_STATUS_EXPIRED;
+			}
+			else if (!ret) {
+				LOG_ERROR("Failed to apply transaction(%s): %s",
+					utils::String::BinToHexString(tx_frm->GetContentHash()).c_str(), tx_frm->GetResult().desc().c_str());
+				status = TX_STATUS_FAILED;
+			}
+			else {
+				tx_frm->ReturnFee(total_fee);
+				tx_frm->environment_->Commit();
+			}
+		}
+
+		environment->ClearChangeBuf();
+		ledger_context->transaction_stack_.pop_back();
+		return status;
+	}
+
 	Json::Value LedgerFrm::ToJson() {
 		return CEG::Proto2Json(ledger_);
 	}
@@ -477,7 +499,7 @@ namespace CEG {
 
 	bool LedgerFrm::Commit(KVTrie* trie, int64_t& new_count, int64_t& change_count) {
 		auto batch = trie->batch_;
-		auto entries = environment_->GetData();
+		const Environment::Map &entries = environment_->GetData();
 
 		for (auto it = entries.begin(); it != entries.end(); it++){
 
@@ -35,6 +35,8 @@ namespace CEG {
 		int64_t tx_execute_count_;
 		protocol::ConsensusValueValidation cons_validation_;
 		std::set<int32_t> need_dropped_tx_;
+		//Hash of the executed consensus value
+		std::string value_hash_;
 
 		void SetApply(ProposeTxsResult &result);
 	};
@@ -50,6 +52,12 @@ namespace CEG {
 			APPLY_MODE_FOLLOW = 2
 		} APPLY_MODE;
 
+		typedef enum tagTX_STATUS {
+			TX_STATUS_SUCCESS = 0,
+			TX_STATUS_FAILED = 1,
+			TX_STATUS_EXPIRED = 2
+		} TX_STATUS;
+
 		LedgerFrm();
 		~LedgerFrm();
 
@@ -72,7 +80,17 @@ namespace CEG {
 
 		bool Cancel();
 
+		//Execute a transaction whose fee has been paid, in the given ledger context and environment
+		TX_STATUS ExecuteTransaction(TransactionFrm::pointer tx_frm,
+			LedgerContext *ledger_context,
+			std::shared_ptr<Environment> environment,
+			int64_t &total_fee,
+			APPLY_MODE mode,
+			bool expired_by_check);
+
 		bool AddToDb(WRITE_BATCH& batch);
+		//Put the header and the transactions into the batch without writing it
+		void PrepareDbBatch(WRITE_BATCH& batch);
 
 		bool LoadFromDb(int64_t seq);
 
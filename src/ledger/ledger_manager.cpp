@@ -20,9 +20,43 @@
 #include "ledger_manager.h"
 #include <contract/contract_manager.h>
 #include "fee_calculate.h"
+#include "parallel_apply.h"
 
 namespace CEG {
-	LedgerManager::LedgerManager() : tree_(NULL) {
+	class LedgerManager::CommitTask : public utils::Runnable {
+	public:
+		LedgerFrm::pointer closing_ledger_;
+		std::shared_ptr<WRITE_BATCH> ledger_db_batch_;
+		std::shared_ptr<WRITE_BATCH> account_db_batch_;
+
+		CommitTask(LedgerFrm::pointer closing_ledger, std::shared_ptr<WRITE_BATCH> ledger_db_batch, std::shared_ptr<WRITE_BATCH> account_db_batch)
+			:closing_ledger_(closing_ledger), ledger_db_batch_(ledger_db_batch), account_db_batch_(account_db_batch) {}
+
+		virtual void Run(utils::Thread *this_thread) override {
+			LedgerManager::Instance().CommitLedger(closing_ledger_, *ledger_db_batch_, account_db_batch_);
+			delete this;
+		}
+	};
+
+	class LedgerManager::PrepareTask : public utils::Runnable {
+	public:
+		SyncValuePointer sync_value_;
+
+		PrepareTask(SyncValuePointer sync_value) :sync_value_(sync_value) {}
+
+		virtual void Run(utils::Thread *this_thread) override {
+			LedgerManager::Instance().PrepareSyncValue(sync_value_);
+			delete this;
+		}
+	};
+
+	LedgerManager::LedgerManager() :
+		tree_(NULL),
+		commit_slot_(1),
+		pending_seq_(0),
+		commit_count_(0),
+		commit_wait_time_(0),
+		last_commit_time_(0) {
 		check_interval_ = 500 * utils::MICRO_UNITS_PER_MILLI;
 		timer_name_ = "Ledger Mananger";
 		chain_max_ledger_probaly_ = 0;
@@ -41,20 +75,27 @@ namespace CEG {
 			return false;
 		}
 
-		std::string hashhex = utils::String::BinToHexString(frm.GetProtoHeader().validators_hash());
-		std::string key = utils::String::Format("validators-%s", hashhex.c_str());
-		auto db = Storage::Instance().account_db();
-		std::string str;
-		if (!db->Get(key, str)) {
+		return ValidatorsGet(frm.GetProtoHeader().validators_hash(), validators_set);
+	}
+
+	bool LedgerManager::PendingGet(const std::string &key, std::string &value) {
+		utils::MutexGuard guard(pending_mutex_);
+		auto iter = pending_records_.find(key);
+		if (iter == pending_records_.end()) {
 			return false;
 		}
-		return validators_set.ParseFromString(str);
+
+		value = iter->second;
+		return true;
 	}
 
+	//A closed ledger is written by the commit thread, the ledger-db batch first and then the account-db batch,
+	//and the next ledger is not written before. A crash leaves one of these states:
+	//1. Nothing of the ledger is written, the node restarts from the previous one.
+	//2. The ledger-db is at seq while the account-db is still at seq - 1, the ledger-db seq is set back here.
+	//3. Both are at seq.
+	//The ledger has been agreed by the validators, so the node gets it again from its peers after restart.
 	bool LedgerManager::CheckAndRepairLedgerSeq(){
-#ifdef OS_LINUX
-		return true;
-#endif
 		auto ledger_db = Storage::Instance().ledger_db();
 		auto account_db = Storage::Instance().account_db();
 
@@ -106,11 +147,34 @@ namespace CEG {
 
 		HashWrapper::SetLedgerHashType(Configure::Instance().ledger_configure_.hash_type_);
 
+		KVTrie::NodeCache().SetCapacity(Configure::Instance().ledger_configure_.trie_cache_size_);
 		tree_ = new KVTrie();
 		auto batch = std::make_shared<WRITE_BATCH>();
 		tree_->Init(Storage::Instance().account_db(), batch, General::ACCOUNT_PREFIX, 4);
+		if (!hash_pool_.Init("trie-hash", Configure::Instance().ledger_configure_.hash_thread_count_)) {
+			LOG_ERROR("Failed to start the trie hash thread pool");
+			return false;
+		}
+		tree_->SetHashPool(&hash_pool_);
+
+		if (!apply_pool_.Init("tx-apply", Configure::Instance().ledger_configure_.apply_thread_count_)) {
+			LOG_ERROR("Failed to start the transaction apply thread pool");
+			return false;
+		}
+
+		if (!commit_pool_.Init("ledger-commit", 1)) {
+			LOG_ERROR("Failed to start the ledger commit thread");
+			return false;
+		}
 
-		context_manager_.Initialize();
+		if (!sync_pool_.Init("ledger-sync", MAX(Configure::Instance().ledger_configure_.sync_thread_count_, 1))) {
+			LOG_ERROR("Failed to start the ledger sync thread pool");
+			return false;
+		}
+
+		if (!context_manager_.Initialize()) {
+			return false;
+		}
 
 		auto kvdb = Storage::Instance().account_db();
 		std::string str_max_seq;
@@ -168,7 +232,7 @@ namespace CEG {
 		Storage::Instance().account_db()->Get(General::LAST_PROOF, proof_);
 
 		//Update consensus configuration.
-		Global::Instance().GetIoService().post([this]() {
+		Global::Instance().Post([this]() {
 			GlueManager::Instance().UpdateValidators(validators_, proof_);
 		});
 
@@ -184,6 +248,10 @@ namespace CEG {
 			PROCESS_EXIT("Consensus ledger version:%d, software ledger version:%d", lclheader.version(), General::LEDGER_VERSION);
 		}
 
+		if (!snapshot_manager_.Initialize()) {
+			return false;
+		}
+
 		TimerNotify::RegisterModule(this);
 		StatusModule::RegisterModule(this);
 		return true;
@@ -191,79 +259,106 @@ namespace CEG {
 
 	bool LedgerManager::Exit() {
 		LOG_INFO("Ledger manager stoping...");
+		snapshot_manager_.Exit();
+		context_manager_.Exit();
+		sync_pool_.Exit();
+
+		//Wait for the ledger being written
+		commit_slot_.Wait();
+		commit_pool_.Exit();
+		commit_slot_.Signal();
 
 		if (tree_) {
 			delete tree_;
 			tree_ = NULL;
 		}
+		hash_pool_.Exit();
+		apply_pool_.Exit();
 		LOG_INFO("Ledger manager stoped. [OK]");
 		return true;
 	}
 
-	int LedgerManager::GetAccountNum() {
+	void LedgerManager::LoadSnapshotState() {
 		utils::MutexGuard guard(gmutex_);
-		return statistics_["account_count"].asInt();
-	}
 
-	utils::ReadWriteLock& LedgerManager::GetTreeMutex()  {
-		return tree_mutex_;
-	}
+		//No ledger is being written
+		commit_slot_.Wait();
+		commit_slot_.Signal();
 
+		int64_t seq = GetMaxLedger();
+		LedgerFrm::pointer lcl = std::make_shared<LedgerFrm>();
+		if (!lcl->LoadFromDb(seq)) {
+			PROCESS_EXIT("Failed to load the ledger(" FMT_I64 ") of the snapshot", seq);
+		}
 
-	void LedgerManager::OnTimer(int64_t current_time) {
-		int64_t next_seq = 0;
-		std::set<int64_t> active_peers = PeerManager::Instance().ConsensusNetwork().GetActivePeerIds();
-		std::set<int64_t> enable_peers;
-		protocol::GetLedgers gl;
+		const protocol::LedgerHeader &header = lcl->GetProtoHeader();
+		protocol::ValidatorSet validators;
+		protocol::FeeConfig fees;
+		if (!ValidatorsGet(header.validators_hash(), validators) || !FeesConfigGet(header.fees_hash(), fees)) {
+			PROCESS_EXIT("Failed to load the validators or the fees of the snapshot ledger(" FMT_I64 ")", seq);
+		}
 
+		KVTrie::NodeCache().Clear();
 		do {
-			utils::MutexGuard guard(gmutex_);
-			if (current_time - sync_.update_time_ <= 30 * utils::MICRO_UNITS_PER_SEC) {
-				return;
+			utils::WriteLockGuard tree_guard(tree_mutex_);
+			delete tree_;
+			tree_ = new KVTrie();
+			tree_->Init(Storage::Instance().account_db(), std::make_shared<WRITE_BATCH>(), General::ACCOUNT_PREFIX, 4);
+			tree_->SetHashPool(&hash_pool_);
+			tree_->UpdateHash();
+			if (header.account_tree_hash() != tree_->GetRootHash()) {
+				PROCESS_EXIT("ledger account_tree_hash(%s)!=account_root_hash(%s)",
+					utils::String::Bin4ToHexString(header.account_tree_hash()).c_str(),
+					utils::String::Bin4ToHexString(tree_->GetRootHash()).c_str());
 			}
+		} while (false);
 
-			for (auto it = sync_.peers_.begin(); it != sync_.peers_.end();) {
-				int64_t pid = it->first;
-				if (active_peers.find(pid) == active_peers.end()) {
-					it = sync_.peers_.erase(it);
-				}
-				else {
-					it++;
-				}
-			}
+		std::string str;
+		if (Storage::Instance().account_db()->Get(General::STATISTICS, str) > 0) {
+			statistics_.fromString(str);
+		}
+		proof_.clear();
+		Storage::Instance().account_db()->Get(General::LAST_PROOF, proof_);
 
-			next_seq = last_closed_ledger_->GetProtoHeader().seq() + 1;
+		last_closed_ledger_ = lcl;
+		validators_ = validators;
+		do {
+			utils::WriteLockGuard fee_guard(fee_config_mutex_);
+			fees_ = fees;
+		} while (false);
+		do {
+			utils::WriteLockGuard header_guard(lcl_header_mutex_);
+			lcl_header_ = header;
+		} while (false);
+		do {
+			utils::MutexGuard sync_guard(sync_mutex_);
+			sync_.values_.clear();
+			sync_.update_time_ = utils::Timestamp::HighResolution();
+		} while (false);
 
-			sync_.update_time_ = current_time;
-			LOG_INFO("OnTimer. Request maximum ledger sequence from neighbours. BEGIN");
+		Global::Instance().Post([validators, this]() {
+			GlueManager::Instance().UpdateValidators(validators, proof_);
+		});
+		LOG_INFO("Loaded the snapshot of ledger(" FMT_I64 "), hash(%s)", seq, utils::String::Bin4ToHexString(header.hash()).c_str());
+	}
 
-			gl.set_begin(next_seq);
-			gl.set_end(next_seq);
-			gl.set_timestamp(current_time);
-			gl.set_chain_id(General::GetSelfChainId());
+	int LedgerManager::GetAccountNum() {
+		utils::MutexGuard guard(gmutex_);
+		return statistics_["account_count"].asInt();
+	}
 
-			for (std::set<int64_t>::iterator it = active_peers.begin(); it != active_peers.end(); it++) {
-				int64_t pid = *it;
-				auto iter = sync_.peers_.find(pid);
-				if (iter != sync_.peers_.end()) {
-					SyncStat& st = iter->second;
-					if (current_time - st.send_time_ > 30 * utils::MICRO_UNITS_PER_SEC) {
-						st.send_time_ = 0;
-					}
-					if (st.probation_ > current_time) {
-						continue;
-					}
-					if (st.send_time_ != 0) {
-						continue;
-					}
-				}
-				enable_peers.insert(pid);
-			}
-			LOG_INFO("OnTimer. Request maximum ledger sequence from neighbours. END");
-		} while (false);
+	utils::ReadWriteLock& LedgerManager::GetTreeMutex()  {
+		return tree_mutex_;
+	}
 
-		for (auto it = enable_peers.begin(); it != enable_peers.end(); it++)
-			RequestConsensusValues(*it, gl, current_time);
+
+	void LedgerManager::OnTimer(int64_t current_time) {
+		snapshot_manager_.OnTimer(current_time);
+
+		//The ledgers after the snapshot are synced once it is installed
+		if (!snapshot_manager_.IsFastSyncing()) {
+			ScheduleSync(current_time);
+		}
 	}
 
 	void LedgerManager::OnSlowTimer(int64_t current_time) {
@@ -275,32 +370,40 @@ namespace CEG {
 		return lcl_header_;
 	}
 
+	std::string LedgerManager::ValidatorsKey(const std::string& hash) {
+		return utils::String::Format("validators-%s", utils::String::BinToHexString(hash).c_str());
+	}
+
 	void LedgerManager::ValidatorsSet(std::shared_ptr<WRITE_BATCH> batch, const protocol::ValidatorSet& validators) {
 		//should be recoded
 		std::string hash = HashWrapper::Crypto(validators.SerializeAsString());
-		batch->Put(utils::String::Format("validators-%s", utils::String::BinToHexString(hash).c_str()), validators.SerializeAsString());
+		batch->Put(ValidatorsKey(hash), validators.SerializeAsString());
 	}
 
 	bool LedgerManager::ValidatorsGet(const std::string& hash, protocol::ValidatorSet& vlidators_set) {
-		std::string key = utils::String::Format("validators-%s", utils::String::BinToHexString(hash).c_str());
+		std::string key = ValidatorsKey(hash);
 		auto db = Storage::Instance().account_db();
 		std::string str;
-		if (!db->Get(key, str)) {
+		if (!LedgerManager::Instance().PendingGet(key, str) && !db->Get(key, str)) {
 			return false;
 		}
 		return vlidators_set.ParseFromString(str);
 	}
 
+	std::string LedgerManager::FeesKey(const std::string& hash) {
+		return utils::String::Format("fees-%s", utils::String::BinToHexString(hash).c_str());
+	}
+
 	void LedgerManager::FeesConfigSet(std::shared_ptr<WRITE_BATCH> batch, const protocol::FeeConfig &fee) {
 		std::string hash = HashWrapper::Crypto(fee.SerializeAsString());
-		batch->Put(utils::String::Format("fees-%s", utils::String::BinToHexString(hash).c_str()), fee.SerializeAsString());
+		batch->Put(FeesKey(hash), fee.SerializeAsString());
 	}
 
 	bool LedgerManager::FeesConfigGet(const std::string& hash, protocol::FeeConfig &fee) {
-		std::string key = utils::String::Format("fees-%s", utils::String::BinToHexString(hash).c_str());
+		std::string key = FeesKey(hash);
 		auto db = Storage::Instance().account_db();
 		std::string str;
-		if (!db->Get(key, str)) {
+		if (!LedgerManager::Instance().PendingGet(key, str) && !db->Get(key, str)) {
 			return false;
 		}
 		return fee.ParseFromString(str);
@@ -381,6 +484,7 @@ namespace CEG {
 		if (!Storage::Instance().account_db()->WriteBatch(*batch)) {
 			PROCESS_EXIT("Failed to write account to database, %s", Storage::Instance().account_db()->error_desc().c_str());
 		}
+		KVTrie::NodeCache().Commit();
 
 		return true;
 	}
@@ -477,6 +581,7 @@ namespace CEG {
 			if (!Storage::Instance().account_db()->WriteBatch(*batch_account)) {
 				PROCESS_EXIT("Failed to write account to database, %s", Storage::Instance().account_db()->error_desc().c_str());
 			}
+			KVTrie::NodeCache().Commit();
 
 			header->set_hash(HashWrapper::Crypto(ledger_frm->ProtoLedger().SerializeAsString()));
 
@@ -510,14 +615,49 @@ namespace CEG {
 
 	bool LedgerManager::ConsensusValueFromDB(int64_t seq, protocol::ConsensusValue& consensus_value) {
 		KeyValueDb *ledger_db = Storage::Instance().ledger_db();
+		std::string key = ComposePrefix(General::CONSENSUS_VALUE_PREFIX, seq);
 		std::string str_cons;
-		if (ledger_db->Get(ComposePrefix(General::CONSENSUS_VALUE_PREFIX, seq), str_cons) <= 0) {
+		if (!PendingGet(key, str_cons) && ledger_db->Get(key, str_cons) <= 0) {
 			return false;
 		}
 
 		return consensus_value.ParseFromString(str_cons);
 	}
 
+	void LedgerManager::ConsensusValuesFromDB(int64_t begin, int64_t end, std::vector<protocol::ConsensusValue>& values) {
+		values.clear();
+		std::vector<std::string> keys;
+		for (int64_t seq = begin; seq <= end; seq++) {
+			keys.push_back(ComposePrefix(General::CONSENSUS_VALUE_PREFIX, seq));
+		}
+
+		//Look at the pending records first, they are removed only after being written
+		std::map<size_t, std::string> pendings;
+		for (size_t i = 0; i < keys.size(); i++) {
+			std::string buff;
+			if (PendingGet(keys[i], buff)) {
+				pendings[i] = buff;
+			}
+		}
+
+		KeyValueDb *ledger_db = Storage::Instance().ledger_db();
+		std::vector<std::string> buffs;
+		std::vector<int32_t> results;
+		ledger_db->MultiGet(keys, buffs, results);
+		for (auto iter = pendings.begin(); iter != pendings.end(); iter++) {
+			buffs[iter->first] = iter->second;
+			results[iter->first] = 1;
+		}
+
+		for (size_t i = 0; i < keys.size(); i++) {
+			protocol::ConsensusValue value;
+			if (results[i] <= 0 || !value.ParseFromString(buffs[i])) {
+				break;
+			}
+			values.push_back(value);
+		}
+	}
+
 	protocol::FeeConfig LedgerManager::GetCurFeeConfig() {
 		utils::ReadLockGuard guard(fee_config_mutex_);
 		return fees_;
@@ -535,7 +675,10 @@ namespace CEG {
 		}
 
 		if (last_closed_ledger_->GetProtoHeader().seq() + 1 == consensus_value.ledger_seq()) {
-			sync_.update_time_ = utils::Timestamp::HighResolution();
+			do {
+				utils::MutexGuard sync_guard(sync_mutex_);
+				sync_.update_time_ = utils::Timestamp::HighResolution();
+			} while (false);
 			CloseLedger(consensus_value, proof);
 		}
 		return 0;
@@ -566,15 +709,34 @@ namespace CEG {
 		data["time"] = utils::String::Format(FMT_I64 " ms",
 			(utils::Timestamp::HighResolution() - begin_time) / utils::MICRO_UNITS_PER_MILLI);
 		data["hash_type"] = HashWrapper::GetLedgerHashType() == HashWrapper::HASH_TYPE_SM3 ? "sm3" : "sha256";
-		data["sync"] = sync_.ToJson();
+		do {
+			utils::MutexGuard sync_guard(sync_mutex_);
+			data["sync"] = sync_.ToJson();
+		} while (false);
 		context_manager_.GetModuleStatus(data["ledger_context"]);
+		KVTrie::NodeCache().GetModuleStatus(data["trie_cache"]);
+		KVTrie::PendingBatch().GetModuleStatus(data["trie_pending_batch"]);
+		ParallelApplier::GetModuleStatus(data["parallel_apply"]);
+		AccountFrm::GetCopyStatus(data["account_copy"]);
+		ContractManager::Instance().GetModuleStatus(data["contract"]);
+		snapshot_manager_.GetModuleStatus(data["snapshot"]);
+		do {
+			utils::MutexGuard guard(pending_mutex_);
+			Json::Value &commit = data["ledger_commit"];
+			commit["async"] = Configure::Instance().ledger_configure_.async_commit_;
+			commit["pending_seq"] = pending_seq_;
+			commit["count"] = commit_count_;
+			commit["wait_time"] = commit_wait_time_;
+			commit["last_time"] = last_commit_time_;
+		} while (false);
 
 		data["chain_max_ledger_seq"] = chain_max_ledger_probaly_ > data["ledger_sequence"].asInt64() ?
 		chain_max_ledger_probaly_ : data["ledger_sequence"].asInt64();
 	}
 
-	bool LedgerManager::CloseLedger(const protocol::ConsensusValue& consensus_value, const std::string& proof) {
-		if (!GlueManager::Instance().CheckValueAndProof(consensus_value.SerializeAsString(), proof)) {
+	bool LedgerManager::CloseLedger(const protocol::ConsensusValue& consensus_value, const std::string& proof, SyncValue *prepared) {
+		if (!GlueManager::Instance().CheckValueAndProof(consensus_value.SerializeAsString(), proof,
+			prepared ? prepared->proof_validators_ : std::string())) {
 
 			protocol::PbftProof proof_proto;
 			proof_proto.ParseFromString(proof);
@@ -588,7 +750,7 @@ namespace CEG {
 
 		std::string con_str = consensus_value.SerializeAsString();
 		std::string chash = HashWrapper::Crypto(con_str);
-		LedgerFrm::pointer closing_ledger = context_manager_.SyncProcess(consensus_value);
+		LedgerFrm::pointer closing_ledger = context_manager_.SyncProcess(consensus_value, prepared ? &prepared->tx_frms_ : NULL);
 		if (closing_ledger == NULL){
 			return false;
 		}
@@ -602,14 +764,25 @@ namespace CEG {
 		header->set_chain_id(General::GetSelfChainId());
 		header->set_version(last_closed_ledger_->GetProtoHeader().version());
 
+		//The tree and its batch belong to the commit thread until the previous ledger is written
+		int64_t wait_begin = utils::Timestamp().HighResolution();
+		commit_slot_.Wait();
+		int64_t wait_time = utils::Timestamp().HighResolution() - wait_begin;
+
 		int64_t time0 = utils::Timestamp().HighResolution();
 		int64_t new_count = 0, change_count = 0;
-		closing_ledger->Commit(tree_, new_count, change_count);
+		int64_t time1 = 0;
+		do {
+			//The readers of the accounts find them in the tree under the read lock
+			utils::WriteLockGuard tree_guard(tree_mutex_);
+			closing_ledger->Commit(tree_, new_count, change_count);
+			time1 = utils::Timestamp().HighResolution();
+
+			tree_->UpdateHash();
+			//The tries of the next ledger read the records of this one from here until they are written
+			KVTrie::PendingBatch().Set(Storage::Instance().account_db(), *tree_->batch_);
+		} while (false);
 		statistics_["account_count"] = statistics_["account_count"].asInt64() + new_count;
-
-		int64_t time1 = utils::Timestamp().HighResolution();
-
-		tree_->UpdateHash();
 		int64_t time2 = utils::Timestamp().HighResolution();
 
 		header->set_account_tree_hash(tree_->GetRootHash());
@@ -640,9 +813,13 @@ namespace CEG {
 		std::shared_ptr<WRITE_BATCH> account_db_batch = tree_->batch_;
 		account_db_batch->Put(CEG::General::KEY_LEDGER_SEQ, utils::String::Format(FMT_I64, ledger_seq));
 
+		//Records of the ledger which are read before the commit thread writes them
+		std::map<std::string, std::string> pending_records;
+
 		//for validator upgrade
 		if (new_set.validators_size() > 0 || closing_ledger->environment_->GetVotedValidators(validators_, new_set)) {
 			ValidatorsSet(account_db_batch, new_set);
+			pending_records[ValidatorsKey(HashWrapper::Crypto(new_set.SerializeAsString()))] = new_set.SerializeAsString();
 			validators_ = new_set;
 		}
 		header->set_validators_hash(HashWrapper::Crypto(new_set.SerializeAsString()));//TODO
@@ -651,6 +828,7 @@ namespace CEG {
 		protocol::FeeConfig new_fees;
 		if (closing_ledger->environment_->GetVotedFee(fees_, new_fees)) {
 			FeesConfigSet(account_db_batch, new_fees);
+			pending_records[FeesKey(HashWrapper::Crypto(new_fees.SerializeAsString()))] = new_fees.SerializeAsString();
 			utils::WriteLockGuard guard(fee_config_mutex_);
 			fees_ = new_fees;
 		}
@@ -661,43 +839,43 @@ namespace CEG {
 
 		//proof
 		account_db_batch->Put(CEG::General::LAST_PROOF, proof);
+		pending_records[CEG::General::LAST_PROOF] = proof;
 		account_db_batch->Put(CEG::General::STATISTICS, statistics_.toFastString());
 		proof_ = proof;
 
 		//consensus value
-		WRITE_BATCH ledger_db_batch;
-		ledger_db_batch.Put(ComposePrefix(General::CONSENSUS_VALUE_PREFIX, consensus_value.ledger_seq()), consensus_value.SerializeAsString());
+		std::shared_ptr<WRITE_BATCH> ledger_db_batch = std::make_shared<WRITE_BATCH>();
+		std::string cons_key = ComposePrefix(General::CONSENSUS_VALUE_PREFIX, consensus_value.ledger_seq());
+		ledger_db_batch->Put(cons_key, con_str);
+		closing_ledger->PrepareDbBatch(*ledger_db_batch);
+		pending_records[cons_key] = con_str;
+		pending_records[ComposePrefix(General::LEDGER_PREFIX, ledger_seq)] = header->SerializeAsString();
 
 		do {
-			utils::WriteLockGuard guard(Storage::Instance().account_ledger_lock_);
-
-			if (!closing_ledger->AddToDb(ledger_db_batch)) {
-				PROCESS_EXIT("Failed to write ledger to database.");
-			}
-
-			if (!Storage::Instance().account_db()->WriteBatch(*account_db_batch)) {
-				PROCESS_EXIT("Failed to write accounts to database: %s", Storage::Instance().account_db()->error_desc().c_str());
-			}
-
+			utils::MutexGuard guard(pending_mutex_);
+			pending_seq_ = ledger_seq;
+			pending_records_.swap(pending_records);
+			commit_wait_time_ += wait_time;
 		} while (false);
 
-		//Update the variable when the write is successful.
+		//The records above and the trie records are served from memory until the ledger is written, so it is published now
 		last_closed_ledger_ = closing_ledger;
-
-		int64_t time3 = utils::Timestamp().HighResolution();
 		tree_->batch_ = std::make_shared<WRITE_BATCH>();
-		{
-			utils::WriteLockGuard guard(tree_mutex_);
-			tree_->FreeMemory(4);
+		commit_pool_.AddTask(new CommitTask(closing_ledger, ledger_db_batch, account_db_batch));
+		if (!Configure::Instance().ledger_configure_.async_commit_) {
+			commit_slot_.Wait();
+			commit_slot_.Signal();
 		}
-		LOG_INFO("ledger(" FMT_I64 "): closed transaction count(" FMT_SIZE "), ledger hash(%s), time of apply ledger ="  FMT_I64_EX(-8) " time of calculating hash="  FMT_I64_EX(-8) " time of addtodb=" FMT_I64_EX(-8)
+
+		int64_t time3 = utils::Timestamp().HighResolution();
+		LOG_INFO("ledger(" FMT_I64 "): closed transaction count(" FMT_SIZE "), ledger hash(%s), time of apply ledger ="  FMT_I64_EX(-8) " time of calculating hash="  FMT_I64_EX(-8) " time of wait commit=" FMT_I64_EX(-8)
 			" total=" FMT_I64_EX(-8) " LoadValue=" FMT_I64 " tsize=" FMT_SIZE,
 			closing_ledger->GetProtoHeader().seq(),
 			closing_ledger->GetTxOpeCount(),
 			utils::String::Bin4ToHexString(closing_ledger->GetProtoHeader().hash()).c_str(),
 			time1 - time0 + closing_ledger->apply_time_,
 			time2 - time1,
-			time3 - time2,
+			wait_time,
 			time3 - time0 + closing_ledger->apply_time_,
 			tree_->time_,
 			closing_ledger->GetTxCount());
@@ -707,6 +885,46 @@ namespace CEG {
 		return true;
 	}
 
+	void LedgerManager::CommitLedger(LedgerFrm::pointer closing_ledger, WRITE_BATCH &ledger_db_batch, std::shared_ptr<WRITE_BATCH> account_db_batch) {
+		int64_t time0 = utils::Timestamp().HighResolution();
+		do {
+			utils::WriteLockGuard guard(Storage::Instance().account_ledger_lock_);
+
+			KeyValueDb *ledger_db = Storage::Instance().ledger_db();
+			if (!ledger_db->WriteBatch(ledger_db_batch)) {
+				PROCESS_EXIT("Failed to write ledger and transaction to database(%s)", ledger_db->error_desc().c_str());
+			}
+
+			if (!Storage::Instance().account_db()->WriteBatch(*account_db_batch)) {
+				PROCESS_EXIT("Failed to write accounts to database: %s", Storage::Instance().account_db()->error_desc().c_str());
+			}
+			KVTrie::NodeCache().Commit();
+			KVTrie::PendingBatch().Clear();
+
+		} while (false);
+
+		int64_t time1 = utils::Timestamp().HighResolution();
+		{
+			utils::WriteLockGuard guard(tree_mutex_);
+			tree_->FreeMemory(4);
+		}
+
+		int64_t time2 = utils::Timestamp().HighResolution();
+		do {
+			utils::MutexGuard guard(pending_mutex_);
+			pending_seq_ = 0;
+			pending_records_.clear();
+			commit_count_++;
+			last_commit_time_ = time2 - time0;
+		} while (false);
+
+		LOG_TRACE("ledger(" FMT_I64 "): time of addtodb=" FMT_I64 " time of free memory=" FMT_I64,
+			closing_ledger->GetProtoHeader().seq(), time1 - time0, time2 - time1);
+
+		commit_slot_.Signal();
+		snapshot_manager_.OnLedgerCommitted(closing_ledger->GetProtoHeader().seq());
+	}
+
 	void LedgerManager::NotifyLedgerClose(LedgerFrm::pointer closing_ledger, bool has_upgrade) {
 		//Avoid dead lock
 		protocol::LedgerHeader tmp_lcl_header;
@@ -717,7 +935,7 @@ namespace CEG {
 
 		protocol::ValidatorSet tmp_v = validators_;
 		std::string tmp_proof = proof_;
-		Global::Instance().GetIoService().post([tmp_v, tmp_proof, has_upgrade]() { //avoid deadlock
+		Global::Instance().Post([tmp_v, tmp_proof, has_upgrade]() { //avoid deadlock
 			GlueManager::Instance().UpdateValidators(tmp_v, tmp_proof);
 			if (has_upgrade) GlueManager::Instance().LedgerHasUpgrade();
 		});
@@ -795,44 +1013,58 @@ namespace CEG {
 		do {
 			utils::MutexGuard guard(gmutex_);
 			LOG_TRACE("OnRequestLedgers pid(" FMT_I64 "),[" FMT_I64 ", " FMT_I64 "]", peer_id, message.begin(), message.end());
-			if (message.end() - message.begin() + 1 > 5) {
-				LOG_ERROR("Only 5 blocks can be requested at a time while try to (" FMT_I64 ")", message.end() - message.begin());
-				return;
-			}
-
 			if (message.end() - message.begin() < 0) {
 				LOG_ERROR("Begin is greater than end [" FMT_I64 "," FMT_I64 "]", message.begin(), message.end());
 				return;
 			}
 
-			if (last_closed_ledger_->GetProtoHeader().seq() < message.end()) {
+			int64_t last_seq = last_closed_ledger_->GetProtoHeader().seq();
+			if (last_seq < message.begin()) {
 				LOG_INFO("Peer node(" FMT_I64 ") request ledger[" FMT_I64 "," FMT_I64 "] while the max consensus value is (" FMT_I64 ")",
-					peer_id, message.begin(), message.end(), last_closed_ledger_->GetProtoHeader().seq());
+					peer_id, message.begin(), message.end(), last_seq);
 				return;
 			}
 
+			//Serve the first part of a range which is too large or goes beyond the last closed ledger
+			int64_t max_count = MAX(Configure::Instance().ledger_configure_.max_ledger_per_message_, 1);
+			int64_t end = MIN(message.end(), last_seq);
+			end = MIN(end, message.begin() + max_count - 1);
 
-			ledgers.set_max_seq(last_closed_ledger_->GetProtoHeader().seq());
+			ledgers.set_max_seq(last_seq);
 
-			for (int64_t i = message.begin(); i <= message.end(); i++) {
-				protocol::ConsensusValue item;
-				if (!ConsensusValueFromDB(i, item)) {
+			//The value after the range carries the proof of the last one
+			bool last_closed = (end == last_seq);
+			std::vector<protocol::ConsensusValue> values;
+			ConsensusValuesFromDB(message.begin(), last_closed ? end : end + 1, values);
+
+			int64_t message_size = 0;
+			for (int64_t i = message.begin(); i <= end; i++) {
+				size_t index = (size_t)(i - message.begin());
+				if (index >= values.size()) {
 					ret = false;
 					LOG_ERROR("Failed to get consensus value from database: consensus value sequence=" FMT_I64, i);
 					break;
 				}
-				ledgers.add_values()->CopyFrom(item);
+
+				message_size += values[index].ByteSize();
+				if (ledgers.values_size() > 0 && message_size > General::TXSET_LIMIT_SIZE) {
+					break;
+				}
+				ledgers.add_values()->CopyFrom(values[index]);
 			}
 
-			int64_t seq = message.end();
-			protocol::ConsensusValue next;
+			if (!ret) {
+				break;
+			}
 
-			if (seq == last_closed_ledger_->GetProtoHeader().seq())
+			size_t count = (size_t)ledgers.values_size();
+			if (last_closed && count == values.size())
 				ledgers.set_proof(proof_);
-			else if (ConsensusValueFromDB(seq + 1, next))
-				ledgers.set_proof(next.previous_proof());
+			else if (values.size() > count)
+				ledgers.set_proof(values[count].previous_proof());
 			else {
-				LOG_ERROR("");
+				LOG_ERROR("Failed to get the proof of consensus value(" FMT_I64 ")", message.begin() + (int64_t)count - 1);
+				ret = false;
 			}
 		} while (false);
 		if (ret) {
@@ -840,7 +1072,7 @@ namespace CEG {
 			ws->set_data(ledgers.SerializeAsString());
 			ws->set_type(protocol::OVERLAY_MSGTYPE_LEDGERS);
 			ws->set_request(false);
-			LOG_TRACE("Send ledgers[" FMT_I64 "," FMT_I64 "] to(" FMT_I64 ")", message.begin(), message.end(), peer_id);
+			LOG_TRACE("Send ledgers[" FMT_I64 "," FMT_I64 "] to(" FMT_I64 ")", message.begin(), message.begin() + ledgers.values_size() - 1, peer_id);
 			PeerManager::Instance().ConsensusNetwork().SendMsgToPeer(peer_id, ws);
 		}
 	}
@@ -852,11 +1084,12 @@ namespace CEG {
 			return;
 		}
 
-		bool valid = false;
-		int64_t next = 0;
+		int64_t current_time = utils::Timestamp::HighResolution();
+		int64_t next_seq = GetLastClosedLedger().seq() + 1;
+		std::vector<SyncValuePointer> received;
 
 		do {
-			utils::MutexGuard guard(gmutex_);
+			utils::MutexGuard guard(sync_mutex_);
 			if (ledgers.values_size() == 0) {
 				LOG_ERROR("Received empty Ledgers from(" FMT_I64 ")", peer_id);
 				break;
@@ -866,77 +1099,296 @@ namespace CEG {
 
 			LOG_INFO("OnReceiveLedgers [" FMT_I64 "," FMT_I64 "] from peer node(" FMT_I64 ")", begin, end, peer_id);
 
-			if (sync_.peers_.find(peer_id) == sync_.peers_.end()) {
+			auto iter = sync_.peers_.find(peer_id);
+			if (iter == sync_.peers_.end()) {
 				LOG_ERROR("Received unexpected ledgers [" FMT_I64 "," FMT_I64 "] from (" FMT_I64 ")",
 					begin, end, peer_id);
 				break;
 			}
 
-			auto& itm = sync_.peers_[peer_id];
-			itm.send_time_ = 0;
+			//The request may have timed out, or the ledgers have been closed by the consensus meanwhile
+			SyncStat &stat = iter->second;
+			auto request = stat.requests_.find(begin);
+			if (request == stat.requests_.end()) {
+				LOG_TRACE("Received ledgers [" FMT_I64 "," FMT_I64 "] from (" FMT_I64 ") which are not requested any more",
+					begin, end, peer_id);
+				break;
+			}
+
+			int64_t request_end = request->second.end_;
+			stat.requests_.erase(request);
+
+			//A peer may serve the first part of the range only
+			bool valid = end <= request_end;
+			for (int32_t i = 0; i < ledgers.values_size() && valid; i++) {
+				valid = (ledgers.values(i).ledger_seq() == begin + i);
+			}
 
-			if (begin != itm.gl_.begin() || end != itm.gl_.end()) {
+			if (!valid) {
 				LOG_ERROR("Received unexpected ledgers[" FMT_I64 "," FMT_I64 "] while expect[" FMT_I64 "," FMT_I64 "]",
-					begin, end, itm.gl_.begin(), itm.gl_.end());
-				itm.probation_ = utils::Timestamp::HighResolution() + 60 * utils::MICRO_UNITS_PER_SEC;
-				itm.gl_.set_begin(0);
-				itm.gl_.set_end(0);
+					begin, end, begin, request_end);
+				stat.probation_ = current_time + 60 * utils::MICRO_UNITS_PER_SEC;
 				break;
 			}
 
-			itm.gl_.set_begin(0);
-			itm.gl_.set_end(0);
+			stat.max_seq_ = MAX(stat.max_seq_, ledgers.max_seq());
+			if (ledgers.max_seq() > chain_max_ledger_probaly_) {
+				chain_max_ledger_probaly_ = ledgers.max_seq();
+			}
+
+			for (int32_t i = 0; i < ledgers.values_size(); i++) {
+				int64_t seq = begin + i;
+				if (seq < next_seq || sync_.values_.find(seq) != sync_.values_.end()) {
+					continue;
+				}
 
-			for (int i = 0; i < ledgers.values_size(); i++) {
-				const protocol::ConsensusValue& consensus_value = ledgers.values(i);
-				std::string proof;
+				SyncValuePointer sync_value = std::make_shared<SyncValue>();
+				sync_value->value_ = ledgers.values(i);
 				if (i < ledgers.values_size() - 1) {
-					proof = ledgers.values(i + 1).previous_proof();
+					sync_value->proof_ = ledgers.values(i + 1).previous_proof();
 				}
 				else {
-					proof = ledgers.proof();
+					sync_value->proof_ = ledgers.proof();
 				}
-				if (consensus_value.ledger_seq() == last_closed_ledger_->GetProtoHeader().seq() + 1) {
-					if (!CloseLedger(consensus_value, proof)) {
-						valid = false;
-						itm.probation_ = utils::Timestamp::HighResolution() + 60 * utils::MICRO_UNITS_PER_SEC;
-						break;
+				sync_value->peer_id_ = peer_id;
+				sync_.values_[seq] = sync_value;
+				received.push_back(sync_value);
+			}
+		} while (false);
+
+		for (size_t i = 0; i < received.size(); i++) {
+			sync_pool_.AddTask(new PrepareTask(received[i]));
+		}
+
+		ScheduleSync(current_time);
+	}
+
+	void LedgerManager::ScheduleSync(int64_t current_time) {
+		std::set<int64_t> active_peers = PeerManager::Instance().ConsensusNetwork().GetActivePeerIds();
+		const LedgerConfigure &ledger_configure = Configure::Instance().ledger_configure_;
+		int64_t next_seq = GetLastClosedLedger().seq() + 1;
+		//Do not run further ahead of the last closed ledger
+		int64_t prefetch_count = MAX(ledger_configure.sync_prefetch_count_, 1);
+		int64_t last_seq = next_seq + prefetch_count - 1;
+		int64_t max_window = MAX(ledger_configure.max_ledger_per_message_, 1);
+		size_t max_requests = MAX(ledger_configure.sync_requests_per_peer_, 1);
+		std::vector<std::pair<int64_t, protocol::GetLedgers> > requests;
+
+		do {
+			utils::MutexGuard guard(sync_mutex_);
+			if (sync_.rate_time_ == 0) {
+				sync_.rate_time_ = current_time;
+			}
+			else if (current_time - sync_.rate_time_ >= 5 * utils::MICRO_UNITS_PER_SEC) {
+				sync_.blocks_per_second_ = (double)(sync_.applied_count_ - sync_.rate_count_) * utils::MICRO_UNITS_PER_SEC / (current_time - sync_.rate_time_);
+				sync_.rate_time_ = current_time;
+				sync_.rate_count_ = sync_.applied_count_;
+			}
+
+			//The values closed by the consensus meanwhile
+			sync_.values_.erase(sync_.values_.begin(), sync_.values_.lower_bound(next_seq));
+
+			//Sequences which are received or requested already
+			std::set<int64_t> covered;
+			for (auto it = sync_.values_.begin(); it != sync_.values_.end(); it++) {
+				covered.insert(it->first);
+			}
+
+			for (auto it = sync_.peers_.begin(); it != sync_.peers_.end();) {
+				if (active_peers.find(it->first) == active_peers.end()) {
+					it = sync_.peers_.erase(it);
+					continue;
+				}
+
+				SyncStat &stat = it->second;
+				for (auto iter = stat.requests_.begin(); iter != stat.requests_.end();) {
+					if (current_time - iter->second.send_time_ > 10 * utils::MICRO_UNITS_PER_SEC) {
+						LOG_TRACE("Request ledgers[" FMT_I64 "," FMT_I64 "] from peer(" FMT_I64 ") timed out", iter->first, iter->second.end_, it->first);
+						//A peer of an older version does not answer a range over the legacy window
+						if (iter->second.end_ - iter->first + 1 > LEGACY_SYNC_WINDOW) {
+							stat.window_ = LEGACY_SYNC_WINDOW;
+						}
+						iter = stat.requests_.erase(iter);
+						continue;
+					}
+
+					for (int64_t seq = MAX(iter->first, next_seq); seq <= iter->second.end_; seq++) {
+						covered.insert(seq);
 					}
-					valid = true;
+					iter++;
 				}
+				it++;
 			}
-			next = last_closed_ledger_->GetProtoHeader().seq() + 1;
-		} while (false);
 
+			//Ask the peers for the next ledger if nothing has been closed for a while, as they may be ahead
+			bool stalled = current_time - sync_.update_time_ > 30 * utils::MICRO_UNITS_PER_SEC;
+			for (auto it = active_peers.begin(); it != active_peers.end(); it++) {
+				SyncStat &stat = sync_.peers_[*it];
+				if (stat.window_ == 0) {
+					stat.window_ = max_window;
+				}
+
+				if (!stalled || stat.probation_ > current_time || stat.max_seq_ >= next_seq || !stat.requests_.empty() ||
+					current_time - stat.probe_time_ <= 30 * utils::MICRO_UNITS_PER_SEC) {
+					continue;
+				}
+
+				stat.probe_time_ = current_time;
+				SyncRequest &request = stat.requests_[next_seq];
+				request.end_ = next_seq;
+				request.send_time_ = current_time;
+				covered.insert(next_seq);
 
-		if (valid) {
-			int64_t current_time = utils::Timestamp::HighResolution();
-			if (next <= ledgers.max_seq()) {
 				protocol::GetLedgers gl;
-				gl.set_begin(next);
-				gl.set_end(MIN(ledgers.max_seq(), next + 4));
+				gl.set_begin(next_seq);
+				gl.set_end(next_seq);
 				gl.set_timestamp(current_time);
 				gl.set_chain_id(General::GetSelfChainId());
-				RequestConsensusValues(peer_id, gl, current_time);
+				requests.push_back(std::make_pair(*it, gl));
 			}
 
-			if (ledgers.max_seq() > chain_max_ledger_probaly_) {
-				chain_max_ledger_probaly_ = ledgers.max_seq();
+			//Give each peer ahead of this node the next missing range, in turns, so the ranges are fetched in parallel
+			bool assigned = true;
+			while (assigned) {
+				assigned = false;
+				for (auto it = sync_.peers_.begin(); it != sync_.peers_.end(); it++) {
+					SyncStat &stat = it->second;
+					if (stat.probation_ > current_time || stat.requests_.size() >= max_requests || stat.max_seq_ < next_seq) {
+						continue;
+					}
+
+					int64_t begin = next_seq;
+					while (covered.find(begin) != covered.end()) {
+						begin++;
+					}
+
+					int64_t end_limit = MIN(stat.max_seq_, last_seq);
+					if (begin > end_limit) {
+						continue;
+					}
+
+					int64_t end = begin;
+					while (end < end_limit && end - begin + 1 < stat.window_ && covered.find(end + 1) == covered.end()) {
+						end++;
+					}
+
+					for (int64_t seq = begin; seq <= end; seq++) {
+						covered.insert(seq);
+					}
+
+					SyncRequest &request = stat.requests_[begin];
+					request.end_ = end;
+					request.send_time_ = current_time;
+
+					protocol::GetLedgers gl;
+					gl.set_begin(begin);
+					gl.set_end(end);
+					gl.set_timestamp(current_time);
+					gl.set_chain_id(General::GetSelfChainId());
+					requests.push_back(std::make_pair(it->first, gl));
+					assigned = true;
+				}
 			}
+		} while (false);
+
+		for (size_t i = 0; i < requests.size(); i++) {
+			RequestConsensusValues(requests[i].first, requests[i].second);
 		}
 	}
 
-	void LedgerManager::RequestConsensusValues(int64_t pid, protocol::GetLedgers& gl, int64_t time) {
+	void LedgerManager::RequestConsensusValues(int64_t pid, const protocol::GetLedgers& gl) {
 		LOG_TRACE("Request consensus values from peer(" FMT_I64 "), [" FMT_I64 "," FMT_I64 "]", pid, gl.begin(), gl.end());
+		PeerManager::Instance().ConsensusNetwork().SendRequest(pid, protocol::OVERLAY_MSGTYPE_LEDGERS, gl.SerializeAsString());
+	}
+
+	void LedgerManager::PrepareSyncValue(SyncValuePointer sync_value) {
+		const protocol::ConsensusValue &value = sync_value->value_;
+		std::vector<TransactionFrm::pointer> tx_frms;
+		TransactionFrm::CreateBatch(value.txset(), tx_frms);
+
+		//The proof is signed by the validators of the previous ledger. If it is not closed yet,
+		//the validators of the last closed ledger are taken, and closing checks whether they changed.
+		std::string proof_validators;
+		protocol::ValidatorSet validators;
+		int64_t validators_seq = MIN(value.ledger_seq() - 1, GetLastClosedLedger().seq());
+		if (GetValidators(validators_seq, validators) &&
+			GlueManager::Instance().CheckProof(validators, HashWrapper::Crypto(value.SerializeAsString()), sync_value->proof_)) {
+			proof_validators = validators.SerializeAsString();
+		}
+
 		do {
-			utils::MutexGuard guard(gmutex_);
-			auto &peer = sync_.peers_[pid];
-			peer.gl_.CopyFrom(gl);
-			peer.send_time_ = time;
-			sync_.update_time_ = time;
+			utils::MutexGuard guard(sync_mutex_);
+			sync_value->tx_frms_.swap(tx_frms);
+			sync_value->proof_validators_ = proof_validators;
+			sync_value->prepared_ = true;
 		} while (false);
 
-		PeerManager::Instance().ConsensusNetwork().SendRequest(pid, protocol::OVERLAY_MSGTYPE_LEDGERS, gl.SerializeAsString());
+		Global::Instance().Post([]() {
+			LedgerManager::Instance().ApplySyncValues();
+		});
+	}
+
+	void LedgerManager::ApplySyncValues() {
+		int64_t applied = 0;
+		while (true) {
+			int64_t next_seq = GetLastClosedLedger().seq() + 1;
+			SyncValuePointer sync_value;
+			do {
+				utils::MutexGuard guard(sync_mutex_);
+				sync_.values_.erase(sync_.values_.begin(), sync_.values_.lower_bound(next_seq));
+				auto iter = sync_.values_.find(next_seq);
+				if (iter == sync_.values_.end() || !iter->second->prepared_) {
+					break;
+				}
+
+				sync_value = iter->second;
+				sync_.values_.erase(iter);
+			} while (false);
+
+			if (!sync_value) {
+				break;
+			}
+
+			bool closed = true;
+			do {
+				utils::MutexGuard guard(gmutex_);
+				//Closed by the consensus meanwhile
+				if (sync_value->value_.ledger_seq() != last_closed_ledger_->GetProtoHeader().seq() + 1) {
+					break;
+				}
+
+				closed = CloseLedger(sync_value->value_, sync_value->proof_, sync_value.get());
+				if (closed) {
+					applied++;
+				}
+			} while (false);
+
+			if (!closed) {
+				//Drop what the peer has sent, the ranges are asked from the others
+				utils::MutexGuard guard(sync_mutex_);
+				sync_.peers_[sync_value->peer_id_].probation_ = utils::Timestamp::HighResolution() + 60 * utils::MICRO_UNITS_PER_SEC;
+				for (auto iter = sync_.values_.begin(); iter != sync_.values_.end();) {
+					if (iter->second->peer_id_ == sync_value->peer_id_) {
+						iter = sync_.values_.erase(iter);
+					}
+					else {
+						iter++;
+					}
+				}
+				break;
+			}
+		}
+
+		if (applied > 0) {
+			int64_t current_time = utils::Timestamp::HighResolution();
+			do {
+				utils::MutexGuard guard(sync_mutex_);
+				sync_.applied_count_ += applied;
+				sync_.update_time_ = current_time;
+			} while (false);
+
+			ScheduleSync(current_time);
+		}
 	}
 
 	Result LedgerManager::DoTransaction(protocol::TransactionEnv& env, LedgerContext *ledger_context) {
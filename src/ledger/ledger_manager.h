@@ -26,6 +26,7 @@
 #include "ledgercontext_manager.h"
 #include "environment.h"
 #include "kv_trie.h"
+#include "snapshot_manager.h"
 #include "proto/cpp/consensus.pb.h"
 
 #ifdef WIN32
@@ -64,7 +65,11 @@ namespace CEG {
 		}
 
 		static bool FeesConfigGet(const std::string& hash, protocol::FeeConfig &fee);
+		//Records of the ledger which is being written by the commit thread
+		bool PendingGet(const std::string &key, std::string &value);
 		bool ConsensusValueFromDB(int64_t seq, protocol::ConsensusValue& request);
+		//Read the consensus values of [begin, end] in one call, stop at the first missing one
+		void ConsensusValuesFromDB(int64_t begin, int64_t end, std::vector<protocol::ConsensusValue>& values);
 		protocol::FeeConfig GetCurFeeConfig();
 
 		Result DoTransaction(protocol::TransactionEnv& env, LedgerContext *ledger_context); // -1: false, 0 : successs, > 0 exception
@@ -77,24 +82,53 @@ namespace CEG {
 
 		static void CreateHardforkLedger();
 		utils::ReadWriteLock& GetTreeMutex();
-	private:
-		bool CheckAndRepairLedgerSeq();
+
+		//Reload the last closed ledger, the tree and the validators after a snapshot is written into the databases
+		void LoadSnapshotState();
+
+		static std::string ValidatorsKey(const std::string& hash);
+		static std::string FeesKey(const std::string& hash);
+
+		//Set the ledger-db seq back when a crash left the ledger-db one ledger ahead of the account-db
+		static bool CheckAndRepairLedgerSeq();
 	public:
 		utils::Mutex gmutex_;
 		Json::Value statistics_;
 		utils::ReadWriteLock tree_mutex_;
 		KVTrie* tree_;
+		utils::ThreadPool hash_pool_;
+		//Workers of the parallel transaction execution, no thread means serial execution
+		utils::ThreadPool apply_pool_;
+		//One thread which writes the closed ledgers to the databases in order
+		utils::ThreadPool commit_pool_;
+		//Workers which verify the values received by the sync ahead of their turn
+		utils::ThreadPool sync_pool_;
 
 		LedgerContextManager context_manager_;
+		SnapshotManager snapshot_manager_;
 	private:
 		LedgerManager();
 		~LedgerManager();
 
-		void RequestConsensusValues(int64_t pid, protocol::GetLedgers& gl, int64_t time);
+		struct SyncValue;
+		typedef std::shared_ptr<SyncValue> SyncValuePointer;
+		class PrepareTask;
+
+		//Assign the missing sequences to the peers, called on the main thread
+		void ScheduleSync(int64_t current_time);
+		void RequestConsensusValues(int64_t pid, const protocol::GetLedgers& gl);
+		//Runs on the sync pool: parse the transactions, verify their signatures and the proof
+		void PrepareSyncValue(SyncValuePointer sync_value);
+		//Close the prepared values which follow the last closed ledger, called on the main thread
+		void ApplySyncValues();
 
 		int64_t GetMaxLedger();
 
-		bool CloseLedger(const protocol::ConsensusValue& request, const std::string& proof);
+		bool CloseLedger(const protocol::ConsensusValue& request, const std::string& proof, SyncValue *prepared = NULL);
+
+		class CommitTask;
+		//Runs on the commit thread: write the batches, release the trie memory and free the slot
+		void CommitLedger(LedgerFrm::pointer closing_ledger, WRITE_BATCH &ledger_db_batch, std::shared_ptr<WRITE_BATCH> account_db_batch);
 
 		bool CreateGenesisAccount();
 
@@ -114,33 +148,95 @@ namespace CEG {
 		utils::ReadWriteLock fee_config_mutex_;
 		protocol::FeeConfig fees_;
 
-		struct SyncStat{
+		//At most one closed ledger is being written, the next one waits for it before touching the tree
+		utils::Semaphore commit_slot_;
+		utils::Mutex pending_mutex_;
+		int64_t pending_seq_;
+		std::map<std::string, std::string> pending_records_;
+		int64_t commit_count_;
+		int64_t commit_wait_time_;
+		int64_t last_commit_time_;
+
+		//Peers which do not know larger requests serve at most so many ledgers
+		static const int64_t LEGACY_SYNC_WINDOW = 5;
+
+		struct SyncRequest{
+			int64_t end_;
 			int64_t send_time_;
-			protocol::GetLedgers gl_;
+			SyncRequest(){
+				end_ = 0;
+				send_time_ = 0;
+			}
+		};
+
+		struct SyncStat{
 			int64_t probation_; //
+			int64_t probe_time_;
+			//The max ledger sequence of the peer, as it told in its last reply
+			int64_t max_seq_;
+			//Ledgers asked in one request, cut to the legacy window after a request timed out
+			int64_t window_;
+			//Requests in flight by their begin sequence
+			std::map<int64_t, SyncRequest> requests_;
 			SyncStat(){
-				send_time_ = 0;
 				probation_ = 0;
+				probe_time_ = 0;
+				max_seq_ = 0;
+				window_ = 0;
 			}
 			Json::Value ToJson(){
 				Json::Value v;
-				v["send_time"] = send_time_;
 				v["probation"] = probation_;
-				v["gl"] = Proto2Json(gl_);
+				v["max_seq"] = max_seq_;
+				v["window"] = window_;
+				Json::Value &requests = v["requests"];
+				for (auto it = requests_.begin(); it != requests_.end(); it++){
+					Json::Value &request = requests[requests.size()];
+					request["begin"] = it->first;
+					request["end"] = it->second.end_;
+					request["send_time"] = it->second.send_time_;
+				}
 				return v;
 			}
 		};
-		
+
+		struct SyncValue{
+			protocol::ConsensusValue value_;
+			std::string proof_;
+			int64_t peer_id_;
+			bool prepared_;
+			//The serialized validator set the proof has been verified with, empty if it has not
+			std::string proof_validators_;
+			//The transactions of the value, parsed and with their signatures verified
+			std::vector<TransactionFrm::pointer> tx_frms_;
+			SyncValue(){
+				peer_id_ = 0;
+				prepared_ = false;
+			}
+		};
+
 		struct Sync{
 			int64_t update_time_;
-			/*std::map<int64_t, int> buffer_;*/
 			std::map<int64_t, SyncStat> peers_;
+			//Values received ahead of the last closed ledger
+			std::map<int64_t, SyncValuePointer> values_;
+			int64_t applied_count_;
+			int64_t rate_time_;
+			int64_t rate_count_;
+			double blocks_per_second_;
 			Sync(){
 				update_time_ = 0;
+				applied_count_ = 0;
+				rate_time_ = 0;
+				rate_count_ = 0;
+				blocks_per_second_ = 0;
 			}
 			Json::Value ToJson(){
 				Json::Value v;
 				v["update_time"] = update_time_;
+				v["buffered"] = (Json::UInt64)values_.size();
+				v["applied"] = applied_count_;
+				v["blocks_per_second"] = blocks_per_second_;
 				Json::Value& peers = v["peers"];
 				for (auto it = peers_.begin(); it != peers_.end(); it++){
 					Json::Value tmp = it->second.ToJson();
@@ -151,6 +247,7 @@ namespace CEG {
 			}
 		};
 
+		utils::Mutex sync_mutex_;
 		Sync sync_;
 	};
 }
@@ -21,13 +21,14 @@ namespace CEG {
 	//For synchronizing blocks.
 	LedgerContext::LedgerContext(const std::string &chash, const protocol::ConsensusValue &consvalue) :
 		type_(AT_NORMAL),
-		lpmanager_(NULL),
 		hash_(chash),
-		consensus_value_(consvalue),
+		lpmanager_(NULL),
 		start_time_(-1),
+		apply_mode_(LedgerFrm::APPLY_MODE_FOLLOW),
+		cancelled_(false),
+		consensus_value_(consvalue),
 		tx_timeout_(-1),
-		timeout_tx_index_(-1),
-		apply_mode_(LedgerFrm::APPLY_MODE_FOLLOW) {
+		timeout_tx_index_(-1) {
 		closing_ledger_ = std::make_shared<LedgerFrm>();
 	}
 
@@ -35,11 +36,12 @@ namespace CEG {
 	//For synchronizing the block before the current block.
 	LedgerContext::LedgerContext(LedgerContextManager *lpmanager, const std::string &chash, const protocol::ConsensusValue &consvalue, bool propose) :
 		type_(AT_NORMAL),
-		lpmanager_(lpmanager),
 		hash_(chash),
-		consensus_value_(consvalue),
+		lpmanager_(lpmanager),
 		start_time_(-1),
-		timeout_tx_index_(-1){
+		cancelled_(false),
+		consensus_value_(consvalue),
+		timeout_tx_index_(-1) {
 		apply_mode_ = propose ? LedgerFrm::APPLY_MODE_PROPOSE : LedgerFrm::APPLY_MODE_CHECK;
 		closing_ledger_ = std::make_shared<LedgerFrm>();
 	}
@@ -50,7 +52,9 @@ namespace CEG {
 		const ContractTestParameter &parameter) :
 		type_(type), 
 		parameter_(parameter),
-		lpmanager_(NULL) {
+		lpmanager_(NULL),
+		start_time_(-1),
+		cancelled_(false) {
 		apply_mode_ = LedgerFrm::APPLY_MODE_PROPOSE;
 		closing_ledger_ = std::make_shared<LedgerFrm>();
 	}
@@ -59,17 +63,29 @@ namespace CEG {
 		const protocol::ConsensusValue &consensus_value,
 		int64_t timeout) :
 		type_(type),
-		consensus_value_(consensus_value),
 		lpmanager_(NULL),
+		start_time_(-1),
+		cancelled_(false),
+		consensus_value_(consensus_value),
 		tx_timeout_(timeout) {
 		apply_mode_ = LedgerFrm::APPLY_MODE_PROPOSE;
 		closing_ledger_ = std::make_shared<LedgerFrm>();
 	}
 	LedgerContext::~LedgerContext() {}
 
-	void LedgerContext::Run() {
-		LOG_INFO("Preprocessing the consensus value, ledger(" FMT_I64 ")", consensus_value_.ledger_seq());
+	void LedgerContext::Run(utils::Thread *this_thread) {
 		start_time_ = utils::Timestamp::HighResolution();
+		if (cancelled_) {
+			LOG_ERROR("The consensus value, ledger(" FMT_I64 ") is cancelled before it is preprocessed", consensus_value_.ledger_seq());
+			propose_result_.exec_result_ = false;
+			if (lpmanager_) {
+				lpmanager_->MoveRunningToDelete(this);
+			}
+			done_.Signal();
+			return;
+		}
+
+		LOG_INFO("Preprocessing the consensus value, ledger(" FMT_I64 ")", consensus_value_.ledger_seq());
 		switch (type_)
 		{
 		case AT_NORMAL:
@@ -88,6 +104,9 @@ namespace CEG {
 			LOG_ERROR("Action type unknown of LedgerContext.");
 			break;
 		}
+
+		//The last access, a context of the manager may be deleted once it is waited for
+		done_.Signal();
 	}
 
 	void LedgerContext::Do() {
@@ -98,7 +117,9 @@ namespace CEG {
 		header->set_previous_hash(consensus_value_.previous_ledger_hash());
 		header->set_consensus_value_hash(hash_);
 		header->set_chain_id(General::GetSelfChainId());
-		header->set_version(LedgerManager::Instance().GetLastClosedLedger().version());
+		protocol::LedgerHeader lcl = LedgerManager::Instance().GetLastClosedLedger();
+		header->set_version(lcl.version());
+		parent_state_root_ = lcl.account_tree_hash();
 		LedgerManager::Instance().tree_->time_ = 0;
 		if (apply_mode_ == LedgerFrm::APPLY_MODE_PROPOSE) {
 			propose_result_.exec_result_ = closing_ledger_->ApplyPropose(consensus_value_, this, propose_result_);
@@ -283,6 +304,7 @@ namespace CEG {
 	}
 
 	void LedgerContext::Cancel() {
+		cancelled_ = true;
 		std::stack<int64_t> copy_stack;
 		do {
 			utils::MutexGuard guard(lock_);
@@ -295,13 +317,98 @@ namespace CEG {
 			copy_stack.pop();
 		}
 
-		JoinWithStop();
+		WaitComplete();
+	}
+
+	bool LedgerContext::WaitComplete(uint32_t timeout) {
+		if (!done_.Wait(timeout)) {
+			return false;
+		}
+
+		done_.Signal();
+		return true;
 	}
 
 	bool LedgerContext::CheckExpire(int64_t total_timeout) {
 		return utils::Timestamp::HighResolution() - start_time_ >= total_timeout;
 	}
 
+	int64_t LedgerContext::GetStartTime() const {
+		return start_time_;
+	}
+
+	bool LedgerContext::IsReusable() const {
+		if (apply_mode_ != LedgerFrm::APPLY_MODE_PROPOSE) {
+			return true;
+		}
+
+		const protocol::ConsensusValueValidation &validation = propose_result_.cons_validation_;
+		return propose_result_.need_dropped_tx_.empty() && validation.expire_tx_ids_size() == 0 && validation.error_tx_ids_size() == 0;
+	}
+
+	ExecutionResultCache::ExecutionResultCache() :
+		hit_count_(0),
+		miss_count_(0),
+		store_count_(0),
+		evict_count_(0) {}
+
+	ExecutionResultCache::~ExecutionResultCache() {}
+
+	void ExecutionResultCache::Store(const std::string &value_hash, const std::string &state_root, int64_t seq, LedgerFrm::pointer ledger) {
+		utils::MutexGuard guard(lock_);
+		Entry &entry = entries_[value_hash + state_root];
+		entry.seq_ = seq;
+		entry.ledger_ = ledger;
+		store_count_++;
+
+		//Evict the lowest ledger, the newest values are the ones which may close
+		while (entries_.size() > MAX_SIZE) {
+			EntryMap::iterator lowest = entries_.begin();
+			for (EntryMap::iterator iter = entries_.begin(); iter != entries_.end(); iter++) {
+				if (iter->second.seq_ < lowest->second.seq_) {
+					lowest = iter;
+				}
+			}
+			entries_.erase(lowest);
+			evict_count_++;
+		}
+	}
+
+	LedgerFrm::pointer ExecutionResultCache::Take(const std::string &value_hash, const std::string &state_root) {
+		utils::MutexGuard guard(lock_);
+		EntryMap::iterator iter = entries_.find(value_hash + state_root);
+		if (iter == entries_.end()) {
+			miss_count_++;
+			return NULL;
+		}
+
+		LedgerFrm::pointer ledger = iter->second.ledger_;
+		entries_.erase(iter);
+		hit_count_++;
+		return ledger;
+	}
+
+	void ExecutionResultCache::RemoveClosed(int64_t ledger_seq) {
+		utils::MutexGuard guard(lock_);
+		for (EntryMap::iterator iter = entries_.begin(); iter != entries_.end();) {
+			if (iter->second.seq_ <= ledger_seq) {
+				iter = entries_.erase(iter);
+			}
+			else {
+				iter++;
+			}
+		}
+	}
+
+	void ExecutionResultCache::GetModuleStatus(Json::Value &data) {
+		utils::MutexGuard guard(lock_);
+		data["size"] = (Json::UInt64)entries_.size();
+		data["hit"] = hit_count_;
+		data["miss"] = miss_count_;
+		data["stored"] = store_count_;
+		data["evicted"] = evict_count_;
+	}
+
 	void LedgerContext::PushLog(const std::string &address, const utils::StringList &logs) {
 		Json::Value &item = logs_[utils::String::Format(FMT_SIZE "-%s", logs_.size(), address.c_str())];
 		for (utils::StringList::const_iterator iter = logs.begin(); iter != logs.end(); iter++) {
@@ -376,8 +483,25 @@ namespace CEG {
 	LedgerContextManager::~LedgerContextManager() {
 	}
 
-	void LedgerContextManager::Initialize() {
+	bool LedgerContextManager::Initialize() {
+		if (!execute_pool_.Init("ledger-execute", 1)) {
+			LOG_ERROR("Failed to start the ledger execution thread");
+			return false;
+		}
+
+		if (!test_pool_.Init("ledger-test", MAX(Configure::Instance().ledger_configure_.test_thread_count_, 1))) {
+			LOG_ERROR("Failed to start the ledger test thread pool");
+			return false;
+		}
+
 		TimerNotify::RegisterModule(this);
+		return true;
+	}
+
+	bool LedgerContextManager::Exit() {
+		test_pool_.Exit();
+		execute_pool_.Exit();
+		return true;
 	}
 
 	int32_t LedgerContextManager::CheckComplete(const std::string &chash) {
@@ -392,19 +516,22 @@ namespace CEG {
 		return -1;
 	}
 
-	LedgerFrm::pointer LedgerContextManager::SyncProcess(const protocol::ConsensusValue& consensus_value) {
+	LedgerFrm::pointer LedgerContextManager::SyncProcess(const protocol::ConsensusValue& consensus_value,
+		std::vector<std::shared_ptr<TransactionFrm>> *prepared_tx_frms) {
 		std::string con_str = consensus_value.SerializeAsString();
 		std::string chash = HashWrapper::Crypto(con_str);
-		do {
-			utils::MutexGuard guard(ctxs_lock_);
-			LedgerContextMap::iterator iter = completed_ctxs_.find(chash);
-			if (iter != completed_ctxs_.end()) {
-				return iter->second->closing_ledger_;
-			}
-		} while (false);
+		std::string state_root = LedgerManager::Instance().GetLastClosedLedger().account_tree_hash();
+		LedgerFrm::pointer executed_ledger = execution_cache_.Take(chash, state_root);
+		if (executed_ledger) {
+			LOG_TRACE("Reuse the execution result of the consensus value, ledger seq(" FMT_I64 ")", consensus_value.ledger_seq());
+			return executed_ledger;
+		}
 
 		LOG_TRACE("Sync processing the consensus value, ledger seq(" FMT_I64 ")", consensus_value.ledger_seq());
 		LedgerContext ledger_context(chash, consensus_value);
+		if (prepared_tx_frms) {
+			ledger_context.prepared_tx_frms_.swap(*prepared_tx_frms);
+		}
 		ledger_context.Do();
 		if (ledger_context.propose_result_.exec_result_) {
 			return ledger_context.closing_ledger_;
@@ -425,9 +552,7 @@ namespace CEG {
 		Json::Value &stat,
 		int32_t signature_number) {
 		LedgerContext *ledger_context = nullptr;
-		std::string thread_name = "test";
 		if (type == LedgerContext::AT_TEST_V8){
-			thread_name = "test-contract";
 			ledger_context = new LedgerContext(type, *((ContractTestParameter*)parameter));
 
 			do {
@@ -454,7 +579,6 @@ namespace CEG {
 			} while (false);
 		}
 		else if (type == LedgerContext::AT_TEST_TRANSACTION){
-			thread_name = "test-transaction";
 			ledger_context = new LedgerContext(type, ((TransactionTestParameter*)parameter)->consensus_value_, total_timeout);
 		}
 		else {
@@ -462,31 +586,12 @@ namespace CEG {
 			return false;
 		}
 
-		if (!ledger_context->Start(thread_name)) {
-			LOG_ERROR_ERRNO("Failed to start test thread.",
-				STD_ERR_CODE, STD_ERR_DESC);
-			result.set_code(protocol::ERRCODE_INTERNAL_ERROR);
-			result.set_desc("Failed to start thread.");
-			delete ledger_context;
-			return false;
-		}
-
-		int64_t time_start = utils::Timestamp::HighResolution();
-		bool is_timeout = false;
-		while (ledger_context->IsRunning()) {
-			utils::Sleep(10);
-			if (utils::Timestamp::HighResolution() - time_start > total_timeout) {
-				is_timeout = true;
-				break;
-			}
-		}
-
-		if (is_timeout) { //cancel it
+		test_pool_.AddTask(ledger_context);
+		if (!ledger_context->WaitComplete((uint32_t)(total_timeout / utils::MICRO_UNITS_PER_MILLI))) { //cancel it
 			ledger_context->Cancel();
 			result.set_code(protocol::ERRCODE_TX_TIMEOUT);
 			result.set_desc("Contract execution timeout");
 			LOG_ERROR("Testing consensus value(" FMT_I64 "ms) timeout", total_timeout / utils::MICRO_UNITS_PER_MILLI);
-			ledger_context->JoinWithStop();
 			delete ledger_context;
 			return false;
 		}
@@ -562,7 +667,6 @@ namespace CEG {
 
 		ledger_context->GetLogs(logs);
 		ledger_context->GetRets(rets);
-		ledger_context->JoinWithStop();
 		delete ledger_context;
 		return true;
 	}
@@ -577,25 +681,18 @@ namespace CEG {
 			return check_complete == 1;
 		} 
 
+		//Owned by the manager once it is executed, it is moved to the completed or the deleted contexts
 		LedgerContext *ledger_context = new LedgerContext(this, chash, consensus_value, propose);
 
-		if (!ledger_context->Start("process-value")) {
-			LOG_ERROR_ERRNO("Failed to start processing consensus value, consensus value hash(%s)", utils::String::BinToHexString(chash).c_str(), 
-				STD_ERR_CODE, STD_ERR_DESC);
-
+		int64_t time_start = utils::Timestamp::HighResolution();
+		execute_pool_.AddTask(ledger_context);
+		if (!ledger_context->WaitComplete((uint32_t)(General::BLOCK_EXECUTE_TIME_OUT / utils::MICRO_UNITS_PER_MILLI))) {
 			propose_result.block_timeout_ = true;
-			delete ledger_context;
-			return false;
 		}
-
-		int64_t time_start = utils::Timestamp::HighResolution();
-		while (ledger_context->IsRunning()) {
-			utils::Sleep(10);
-			if (utils::Timestamp::HighResolution() - time_start > General::BLOCK_EXECUTE_TIME_OUT) {
-				propose_result.block_timeout_ = true;
-				break;
-			}
+		else {
+			preprocess_start_.Add(ledger_context->GetStartTime() - time_start);
 		}
+		preprocess_time_.Add(utils::Timestamp::HighResolution() - time_start);
 
 		propose_result.tx_execute_count_ = ledger_context->closing_ledger_->GetTxCount();
 
@@ -606,9 +703,29 @@ namespace CEG {
 		}
 
 		propose_result = ledger_context->propose_result_;
+		propose_result.value_hash_ = chash;
 		return propose_result.exec_result_;
 	}
 
+	void LedgerContextManager::ReuseProposal(const std::string &executed_hash, const protocol::ConsensusValue &proposed_value) {
+		LedgerContext *ledger_context = NULL;
+		do {
+			utils::MutexGuard guard(ctxs_lock_);
+			//A value which drops transactions or carries a validation is not the one which was executed
+			LedgerContextMap::iterator iter = completed_ctxs_.find(executed_hash);
+			if (iter == completed_ctxs_.end() || !iter->second->IsReusable()) {
+				return;
+			}
+			ledger_context = iter->second;
+		} while (false);
+
+		//The completed contexts are only deleted on the main thread, as this is called
+		std::string proposed_hash = HashWrapper::Crypto(proposed_value.SerializeAsString());
+		if (proposed_hash != executed_hash) {
+			execution_cache_.Store(proposed_hash, ledger_context->parent_state_root_, proposed_value.ledger_seq(), ledger_context->closing_ledger_);
+		}
+	}
+
 	void LedgerContextManager::RemoveCompleted(int64_t ledger_seq) {
 		utils::MutexGuard guard(ctxs_lock_);
 		for (LedgerContextMap::iterator iter = completed_ctxs_.begin();
@@ -622,12 +739,18 @@ namespace CEG {
 				iter++;
 			}
 		}
+
+		execution_cache_.RemoveClosed(ledger_seq);
 	}
 
 	void LedgerContextManager::GetModuleStatus(Json::Value &data) {
 		utils::MutexGuard guard(ctxs_lock_);
 		data["completed_size"] = (Json::UInt64)completed_ctxs_.size();
 		data["running_size"] = (Json::UInt64)running_ctxs_.size();
+		data["test_thread_count"] = (Json::UInt64)test_pool_.Size();
+		execution_cache_.GetModuleStatus(data["execution_cache"]);
+		preprocess_start_.ToJson(data["preprocess_start"]);
+		preprocess_time_.ToJson(data["preprocess_time"]);
 	}
 
 	void LedgerContextManager::OnTimer(int64_t current_time) {
@@ -697,5 +820,9 @@ namespace CEG {
 		}
 
 		completed_ctxs_.insert(std::make_pair(ledger_context->GetHash(), ledger_context));
+		if (ledger_context->IsReusable()) {
+			execution_cache_.Store(ledger_context->GetHash(), ledger_context->parent_state_root_,
+				ledger_context->consensus_value_.ledger_seq(), ledger_context->closing_ledger_);
+		}
 	}
 }
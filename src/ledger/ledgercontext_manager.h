@@ -27,7 +27,8 @@ namespace CEG {
 	class LedgerContextManager;
 	class LedgerContext;
 	typedef std::function< void(bool check_result)> PreProcessCallback;
-	class LedgerContext : public utils::Thread {
+	//Execution of a consensus value or of a test, run as a task of the execution pools of LedgerContextManager
+	class LedgerContext : public utils::Runnable {
 		std::stack<int64_t> contract_ids_; //The contract_ids may be called by checking the thread or executing the thread, so contract_ids needs to be locked.
 		//parameter
 		int32_t type_; // -1 : normal, 0 : test v8 , 1: test evm ,2 test transaction
@@ -41,6 +42,10 @@ namespace CEG {
 
 		Json::Value logs_;
 		Json::Value rets_;
+
+		//Signaled once Run returns, and signaled again by each waiter so that it stays signaled
+		utils::Semaphore done_;
+		volatile bool cancelled_;
 	public:
 		LedgerContext(
 			LedgerContextManager *lpmanager,
@@ -72,9 +77,13 @@ namespace CEG {
 
 		protocol::ConsensusValue consensus_value_;
 		int64_t tx_timeout_;
+		//Account tree hash of the last closed ledger when the value is executed
+		std::string parent_state_root_;
 
 		LedgerFrm::pointer closing_ledger_;
 		std::vector<std::shared_ptr<TransactionFrm>> transaction_stack_;
+		//Transactions of the consensus value which the sync has parsed and verified already
+		std::vector<std::shared_ptr<TransactionFrm>> prepared_tx_frms_;
 		
 		//result
 		//bool exe_result_;
@@ -84,12 +93,19 @@ namespace CEG {
 
 		utils::Mutex lock_;
 
-		virtual void Run();
+		virtual void Run(utils::Thread *this_thread) override;
 		void Do();
 		bool TestV8();
 		bool TestTransaction();
+		//Cancel the running contracts and wait for the task to return, a task still queued does not execute
 		void Cancel();
+		//Wait for the task to return, in milliseconds
+		bool WaitComplete(uint32_t timeout = utils::Semaphore::kInfinite);
 		bool CheckExpire(int64_t total_timeout);
+		int64_t GetStartTime() const;
+		//Whether the result is the one of the executed value as it may close. A proposal is not if the leader
+		//drops some transactions or adds the validation.
+		bool IsReusable() const;
 		
 		void PushContractId(int64_t id);
 		void PopContractId();
@@ -109,6 +125,37 @@ namespace CEG {
 		std::shared_ptr<TransactionFrm> GetTopTx();
 	};
 
+	//Results of the consensus values executed by this node, so that a value which was proposed or checked is not
+	//executed again when it closes. The key is the value hash with the account tree hash of the ledger it was
+	//executed on, a result computed on another state is never used. The results outlive their contexts, until
+	//their ledger closes or MAX_SIZE newer ones are stored.
+	class ExecutionResultCache {
+		struct Entry {
+			int64_t seq_;
+			LedgerFrm::pointer ledger_;
+		};
+		typedef std::map<std::string, Entry> EntryMap;
+
+		utils::Mutex lock_;
+		EntryMap entries_;
+		int64_t hit_count_;
+		int64_t miss_count_;
+		int64_t store_count_;
+		int64_t evict_count_;
+
+		static const size_t MAX_SIZE = 64;
+	public:
+		ExecutionResultCache();
+		~ExecutionResultCache();
+
+		void Store(const std::string &value_hash, const std::string &state_root, int64_t seq, LedgerFrm::pointer ledger);
+		//Remove and return the result, NULL if it is not cached
+		LedgerFrm::pointer Take(const std::string &value_hash, const std::string &state_root);
+		//Drop the results of the closed ledgers
+		void RemoveClosed(int64_t ledger_seq);
+		void GetModuleStatus(Json::Value &data);
+	};
+
 	typedef std::multimap<std::string, LedgerContext *> LedgerContextMultiMap;
 	typedef std::multimap<int64_t, LedgerContext *> LedgerContextTimeMultiMap;
 	typedef std::map<std::string, LedgerContext *> LedgerContextMap;
@@ -118,11 +165,22 @@ namespace CEG {
 		LedgerContextMultiMap running_ctxs_;
 		LedgerContextMap completed_ctxs_;
 		LedgerContextTimeMultiMap delete_ctxs_;
+
+		//The consensus values are executed one at a time by the main thread, so one worker is enough.
+		//The tests of the web server have their own workers, so that they never delay the consensus.
+		utils::ThreadPool execute_pool_;
+		utils::ThreadPool test_pool_;
+		ExecutionResultCache execution_cache_;
+
+		//Pre-processing of the consensus values on the main thread: the wait for a worker, and the whole call
+		LatencyHistogram preprocess_start_;
+		LatencyHistogram preprocess_time_;
 	public:
 		LedgerContextManager();
 		~LedgerContextManager();
 
-		void Initialize();
+		bool Initialize();
+		bool Exit();
 		virtual void OnTimer(int64_t current_time);
 		virtual void OnSlowTimer(int64_t current_time);
 		void MoveRunningToComplete(LedgerContext *ledger_context);
@@ -143,10 +201,13 @@ namespace CEG {
 		//<0 : notfound 1: found and success 0: found and failed
 		int32_t CheckComplete(const std::string &chash);
 		bool SyncPreProcess(const protocol::ConsensusValue& consensus_value, bool propose, ProposeTxsResult &propose_result);
+		//The leader adds the validation to the value it executed, cache the result under the hash of the proposed value
+		void ReuseProposal(const std::string &executed_hash, const protocol::ConsensusValue &proposed_value);
 
 		//<0 : processing 1: found and success 0: found and failed
 //		int32_t AsyncPreProcess(const protocol::ConsensusValue& consensus_value, int64_t timeout, PreProcessCallback callback, int32_t &timeout_tx_index);
-		LedgerFrm::pointer SyncProcess(const protocol::ConsensusValue& consensus_value); //for ledger closing
+		LedgerFrm::pointer SyncProcess(const protocol::ConsensusValue& consensus_value,
+			std::vector<std::shared_ptr<TransactionFrm>> *prepared_tx_frms = NULL); //for ledger closing
 	};
 
 }
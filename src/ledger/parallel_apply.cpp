@@ -0,0 +1,249 @@
+/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <utils/utils.h>
+#include <utils/logger.h>
+#include "ledger_manager.h"
+#include "ledgercontext_manager.h"
+#include "parallel_apply.h"
+
+namespace CEG {
+
+	bool SpeculativeEnvironment::GetFromDB(const std::string &address, AccountFrm::pointer &account_ptr) {
+		reads_.insert(address);
+		return Environment::GetFromDB(address, account_ptr);
+	}
+
+	int64_t ParallelApplier::speculated_count_ = 0;
+	int64_t ParallelApplier::adopted_count_ = 0;
+	int64_t ParallelApplier::conflict_count_ = 0;
+
+	class ParallelApplier::SpeculateTask : public utils::Runnable {
+	public:
+		ParallelApplier *applier_;
+		const std::vector<size_t> &indexes_;
+		size_t begin_;
+		size_t end_;
+		utils::Semaphore *done_;
+
+		SpeculateTask(ParallelApplier *applier, const std::vector<size_t> &indexes, size_t begin, size_t end, utils::Semaphore *done)
+			:applier_(applier), indexes_(indexes), begin_(begin), end_(end), done_(done) {}
+
+		virtual void Run(utils::Thread *this_thread) override {
+			applier_->SpeculateRange(indexes_, begin_, end_);
+			done_->Signal();
+		}
+	};
+
+	ParallelApplier::ParallelApplier(LedgerFrm *ledger,
+		LedgerFrm::APPLY_MODE mode,
+		const std::vector<TransactionFrm::pointer> &tx_frms,
+		const std::set<int32_t> &expire_txs) :
+		ledger_(ledger),
+		mode_(mode),
+		tx_frms_(tx_frms),
+		expire_txs_(expire_txs) {}
+
+	ParallelApplier::~ParallelApplier() {}
+
+	bool ParallelApplier::IsCandidate(size_t index) const {
+		if (expire_txs_.find((int32_t)index) != expire_txs_.end()) {
+			return false;
+		}
+
+		//Only the operations which never run contract code on their own
+		const protocol::Transaction &tran = tx_frms_[index]->GetTransactionEnv().transaction();
+		if (tran.operations_size() == 0) {
+			return false;
+		}
+
+		for (int32_t i = 0; i < tran.operations_size(); i++) {
+			const protocol::Operation &ope = tran.operations(i);
+			switch (ope.type()) {
+			case protocol::Operation_Type_PAY_COIN:
+			case protocol::Operation_Type_SET_SIGNER_WEIGHT:
+			case protocol::Operation_Type_SET_THRESHOLD:
+			case protocol::Operation_Type_SET_PRIVILEGE:
+			case protocol::Operation_Type_LOG:
+				break;
+			case protocol::Operation_Type_CREATE_ACCOUNT:
+				if (!ope.create_account().contract().payload().empty() || ope.create_account().metadatas_size() > 0) {
+					return false;
+				}
+				break;
+			default:
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void ParallelApplier::Speculate() {
+		utils::ThreadPool &pool = LedgerManager::Instance().apply_pool_;
+		if (pool.Size() == 0 || tx_frms_.size() < MIN_PARALLEL_TXS) {
+			return;
+		}
+
+		std::vector<size_t> indexes;
+		for (size_t i = 0; i < tx_frms_.size(); i++) {
+			if (IsCandidate(i)) {
+				indexes.push_back(i);
+			}
+		}
+
+		if (indexes.size() < MIN_PARALLEL_TXS) {
+			return;
+		}
+
+		speculations_.resize(tx_frms_.size());
+
+		//Several ranges per worker, so that a slow range does not hold the others
+		size_t task_count = pool.Size() * 4;
+		if (task_count > indexes.size()) {
+			task_count = indexes.size();
+		}
+
+		utils::Semaphore done;
+		std::vector<SpeculateTask *> tasks;
+		size_t begin = 0;
+		for (size_t i = 0; i < task_count; i++) {
+			size_t end = (indexes.size() * (i + 1)) / task_count;
+			tasks.push_back(new SpeculateTask(this, indexes, begin, end, &done));
+			begin = end;
+		}
+
+		for (size_t i = 0; i < tasks.size(); i++) {
+			pool.AddTask(tasks[i]);
+		}
+
+		for (size_t i = 0; i < tasks.size(); i++) {
+			done.Wait();
+		}
+
+		for (size_t i = 0; i < tasks.size(); i++) {
+			delete tasks[i];
+		}
+	}
+
+	void ParallelApplier::SpeculateRange(const std::vector<size_t> &indexes, size_t begin, size_t end) {
+		//Each range has its own context, so that the bottom transaction is the speculated one
+		LedgerContext ledger_context("", protocol::ConsensusValue());
+		LedgerFrm *ledger = ledger_context.closing_ledger_.get();
+		ledger->lpledger_context_ = &ledger_context;
+		ledger->value_ = ledger_->value_;
+		ledger->SetTestMode(ledger_->IsTestMode());
+
+		for (size_t i = begin; i < end; i++) {
+			Speculate(indexes[i], &ledger_context);
+			utils::AtomicInc(&speculated_count_);
+		}
+	}
+
+	bool ParallelApplier::Speculate(size_t index, LedgerContext *ledger_context) {
+		TransactionFrm::pointer tx_frm = tx_frms_[index]->CloneUnapplied();
+		std::shared_ptr<SpeculativeEnvironment> environment = std::make_shared<SpeculativeEnvironment>();
+		LedgerFrm *ledger = ledger_context->closing_ledger_.get();
+
+		//Paying coin to a contract account runs the contract, leave it to the serial execution
+		const protocol::Transaction &tran = tx_frm->GetTransactionEnv().transaction();
+		for (int32_t i = 0; i < tran.operations_size(); i++) {
+			const protocol::Operation &ope = tran.operations(i);
+			if (ope.type() != protocol::Operation_Type_PAY_COIN) {
+				continue;
+			}
+
+			const std::string &dest_address = ope.pay_coin().dest_address();
+			environment->reads_.insert(dest_address);
+			AccountFrm::pointer dest_account;
+			if (Environment::AccountFromDB(dest_address, dest_account) && !dest_account->GetProtoAccount().contract().payload().empty()) {
+				return false;
+			}
+		}
+
+		//Dropped transactions and failed fee payments are left to the serial execution
+		if (mode_ != LedgerFrm::APPLY_MODE_FOLLOW && !tx_frm->ValidForApply(environment, !ledger->IsTestMode())) {
+			return false;
+		}
+
+		int64_t fee = 0;
+		if (!tx_frm->PayFee(environment, fee)) {
+			return false;
+		}
+
+		LedgerFrm::TX_STATUS status = ledger->ExecuteTransaction(tx_frm, ledger_context, environment, fee, mode_, false);
+
+		//Expiration depends on the execution time, and the settings are shared by the whole ledger
+		if (status == LedgerFrm::TX_STATUS_EXPIRED || !environment->settings_.GetData().empty()) {
+			return false;
+		}
+
+		Speculation &speculation = speculations_[index];
+		speculation.tx_frm_ = tx_frm;
+		speculation.environment_ = environment;
+		speculation.fee_ = fee;
+		speculation.status_ = status;
+		speculation.done_ = true;
+		return true;
+	}
+
+	bool ParallelApplier::Adopt(size_t index, TransactionFrm::pointer &tx_frm, LedgerFrm::TX_STATUS &status) {
+		if (index >= speculations_.size() || !speculations_[index].done_) {
+			return false;
+		}
+
+		Speculation speculation = speculations_[index];
+		speculations_[index] = Speculation();
+
+		//Any account touched before, even by a dropped transaction, may have changed since the speculation read it
+		Environment &environment = *ledger_->environment_;
+		const Environment::Map &data = environment.GetData();
+		Environment::Map &buff = environment.GetChangeBuf();
+		for (auto it = speculation.environment_->reads_.begin(); it != speculation.environment_->reads_.end(); it++) {
+			if (data.find(*it) != data.end() || buff.find(*it) != buff.end()) {
+				utils::AtomicInc(&conflict_count_);
+				return false;
+			}
+		}
+
+		//Same overflow check as paying the fee on the ledger
+		int64_t total_fee = 0;
+		if (!utils::SafeIntAdd(ledger_->total_fee_, speculation.tx_frm_->GetFeeLimit(), total_fee)) {
+			return false;
+		}
+		ledger_->total_fee_ += speculation.fee_;
+
+		//Also commits what dropped transactions left in the change buffer, as the serial execution does
+		const Environment::Map &changes = speculation.environment_->GetData();
+		for (auto it = changes.begin(); it != changes.end(); it++) {
+			buff[it->first] = it->second;
+		}
+		environment.Commit();
+
+		speculation.tx_frm_->ledger_ = ledger_;
+		speculation.tx_frm_->environment_ = ledger_->environment_;
+		tx_frm = speculation.tx_frm_;
+		status = speculation.status_;
+		utils::AtomicInc(&adopted_count_);
+		return true;
+	}
+
+	void ParallelApplier::GetModuleStatus(Json::Value &data) {
+		data["thread_count"] = (Json::UInt64)LedgerManager::Instance().apply_pool_.Size();
+		data["speculated"] = speculated_count_;
+		data["adopted"] = adopted_count_;
+		data["conflicted"] = conflict_count_;
+	}
+}
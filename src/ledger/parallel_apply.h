@@ -0,0 +1,88 @@
+/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARALLEL_APPLY_H_
+#define PARALLEL_APPLY_H_
+
+#include <unordered_set>
+#include <utils/thread.h>
+#include "environment.h"
+#include "ledger_frm.h"
+
+namespace CEG {
+
+	//Root environment which records every account it loads, these are the read set of a speculation
+	class SpeculativeEnvironment : public Environment {
+	public:
+		std::unordered_set<std::string> reads_;
+
+		virtual bool GetFromDB(const std::string &address, AccountFrm::pointer &account_ptr) override;
+	};
+
+	//Optimistic parallel execution of a transaction set.
+	//Transactions which can not reach contract code are executed speculatively on the apply pool,
+	//each one against its own environment over the state of the last closed ledger.
+	//The ledger then walks the set in order: a speculation is adopted only if none of the accounts
+	//it read has been touched by the transactions before it, otherwise the transaction is executed
+	//again serially. The final state is the same as the one of serial execution.
+	class ParallelApplier {
+		DISALLOW_COPY_AND_ASSIGN(ParallelApplier);
+
+		class SpeculateTask;
+
+		struct Speculation {
+			Speculation() :done_(false), fee_(0), status_(LedgerFrm::TX_STATUS_SUCCESS) {}
+			bool done_;
+			TransactionFrm::pointer tx_frm_;
+			std::shared_ptr<SpeculativeEnvironment> environment_;
+			int64_t fee_;
+			LedgerFrm::TX_STATUS status_;
+		};
+
+		LedgerFrm *ledger_;
+		LedgerFrm::APPLY_MODE mode_;
+		const std::vector<TransactionFrm::pointer> &tx_frms_;
+		std::set<int32_t> expire_txs_;
+		std::vector<Speculation> speculations_;
+
+		//Less transactions are not worth dispatching
+		static const size_t MIN_PARALLEL_TXS = 16;
+
+		static int64_t speculated_count_;
+		static int64_t adopted_count_;
+		static int64_t conflict_count_;
+
+		bool IsCandidate(size_t index) const;
+		void SpeculateRange(const std::vector<size_t> &indexes, size_t begin, size_t end);
+		bool Speculate(size_t index, LedgerContext *ledger_context);
+	public:
+		ParallelApplier(LedgerFrm *ledger,
+			LedgerFrm::APPLY_MODE mode,
+			const std::vector<TransactionFrm::pointer> &tx_frms,
+			const std::set<int32_t> &expire_txs);
+		~ParallelApplier();
+
+		//Execute the candidates on the apply pool and wait for them
+		void Speculate();
+
+		//Merge the speculation of tx_frms[index] into the ledger if it is still valid.
+		//On success tx_frm is replaced by the executed frame and status is its result.
+		bool Adopt(size_t index, TransactionFrm::pointer &tx_frm, LedgerFrm::TX_STATUS &status);
+
+		static void GetModuleStatus(Json::Value &data);
+	};
+}
+
+#endif
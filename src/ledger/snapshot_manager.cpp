@@ -0,0 +1,999 @@
+/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <utils/file.h>
+#include <common/general.h>
+#include <main/configure.h>
+#include <overlay/peer_manager.h>
+#include <glue/glue_manager.h>
+#include "ledger_manager.h"
+#include "snapshot_manager.h"
+
+namespace CEG {
+
+	//Files larger than this are not snapshot files
+	static const int64_t MAX_SNAPSHOT_FILE_SIZE = 64 * utils::BYTES_PER_MEGA;
+	//Records per batch when the snapshot is written into the account-db
+	static const size_t INSTALL_BATCH_RECORDS = 4096;
+
+	static const char *MANIFEST_NAME = "manifest";
+	static const char *STAGING_NAME = "staging.db";
+
+	static bool WriteSnapshotFile(const std::string &name, const std::string &data) {
+		utils::File file;
+		if (!file.Open(name, utils::File::FILE_M_WRITE | utils::File::FILE_M_BINARY)) {
+			return false;
+		}
+
+		bool ret = data.empty() || file.Write(data.data(), 1, data.size()) == data.size();
+		file.Close();
+		return ret;
+	}
+
+	//File::ReadData shares a static buffer, the files are read by several threads
+	static bool ReadSnapshotFile(const std::string &name, std::string &data) {
+		utils::FileAttribute attr;
+		if (!utils::File::GetAttribue(name, attr) || attr.is_directory_ || attr.size_ > MAX_SNAPSHOT_FILE_SIZE) {
+			return false;
+		}
+
+		utils::File file;
+		if (!file.Open(name, utils::File::FILE_M_READ | utils::File::FILE_M_BINARY)) {
+			return false;
+		}
+
+		data.resize((size_t)attr.size_);
+		bool ret = data.empty() || file.Read(&data[0], 1, data.size()) == data.size();
+		file.Close();
+		return ret;
+	}
+
+	//The ledger as it was hashed when it was closed, the header with the transactions applied in it.
+	//The hash list keeps the transactions triggered by a contract right after the one which triggered them.
+	static bool LoadLedger(KeyValueDb *ledger_db, int64_t seq, protocol::Ledger &ledger) {
+		std::string str_header;
+		if (ledger_db->Get(ComposePrefix(General::LEDGER_PREFIX, seq), str_header) <= 0 || !ledger.mutable_header()->ParseFromString(str_header)) {
+			return false;
+		}
+
+		std::string str_list;
+		protocol::EntryList list;
+		if (ledger_db->Get(ComposePrefix(General::LEDGER_TRANSACTION_PREFIX, seq), str_list) > 0 && !list.ParseFromString(str_list)) {
+			return false;
+		}
+
+		for (int i = 0; i < list.entry_size(); i++) {
+			std::string str_store;
+			protocol::TransactionEnvStore store;
+			if (ledger_db->Get(ComposePrefix(General::TRANSACTION_PREFIX, list.entry(i)), str_store) <= 0 || !store.ParseFromString(str_store)) {
+				return false;
+			}
+
+			*ledger.add_transaction_envs() = store.transaction_env();
+			i += store.contract_tx_hashes_size();
+		}
+		return true;
+	}
+
+	static bool CheckLedgerHash(const protocol::Ledger &ledger) {
+		protocol::Ledger copy(ledger);
+		copy.mutable_header()->set_hash("");
+		return HashWrapper::Crypto(copy.SerializeAsString()) == ledger.header().hash();
+	}
+
+	//Walk the trie stored under prefix and check every record against the hash its parent holds,
+	//the root record against root_hash. The visitor gets each checked record, false stops the walk.
+	typedef std::function<bool(const std::string &key, const std::string &value, bool leaf)> TrieRecordVisitor;
+	static bool WalkTrie(KeyValueDb *db, const std::string &prefix, const std::string &root_hash, const TrieRecordVisitor &visitor) {
+		//The trie has never been written
+		if (root_hash.empty()) {
+			return true;
+		}
+
+		Location root;
+		root.push_back(Trie::EVEN_PREFIX);
+		std::string key = prefix + root;
+		std::string buff;
+		if (db->Get(key, buff) <= 0 || HashWrapper::Crypto(buff) != root_hash || !visitor(key, buff, false)) {
+			return false;
+		}
+
+		std::vector<std::string> nodes(1, buff);
+		while (!nodes.empty()) {
+			NodeInfo info;
+			bool parsed = info.ParseFrom(nodes.back());
+			nodes.pop_back();
+			if (!parsed) {
+				return false;
+			}
+
+			for (int i = 0; i <= 16; i++) {
+				const ChildFrm &child = info.children_[i];
+				if (child.childtype() == protocol::NONE) {
+					continue;
+				}
+
+				bool leaf = child.childtype() == protocol::LEAF;
+				if (child.sublocation_.empty()) {
+					return false;
+				}
+
+				std::string child_key = prefix + child.sublocation_;
+				if (leaf) {
+					child_key[prefix.size()] = Trie::LEAF_PREFIX;
+				}
+
+				std::string value;
+				if (db->Get(child_key, value) <= 0 || HashWrapper::Crypto(value) != child.GetHash() || !visitor(child_key, value, leaf)) {
+					return false;
+				}
+
+				if (!leaf) {
+					nodes.push_back(value);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool SnapshotManager::Manifest::Parse(const protocol::EntryList &list, int first) {
+		//The two ledgers come with their transactions, so their headers are checked against their hashes
+		protocol::Ledger ledger;
+		protocol::Ledger previous_ledger;
+		if (list.entry_size() < first + 3 ||
+			!ledger.ParseFromString(list.entry(first)) ||
+			!previous_ledger.ParseFromString(list.entry(first + 1)) ||
+			!CheckLedgerHash(ledger) ||
+			!CheckLedgerHash(previous_ledger)) {
+			return false;
+		}
+
+		header_ = ledger.header();
+		previous_header_ = previous_ledger.header();
+		if (previous_header_.seq() + 1 != header_.seq() || header_.previous_hash() != previous_header_.hash()) {
+			return false;
+		}
+
+		seq_ = header_.seq();
+		chunk_hashes_.clear();
+		for (int i = first + 2; i < list.entry_size(); i++) {
+			chunk_hashes_.push_back(list.entry(i));
+		}
+		return true;
+	}
+
+	class SnapshotManager::ExportTask : public utils::Runnable {
+	public:
+		SnapshotManager *manager_;
+
+		ExportTask(SnapshotManager *manager) :manager_(manager) {}
+
+		virtual void Run(utils::Thread *this_thread) override {
+			manager_->Export();
+			delete this;
+		}
+	};
+
+	class SnapshotManager::ServeTask : public utils::Runnable {
+	public:
+		SnapshotManager *manager_;
+		protocol::GetLedgers request_;
+		int64_t peer_id_;
+
+		ServeTask(SnapshotManager *manager, const protocol::GetLedgers &request, int64_t peer_id)
+			:manager_(manager), request_(request), peer_id_(peer_id) {}
+
+		virtual void Run(utils::Thread *this_thread) override {
+			manager_->Serve(request_, peer_id_);
+			delete this;
+		}
+	};
+
+	class SnapshotManager::StageTask : public utils::Runnable {
+	public:
+		SnapshotManager *manager_;
+		int64_t seq_;
+		size_t index_;
+		protocol::EntryList response_;
+		int64_t peer_id_;
+
+		StageTask(SnapshotManager *manager, int64_t seq, size_t index, const protocol::EntryList &response, int64_t peer_id)
+			:manager_(manager), seq_(seq), index_(index), response_(response), peer_id_(peer_id) {}
+
+		virtual void Run(utils::Thread *this_thread) override {
+			//The chunk file is the response without the request in front
+			response_.mutable_entry()->DeleteSubrange(0, 1);
+			manager_->Stage(seq_, index_, response_, peer_id_);
+			delete this;
+		}
+	};
+
+	class SnapshotManager::InstallTask : public utils::Runnable {
+	public:
+		SnapshotManager *manager_;
+
+		InstallTask(SnapshotManager *manager) :manager_(manager) {}
+
+		virtual void Run(utils::Thread *this_thread) override {
+			manager_->Install();
+			delete this;
+		}
+	};
+
+	SnapshotManager::SnapshotManager() :
+		exporting_(false),
+		latest_seq_(0),
+		export_count_(0),
+		last_export_time_(0),
+		served_count_(0),
+		state_(FAST_SYNC_NONE),
+		state_time_(0),
+		discover_time_(0),
+		staged_count_(0),
+		staged_bytes_(0),
+		bad_chunks_(0),
+		staging_db_(NULL) {}
+
+	SnapshotManager::~SnapshotManager() {
+		CloseStagingDb();
+	}
+
+	bool SnapshotManager::Initialize() {
+		const LedgerConfigure &ledger_configure = Configure::Instance().ledger_configure_;
+		path_ = ledger_configure.snapshot_path_;
+		if (!utils::File::IsExist(path_) && !utils::File::CreateDir(path_)) {
+			LOG_ERROR("Failed to create the snapshot directory(%s)", path_.c_str());
+			return false;
+		}
+
+		if (!pool_.Init("ledger-snapshot", 2)) {
+			LOG_ERROR("Failed to start the snapshot thread pool");
+			return false;
+		}
+
+		//Snapshots written before the restart are still served
+		utils::FileAttributes files;
+		utils::File::GetFileList(path_, files, true);
+		for (auto it = files.begin(); it != files.end(); it++) {
+			int64_t seq = utils::String::Stoi64(it->first);
+			if (it->second.is_directory_ && seq > latest_seq_ && it->first == utils::String::ToString(seq) &&
+				utils::File::IsExist(SnapshotPath(seq) + "/" + MANIFEST_NAME)) {
+				latest_seq_ = seq;
+			}
+		}
+
+		if (ledger_configure.fast_sync_ && LedgerManager::Instance().GetLastClosedLedger().seq() == 1) {
+			//The validators and the proof of a snapshot are only checked against the snapshot itself,
+			//so the state is anchored by a ledger hash which the operator got from a source they trust
+			if (ledger_configure.fast_sync_trusted_hash_.empty()) {
+				LOG_ERROR("Fast sync is enabled without snapshot.trusted_ledger_hash, it is ignored and the ledgers are synced from the genesis one");
+			}
+			else {
+				LOG_INFO("The node has no ledger yet, looking for the snapshot of ledger hash(%s) from the peers", ledger_configure.fast_sync_trusted_hash_.c_str());
+				SetState(FAST_SYNC_DISCOVER);
+			}
+		}
+		return true;
+	}
+
+	bool SnapshotManager::Exit() {
+		bool ret = pool_.Exit();
+		CloseStagingDb();
+		return ret;
+	}
+
+	std::string SnapshotManager::SnapshotPath(int64_t seq) const {
+		return utils::String::Format("%s/" FMT_I64, path_.c_str(), seq);
+	}
+
+	std::string SnapshotManager::ChunkName(int64_t index) {
+		return utils::String::Format("chunk-" FMT_I64, index);
+	}
+
+	const char *SnapshotManager::StateName(FastSyncState state) {
+		switch (state) {
+		case FAST_SYNC_NONE: return "none";
+		case FAST_SYNC_DISCOVER: return "discover";
+		case FAST_SYNC_DOWNLOAD: return "download";
+		case FAST_SYNC_INSTALL: return "install";
+		case FAST_SYNC_DONE: return "done";
+		case FAST_SYNC_FAILED: return "failed";
+		}
+		return "unknown";
+	}
+
+	void SnapshotManager::SetState(FastSyncState state) {
+		LOG_INFO("Snapshot fast sync state %s -> %s", StateName(state_), StateName(state));
+		state_ = state;
+		state_time_ = utils::Timestamp::HighResolution();
+	}
+
+	bool SnapshotManager::IsFastSyncing() {
+		utils::MutexGuard guard(mutex_);
+		return state_ == FAST_SYNC_DISCOVER || state_ == FAST_SYNC_DOWNLOAD || state_ == FAST_SYNC_INSTALL;
+	}
+
+	void SnapshotManager::OnLedgerCommitted(int64_t seq) {
+		uint32_t interval = Configure::Instance().ledger_configure_.snapshot_interval_;
+		if (interval == 0 || seq % interval != 0) {
+			return;
+		}
+
+		do {
+			utils::MutexGuard guard(mutex_);
+			if (exporting_) {
+				LOG_INFO("Skip the snapshot of ledger(" FMT_I64 "), the previous one is still being written", seq);
+				return;
+			}
+			exporting_ = true;
+		} while (false);
+
+		pool_.AddTask(new ExportTask(this));
+	}
+
+	void SnapshotManager::Export() {
+		int64_t begin_time = utils::Timestamp::HighResolution();
+		KeyValueDb *account_db = Storage::Instance().account_db();
+		KeyValueDb *ledger_db = Storage::Instance().ledger_db();
+		size_t chunk_size = MAX(Configure::Instance().ledger_configure_.snapshot_chunk_size_, 1024);
+
+		void *iter = NULL;
+		int64_t seq = 0;
+		protocol::Ledger ledger;
+		protocol::Ledger previous_ledger;
+		bool ret = false;
+		do {
+			//The iterator reads the account-db as it is now, and no ledger is written meanwhile
+			utils::ReadLockGuard guard(Storage::Instance().account_ledger_lock_);
+			std::string str_seq;
+			if (account_db->Get(General::KEY_LEDGER_SEQ, str_seq) <= 0) {
+				break;
+			}
+			seq = utils::String::Stoi64(str_seq);
+
+			if (seq < 2 ||
+				!LoadLedger(ledger_db, seq, ledger) ||
+				!LoadLedger(ledger_db, seq - 1, previous_ledger)) {
+				break;
+			}
+
+			//A peer drops the manifest of a ledger which does not hash as its header says
+			if (!CheckLedgerHash(ledger) || !CheckLedgerHash(previous_ledger)) {
+				LOG_ERROR("The transactions of ledger(" FMT_I64 ") do not match its hash, no snapshot is written", seq);
+				seq = 0;
+				break;
+			}
+
+			do {
+				utils::MutexGuard guard(mutex_);
+				if (seq <= latest_seq_) {
+					seq = 0;
+				}
+			} while (false);
+			if (seq == 0) {
+				break;
+			}
+
+			iter = account_db->NewIterator();
+			ret = true;
+		} while (false);
+
+		std::string tmp_path = utils::String::Format("%s/" FMT_I64 ".tmp", path_.c_str(), seq);
+		if (ret) {
+			utils::File::DeleteFolder(tmp_path);
+			ret = utils::File::CreateDir(tmp_path);
+		}
+
+		protocol::EntryList manifest;
+		manifest.add_entry(ledger.SerializeAsString());
+		manifest.add_entry(previous_ledger.SerializeAsString());
+		int64_t record_count = 0;
+		int64_t total_size = 0;
+		if (ret) {
+#ifdef WIN32
+			leveldb::Iterator *it = (leveldb::Iterator *)iter;
+#else
+			rocksdb::Iterator *it = (rocksdb::Iterator *)iter;
+#endif
+			protocol::EntryList chunk;
+			size_t size = 0;
+			for (it->SeekToFirst(); ret; it->Next()) {
+				bool valid = it->Valid();
+				if (valid) {
+					chunk.add_entry(it->key().data(), it->key().size());
+					chunk.add_entry(it->value().data(), it->value().size());
+					size += it->key().size() + it->value().size();
+					record_count++;
+				}
+
+				if ((!valid && chunk.entry_size() > 0) || size >= chunk_size) {
+					std::string data = chunk.SerializeAsString();
+					std::string name = utils::String::Format("%s/%s", tmp_path.c_str(), ChunkName(manifest.entry_size() - 2).c_str());
+					ret = WriteSnapshotFile(name, data);
+					manifest.add_entry(HashWrapper::Crypto(data));
+					total_size += data.size();
+					chunk.Clear();
+					size = 0;
+				}
+
+				if (!valid) {
+					break;
+				}
+			}
+		}
+
+		if (iter != NULL) {
+#ifdef WIN32
+			delete (leveldb::Iterator *)iter;
+#else
+			delete (rocksdb::Iterator *)iter;
+#endif
+		}
+
+		ret = ret && manifest.entry_size() > 2 &&
+			WriteSnapshotFile(utils::String::Format("%s/%s", tmp_path.c_str(), MANIFEST_NAME), manifest.SerializeAsString()) &&
+			utils::File::Move(tmp_path, SnapshotPath(seq));
+
+		int64_t end_time = utils::Timestamp::HighResolution();
+		if (ret) {
+			LOG_INFO("Wrote the snapshot of ledger(" FMT_I64 "): " FMT_I64 " records, " FMT_I64 " chunks, " FMT_I64 " bytes, time " FMT_I64 " ms",
+				seq, record_count, (int64_t)manifest.entry_size() - 2, total_size, (end_time - begin_time) / utils::MICRO_UNITS_PER_MILLI);
+		}
+		else if (seq > 0) {
+			LOG_ERROR("Failed to write the snapshot of ledger(" FMT_I64 ")", seq);
+			utils::File::DeleteFolder(tmp_path);
+		}
+
+		do {
+			utils::MutexGuard guard(mutex_);
+			exporting_ = false;
+			if (ret) {
+				latest_seq_ = seq;
+				export_count_++;
+				last_export_time_ = end_time - begin_time;
+			}
+		} while (false);
+
+		if (ret) {
+			RemoveOldSnapshots();
+		}
+	}
+
+	void SnapshotManager::RemoveOldSnapshots() {
+		utils::FileAttributes files;
+		utils::File::GetFileList(path_, files, true);
+		std::set<int64_t> seqs;
+		for (auto it = files.begin(); it != files.end(); it++) {
+			int64_t seq = utils::String::Stoi64(it->first);
+			if (it->second.is_directory_ && it->first == utils::String::ToString(seq)) {
+				seqs.insert(seq);
+			}
+		}
+
+		size_t keep = MAX(Configure::Instance().ledger_configure_.snapshot_keep_, 1);
+		while (seqs.size() > keep) {
+			LOG_INFO("Remove the snapshot of ledger(" FMT_I64 ")", *seqs.begin());
+			utils::File::DeleteFolder(SnapshotPath(*seqs.begin()));
+			seqs.erase(seqs.begin());
+		}
+	}
+
+	void SnapshotManager::OnRequest(const protocol::GetLedgers &request, int64_t peer_id) {
+		if (request.chain_id() != General::GetSelfChainId()) {
+			LOG_TRACE("Failed to check same chain, node self id(" FMT_I64 ") is not eq (" FMT_I64 ")",
+				General::GetSelfChainId(), request.chain_id());
+			return;
+		}
+
+		pool_.AddTask(new ServeTask(this, request, peer_id));
+	}
+
+	void SnapshotManager::Serve(const protocol::GetLedgers &request, int64_t peer_id) {
+		protocol::GetLedgers served = request;
+		if (served.begin() == 0) {
+			utils::MutexGuard guard(mutex_);
+			served.set_begin(latest_seq_);
+		}
+
+		//Serialized lists concatenate, so the file is appended to the list of the request as it is
+		protocol::EntryList head;
+		head.add_entry(served.SerializeAsString());
+		std::string data = head.SerializeAsString();
+
+		std::string content;
+		if (served.begin() > 0 && served.end() >= -1) {
+			std::string name = served.end() < 0 ? MANIFEST_NAME : ChunkName(served.end());
+			if (ReadSnapshotFile(utils::String::Format("%s/%s", SnapshotPath(served.begin()).c_str(), name.c_str()), content)) {
+				data += content;
+			}
+		}
+
+		if (content.empty()) {
+			LOG_TRACE("Snapshot(" FMT_I64 ") file(" FMT_I64 ") requested by peer(" FMT_I64 ") is not available", served.begin(), served.end(), peer_id);
+		}
+		else {
+			utils::MutexGuard guard(mutex_);
+			served_count_++;
+		}
+
+		CEG::WsMessagePointer ws = std::make_shared<protocol::WsMessage>();
+		ws->set_type(OVERLAY_MSGTYPE_SNAPSHOT);
+		ws->set_request(false);
+		ws->set_data(data);
+		Global::Instance().Post([ws, peer_id]() {
+			PeerManager::Instance().ConsensusNetwork().SendMsgToPeer(peer_id, ws);
+		});
+	}
+
+	void SnapshotManager::SendRequest(int64_t peer_id, int64_t seq, int64_t index) {
+		protocol::GetLedgers request;
+		request.set_begin(seq);
+		request.set_end(index);
+		request.set_timestamp(utils::Timestamp::HighResolution());
+		request.set_chain_id(General::GetSelfChainId());
+		PeerManager::Instance().ConsensusNetwork().SendRequest(peer_id, OVERLAY_MSGTYPE_SNAPSHOT, request.SerializeAsString());
+	}
+
+	void SnapshotManager::OnTimer(int64_t current_time) {
+		std::set<int64_t> active_peers = PeerManager::Instance().ConsensusNetwork().GetActivePeerIds();
+		std::vector<std::pair<int64_t, std::pair<int64_t, int64_t> > > requests;
+
+		do {
+			utils::MutexGuard guard(mutex_);
+			if (state_ == FAST_SYNC_DISCOVER) {
+				for (auto it = peer_manifests_.begin(); it != peer_manifests_.end();) {
+					if (active_peers.find(it->first) == active_peers.end()) {
+						it = peer_manifests_.erase(it);
+					}
+					else {
+						it++;
+					}
+				}
+
+				//Ask again now and then, a peer may write its first snapshot meanwhile
+				if (current_time - discover_time_ >= DISCOVER_TIME) {
+					discover_time_ = current_time;
+					for (auto it = active_peers.begin(); it != active_peers.end(); it++) {
+						requests.push_back(std::make_pair(*it, std::make_pair((int64_t)0, (int64_t)-1)));
+					}
+				}
+
+				ChooseManifest(current_time);
+			}
+
+			if (state_ != FAST_SYNC_DOWNLOAD) {
+				break;
+			}
+
+			for (auto it = sources_.begin(); it != sources_.end();) {
+				if (active_peers.find(*it) == active_peers.end()) {
+					it = sources_.erase(it);
+				}
+				else {
+					it++;
+				}
+			}
+
+			for (auto it = requests_.begin(); it != requests_.end();) {
+				if (current_time - it->second.send_time_ > CHUNK_TIMEOUT || sources_.find(it->second.peer_id_) == sources_.end()) {
+					LOG_TRACE("Request of snapshot chunk(" FMT_SIZE ") from peer(" FMT_I64 ") timed out", it->first, it->second.peer_id_);
+					it = requests_.erase(it);
+				}
+				else {
+					it++;
+				}
+			}
+
+			//No peer serves the snapshot any more, the staged chunks of another one are overwritten
+			if (sources_.empty()) {
+				LOG_WARN("No peer serves the snapshot of ledger(" FMT_I64 ") any more, looking for another one", manifest_.seq_);
+				requests_.clear();
+				received_.clear();
+				staged_count_ = 0;
+				peer_manifests_.clear();
+				discover_time_ = 0;
+				SetState(FAST_SYNC_DISCOVER);
+				break;
+			}
+
+			std::map<int64_t, size_t> in_flight;
+			for (auto it = requests_.begin(); it != requests_.end(); it++) {
+				in_flight[it->second.peer_id_]++;
+			}
+
+			size_t max_requests = MAX(Configure::Instance().ledger_configure_.sync_requests_per_peer_, 1);
+			size_t next = 0;
+			bool assigned = true;
+			while (assigned) {
+				assigned = false;
+				for (auto it = sources_.begin(); it != sources_.end(); it++) {
+					if (in_flight[*it] >= max_requests) {
+						continue;
+					}
+
+					while (next < manifest_.chunk_hashes_.size() &&
+						(received_.find(next) != received_.end() || requests_.find(next) != requests_.end())) {
+						next++;
+					}
+					if (next >= manifest_.chunk_hashes_.size()) {
+						break;
+					}
+
+					ChunkRequest &request = requests_[next];
+					request.peer_id_ = *it;
+					request.send_time_ = current_time;
+					in_flight[*it]++;
+					requests.push_back(std::make_pair(*it, std::make_pair(manifest_.seq_, (int64_t)next)));
+					assigned = true;
+				}
+			}
+		} while (false);
+
+		for (size_t i = 0; i < requests.size(); i++) {
+			SendRequest(requests[i].first, requests[i].second.first, requests[i].second.second);
+		}
+	}
+
+	void SnapshotManager::ChooseManifest(int64_t current_time) {
+		const LedgerConfigure &ledger_configure = Configure::Instance().ledger_configure_;
+		int64_t lcl_seq = LedgerManager::Instance().GetLastClosedLedger().seq();
+		if (lcl_seq > 1) {
+			LOG_INFO("The node has closed ledger(" FMT_I64 "), no snapshot is needed", lcl_seq);
+			SetState(FAST_SYNC_NONE);
+			return;
+		}
+
+		//The peers which offer the same snapshot, by the hash of its header
+		std::map<std::string, std::set<int64_t> > offers;
+		for (auto it = peer_manifests_.begin(); it != peer_manifests_.end(); it++) {
+			const Manifest &manifest = it->second;
+			if (manifest.header_.chain_id() != General::GetSelfChainId() ||
+				manifest.seq_ < lcl_seq + (int64_t)ledger_configure.fast_sync_min_gap_) {
+				continue;
+			}
+
+			//The header is checked against its hash when the manifest is parsed, and the hash against the trusted one here
+			if (utils::String::BinToHexString(manifest.header_.hash()) != ledger_configure.fast_sync_trusted_hash_) {
+				continue;
+			}
+			offers[manifest.header_.hash()].insert(it->first);
+		}
+
+		//The trusted snapshot is fetched once enough peers serve it, the chunks are checked against the manifest
+		size_t min_peers = MAX(ledger_configure.fast_sync_min_peers_, 1);
+		const Manifest *chosen = NULL;
+		for (auto it = offers.begin(); it != offers.end(); it++) {
+			if (it->second.size() < min_peers) {
+				continue;
+			}
+
+			const Manifest &manifest = peer_manifests_[*it->second.begin()];
+			if (chosen == NULL || manifest.seq_ > chosen->seq_) {
+				chosen = &manifest;
+				sources_ = it->second;
+			}
+		}
+
+		if (chosen == NULL) {
+			if (current_time - state_time_ > DISCOVER_TIMEOUT) {
+				LOG_WARN("No peer offers a snapshot, sync the ledgers from the genesis one");
+				SetState(FAST_SYNC_FAILED);
+			}
+			return;
+		}
+
+		if (staging_db_ == NULL) {
+			std::string staging_path = utils::String::Format("%s/%s", path_.c_str(), STAGING_NAME);
+			utils::File::DeleteFolder(staging_path);
+			const DbConfigure &db_configure = Configure::Instance().db_configure_;
+			staging_db_ = Storage::Instance().NewKeyValueDb(db_configure, db_configure.account_options_);
+			if (!staging_db_->Open(staging_path, -1)) {
+				LOG_ERROR("Failed to open the snapshot staging db(%s), %s", staging_path.c_str(), staging_db_->error_desc().c_str());
+				CloseStagingDb();
+				SetState(FAST_SYNC_FAILED);
+				return;
+			}
+		}
+
+		manifest_ = *chosen;
+		LOG_INFO("Fetch the snapshot of ledger(" FMT_I64 "), hash(%s), " FMT_SIZE " chunks from " FMT_SIZE " peers",
+			manifest_.seq_, utils::String::BinToHexString(manifest_.header_.hash()).c_str(), manifest_.chunk_hashes_.size(), sources_.size());
+		SetState(FAST_SYNC_DOWNLOAD);
+	}
+
+	void SnapshotManager::OnResponse(const protocol::EntryList &response, int64_t peer_id) {
+		protocol::GetLedgers request;
+		if (response.entry_size() == 0 || !request.ParseFromString(response.entry(0))) {
+			LOG_ERROR("Received an invalid snapshot response from peer(" FMT_I64 ")", peer_id);
+			return;
+		}
+
+		utils::MutexGuard guard(mutex_);
+		if (request.end() < 0) {
+			if (state_ != FAST_SYNC_DISCOVER) {
+				return;
+			}
+
+			Manifest manifest;
+			if (response.entry_size() == 1 || !manifest.Parse(response, 1) || manifest.seq_ != request.begin()) {
+				peer_manifests_.erase(peer_id);
+				return;
+			}
+
+			LOG_INFO("Peer(" FMT_I64 ") offers the snapshot of ledger(" FMT_I64 ")", peer_id, manifest.seq_);
+			peer_manifests_[peer_id] = manifest;
+			return;
+		}
+
+		if (state_ != FAST_SYNC_DOWNLOAD || request.begin() != manifest_.seq_) {
+			return;
+		}
+
+		auto iter = requests_.find((size_t)request.end());
+		if (iter == requests_.end() || iter->second.peer_id_ != peer_id) {
+			return;
+		}
+		requests_.erase(iter);
+
+		//The peer has removed the snapshot
+		if (response.entry_size() == 1) {
+			sources_.erase(peer_id);
+			return;
+		}
+
+		received_.insert((size_t)request.end());
+		pool_.AddTask(new StageTask(this, manifest_.seq_, (size_t)request.end(), response, peer_id));
+	}
+
+	void SnapshotManager::Stage(int64_t seq, size_t index, const protocol::EntryList &chunk, int64_t peer_id) {
+		std::string data = chunk.SerializeAsString();
+		std::string hash = HashWrapper::Crypto(data);
+
+		WRITE_BATCH batch;
+		for (int i = 0; i + 1 < chunk.entry_size(); i += 2) {
+			batch.Put(chunk.entry(i), chunk.entry(i + 1));
+		}
+
+		bool install = false;
+		do {
+			utils::MutexGuard guard(mutex_);
+			if (state_ != FAST_SYNC_DOWNLOAD || seq != manifest_.seq_) {
+				return;
+			}
+
+			if (index >= manifest_.chunk_hashes_.size() || hash != manifest_.chunk_hashes_[index] || chunk.entry_size() % 2 != 0) {
+				LOG_ERROR("The snapshot chunk(" FMT_SIZE ") from peer(" FMT_I64 ") does not match the manifest", index, peer_id);
+				bad_chunks_++;
+				received_.erase(index);
+				sources_.erase(peer_id);
+				return;
+			}
+
+			if (!staging_db_->WriteBatch(batch)) {
+				LOG_ERROR("Failed to write the snapshot staging db, %s", staging_db_->error_desc().c_str());
+				CloseStagingDb();
+				SetState(FAST_SYNC_FAILED);
+				return;
+			}
+
+			staged_count_++;
+			staged_bytes_ += data.size();
+			if (staged_count_ == manifest_.chunk_hashes_.size()) {
+				SetState(FAST_SYNC_INSTALL);
+				install = true;
+			}
+		} while (false);
+
+		if (install) {
+			pool_.AddTask(new InstallTask(this));
+		}
+	}
+
+	bool SnapshotManager::VerifyStaged(int64_t &account_count, std::string &proof) {
+		const protocol::LedgerHeader &header = manifest_.header_;
+		account_count = 0;
+		proof.clear();
+		bool ret = WalkTrie(staging_db_, General::ACCOUNT_PREFIX, header.account_tree_hash(),
+			[this, &account_count](const std::string &key, const std::string &value, bool leaf) {
+			if (!leaf) {
+				return true;
+			}
+
+			protocol::Account account;
+			if (!account.ParseFromString(value)) {
+				return false;
+			}
+			account_count++;
+
+			TrieRecordVisitor visitor = [](const std::string &key, const std::string &value, bool leaf) { return true; };
+			std::string address = DecodeAddress(account.address());
+			return WalkTrie(staging_db_, ComposePrefix(General::ASSET_PREFIX, address), account.assets_hash(), visitor) &&
+				WalkTrie(staging_db_, ComposePrefix(General::METADATA_PREFIX, address), account.metadatas_hash(), visitor);
+		});
+
+		if (!ret) {
+			LOG_ERROR("The staged state does not match the account tree hash(%s) of ledger(" FMT_I64 ")",
+				utils::String::BinToHexString(header.account_tree_hash()).c_str(), manifest_.seq_);
+			return false;
+		}
+
+		//The validators of the previous ledger check the proof of the next one
+		std::vector<std::string> hashed_keys;
+		hashed_keys.push_back(LedgerManager::ValidatorsKey(header.validators_hash()));
+		hashed_keys.push_back(LedgerManager::ValidatorsKey(manifest_.previous_header_.validators_hash()));
+		hashed_keys.push_back(LedgerManager::FeesKey(header.fees_hash()));
+		std::vector<std::string> hashes;
+		hashes.push_back(header.validators_hash());
+		hashes.push_back(manifest_.previous_header_.validators_hash());
+		hashes.push_back(header.fees_hash());
+		for (size_t i = 0; i < hashed_keys.size(); i++) {
+			std::string value;
+			if (staging_db_->Get(hashed_keys[i], value) <= 0 || HashWrapper::Crypto(value) != hashes[i]) {
+				LOG_ERROR("The staged record(%s) does not match the header of ledger(" FMT_I64 ")", hashed_keys[i].c_str(), manifest_.seq_);
+				return false;
+			}
+		}
+
+		//The proof is not covered by the ledger hash, it is kept only if the validators of the previous ledger signed the value
+		std::string str_validators;
+		protocol::ValidatorSet previous_validators;
+		if (staging_db_->Get(General::LAST_PROOF, proof) > 0 && !proof.empty() &&
+			(staging_db_->Get(hashed_keys[1], str_validators) <= 0 || !previous_validators.ParseFromString(str_validators) ||
+			!GlueManager::Instance().CheckProof(previous_validators, header.consensus_value_hash(), proof))) {
+			LOG_WARN("The staged proof of ledger(" FMT_I64 ") is not signed by its validators, it is left out", manifest_.seq_);
+			proof.clear();
+		}
+
+		return true;
+	}
+
+	void SnapshotManager::Install() {
+		int64_t begin_time = utils::Timestamp::HighResolution();
+
+		//The manifest and the staging db do not change in this state
+		int64_t account_count = 0;
+		std::string proof;
+		if (!VerifyStaged(account_count, proof)) {
+			utils::MutexGuard guard(mutex_);
+			CloseStagingDb();
+			SetState(FAST_SYNC_FAILED);
+			return;
+		}
+
+		int64_t verify_time = utils::Timestamp::HighResolution();
+		LOG_INFO("Verified the snapshot of ledger(" FMT_I64 "), " FMT_I64 " accounts, time " FMT_I64 " ms. Writing it into the databases, "
+			"if the node stops now, restart it with --dropdb", manifest_.seq_, account_count, (verify_time - begin_time) / utils::MICRO_UNITS_PER_MILLI);
+
+		KeyValueDb *account_db = Storage::Instance().account_db();
+		KeyValueDb *ledger_db = Storage::Instance().ledger_db();
+		do {
+			utils::WriteLockGuard guard(Storage::Instance().account_ledger_lock_);
+
+			//Only the records reached from the verified roots are written
+			WRITE_BATCH batch;
+			size_t count = 0;
+			TrieRecordVisitor writer = [&batch, &count, account_db](const std::string &key, const std::string &value, bool leaf) {
+				batch.Put(key, value);
+				if (++count % INSTALL_BATCH_RECORDS == 0) {
+					if (!account_db->WriteBatch(batch)) {
+						PROCESS_EXIT("Failed to write the snapshot into the account-db, %s", account_db->error_desc().c_str());
+					}
+					batch.Clear();
+				}
+				return true;
+			};
+
+			WalkTrie(staging_db_, General::ACCOUNT_PREFIX, manifest_.header_.account_tree_hash(),
+				[this, &writer](const std::string &key, const std::string &value, bool leaf) {
+				writer(key, value, leaf);
+				if (!leaf) {
+					return true;
+				}
+
+				protocol::Account account;
+				account.ParseFromString(value);
+				std::string address = DecodeAddress(account.address());
+				return WalkTrie(staging_db_, ComposePrefix(General::ASSET_PREFIX, address), account.assets_hash(), writer) &&
+					WalkTrie(staging_db_, ComposePrefix(General::METADATA_PREFIX, address), account.metadatas_hash(), writer);
+			});
+
+			//The account count of the statistics is the verified one
+			Json::Value statistics;
+			std::string value;
+			if (staging_db_->Get(General::STATISTICS, value) > 0) {
+				statistics.fromString(value);
+			}
+			statistics["account_count"] = account_count;
+			batch.Put(General::STATISTICS, statistics.toFastString());
+
+			std::vector<std::string> keys;
+			keys.push_back(LedgerManager::ValidatorsKey(manifest_.header_.validators_hash()));
+			keys.push_back(LedgerManager::ValidatorsKey(manifest_.previous_header_.validators_hash()));
+			keys.push_back(LedgerManager::FeesKey(manifest_.header_.fees_hash()));
+			for (size_t i = 0; i < keys.size(); i++) {
+				value.clear();
+				if (staging_db_->Get(keys[i], value) > 0) {
+					batch.Put(keys[i], value);
+				}
+			}
+
+			//The genesis account of the node stays, it comes from its own genesis ledger
+			batch.Put(General::LAST_PROOF, proof);
+			if (!account_db->WriteBatch(batch)) {
+				PROCESS_EXIT("Failed to write the snapshot into the account-db, %s", account_db->error_desc().c_str());
+			}
+
+			//The ledger-db first, as a closed ledger is written
+			WRITE_BATCH ledger_batch;
+			ledger_batch.Put(ComposePrefix(General::LEDGER_PREFIX, manifest_.seq_ - 1), manifest_.previous_header_.SerializeAsString());
+			ledger_batch.Put(ComposePrefix(General::LEDGER_PREFIX, manifest_.seq_), manifest_.header_.SerializeAsString());
+			ledger_batch.Put(General::KEY_LEDGER_SEQ, utils::String::ToString(manifest_.seq_));
+			if (!ledger_db->WriteBatch(ledger_batch)) {
+				PROCESS_EXIT("Failed to write the snapshot headers into the ledger-db, %s", ledger_db->error_desc().c_str());
+			}
+
+			if (!account_db->Put(General::KEY_LEDGER_SEQ, utils::String::ToString(manifest_.seq_))) {
+				PROCESS_EXIT("Failed to write the snapshot sequence into the account-db, %s", account_db->error_desc().c_str());
+			}
+		} while (false);
+
+		int64_t end_time = utils::Timestamp::HighResolution();
+		LOG_INFO("Wrote the snapshot of ledger(" FMT_I64 ") into the databases, time " FMT_I64 " ms",
+			manifest_.seq_, (end_time - verify_time) / utils::MICRO_UNITS_PER_MILLI);
+
+		do {
+			utils::MutexGuard guard(mutex_);
+			CloseStagingDb();
+		} while (false);
+
+		Global::Instance().Post([this]() {
+			LedgerManager::Instance().LoadSnapshotState();
+			utils::MutexGuard guard(mutex_);
+			SetState(FAST_SYNC_DONE);
+		});
+	}
+
+	void SnapshotManager::CloseStagingDb() {
+		if (staging_db_ != NULL) {
+			staging_db_->Close();
+			delete staging_db_;
+			staging_db_ = NULL;
+			utils::File::DeleteFolder(utils::String::Format("%s/%s", path_.c_str(), STAGING_NAME));
+		}
+	}
+
+	void SnapshotManager::GetModuleStatus(Json::Value &data) {
+		utils::MutexGuard guard(mutex_);
+		const LedgerConfigure &ledger_configure = Configure::Instance().ledger_configure_;
+		Json::Value &snapshot = data["export"];
+		snapshot["interval"] = ledger_configure.snapshot_interval_;
+		snapshot["latest_seq"] = latest_seq_;
+		snapshot["exporting"] = exporting_;
+		snapshot["count"] = export_count_;
+		snapshot["last_time"] = last_export_time_;
+		snapshot["served_files"] = served_count_;
+
+		Json::Value &fast_sync = data["fast_sync"];
+		fast_sync["state"] = StateName(state_);
+		fast_sync["seq"] = manifest_.seq_;
+		fast_sync["chunks"] = (Json::UInt64)manifest_.chunk_hashes_.size();
+		fast_sync["staged"] = (Json::UInt64)staged_count_;
+		fast_sync["staged_bytes"] = staged_bytes_;
+		fast_sync["requests"] = (Json::UInt64)requests_.size();
+		fast_sync["sources"] = (Json::UInt64)sources_.size();
+		fast_sync["bad_chunks"] = bad_chunks_;
+	}
+}
@@ -0,0 +1,146 @@
+/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SNAPSHOT_MANAGER_H_
+#define SNAPSHOT_MANAGER_H_
+
+#include <utils/headers.h>
+#include <common/general.h>
+#include <common/storage.h>
+#include <proto/cpp/overlay.pb.h>
+
+namespace CEG {
+
+	//Overlay message of the snapshot transfer. It is not in overlay.proto, so the generated code is unchanged,
+	//and the peers which do not know it drop the requests as an unknown type.
+	//Request: protocol::GetLedgers, begin is the snapshot sequence (0 for the latest) and end the chunk index (-1 for the manifest).
+	//Response: protocol::EntryList, the request with the served sequence first, then the entries of the file, none if it is missing.
+	const int64_t OVERLAY_MSGTYPE_SNAPSHOT = 8;
+
+	//State snapshots of the account-db for the fast sync of new nodes.
+	//Every snapshot_interval ledgers a node writes the whole account-db (the account trie, the asset and metadata
+	//tries of the accounts, the validators, the fees and the proof) as chunk files in snapshot_path/<seq>/.
+	//The manifest of a snapshot holds the headers of the ledgers seq and seq - 1 and the hash of every chunk.
+	//A node whose last closed ledger is the genesis one and which has fast_sync enabled downloads the latest snapshot
+	//of its peers into a staging database, checking each chunk against the manifest, and verifies every trie record
+	//against its parent up to the account_tree_hash of the header. Then it writes the records into its databases,
+	//reloads the ledger state and syncs the ledgers after the snapshot as usual.
+	class SnapshotManager {
+		DISALLOW_COPY_AND_ASSIGN(SnapshotManager);
+
+		class ExportTask;
+		class ServeTask;
+		class StageTask;
+		class InstallTask;
+
+		enum FastSyncState {
+			FAST_SYNC_NONE,      //Not enabled, or the node has ledgers already
+			FAST_SYNC_DISCOVER,  //Asking the peers for their latest manifest
+			FAST_SYNC_DOWNLOAD,  //Fetching the chunks into the staging database
+			FAST_SYNC_INSTALL,   //Verifying the staged records and writing them into the node databases
+			FAST_SYNC_DONE,
+			FAST_SYNC_FAILED
+		};
+
+		struct Manifest {
+			int64_t seq_;
+			protocol::LedgerHeader header_;
+			protocol::LedgerHeader previous_header_;
+			std::vector<std::string> chunk_hashes_;
+			Manifest() :seq_(0) {}
+			bool Parse(const protocol::EntryList &list, int first);
+		};
+
+		struct ChunkRequest {
+			int64_t peer_id_;
+			int64_t send_time_;
+		};
+
+		utils::Mutex mutex_;
+		//Two threads, so that the chunks are served while a snapshot is written
+		utils::ThreadPool pool_;
+		std::string path_;
+
+		//Export
+		bool exporting_;
+		int64_t latest_seq_;
+		int64_t export_count_;
+		int64_t last_export_time_;
+		int64_t served_count_;
+
+		//Fast sync
+		FastSyncState state_;
+		int64_t state_time_;
+		int64_t discover_time_;
+		std::map<int64_t, Manifest> peer_manifests_;
+		Manifest manifest_;
+		std::set<int64_t> sources_;
+		std::map<size_t, ChunkRequest> requests_;
+		std::set<size_t> received_;
+		size_t staged_count_;
+		int64_t staged_bytes_;
+		int64_t bad_chunks_;
+		KeyValueDb *staging_db_;
+
+		//Wait so long for the manifests of the peers before choosing one
+		static const int64_t DISCOVER_TIME = 10 * utils::MICRO_UNITS_PER_SEC;
+		//Fall back to the ledger sync if no peer offers a snapshot
+		static const int64_t DISCOVER_TIMEOUT = 60 * utils::MICRO_UNITS_PER_SEC;
+		static const int64_t CHUNK_TIMEOUT = 30 * utils::MICRO_UNITS_PER_SEC;
+
+		std::string SnapshotPath(int64_t seq) const;
+		static std::string ChunkName(int64_t index);
+		static const char *StateName(FastSyncState state);
+
+		//Runs on the pool: write the account-db as of the last committed ledger
+		void Export();
+		void RemoveOldSnapshots();
+		//Runs on the pool: read the requested file and send it back
+		void Serve(const protocol::GetLedgers &request, int64_t peer_id);
+		//Runs on the pool: check a received chunk and write its records into the staging database
+		void Stage(int64_t seq, size_t index, const protocol::EntryList &chunk, int64_t peer_id);
+		//Runs on the pool: verify the staged state and write it into the node databases
+		void Install();
+		//proof is the staged proof of the ledger if the validators of the previous one signed it, empty otherwise
+		bool VerifyStaged(int64_t &account_count, std::string &proof);
+
+		void SendRequest(int64_t peer_id, int64_t seq, int64_t index);
+		void ChooseManifest(int64_t current_time);
+		void RequestChunks(int64_t current_time);
+		void SetState(FastSyncState state);
+		void CloseStagingDb();
+	public:
+		SnapshotManager();
+		~SnapshotManager();
+
+		bool Initialize();
+		bool Exit();
+
+		//Called by the commit thread after the ledger is written
+		void OnLedgerCommitted(int64_t seq);
+		//Called on the main thread by the ledger manager timer
+		void OnTimer(int64_t current_time);
+
+		void OnRequest(const protocol::GetLedgers &request, int64_t peer_id);
+		void OnResponse(const protocol::EntryList &response, int64_t peer_id);
+
+		//The ledger sync waits while a snapshot is being fetched or installed
+		bool IsFastSyncing();
+
+		void GetModuleStatus(Json::Value &data);
+	};
+}
+
+#endif
@@ -48,7 +48,7 @@ namespace CEG {
 	}
 
 
-	TransactionFrm::TransactionFrm(const protocol::TransactionEnv &env) :
+	TransactionFrm::TransactionFrm(const protocol::TransactionEnv &env, bool verify_signature) :
 		apply_time_(0),
 		ledger_seq_(0),
 		result_(),
@@ -65,7 +65,12 @@ namespace CEG {
 		contract_stack_max_vaule_(0),
 		enable_check_(false), apply_start_time_(0), apply_use_time_(0),
 		incoming_time_(utils::Timestamp::HighResolution()) {
-		Initialize();
+		if (verify_signature) {
+			Initialize();
+		}
+		else {
+			InitializeContent();
+		}
 		utils::AtomicInc(&CEG::General::tx_new_count);
 	}
 
@@ -97,24 +102,92 @@ namespace CEG {
 	}
 
 	void TransactionFrm::Initialize() {
+		InitializeContent();
+		VerifySignatures(std::vector<TransactionFrm *>(1, this), false);
+	}
+
+	void TransactionFrm::InitializeContent() {
 		const protocol::Transaction &tran = transaction_env_.transaction();
 		data_ = tran.SerializeAsString();
 		hash_ = HashWrapper::Crypto(data_);
 		full_data_ = transaction_env_.SerializeAsString();
+	}
+
+	void TransactionFrm::CreateBatch(const std::vector<const protocol::TransactionEnv *> &envs, std::vector<pointer> &frms, bool batch_verify) {
+		frms.clear();
+		frms.reserve(envs.size());
+		std::vector<TransactionFrm *> raw_frms;
+		raw_frms.reserve(envs.size());
+		for (size_t i = 0; i < envs.size(); i++) {
+			frms.push_back(std::make_shared<TransactionFrm>(*envs[i], false));
+			raw_frms.push_back(frms.back().get());
+		}
+		VerifySignatures(raw_frms, batch_verify);
+	}
 
-		for (int32_t i = 0; i < transaction_env_.signatures_size(); i++) {
-			const protocol::Signature &signature = transaction_env_.signatures(i);
-			PublicKey pubkey(signature.public_key());
+	void TransactionFrm::CreateBatch(const protocol::TransactionEnvSet &txset, std::vector<pointer> &frms, bool batch_verify) {
+		std::vector<const protocol::TransactionEnv *> envs;
+		envs.reserve(txset.txs_size());
+		for (int32_t i = 0; i < txset.txs_size(); i++) {
+			envs.push_back(&txset.txs(i));
+		}
+		CreateBatch(envs, frms, batch_verify);
+	}
 
-			if (!pubkey.IsValid()) {
-				LOG_ERROR("Invalid publickey(%s)", signature.public_key().c_str());
-				continue;
+	TransactionFrm::pointer TransactionFrm::CloneUnapplied() const {
+		pointer frm = std::make_shared<TransactionFrm>();
+		frm->transaction_env_ = transaction_env_;
+		frm->hash_ = hash_;
+		frm->data_ = data_;
+		frm->full_data_ = full_data_;
+		frm->valid_signature_ = valid_signature_;
+		frm->incoming_time_ = incoming_time_;
+		return frm;
+	}
+
+	void TransactionFrm::VerifySignatures(const std::vector<TransactionFrm *> &frms, bool batch_verify) {
+		std::vector<SignatureItem> items;
+		std::vector<const protocol::Signature *> signatures;
+		std::vector<std::pair<TransactionFrm *, std::string>> signers;
+		for (size_t i = 0; i < frms.size(); i++) {
+			TransactionFrm *frm = frms[i];
+			for (int32_t j = 0; j < frm->transaction_env_.signatures_size(); j++) {
+				const protocol::Signature &signature = frm->transaction_env_.signatures(j);
+				PublicKey pubkey(signature.public_key());
+
+				if (!pubkey.IsValid()) {
+					LOG_ERROR("Invalid publickey(%s)", signature.public_key().c_str());
+					continue;
+				}
+
+				SignatureItem item;
+				item.data_ = &frm->data_;
+				item.signature_ = &signature.sign_data();
+				item.type_ = pubkey.GetSignType();
+				item.raw_public_key_ = pubkey.GetRawPublicKey();
+				items.push_back(item);
+				signatures.push_back(&signature);
+				signers.push_back(std::make_pair(frm, pubkey.GetEncAddress()));
+			}
+		}
+
+		std::vector<bool> results;
+		if (batch_verify) {
+			PublicKey::VerifyBatch(items, results);
+		}
+		else {
+			results.resize(items.size());
+			for (size_t i = 0; i < items.size(); i++) {
+				results[i] = PublicKey::Verify(items[i]);
 			}
-			if (!PublicKey::Verify(data_, signature.sign_data(), signature.public_key())) {
-				LOG_ERROR("Invalid signature data(%s)", utils::String::BinToHexString(signature.SerializeAsString()).c_str());
+		}
+
+		for (size_t i = 0; i < results.size(); i++) {
+			if (!results[i]) {
+				LOG_ERROR("Invalid signature data(%s)", utils::String::BinToHexString(signatures[i]->SerializeAsString()).c_str());
 				continue;
 			}
-			valid_signature_.insert(pubkey.GetEncAddress());
+			signers[i].first->valid_signature_.insert(signers[i].second);
 		}
 	}
 
@@ -714,6 +787,72 @@ namespace CEG {
 		}
 
 		protocol::TransactionEnvStore envstor;
+		uint32_t code = LoadFromStore(hash, txenv_store, envstor);
+		if (code != 0) {
+			return code;
+		}
+
+		Initialize();
+		result_.set_code(envstor.error_code());
+		result_.set_desc(envstor.error_desc());
+		return 0;
+	}
+
+	uint32_t TransactionFrm::LoadFromDb(const std::vector<std::string> &hashes, std::vector<pointer> &frms) {
+		KeyValueDb *db = Storage::Instance().ledger_db();
+		frms.clear();
+
+		std::vector<std::string> keys;
+		keys.reserve(hashes.size());
+		for (size_t i = 0; i < hashes.size(); i++) {
+			keys.push_back(ComposePrefix(General::TRANSACTION_PREFIX, hashes[i]));
+		}
+
+		std::vector<std::string> values;
+		std::vector<int32_t> results;
+		db->MultiGet(keys, values, results);
+
+		uint32_t code = 0;
+		std::vector<protocol::TransactionEnvStore> envstors;
+		envstors.reserve(hashes.size());
+		for (size_t i = 0; i < hashes.size(); i++) {
+			if (results[i] < 0) {
+				LOG_ERROR("Failed to get transaction and the error decripition is: %s.", db->error_desc().c_str());
+				code = protocol::ERRCODE_INTERNAL_ERROR;
+				break;
+			}
+			else if (results[i] == 0) {
+				LOG_TRACE("Transaction(%s) does not exist.", utils::String::BinToHexString(hashes[i]).c_str());
+				code = protocol::ERRCODE_NOT_EXIST;
+				break;
+			}
+
+			pointer frm = std::make_shared<TransactionFrm>();
+			envstors.push_back(protocol::TransactionEnvStore());
+			code = frm->LoadFromStore(hashes[i], values[i], envstors.back());
+			if (code != 0) {
+				break;
+			}
+			frms.push_back(frm);
+		}
+
+		//Verify the signatures of the loaded transactions in one batch
+		std::vector<TransactionFrm *> raw_frms;
+		raw_frms.reserve(frms.size());
+		for (size_t i = 0; i < frms.size(); i++) {
+			frms[i]->InitializeContent();
+			raw_frms.push_back(frms[i].get());
+		}
+		VerifySignatures(raw_frms, true);
+
+		for (size_t i = 0; i < frms.size(); i++) {
+			frms[i]->result_.set_code(envstors[i].error_code());
+			frms[i]->result_.set_desc(envstors[i].error_desc());
+		}
+		return code;
+	}
+
+	uint32_t TransactionFrm::LoadFromStore(const std::string &hash, const std::string &txenv_store, protocol::TransactionEnvStore &envstor) {
 		if (!envstor.ParseFromString(txenv_store)) {
 			LOG_ERROR("Failed to parse transaction(%s) body from txenv_store.", utils::String::BinToHexString(hash).c_str());
 			return protocol::ERRCODE_INTERNAL_ERROR;
@@ -729,9 +868,6 @@ namespace CEG {
 		}
 
 		ledger_seq_ = envstor.ledger_seq();
-		Initialize();
-		result_.set_code(envstor.error_code());
-		result_.set_desc(envstor.error_desc());
 		return 0;
 	}
 
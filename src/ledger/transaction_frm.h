@@ -39,12 +39,22 @@ namespace CEG {
 	public:
 		//Valid only when the transaction belongs to a txset.
 		TransactionFrm();
-		TransactionFrm(const protocol::TransactionEnv &env);
+		TransactionFrm(const protocol::TransactionEnv &env, bool verify_signature = true);
 		
 		virtual ~TransactionFrm();
 		
 		static bool AccountFromDB(const std::string &address, AccountFrm::pointer &account_ptr);
 
+		//Create the frames of many transactions and verify all of their signatures.
+		//With batch_verify the ed25519 signatures go through PublicKey::VerifyBatch, whose accepts may differ from
+		//the single verification, so it is only for the admission into the pool. The ledgers verify one by one.
+		static void CreateBatch(const std::vector<const protocol::TransactionEnv *> &envs, std::vector<pointer> &frms, bool batch_verify = false);
+		static void CreateBatch(const protocol::TransactionEnvSet &txset, std::vector<pointer> &frms, bool batch_verify = false);
+		static void VerifySignatures(const std::vector<TransactionFrm *> &frms, bool batch_verify);
+
+		//A frame of the same transaction which has not been applied, for speculative execution
+		pointer CloneUnapplied() const;
+
 		std::string GetContentHash() const;
 		std::string GetContentData() const;
 
@@ -63,8 +73,11 @@ namespace CEG {
 		std::string GetOperatingSourceAddress() const;
 
 		void Initialize();
+		void InitializeContent();
 
 		uint32_t LoadFromDb(const std::string &hash);
+		//Load many transactions with one read, stop at the first one which fails and return its error code
+		static uint32_t LoadFromDb(const std::vector<std::string> &hashes, std::vector<pointer> &frms);
 
 		bool CheckTimeout(int64_t expire_time);
 		void NonceIncrease(LedgerFrm* ledger_frm, std::shared_ptr<Environment> env);
@@ -121,6 +134,9 @@ namespace CEG {
 		//for query
 		std::list<std::string> contract_tx_hashes_;
 	private:		
+		//Fill the frame from a stored TransactionEnvStore, without the signature checks
+		uint32_t LoadFromStore(const std::string &hash, const std::string &txenv_store, protocol::TransactionEnvStore &envstor);
+
 		protocol::TransactionEnv transaction_env_;
 		std::string hash_;
 		std::string data_;
@@ -30,12 +30,185 @@ namespace CEG{
 	-----------------------------
 	*/
 
-	NodeFrm::NodeFrm(const Location& location)
-		:leaf_(nullptr),  /*indb_(false),leaf_indb_(false),*/ leaf_deleted_(false), modified_(true), location_(location){
+	static void WriteVarint(std::string& out, uint64_t value){
+		while (value >= 0x80){
+			out.push_back((char)((value & 0x7f) | 0x80));
+			value >>= 7;
+		}
+		out.push_back((char)value);
+	}
+
+	static size_t VarintSize(uint64_t value){
+		size_t size = 1;
+		while (value >= 0x80){
+			value >>= 7;
+			size++;
+		}
+		return size;
+	}
+
+	static bool ReadVarint(const char*& p, const char* end, uint64_t& value){
+		value = 0;
+		for (int shift = 0; shift < 64 && p < end; shift += 7){
+			uint8_t byte = (uint8_t)*p++;
+			value |= (uint64_t)(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static bool SkipField(const char*& p, const char* end, int wire_type){
+		uint64_t len = 0;
+		switch (wire_type){
+		case 0:
+			return ReadVarint(p, end, len);
+		case 1:
+			len = 8;
+			break;
+		case 2:
+			if (!ReadVarint(p, end, len)) return false;
+			break;
+		case 5:
+			len = 4;
+			break;
+		default:
+			return false;
+		}
+		if (len > (uint64_t)(end - p)) return false;
+		p += len;
+		return true;
+	}
+
+	//protobuf tags of protocol::Node and protocol::Child
+	static const char TAG_NODE_CHILDREN = 0x0a;
+	static const char TAG_CHILD_SUBLOCATION = 0x0a;
+	static const char TAG_CHILD_HASH = 0x12;
+	static const char TAG_CHILD_TYPE = 0x18;
+
+	ChildFrm::ChildFrm() :hash_size_(0), childtype_(protocol::NONE){
+	}
+
+	void ChildFrm::Clear(){
+		sublocation_.clear();
+		hash_size_ = 0;
+		childtype_ = protocol::NONE;
+	}
+
+	bool ChildFrm::SetHash(const std::string& hash){
+		if (hash.size() > MAX_HASH_SIZE){
+			return false;
+		}
+		memcpy(hash_, hash.data(), hash.size());
+		hash_size_ = (uint8_t)hash.size();
+		return true;
+	}
+
+	std::string ChildFrm::GetHash() const{
+		return std::string((const char*)hash_, hash_size_);
+	}
+
+	void NodeInfo::Clear(){
+		for (int i = 0; i <= 16; i++){
+			children_[i].Clear();
+		}
+	}
+
+	void NodeInfo::SerializeTo(std::string& out) const{
+		out.clear();
+		for (int i = 0; i <= 16; i++){
+			const ChildFrm& ch = children_[i];
+			size_t size = 0;
+			if (!ch.sublocation_.empty()){
+				size += 1 + VarintSize(ch.sublocation_.size()) + ch.sublocation_.size();
+			}
+			if (ch.hash_size_ > 0){
+				size += 1 + VarintSize(ch.hash_size_) + ch.hash_size_;
+			}
+			if (ch.childtype_ != protocol::NONE){
+				size += 1 + VarintSize(ch.childtype_);
+			}
+
+			out.push_back(TAG_NODE_CHILDREN);
+			WriteVarint(out, size);
+			if (!ch.sublocation_.empty()){
+				out.push_back(TAG_CHILD_SUBLOCATION);
+				WriteVarint(out, ch.sublocation_.size());
+				out.append(ch.sublocation_);
+			}
+			if (ch.hash_size_ > 0){
+				out.push_back(TAG_CHILD_HASH);
+				WriteVarint(out, ch.hash_size_);
+				out.append((const char*)ch.hash_, ch.hash_size_);
+			}
+			if (ch.childtype_ != protocol::NONE){
+				out.push_back(TAG_CHILD_TYPE);
+				WriteVarint(out, ch.childtype_);
+			}
+		}
+	}
+
+	bool NodeInfo::ParseFrom(const std::string& buff){
+		Clear();
+		const char* p = buff.data();
+		const char* end = p + buff.size();
+		int index = 0;
+		while (p < end){
+			uint64_t tag = 0;
+			if (!ReadVarint(p, end, tag)) return false;
+			if (tag != (uint64_t)TAG_NODE_CHILDREN){
+				if (!SkipField(p, end, tag & 0x07)) return false;
+				continue;
+			}
+
+			uint64_t len = 0;
+			if (!ReadVarint(p, end, len) || len > (uint64_t)(end - p)) return false;
+			if (index > 16) return false;
+
+			ChildFrm& ch = children_[index++];
+			const char* cend = p + len;
+			while (p < cend){
+				uint64_t ctag = 0;
+				if (!ReadVarint(p, cend, ctag)) return false;
+				if (ctag == (uint64_t)TAG_CHILD_SUBLOCATION || ctag == (uint64_t)TAG_CHILD_HASH){
+					uint64_t flen = 0;
+					if (!ReadVarint(p, cend, flen) || flen > (uint64_t)(cend - p)) return false;
+					if (ctag == (uint64_t)TAG_CHILD_SUBLOCATION){
+						ch.sublocation_.assign(p, flen);
+					}
+					else if (!ch.SetHash(std::string(p, flen))){
+						return false;
+					}
+					p += flen;
+				}
+				else if (ctag == (uint64_t)TAG_CHILD_TYPE){
+					uint64_t type = 0;
+					if (!ReadVarint(p, cend, type)) return false;
+					ch.childtype_ = (uint8_t)type;
+				}
+				else if (!SkipField(p, cend, ctag & 0x07)){
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void NodeInfo::ToProto(protocol::Node& node) const{
+		node.Clear();
 		for (int i = 0; i <= 16; i++){
-			protocol::Child* ch = info_.add_children();
-			if (i != 16)
-				children_[i] = nullptr;
+			protocol::Child* ch = node.add_children();
+			ch->set_sublocation(children_[i].sublocation_);
+			ch->set_hash(children_[i].GetHash());
+			ch->set_childtype(children_[i].childtype());
+		}
+	}
+
+	NodeFrm::NodeFrm(const Location& location)
+		:location_(location), modified_(true), leaf_deleted_(false), has_leaf_(false){
+		for (int i = 0; i < 16; i++){
+			children_[i] = nullptr;
 		}
 		NEWCOUNT++;
 	}
@@ -43,54 +216,141 @@ namespace CEG{
 	void NodeFrm::SetValue(const std::string& v){
 		modified_ = true;
 		leaf_deleted_ = false;
-		leaf_ = std::make_shared<std::string>(v);
-		protocol::Child* ch16 = info_.mutable_children(16);
-		ch16->set_childtype(protocol::LEAF);
-		ch16->set_sublocation(location_);
+		has_leaf_ = true;
+		leaf_ = v;
+		ChildFrm& ch16 = info_.children_[16];
+		ch16.set_childtype(protocol::LEAF);
+		ch16.sublocation_ = location_;
 	}
 
 	void NodeFrm::MarkRemove(){
 		modified_ = true;
 		leaf_deleted_ = true;
-		leaf_ = nullptr;
-		protocol::Child* ch16 = info_.mutable_children(16);
-		ch16->Clear();
+		has_leaf_ = false;
+		leaf_.clear();
+		info_.children_[16].Clear();
 	}
 
 	void NodeFrm::SetChild(int branch, POINTER child){
 		assert(branch < 16);
 		modified_ = true;
 		children_[branch] = child;
-		info_.mutable_children(branch)->set_sublocation(child->location_);
-		//info_.mutable_children(branch)->set_childtype();
+		info_.children_[branch].sublocation_ = child->location_;
 	}
 
 	NodeFrm::~NodeFrm(){
 		DELCOUNT++;
 	}
 
-	Trie::Trie(){
+	NodeArena::NodeArena() :free_list_(nullptr), block_nodes_(0), used_in_block_(0), live_count_(0), capacity_(0){
+	}
+
+	NodeArena::~NodeArena(){
+		assert(live_count_ == 0);
+		for (size_t i = 0; i < blocks_.size(); i++){
+			free(blocks_[i]);
+		}
+	}
+
+	NodeFrm::POINTER NodeArena::New(const Location& location){
+		void* slot = nullptr;
+		if (free_list_ != nullptr){
+			slot = free_list_;
+			free_list_ = *(void**)free_list_;
+		}
+		else{
+			if (blocks_.empty() || used_in_block_ == block_nodes_){
+				//Small tries (per account assets and metadata) start with a small block
+				block_nodes_ = (block_nodes_ == 0) ? MIN_BLOCK_NODES : block_nodes_ * 2;
+				if (block_nodes_ > MAX_BLOCK_NODES){
+					block_nodes_ = MAX_BLOCK_NODES;
+				}
+				char* block = (char*)malloc(block_nodes_ * sizeof(NodeFrm));
+				if (block == nullptr){
+					PROCESS_EXIT("Failed to allocate trie node block of " FMT_SIZE " nodes", block_nodes_);
+				}
+				blocks_.push_back(block);
+				used_in_block_ = 0;
+				capacity_ += block_nodes_;
+			}
+			slot = blocks_.back() + used_in_block_ * sizeof(NodeFrm);
+			used_in_block_++;
+		}
+		live_count_++;
+		return new (slot)NodeFrm(location);
+	}
+
+	void NodeArena::Delete(NodeFrm::POINTER node){
+		node->~NodeFrm();
+		*(void**)node = free_list_;
+		free_list_ = node;
+		live_count_--;
+	}
+
+	void TrieWriteLog::Add(OpType type, NodeFrm::POINTER node, const std::string& buff){
+		ops_.push_back(Op());
+		Op& op = ops_.back();
+		op.type_ = type;
+		op.node_ = node;
+		op.buff_ = buff;
+	}
+
+	class Trie::HashTask : public utils::Runnable{
+	public:
+		Trie* trie_;
+		NodeFrm::POINTER node_;
+		utils::Semaphore* done_;
+		ChildFrm result_;
+		TrieWriteLog log_;
+
+		HashTask(Trie* trie, NodeFrm::POINTER node, utils::Semaphore* done)
+			:trie_(trie), node_(node), done_(done){}
+
+		virtual void Run(utils::Thread *this_thread) override{
+			result_ = trie_->update_hash(node_, &log_, nullptr);
+			done_->Signal();
+		}
+	};
+
+	Trie::Trie() :hash_pool_(nullptr), root_(nullptr){
 		rootl = "";
 		rootl.push_back(0);
 	}
 
 
 	Trie::~Trie(){
-		FreeMemory(0);
+		if (root_ != nullptr){
+			FreeNode(root_);
+			root_ = nullptr;
+		}
 	}
 
 	void Trie::FreeMemory(int depth){
-		Release(root_, depth);
+		if (root_ != nullptr){
+			Release(root_, depth);
+		}
+	}
+
+	void Trie::FreeNode(NodeFrm::POINTER node){
+		for (int i = 0; i < 16; i++){
+			if (node->children_[i] != nullptr){
+				FreeNode(node->children_[i]);
+			}
+		}
+		arena_.Delete(node);
 	}
 
 	void Trie::Release(NodeFrm::POINTER node, int depth){
 		for (int i = 0; i < 16; i++){
 			auto child = node->children_[i];
 			if (child != nullptr){
-				Release(child, depth - 1);
 				if (depth <= 0){
+					FreeNode(child);
 					node->children_[i] = nullptr;
 				}
+				else{
+					Release(child, depth - 1);
+				}
 			}
 		}
 	}
@@ -98,21 +358,21 @@ namespace CEG{
 	NodeFrm::POINTER Trie::ChildMayFromDB(NodeFrm::POINTER node, int branch) {
 		if (node->children_[branch] == nullptr){
 			NodeFrm::POINTER frm = nullptr;
-			const protocol::Child& chd = node->info_.children(branch);
+			const ChildFrm& chd = node->info_.children_[branch];
 			if (chd.childtype() == protocol::NONE){
 				return nullptr;
 			}
 
-			frm = std::make_shared<NodeFrm>(chd.sublocation());
+			frm = arena_.New(chd.sublocation_);
 			frm->modified_ = false;
 
 			if (chd.childtype() == protocol::LEAF){
-				frm->info_.mutable_children(16)->CopyFrom(node->info_.children(branch));
+				frm->info_.children_[16] = chd;
 
 			}
 			else if (chd.childtype() == protocol::INNER){
-				if (!storage_load(chd.sublocation(), frm->info_)){
-					PROCESS_EXIT("load:%s failed", utils::String::BinToHexString(chd.sublocation()).c_str());
+				if (!storage_load(chd.sublocation_, frm->info_)){
+					PROCESS_EXIT("load:%s failed", utils::String::BinToHexString(chd.sublocation_).c_str());
 				}
 			}
 			node->children_[branch] = frm;
@@ -179,78 +439,94 @@ namespace CEG{
 		return location + key;
 	}
 
-	protocol::Child Trie::update_hash(NodeFrm::POINTER node){
+	void Trie::ReplayWriteLog(const TrieWriteLog& log){
+		for (size_t i = 0; i < log.ops_.size(); i++){
+			const TrieWriteLog::Op& op = log.ops_[i];
+			switch (op.type_){
+			case TrieWriteLog::SAVE_NODE:
+				StorageSaveNode(op.node_, op.buff_);
+				break;
+			case TrieWriteLog::SAVE_LEAF:
+				StorageSaveLeaf(op.node_);
+				break;
+			case TrieWriteLog::DELETE_NODE:
+				StorageDeleteNode(op.node_);
+				break;
+			case TrieWriteLog::DELETE_LEAF:
+				StorageDeleteLeaf(op.node_);
+				break;
+			}
+		}
+	}
+
+	//The storage writes are recorded into log when it is not null, so that the caller
+	//can replay them into the batch in the same order as a serial update_hash
+	ChildFrm Trie::update_hash(NodeFrm::POINTER node, TrieWriteLog* log, HashTask** tasks){
 
 		int branch_count = 0;
 		int onlybranch = -1;
-		int64_t children_count = 0;
 
 		//////////////////////////////////////////////////////////////
 		if (!node->leaf_deleted_){
-			if (node->leaf_ != nullptr){
-				protocol::Child* this_child = node->info_.mutable_children(16);
-#ifdef COUNT
-				this_child->set_count(1);
-#endif
-				this_child->set_sublocation(node->location_);
-				this_child->set_hash(HashCrypto(*(node->leaf_)));
-				this_child->set_childtype(protocol::LEAF);
-				StorageSaveLeaf(node);
+			if (node->has_leaf_){
+				ChildFrm& this_child = node->info_.children_[16];
+				this_child.sublocation_ = node->location_;
+				if (!this_child.SetHash(HashCrypto(node->leaf_))){
+					PROCESS_EXIT("Hash size of leaf(%s) exceeds the trie limit", utils::String::BinToHexString(node->location_).c_str());
+				}
+				this_child.set_childtype(protocol::LEAF);
+				if (log) log->Add(TrieWriteLog::SAVE_LEAF, node);
+				else StorageSaveLeaf(node);
 			}
 		}
 		else{
-			protocol::Child* ch = node->info_.mutable_children(16);
-			ch->Clear();
-			StorageDeleteLeaf(node);
+			node->info_.children_[16].Clear();
+			if (log) log->Add(TrieWriteLog::DELETE_LEAF, node);
+			else StorageDeleteLeaf(node);
 		}
 
-		if (node->info_.children(16).childtype() != protocol::CHILDTYPE::NONE){
+		if (node->info_.children_[16].childtype() != protocol::CHILDTYPE::NONE){
 			branch_count++;
 			onlybranch = 16;
-			children_count++;
 		}
 
 		for (int i = 0; i < 16; i++){
 			NodeFrm::POINTER child = node->children_[i];
-			if ((child != nullptr) && (child->modified_)){
-				protocol::Child childresult = update_hash(child);
-				node->info_.mutable_children(i)->CopyFrom(childresult);
+			if (tasks != nullptr && tasks[i] != nullptr){
+				ReplayWriteLog(tasks[i]->log_);
+				node->info_.children_[i] = tasks[i]->result_;
+			}
+			else if ((child != nullptr) && (child->modified_)){
+				node->info_.children_[i] = update_hash(child, log, nullptr);
 			}
 
-			if (node->info_.children(i).childtype() != protocol::CHILDTYPE::NONE){
+			if (node->info_.children_[i].childtype() != protocol::CHILDTYPE::NONE){
 				branch_count++;
 				onlybranch = i;
-#ifdef COUNT
-				if (node->info_.children(i).count() == 0){
-					printf("fatel error");
-				}
-				children_count += node->info_.children(i).count();
-#endif
 			}
 		}
 
 
-		protocol::Child result;
-#ifdef COUNT
-		result.set_count(children_count);
-#endif		
+		ChildFrm result;
 		if (branch_count == 0 && node->location_ != rootl){
-			StorageDeleteNode(node);
-			//node->indb_ = false;
+			if (log) log->Add(TrieWriteLog::DELETE_NODE, node);
+			else StorageDeleteNode(node);
 		}
 		else if (branch_count == 1 && node->location_ != rootl){
-			StorageDeleteNode(node);
-			//node->indb_ = false;
-			result.CopyFrom(node->info_.children(onlybranch));
+			if (log) log->Add(TrieWriteLog::DELETE_NODE, node);
+			else StorageDeleteNode(node);
+			result = node->info_.children_[onlybranch];
 		}
 		else {
-			StorageSaveNode(node);
-			result.set_hash(HashCrypto(node->info_.SerializeAsString()));
-			result.set_sublocation(node->location_);
+			std::string buff;
+			node->info_.SerializeTo(buff);
+			if (log) log->Add(TrieWriteLog::SAVE_NODE, node, buff);
+			else StorageSaveNode(node, buff);
+			if (!result.SetHash(HashCrypto(buff))){
+				PROCESS_EXIT("Hash size of node(%s) exceeds the trie limit", utils::String::BinToHexString(node->location_).c_str());
+			}
+			result.sublocation_ = node->location_;
 			result.set_childtype(protocol::CHILDTYPE::INNER);
-#ifdef COUNT
-			result.set_count(children_count);
-#endif
 		}
 		node->modified_ = false;
 		return result;
@@ -270,13 +546,13 @@ namespace CEG{
 		int branch = NextBranch(common, location);
 
 		NodeFrm::POINTER node2 = ChildMayFromDB(node, branch);
-		protocol::Child child2 = node->info_.children(branch);
+		ChildFrm child2 = node->info_.children_[branch];
 		if (node2 == nullptr){
-			NodeFrm::POINTER newnode = std::make_shared<NodeFrm>(location);
+			NodeFrm::POINTER newnode = arena_.New(location);
 			newnode->SetValue(data);
 
 			node->SetChild(branch, newnode);
-			node->info_.mutable_children(branch)->set_childtype(protocol::LEAF);
+			node->info_.children_[branch].set_childtype(protocol::LEAF);
 			
 			return true;
 		}
@@ -298,14 +574,14 @@ namespace CEG{
 				|
 				node2
 				*/
-			NodeFrm::POINTER newnode = std::make_shared< NodeFrm>(location);
+			NodeFrm::POINTER newnode = arena_.New(location);
 			newnode->SetValue(data);
 			int b1 = NextBranch(newcommon, location2);
 			newnode->SetChild(b1, node2);
-			newnode->info_.mutable_children(b1)->CopyFrom(child2);
+			newnode->info_.children_[b1] = child2;
 
 			node->SetChild(branch, newnode);
-			node->info_.mutable_children(branch)->set_childtype(protocol::INNER);
+			node->info_.children_[branch].set_childtype(protocol::INNER);
 			return true;
 		}
 		else {
@@ -323,15 +599,15 @@ namespace CEG{
 						  */
 			/************************************************************************/
 
-			NodeFrm::POINTER mnode = std::make_shared< NodeFrm>(newcommon);
-			NodeFrm::POINTER newnode = std::make_shared< NodeFrm>(location);
+			NodeFrm::POINTER mnode = arena_.New(newcommon);
+			NodeFrm::POINTER newnode = arena_.New(location);
 			newnode->SetValue(data);
 
 			int b1 = NextBranch(newcommon, location);
 			int b2 = NextBranch(newcommon, location2);
 			mnode->SetChild(b1, newnode);
 			mnode->SetChild(b2, node2);
-			mnode->info_.mutable_children(b2)->CopyFrom(child2);
+			mnode->info_.children_[b2] = child2;
 			node->SetChild(branch, mnode);
 			return true;
 		}
@@ -368,7 +644,7 @@ namespace CEG{
 	}
 
 	void Trie::GetAllItem(const Location& node, const Location& location, std::vector<std::string>& result){
-		protocol::Node info;
+		NodeInfo info;
 		if (!storage_load(node, info)){
 			return;
 		}
@@ -380,7 +656,7 @@ namespace CEG{
 
 		if (common == node){
 			int nextbranch = NextBranch(common, location);
-			Location location2 = info.children(nextbranch).sublocation();
+			Location location2 = info.children_[nextbranch].sublocation_;
 			GetAllItem(location2, location, result);
 		}
 
@@ -406,11 +682,11 @@ namespace CEG{
 		auto common = CommonPrefix(node->location_, key);
 		int branch = NextBranch(common, key);
 
-		if (node->info_.children(branch).childtype() == protocol::CHILDTYPE::NONE){
+		if (node->info_.children_[branch].childtype() == protocol::CHILDTYPE::NONE){
 			return false;
 		}
 
-		Location location2 = node->info_.children(branch).sublocation();
+		const Location& location2 = node->info_.children_[branch].sublocation_;
 
 		auto common2 = CommonPrefix(location2, key);
 		if (common2 != location2){
@@ -420,6 +696,52 @@ namespace CEG{
 		return Exists(child, key);
 	}
 
+	bool Trie::Find(const std::string& key, std::string& value){
+		Location location = Key2Location(key);
+		NodeFrm::POINTER node = root_;
+		const NodeInfo* info = &root_->info_;
+		Location node_location = root_->location_;
+		NodeInfo loaded;
+
+		while (node_location != location){
+			auto common = CommonPrefix(node_location, location);
+			int branch = NextBranch(common, location);
+
+			const ChildFrm& chd = info->children_[branch];
+			if (chd.childtype() == protocol::CHILDTYPE::NONE){
+				return false;
+			}
+
+			Location sublocation = chd.sublocation_;
+			if (CommonPrefix(sublocation, location) != sublocation){
+				return false;
+			}
+
+			//Walk the nodes in memory, the others are read into a local copy
+			if (node != nullptr && node->children_[branch] != nullptr){
+				node = node->children_[branch];
+				info = &node->info_;
+				node_location = node->location_;
+				continue;
+			}
+
+			node = nullptr;
+			node_location = sublocation;
+			if (chd.childtype() == protocol::LEAF){
+				if (sublocation != location){
+					return false;
+				}
+				break;
+			}
+
+			if (!StorageFindNode(sublocation, loaded)){
+				PROCESS_EXIT("load:%s failed", utils::String::BinToHexString(sublocation).c_str());
+			}
+			info = &loaded;
+		}
+		return StorageGetLeaf(location, value);
+	}
+
 	void Trie::GetAll(const std::string& key, std::vector<std::string>& values){
 		Location location = Key2Location(key);
 		Location node = Key2Location("");
@@ -431,8 +753,45 @@ namespace CEG{
 		return root_hash_;
 	}
 
+	void Trie::SetHashPool(utils::ThreadPool* pool){
+		hash_pool_ = pool;
+	}
+
 	void Trie::UpdateHash(){
-		root_hash_ = update_hash(root_).hash();
+		HashTask* tasks[16] = { nullptr };
+		int task_count = 0;
+		if (hash_pool_ != nullptr && hash_pool_->Size() > 0){
+			for (int i = 0; i < 16; i++){
+				NodeFrm::POINTER child = root_->children_[i];
+				if (child != nullptr && child->modified_){
+					task_count++;
+				}
+			}
+		}
+
+		//A single modified subtree is not worth a thread switch
+		if (task_count < 2){
+			root_hash_ = update_hash(root_, nullptr, nullptr).GetHash();
+			return;
+		}
+
+		utils::Semaphore done;
+		for (int i = 0; i < 16; i++){
+			NodeFrm::POINTER child = root_->children_[i];
+			if (child != nullptr && child->modified_){
+				tasks[i] = new HashTask(this, child, &done);
+				hash_pool_->AddTask(tasks[i]);
+			}
+		}
+
+		for (int i = 0; i < task_count; i++){
+			done.Wait();
+		}
+
+		root_hash_ = update_hash(root_, nullptr, tasks).GetHash();
+		for (int i = 0; i < 16; i++){
+			delete tasks[i];
+		}
 	}
 
 	bool Trie::Delete(const std::string& key){
@@ -442,35 +801,85 @@ namespace CEG{
 
 
 	void Trie::StorageAssociated(const Location& location, std::vector<std::string>& result){
-		protocol::Node info;
-		if (!storage_load(location, info)){
+		//Load the subtree level by level, one batched read per level
+		std::unordered_map<Location, NodeInfo> nodes;
+		std::vector<Location> level(1, location);
+		while (!level.empty()){
+			std::vector<NodeInfo> infos;
+			std::vector<bool> found;
+			StorageLoadBatch(level, infos, found);
+
+			std::vector<Location> next;
+			for (size_t i = 0; i < level.size(); i++){
+				if (!found[i]){
+					continue;
+				}
+
+				for (int j = 0; j < 16; j++){
+					const ChildFrm& chd = infos[i].children_[j];
+					if (chd.childtype() == protocol::INNER){
+						next.push_back(chd.sublocation_);
+					}
+				}
+				nodes[level[i]] = infos[i];
+			}
+			level.swap(next);
+		}
+
+		//Then read all the leaves at once, in the same order as a depth first walk
+		std::vector<Location> leaves;
+		CollectLeaves(location, nodes, leaves);
+
+		std::vector<std::string> values;
+		StorageGetLeafBatch(leaves, values);
+		for (size_t i = 0; i < values.size(); i++){
+			result.push_back(std::move(values[i]));
+		}
+	}
+
+	void Trie::CollectLeaves(const Location& location, const std::unordered_map<Location, NodeInfo>& nodes, std::vector<Location>& leaves){
+		auto it = nodes.find(location);
+		if (it == nodes.end()){
 			return;
 		}
-		if (info.children(16).childtype() == protocol::CHILDTYPE::LEAF){
-			std::string v;
-			StorageGetLeaf(location, v);
-			result.push_back(v);
+
+		const NodeInfo& info = it->second;
+		if (info.children_[16].childtype() == protocol::CHILDTYPE::LEAF){
+			leaves.push_back(location);
 		}
 
 		for (int i = 0; i < 16; i++){
-			protocol::Child chd = info.children(i);
+			const ChildFrm& chd = info.children_[i];
 			protocol::CHILDTYPE type = chd.childtype();
 			switch (type)
 			{
 			case protocol::NONE:
 				break;
 			case protocol::INNER:
-				StorageAssociated(chd.sublocation(), result);
+				CollectLeaves(chd.sublocation_, nodes, leaves);
 				break;
 			case protocol::LEAF:
-				std::string value;
-				StorageGetLeaf(chd.sublocation(), value);
-				result.push_back(value);
+				leaves.push_back(chd.sublocation_);
 				break;
 			}
 		}
 	}
 
+	void Trie::StorageLoadBatch(const std::vector<Location>& locations, std::vector<NodeInfo>& infos, std::vector<bool>& found){
+		infos.resize(locations.size());
+		found.assign(locations.size(), false);
+		for (size_t i = 0; i < locations.size(); i++){
+			found[i] = storage_load(locations[i], infos[i]);
+		}
+	}
+
+	void Trie::StorageGetLeafBatch(const std::vector<Location>& locations, std::vector<std::string>& values){
+		values.resize(locations.size());
+		for (size_t i = 0; i < locations.size(); i++){
+			StorageGetLeaf(locations[i], values[i]);
+		}
+	}
+
 
 	///////////////////////////////////////////////////////
 	//std::string Trie::ToJson(){
@@ -502,12 +911,17 @@ namespace CEG{
 		if (lc == ""){
 			lc.push_back(0);
 		}
-		return getNode(root_, lc);
+		protocol::Node node;
+		const NodeInfo* info = getNode(root_, lc);
+		if (info != nullptr){
+			info->ToProto(node);
+		}
+		return node;
 	}
 
-	protocol::Node Trie::getNode(NodeFrm::POINTER node, const Location& location){
+	const NodeInfo* Trie::getNode(NodeFrm::POINTER node, const Location& location){
 		if (node->location_ == location){
-			return node->info_;
+			return &node->info_;
 		}
 
 		Location common = CommonPrefix(location, node->location_);
@@ -518,6 +932,6 @@ namespace CEG{
 			return getNode(frm, location);
 		}
 		else
-			return protocol::Node();
+			return nullptr;
 	}
 }
\ No newline at end of file
@@ -16,24 +16,61 @@
 #ifndef TRIE_H_
 #define TRIE_H_
 
+#include <unordered_map>
 #include <utils/sm3.h>
+#include <utils/noncopyable.h>
+#include <utils/thread.h>
 #include "proto/cpp/merkeltrie.pb.h"
 
 namespace CEG{
 	typedef std::string Location;
 	typedef std::string HASH;
 
+	//Compact form of protocol::Child, the hash is kept inline
+	class ChildFrm{
+	public:
+		static const int MAX_HASH_SIZE = 32;
+
+		Location sublocation_;
+		uint8_t hash_[MAX_HASH_SIZE];
+		uint8_t hash_size_;
+		uint8_t childtype_;
+	public:
+		ChildFrm();
+
+		void Clear();
+		bool SetHash(const std::string& hash);
+		std::string GetHash() const;
+		protocol::CHILDTYPE childtype() const { return (protocol::CHILDTYPE)childtype_; }
+		void set_childtype(protocol::CHILDTYPE type) { childtype_ = (uint8_t)type; }
+	};
+
+	//Compact form of protocol::Node. The canonical layout written by
+	//SerializeTo is byte-identical to protocol::Node::SerializeAsString(),
+	//so the node hashes and database records stay unchanged
+	class NodeInfo{
+	public:
+		ChildFrm children_[17];
+	public:
+		void Clear();
+		void SerializeTo(std::string& out) const;
+		bool ParseFrom(const std::string& buff);
+		void ToProto(protocol::Node& node) const;
+	};
+
 	class NodeFrm{
 	public:
-		typedef std::shared_ptr<NodeFrm> POINTER;
+		//Nodes are owned by the NodeArena of the trie
+		typedef NodeFrm* POINTER;
 		Location location_;
 		POINTER children_[16];
 		
-		protocol::Node info_;
+		NodeInfo info_;
 		
 		bool modified_;
 		bool leaf_deleted_;
-		std::shared_ptr<std::string> leaf_;//nullptr default
+		bool has_leaf_;
+		std::string leaf_;
 
 		static int NEWCOUNT;
 		static int DELCOUNT;
@@ -47,34 +84,89 @@ namespace CEG{
 		void SetChild(int branch, POINTER child);
 	};
 
+	//Slab allocator for the nodes of one trie, freed nodes are kept in a free list
+	//and reused by the next ledger instead of going back to the heap
+	class NodeArena : public utils::NonCopyable{
+		std::vector<char*> blocks_;
+		void* free_list_;
+		size_t block_nodes_;
+		size_t used_in_block_;
+		int64_t live_count_;
+		int64_t capacity_;
+	public:
+		static const size_t MIN_BLOCK_NODES = 16;
+		static const size_t MAX_BLOCK_NODES = 4096;
+
+		NodeArena();
+		~NodeArena();
+
+		NodeFrm::POINTER New(const Location& location);
+		void Delete(NodeFrm::POINTER node);
+
+		int64_t LiveCount() const { return live_count_; }
+		int64_t Capacity() const { return capacity_; }
+		int64_t BytesReserved() const { return capacity_ * sizeof(NodeFrm); }
+	};
+
+	//Storage writes of a subtree hashed on a worker thread, replayed in order on the caller thread
+	class TrieWriteLog{
+	public:
+		enum OpType{
+			SAVE_NODE,
+			SAVE_LEAF,
+			DELETE_NODE,
+			DELETE_LEAF
+		};
+		struct Op{
+			OpType type_;
+			NodeFrm::POINTER node_;
+			std::string buff_;
+		};
+		std::vector<Op> ops_;
+	public:
+		void Add(OpType type, NodeFrm::POINTER node, const std::string& buff = "");
+	};
+
 	class Trie
 	{
+		class HashTask;
 
 		bool SetItem(NodeFrm::POINTER node, const Location &key, const std::string &value, int depth);
 		bool DeleteItem(NodeFrm::POINTER node, const Location& key);
-		protocol::Child update_hash(NodeFrm::POINTER node);
+		ChildFrm update_hash(NodeFrm::POINTER node, TrieWriteLog* log, HashTask** tasks);
+		void ReplayWriteLog(const TrieWriteLog& log);
 
 		void Release(NodeFrm::POINTER node, int depth);
+		void FreeNode(NodeFrm::POINTER node);
 		
 		void GetAllItem(const Location& node, const Location& location, std::vector<std::string>& result);
 		void StorageAssociated(const Location& location, std::vector<std::string>& result);
+		void CollectLeaves(const Location& location, const std::unordered_map<Location, NodeInfo>& nodes, std::vector<Location>& leaves);
 	protected:
+		NodeArena arena_;
+		utils::ThreadPool* hash_pool_;
 		NodeFrm::POINTER root_;
 		HASH root_hash_;
 		Location rootl ;
 		NodeFrm::POINTER ChildMayFromDB(NodeFrm::POINTER node, int branch);
 
-		virtual bool storage_load(const Location& location, protocol::Node& info) = 0;
+		virtual bool storage_load(const Location& location, NodeInfo& info) = 0;
+		//Same as storage_load but safe to call from several threads at once, used by Find
+		virtual bool StorageFindNode(const Location& location, NodeInfo& info) = 0;
 
-		virtual void StorageSaveNode(NodeFrm::POINTER node) = 0;
+		virtual void StorageSaveNode(NodeFrm::POINTER node, const std::string& buff) = 0;
 		virtual void StorageSaveLeaf(NodeFrm::POINTER node) = 0;
 		virtual	void StorageDeleteNode(NodeFrm::POINTER node) = 0;
 		virtual void StorageDeleteLeaf(NodeFrm::POINTER node) = 0;
 
 		virtual bool StorageGetLeaf(const Location& location, std::string& value) = 0;
 		virtual std::string HashCrypto(const std::string& input) = 0;
+
+		//Batched forms of storage_load and StorageGetLeaf, a missing leaf gives an empty value
+		virtual void StorageLoadBatch(const std::vector<Location>& locations, std::vector<NodeInfo>& infos, std::vector<bool>& found);
+		virtual void StorageGetLeafBatch(const std::vector<Location>& locations, std::vector<std::string>& values);
 		
-		protocol::Node getNode(NodeFrm::POINTER node, const Location& location);
+		const NodeInfo* getNode(NodeFrm::POINTER node, const Location& location);
 	public:
 		static const char EVEN_PREFIX = 0x00;
 		static const char ODD_PREFIX = 0x01;
@@ -93,6 +185,10 @@ namespace CEG{
 
 		bool Exists(NodeFrm::POINTER node, const Location& key);
 
+		//Same as Get but the tree is not changed, the nodes which are not in memory are read without being kept.
+		//Several threads may call it together while holding a read lock of the tree.
+		bool Find(const std::string& key, std::string& value);
+
 		void GetAll(const std::string& key, std::vector<std::string>& values);
 
 		//Return false if it is not existed; otherwise, return true.
@@ -102,7 +198,12 @@ namespace CEG{
 
 		void UpdateHash();
 
+		//Modified top level subtrees are hashed on the pool, nullptr hashes serially
+		void SetHashPool(utils::ThreadPool* pool);
+
 		void FreeMemory(int depth);
+
+		const NodeArena& Arena() const { return arena_; }
 	
 		protocol::Node GetNode(const Location& key);
 
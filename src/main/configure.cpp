@@ -77,11 +77,16 @@ namespace CEG {
 		std::string address;
 		Configure::GetValue(value, "listen_address", address);
 		listen_address_ = utils::InetAddress(address);
+		Configure::GetValue(value, "send_queue_size", send_queue_size_);
+		Configure::GetValue(value, "send_buffer_size", send_buffer_size_);
+		send_buffer_size_ *= utils::BYTES_PER_KILO;
 
 		return true;
 	}
 
 	WsServerConfigure::WsServerConfigure() {
+		send_queue_size_ = 10000;
+		send_buffer_size_ = 4096;
 	}
 
 	WebServerConfigure::WebServerConfigure() {
@@ -124,6 +129,25 @@ namespace CEG {
 		hash_type_ = 0; // 0 : SHA256, 1 :SM2
 		queue_limit_ = 10240;
 		queue_per_account_txs_limit_ = 64;
+		hash_thread_count_ = 4;
+		trie_cache_size_ = 20000;
+		code_cache_size_ = 256;
+		code_cache_persist_ = true;
+		apply_thread_count_ = 4;
+		async_commit_ = true;
+		sync_thread_count_ = 2;
+		test_thread_count_ = 4;
+		sync_requests_per_peer_ = 2;
+		sync_prefetch_count_ = 256;
+		snapshot_interval_ = 0;
+		snapshot_keep_ = 2;
+		snapshot_chunk_size_ = utils::BYTES_PER_MEGA;
+		snapshot_path_ = "data/snapshot";
+		fast_sync_ = false;
+		fast_sync_min_gap_ = 1000;
+		fast_sync_min_peers_ = 3;
+		admission_thread_count_ = 2;
+		admission_queue_limit_ = 20480;
 		validation_random = false;
 	}
 
@@ -143,9 +167,34 @@ namespace CEG {
 
 		Configure::GetValue(value, "forbid_addrs", forbid_addrs_);
 		Configure::GetValue(value, "use_atom_map", use_atom_map_);
+		Configure::GetValue(value, "hash_thread_count", hash_thread_count_);
+		Configure::GetValue(value, "trie_cache_size", trie_cache_size_);
+		Configure::GetValue(value, "code_cache_size", code_cache_size_);
+		Configure::GetValue(value, "code_cache_persist", code_cache_persist_);
+		Configure::GetValue(value, "apply_thread_count", apply_thread_count_);
+		Configure::GetValue(value, "async_commit", async_commit_);
+		Configure::GetValue(value, "sync_thread_count", sync_thread_count_);
+		Configure::GetValue(value, "test_thread_count", test_thread_count_);
+		Configure::GetValue(value, "sync_requests_per_peer", sync_requests_per_peer_);
+		Configure::GetValue(value, "sync_prefetch_count", sync_prefetch_count_);
+
+		Configure::GetValue(value["snapshot"], "interval", snapshot_interval_);
+		Configure::GetValue(value["snapshot"], "keep", snapshot_keep_);
+		Configure::GetValue(value["snapshot"], "chunk_size", snapshot_chunk_size_);
+		Configure::GetValue(value["snapshot"], "path", snapshot_path_);
+		Configure::GetValue(value["snapshot"], "fast_sync", fast_sync_);
+		Configure::GetValue(value["snapshot"], "fast_sync_min_gap", fast_sync_min_gap_);
+		Configure::GetValue(value["snapshot"], "fast_sync_min_peers", fast_sync_min_peers_);
+		Configure::GetValue(value["snapshot"], "trusted_ledger_hash", fast_sync_trusted_hash_);
+		utils::String::ToLower(fast_sync_trusted_hash_);
+		if (!utils::File::IsAbsolute(snapshot_path_)) {
+			snapshot_path_ = utils::String::Format("%s/%s", utils::File::GetBinHome().c_str(), snapshot_path_.c_str());
+		}
 
 		Configure::GetValue(value["tx_pool"], "queue_limit", queue_limit_);
         Configure::GetValue(value["tx_pool"], "queue_per_account_txs_limit", queue_per_account_txs_limit_);
+		Configure::GetValue(value["tx_pool"], "admission_thread_count", admission_thread_count_);
+		Configure::GetValue(value["tx_pool"], "admission_queue_limit", admission_queue_limit_);
 
 		if (validation_privatekey_.empty()) {
 			PrivateKey tmp_priv(SIGNTYPE_ED25519);
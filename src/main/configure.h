@@ -52,6 +52,8 @@ namespace CEG {
 		~WsServerConfigure();
 
 		utils::InetAddress listen_address_;
+		int64_t send_queue_size_;           //Messages waiting for a client, a client over it is disconnected
+		int64_t send_buffer_size_;          //KB handed to the socket of a client before the messages wait in its queue
 
 		bool Load(const Json::Value &value);
 	};
@@ -91,6 +93,26 @@ namespace CEG {
 		uint32_t max_apply_ledger_per_round_;
 		uint32_t queue_limit_;
 		uint32_t queue_per_account_txs_limit_;
+		uint32_t hash_thread_count_;
+		uint32_t trie_cache_size_;
+		uint32_t code_cache_size_;
+		bool code_cache_persist_;
+		uint32_t apply_thread_count_;
+		bool async_commit_;
+		uint32_t sync_thread_count_;
+		uint32_t test_thread_count_;
+		uint32_t sync_requests_per_peer_;
+		uint32_t sync_prefetch_count_;
+		uint32_t snapshot_interval_;
+		uint32_t snapshot_keep_;
+		uint32_t snapshot_chunk_size_;
+		std::string snapshot_path_;
+		bool fast_sync_;
+		uint32_t fast_sync_min_gap_;
+		uint32_t fast_sync_min_peers_;
+		std::string fast_sync_trusted_hash_;
+		uint32_t admission_thread_count_;
+		uint32_t admission_queue_limit_;
 		utils::StringList hardfork_points_;
 		utils::StringList forbid_addrs_;
 		bool use_atom_map_;
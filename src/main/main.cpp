@@ -134,6 +134,9 @@ int main(int argc, char *argv[]){
 			break;
 		}
 		object_exit.Push(std::bind(&utils::Logger::Exit, &logger));
+		if (logger_config.async_ && !logger.StartAsync((size_t)logger_config.async_buffer_size_)) {
+			LOG_ERROR("Failed to start the async logger, the lines are written by the logging threads");
+		}
 		LOG_INFO("Initialized daemon successfully");
 		LOG_INFO("Loaded configure successfully");
 		LOG_INFO("Initialized logger successfully");
@@ -293,29 +296,37 @@ int main(int argc, char *argv[]){
 }
 
 void RunLoop(){
-	int64_t check_module_interval = 5 * utils::MICRO_UNITS_PER_SEC;
-	int64_t last_check_module = 0;
-	while (CEG::g_enable_){
-		int64_t current_time = utils::Timestamp::HighResolution();
-
-		for (auto item : CEG::TimerNotify::notifys_){
-			item->TimerWrapper(utils::Timestamp::HighResolution());
+	CEG::Global &global = CEG::Global::Instance();
+	for (auto item : CEG::TimerNotify::notifys_){
+		global.AddTimer(item->GetCheckInterval(), [item](int64_t current_time) {
+			item->TimerWrapper(current_time);
 			if (item->IsExpire(utils::MICRO_UNITS_PER_SEC)){
 				LOG_WARN("The execution time(" FMT_I64 " us) for the timer(%s) is expired after 1s elapses", item->GetLastExecuteTime(), item->GetTimerName().c_str());
 			}
-		}
+		});
+	}
 
+	int64_t tick = utils::Timer::TICK;
+	global.AddTimer(tick, [](int64_t current_time) {
 		utils::Timer::Instance().OnTimer(current_time);
+	});
+	global.AddTimer(utils::MICRO_UNITS_PER_SEC, [](int64_t current_time) {
 		utils::Logger::Instance().CheckExpiredLog();
-
-		if (current_time - last_check_module > check_module_interval){
-			utils::WriteLockGuard guard(CEG::StatusModule::status_lock_);
-			CEG::StatusModule::GetModulesStatus(*CEG::StatusModule::modules_status_);
-			last_check_module = current_time;
+	});
+	global.AddTimer(5 * utils::MICRO_UNITS_PER_SEC, [](int64_t current_time) {
+		utils::WriteLockGuard guard(CEG::StatusModule::status_lock_);
+		CEG::StatusModule::GetModulesStatus(*CEG::StatusModule::modules_status_);
+	});
+
+	//The signal handlers and the console only clear g_enable_
+	global.AddTimer(100 * utils::MICRO_UNITS_PER_MILLI, [&global](int64_t current_time) {
+		if (!CEG::g_enable_){
+			global.Stop();
 		}
+	});
 
-		utils::Sleep(1);
-	}
+	CEG::SlowTimer::Instance().Start();
+	global.Run();
 }
 
 void SaveWSPort(){    
@@ -15,74 +15,186 @@
 
 #include <json/value.h>
 #include <utils/headers.h>
+#include <utils/random.h>
 #include <common/general.h>
 #include "broadcast.h"
 
 namespace CEG{
-	BroadcastRecord::BroadcastRecord(int64_t type, const std::string &data, int64_t peer_id) {
-		type_ = type;
-		peers_.insert(peer_id);
-		time_stamp_ = utils::Timestamp::HighResolution();
-	}
+	BroadcastRecord::BroadcastRecord() :type_(0), time_stamp_(0) {}
 
 	BroadcastRecord::~BroadcastRecord(){}
 
+	bool BroadcastRecord::HasPeer(int64_t peer_id) const {
+		return std::binary_search(peers_.begin(), peers_.end(), peer_id);
+	}
+
+	void BroadcastRecord::AddPeer(int64_t peer_id) {
+		std::vector<int64_t>::iterator iter = std::lower_bound(peers_.begin(), peers_.end(), peer_id);
+		if (iter == peers_.end() || *iter != peer_id) {
+			peers_.insert(iter, peer_id);
+		}
+	}
+
+	BroadcastRecordTable::BroadcastRecordTable() :slots_(MIN_CAPACITY), size_(0) {}
+
+	BroadcastRecordTable::~BroadcastRecordTable() {}
+
+	size_t BroadcastRecordTable::Locate(const BroadcastDigest &digest) const {
+		size_t mask = slots_.size() - 1;
+		for (size_t i = Home(digest);; i = (i + 1) & mask) {
+			const Slot &slot = slots_[i];
+			if (!slot.used_ || slot.digest_ == digest) {
+				return i;
+			}
+		}
+	}
+
+	void BroadcastRecordTable::Grow() {
+		std::vector<Slot> old_slots(slots_.size() * 2);
+		old_slots.swap(slots_);
+		for (size_t i = 0; i < old_slots.size(); i++) {
+			Slot &slot = old_slots[i];
+			if (slot.used_) {
+				Slot &target = slots_[Locate(slot.digest_)];
+				target.used_ = true;
+				target.digest_ = slot.digest_;
+				std::swap(target.record_, slot.record_);
+			}
+		}
+	}
+
+	BroadcastRecord *BroadcastRecordTable::Find(const BroadcastDigest &digest) {
+		Slot &slot = slots_[Locate(digest)];
+		return slot.used_ ? &slot.record_ : NULL;
+	}
+
+	BroadcastRecord *BroadcastRecordTable::Insert(const BroadcastDigest &digest, bool &inserted) {
+		//Keep the load under one half, so that the probe sequences stay short
+		if ((size_ + 1) * 2 > slots_.size()) {
+			Grow();
+		}
+
+		Slot &slot = slots_[Locate(digest)];
+		inserted = !slot.used_;
+		if (inserted) {
+			slot.used_ = true;
+			slot.digest_ = digest;
+			size_++;
+		}
+		return &slot.record_;
+	}
+
+	void BroadcastRecordTable::Erase(const BroadcastDigest &digest) {
+		size_t mask = slots_.size() - 1;
+		size_t hole = Locate(digest);
+		if (!slots_[hole].used_) {
+			return;
+		}
+
+		//Move back the following records of the probe sequence which can not be found any more past the hole
+		for (size_t i = (hole + 1) & mask; slots_[i].used_; i = (i + 1) & mask) {
+			size_t home = Home(slots_[i].digest_);
+			bool stays = (hole <= i) ? (hole < home && home <= i) : (hole < home || home <= i);
+			if (!stays) {
+				slots_[hole].digest_ = slots_[i].digest_;
+				std::swap(slots_[hole].record_, slots_[i].record_);
+				hole = i;
+			}
+		}
+
+		slots_[hole].used_ = false;
+		slots_[hole].record_ = BroadcastRecord();
+		size_--;
+	}
+
 	Broadcast::Broadcast(IBroadcastDriver *driver)
-		:driver_(driver){}
+		:driver_(driver), duplicate_count_(0){}
 
 	Broadcast::~Broadcast(){}
 
-	bool Broadcast::Add(int64_t type, const std::string &data, int64_t peer_id) {
-		std::string hash = HashWrapper::Crypto(data);
-		utils::MutexGuard guard(mutex_msg_sending_);
-		BroadcastRecordMap::iterator result = records_.find(hash);
-		if (result == records_.end()){ // We have never seen this message
-			BroadcastRecord::pointer record = std::make_shared<BroadcastRecord>(type, data, peer_id);
-			records_[hash] = record;
-			records_couple_[record->time_stamp_] = hash;
-			return true;
-		}
-		else {
-			result->second->peers_.insert(peer_id);
-			return false;
+	BroadcastDigest Broadcast::Digest(const std::string &data) {
+		struct Key {
+			unsigned char bytes_[utils::SipHash::KEY_SIZE];
+			Key() {
+				std::string random;
+				if (!utils::GetStrongRandBytes(random) || random.size() < sizeof(bytes_)) {
+					random = utils::Sha256::Crypto(utils::String::ToString(utils::Timestamp::HighResolution()));
+				}
+				memcpy(bytes_, random.c_str(), sizeof(bytes_));
+			}
+		};
+		static const Key key;
+
+		uint64_t out[2];
+		utils::SipHash::Hash128(key.bytes_, data.c_str(), data.size(), out);
+		BroadcastDigest digest;
+		digest.low_ = out[0];
+		digest.high_ = out[1];
+		return digest;
+	}
+
+	BroadcastRecord *Broadcast::NewRecord(int64_t type, const BroadcastDigest &digest, bool &inserted) {
+		BroadcastRecord *record = records_.Insert(digest, inserted);
+		if (inserted) {
+			record->type_ = type;
+			record->time_stamp_ = utils::Timestamp::HighResolution();
+
+			int64_t start_time = record->time_stamp_ - record->time_stamp_ % BUCKET_TIME;
+			if (expiry_wheel_.empty() || expiry_wheel_.back().start_time_ != start_time) {
+				expiry_wheel_.push_back(ExpiryBucket());
+				expiry_wheel_.back().start_time_ = start_time;
+			}
+			expiry_wheel_.back().digests_.push_back(digest);
 		}
+		return record;
+	}
 
-		return true;
+	void Broadcast::DropOldestBucket() {
+		const std::vector<BroadcastDigest> &digests = expiry_wheel_.front().digests_;
+		for (size_t i = 0; i < digests.size(); i++) {
+			records_.Erase(digests[i]);
+		}
+		expiry_wheel_.pop_front();
 	}
 
-	bool Broadcast::IsQueued(int64_t type, const std::string &data) {
-		std::string hash = HashWrapper::Crypto(data);
+	bool Broadcast::Add(int64_t type, const BroadcastDigest &digest, int64_t peer_id) {
 		utils::MutexGuard guard(mutex_msg_sending_);
-		BroadcastRecordMap::iterator result = records_.find(hash);
-		return result != records_.end();
+		bool inserted = false;
+		BroadcastRecord *record = NewRecord(type, digest, inserted);
+		record->AddPeer(peer_id);
+		if (!inserted) {
+			duplicate_count_++;
+		}
+		return inserted;
 	}
 
-	void Broadcast::Send(int64_t type, const std::string &data) {
-		std::string hash = HashWrapper::Crypto(data);
+	bool Broadcast::IsQueued(int64_t type, const BroadcastDigest &digest) {
 		utils::MutexGuard guard(mutex_msg_sending_);
-		BroadcastRecordMap::iterator result = records_.find(hash);
-		if (result == records_.end()){ // No one has sent us this message
-			BroadcastRecord::pointer record = std::make_shared<BroadcastRecord>(
-				type, data, 0);
-
-			records_[hash] = record;
-			records_couple_[record->time_stamp_] = hash;
-			std::set<int64_t> peer_ids = driver_->GetActivePeerIds();
-			for (const auto peer_id : peer_ids)
-			{
-				driver_->SendRequest(peer_id, type, data);
-				record->peers_.insert(peer_id);
+		return records_.Find(digest) != NULL;
+	}
+
+	void Broadcast::Send(int64_t type, const BroadcastDigest &digest, const std::string &data) {
+		std::set<int64_t> active_ids = driver_->GetActivePeerIds();
+		std::vector<int64_t> peer_ids;
+		do {
+			utils::MutexGuard guard(mutex_msg_sending_);
+			bool inserted = false;
+			BroadcastRecord *record = NewRecord(type, digest, inserted);
+			if (inserted) { // No one has sent us this message
+				record->AddPeer(0);
 			}
-		}
-		else{ // Send it to people who haven't sent it to us
-			std::set<int64_t>& peersTold = result->second->peers_;
-			for (const auto peer : driver_->GetActivePeerIds()){
-				if (peersTold.find(peer) == peersTold.end())
-				{
-					driver_->SendRequest(peer, type, data);
-					result->second->peers_.insert(peer);
+
+			// Send it to people who haven't sent it to us
+			for (std::set<int64_t>::const_iterator iter = active_ids.begin(); iter != active_ids.end(); iter++) {
+				if (!record->HasPeer(*iter)) {
+					peer_ids.push_back(*iter);
+					record->AddPeer(*iter);
 				}
 			}
+		} while (false);
+
+		if (!peer_ids.empty()) {
+			driver_->SendRequests(peer_ids, type, data);
 		}
 	}
 
@@ -90,34 +202,27 @@ namespace CEG{
 		utils::MutexGuard guard(mutex_msg_sending_);
 		int64_t current_time = utils::Timestamp::HighResolution();
 
-		for (auto it = records_couple_.begin(); it != records_couple_.end();){
-			// Give one ledger of leeway
-			if (it->first + 3600 * utils::MICRO_UNITS_PER_SEC < current_time)
-			{
-				records_.erase(it->second);
-				records_couple_.erase(it++);
-			}
-			else
-			{
-				break;
-			}
+		while (!expiry_wheel_.empty() && expiry_wheel_.front().start_time_ + BUCKET_TIME + RECORD_TIMEOUT < current_time) {
+			DropOldestBucket();
 		}
 
-		size_t max_size = 1000 * 1000;
-		if (records_couple_.size() > max_size) {
-			size_t i = 0;
-			for (auto it = records_couple_.begin(); it != records_couple_.end();) {
-
-				if (i < max_size / 2) {
-					records_.erase(it->second);
-					records_couple_.erase(it++);
-					i++;
-				}
-				else {
-					break;
-				}
+		if (records_.Size() > MAX_RECORD_SIZE) {
+			while (!expiry_wheel_.empty() && records_.Size() > MAX_RECORD_SIZE / 2) {
+				DropOldestBucket();
 			}
-		} 
+		}
+	}
 
+	size_t Broadcast::GetRecordSize() {
+		utils::MutexGuard guard(mutex_msg_sending_);
+		return records_.Size();
+	}
+
+	void Broadcast::GetModuleStatus(Json::Value &data) {
+		utils::MutexGuard guard(mutex_msg_sending_);
+		data["broad_record_size"] = (Json::UInt64)records_.Size();
+		data["broad_table_capacity"] = (Json::UInt64)records_.Capacity();
+		data["broad_expiry_buckets"] = (Json::UInt64)expiry_wheel_.size();
+		data["broad_duplicate_count"] = duplicate_count_;
 	}
 }
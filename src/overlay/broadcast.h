@@ -16,7 +16,8 @@
 #ifndef BROADCAST_H_
 #define BROADCAST_H_
 
-#include <unordered_map>
+#include <deque>
+#include <vector>
 namespace CEG{
 
 	class IBroadcastDriver{
@@ -26,40 +27,101 @@ namespace CEG{
 
 		//Virtual bool SendMessage(int64_t peer_id, WsMessagePointer msg) = 0;
 		virtual bool SendRequest(int64_t peer_id, int64_t type, const std::string &data) = 0;
+		//Send the same request to several peers, the message is serialized once for all of them
+		virtual size_t SendRequests(const std::vector<int64_t> &peer_ids, int64_t type, const std::string &data) = 0;
 		virtual std::set<int64_t> GetActivePeerIds() = 0;
 	};
 
+	//Fixed size key of a broadcast message, the keyed SipHash-128 of its payload.
+	//The key is random for each process, so the peers can not make messages collide.
+	//The dedup is local to the node, the consensus keeps hashing the messages with HashWrapper.
+	struct BroadcastDigest {
+		uint64_t low_;
+		uint64_t high_;
+
+		BroadcastDigest() :low_(0), high_(0) {}
+		bool operator==(const BroadcastDigest &other) const {
+			return low_ == other.low_ && high_ == other.high_;
+		}
+	};
+
 	class BroadcastRecord{
 	public:
-		typedef std::shared_ptr<BroadcastRecord> pointer;
-
-		BroadcastRecord(int64_t type, const std::string &data, int64_t);
+		BroadcastRecord();
 		~BroadcastRecord();
 
 		int64_t type_;
 		int64_t time_stamp_;
-		std::set<int64_t> peers_;
+		//Sorted, a message is known by a few peers
+		std::vector<int64_t> peers_;
+
+		bool HasPeer(int64_t peer_id) const;
+		void AddPeer(int64_t peer_id);
 	};
 
-	typedef std::map<int64_t, std::string> BroadcastRecordCoupleMap;
-	typedef std::unordered_map<std::string, BroadcastRecord::pointer> BroadcastRecordMap;
+	//Open addressing table of the broadcast records, with linear probing and backward shift deletion
+	class BroadcastRecordTable {
+		struct Slot {
+			Slot() :used_(false) {}
+			bool used_;
+			BroadcastDigest digest_;
+			BroadcastRecord record_;
+		};
+
+		std::vector<Slot> slots_;
+		size_t size_;
+
+		static const size_t MIN_CAPACITY = 1024;
+
+		size_t Home(const BroadcastDigest &digest) const { return (size_t)digest.low_ & (slots_.size() - 1); }
+		size_t Locate(const BroadcastDigest &digest) const;
+		void Grow();
+	public:
+		BroadcastRecordTable();
+		~BroadcastRecordTable();
+
+		BroadcastRecord *Find(const BroadcastDigest &digest);
+		//Return the record of the digest, inserted is true if it was absent
+		BroadcastRecord *Insert(const BroadcastDigest &digest, bool &inserted);
+		void Erase(const BroadcastDigest &digest);
+		size_t Size() const { return size_; }
+		size_t Capacity() const { return slots_.size(); }
+	};
 
 	class Broadcast {
 	private:
-		BroadcastRecordCoupleMap    records_couple_;
-		BroadcastRecordMap records_;
+		//Expiry wheel, the digests added in each period of BUCKET_TIME, oldest first
+		struct ExpiryBucket {
+			int64_t start_time_;
+			std::vector<BroadcastDigest> digests_;
+		};
+
+		BroadcastRecordTable records_;
+		std::deque<ExpiryBucket> expiry_wheel_;
 		utils::Mutex mutex_msg_sending_;
 		IBroadcastDriver *driver_;
+		int64_t duplicate_count_;
+
+		//Give one ledger of leeway
+		static const int64_t RECORD_TIMEOUT = 3600 * utils::MICRO_UNITS_PER_SEC;
+		static const int64_t BUCKET_TIME = 60 * utils::MICRO_UNITS_PER_SEC;
+		static const size_t MAX_RECORD_SIZE = 1000 * 1000;
 
+		BroadcastRecord *NewRecord(int64_t type, const BroadcastDigest &digest, bool &inserted);
+		void DropOldestBucket();
 	public:
 		Broadcast(IBroadcastDriver *driver);
 		~Broadcast();
 
-		bool Add(int64_t type, const std::string &data, int64_t peer_id);
-		void Send(int64_t type, const std::string &data);
-		bool IsQueued(int64_t type, const std::string &data);
+		//Hash a message once, and pass the digest to the functions below
+		static BroadcastDigest Digest(const std::string &data);
+
+		bool Add(int64_t type, const BroadcastDigest &digest, int64_t peer_id);
+		void Send(int64_t type, const BroadcastDigest &digest, const std::string &data);
+		bool IsQueued(int64_t type, const BroadcastDigest &digest);
 		void OnTimer();
-		size_t GetRecordSize() const { return records_.size(); };
+		size_t GetRecordSize();
+		void GetModuleStatus(Json::Value &data);
 	};
 };
 
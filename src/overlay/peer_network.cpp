@@ -43,10 +43,12 @@ namespace CEG {
 		request_methods_[protocol::OVERLAY_MSGTYPE_LEDGERS] = std::bind(&PeerNetwork::OnMethodGetLedgers, this, std::placeholders::_1, std::placeholders::_2);
 		request_methods_[protocol::OVERLAY_MSGTYPE_PBFT] = std::bind(&PeerNetwork::OnMethodPbft, this, std::placeholders::_1, std::placeholders::_2);
 		request_methods_[protocol::OVERLAY_MSGTYPE_LEDGER_UPGRADE_NOTIFY] = std::bind(&PeerNetwork::OnMethodLedgerUpNotify, this, std::placeholders::_1, std::placeholders::_2);
+		request_methods_[OVERLAY_MSGTYPE_SNAPSHOT] = std::bind(&PeerNetwork::OnMethodGetSnapshot, this, std::placeholders::_1, std::placeholders::_2);
 
 
 		response_methods_[protocol::OVERLAY_MSGTYPE_LEDGERS] = std::bind(&PeerNetwork::OnMethodLedgers, this, std::placeholders::_1, std::placeholders::_2);
 		response_methods_[protocol::OVERLAY_MSGTYPE_HELLO] = std::bind(&PeerNetwork::OnMethodHelloResponse, this, std::placeholders::_1, std::placeholders::_2);
+		response_methods_[OVERLAY_MSGTYPE_SNAPSHOT] = std::bind(&PeerNetwork::OnMethodSnapshot, this, std::placeholders::_1, std::placeholders::_2);
 		last_update_peercache_time_ = 0;
 	}
 
@@ -205,7 +207,7 @@ namespace CEG {
 
 				//Asynchronously send peers
 				int64_t peer_id = peer->GetId();
-				Global::GetInstance()->GetIoService().post([peer_id, this] {
+				Global::GetInstance()->Post([peer_id, this] {
 					//Send the local peer list
 					GetActivePeers(50);
 
@@ -243,7 +245,8 @@ namespace CEG {
 			return false;
 		}
 
-		if (broadcast_.IsQueued(protocol::OVERLAY_MSGTYPE_TRANSACTION, message.data())) {
+		BroadcastDigest digest = Broadcast::Digest(message.data());
+		if (broadcast_.IsQueued(protocol::OVERLAY_MSGTYPE_TRANSACTION, digest)) {
 			LOG_TRACE("Failed to process the peer transaction message.The transaction has been broadcast, from connection id (" FMT_I64 ")", conn_id);
 			return true;
 		}
@@ -255,19 +258,31 @@ namespace CEG {
 			return false;
 		}
 
-		TransactionFrm::pointer tran_ptr = std::make_shared<TransactionFrm>(tran);
-		//Switch to main thread
-		Global::Instance().GetIoService().post([tran_ptr, message, this, conn_id]() {
-			Result ig_err;
-			if (GlueManager::Instance().OnTransaction(tran_ptr, ig_err)) {
-				ReceiveBroadcastMsg(protocol::OVERLAY_MSGTYPE_TRANSACTION, message.data(), conn_id);
-				BroadcastMsg(message.type(), message.data());
-			}
-		});
+		//The flush runs in the same poll of the network thread, after the other received messages
+		if (pending_txs_.empty()) {
+			io_.post(std::bind(&PeerNetwork::FlushPendingTransactions, this));
+		}
 
+		pending_txs_.push_back(AdmissionItem());
+		AdmissionItem &item = pending_txs_.back();
+		item.env_.Swap(&tran);
+		item.notify_ = [message, digest, this, conn_id](TransactionFrm::pointer tran_ptr, const Result &result) {
+			if (result.code() == protocol::ERRCODE_SUCCESS) {
+				ReceiveBroadcastMsg(protocol::OVERLAY_MSGTYPE_TRANSACTION, digest, conn_id);
+				BroadcastMsg(message.type(), digest, message.data());
+			}
+		};
 		return true;
 	}
 
+	void PeerNetwork::FlushPendingTransactions() {
+		size_t size = pending_txs_.size();
+		if (!GlueManager::Instance().SubmitTransactions(pending_txs_)) {
+			LOG_TRACE("Dropped " FMT_SIZE " peer transactions, the admission queue is full", size);
+		}
+		pending_txs_.clear();
+	}
+
 	bool PeerNetwork::OnMethodGetLedgers(protocol::WsMessage &message, int64_t conn_id) {
 		protocol::GetLedgers getledgers;
 		getledgers.ParseFromString(message.data());
@@ -282,6 +297,20 @@ namespace CEG {
 		return true;
 	}
 
+	bool PeerNetwork::OnMethodGetSnapshot(protocol::WsMessage &message, int64_t conn_id) {
+		protocol::GetLedgers request;
+		request.ParseFromString(message.data());
+		LedgerManager::Instance().snapshot_manager_.OnRequest(request, conn_id);
+		return true;
+	}
+
+	bool PeerNetwork::OnMethodSnapshot(protocol::WsMessage &message, int64_t conn_id) {
+		protocol::EntryList response;
+		response.ParseFromString(message.data());
+		LedgerManager::Instance().snapshot_manager_.OnResponse(response, conn_id);
+		return true;
+	}
+
 	bool PeerNetwork::OnMethodHelloResponse(protocol::WsMessage &message, int64_t conn_id) {
 		utils::MutexGuard guard(conns_list_lock_);
 		Peer *peer = (Peer *)GetConnection(conn_id);
@@ -325,17 +354,18 @@ namespace CEG {
 			hash.c_str(), msg.GetNodeAddress(), msg.GetSeq(),
 			PbftDesc::GetMessageTypeDesc(msg.GetPbft().pbft().type()), msg.GetSize());
 
-		if (broadcast_.IsQueued(protocol::OVERLAY_MSGTYPE_PBFT, message.data())) {
+		BroadcastDigest digest = Broadcast::Digest(message.data());
+		if (broadcast_.IsQueued(protocol::OVERLAY_MSGTYPE_PBFT, digest)) {
 			LOG_TRACE("Duplicate consensus transaction in the broadcast queue.Received from connection id(" FMT_I64 ")", conn_id);
 			return true;
 		}
 
 		//Switch to main thread
-		Global::Instance().GetIoService().post([msg, message, hash, this, conn_id]() {
+		Global::Instance().Post([msg, message, digest, hash, this, conn_id]() {
 				LOG_TRACE("Pbft hash(%s) would be processed", hash.c_str());
 				if (GlueManager::Instance().OnConsensus(msg)) {
-					ReceiveBroadcastMsg(protocol::OVERLAY_MSGTYPE_PBFT, message.data(), conn_id);
-					BroadcastMsg(protocol::OVERLAY_MSGTYPE_PBFT, message.data());
+					ReceiveBroadcastMsg(protocol::OVERLAY_MSGTYPE_PBFT, digest, conn_id);
+					BroadcastMsg(protocol::OVERLAY_MSGTYPE_PBFT, digest, message.data());
 				}
 				else {
 					LOG_TRACE("Failed to deal with pbft consensus, which hash is(%s)  ", hash.c_str());
@@ -361,8 +391,9 @@ namespace CEG {
 		}
 
 		LOG_INFO("Received a ledger up notify message: (%s)", Proto2Json(notify).toFastString().c_str());
-		if (ReceiveBroadcastMsg(protocol::OVERLAY_MSGTYPE_LEDGER_UPGRADE_NOTIFY, message.data(), conn_id)) {
-			BroadcastMsg(protocol::OVERLAY_MSGTYPE_LEDGER_UPGRADE_NOTIFY, message.data());
+		BroadcastDigest digest = Broadcast::Digest(message.data());
+		if (ReceiveBroadcastMsg(protocol::OVERLAY_MSGTYPE_LEDGER_UPGRADE_NOTIFY, digest, conn_id)) {
+			BroadcastMsg(protocol::OVERLAY_MSGTYPE_LEDGER_UPGRADE_NOTIFY, digest, message.data());
 			GlueManager::Instance().OnRecvLedgerUpMsg(notify);
 		}
 		return true;
@@ -831,11 +862,15 @@ namespace CEG {
 	}
 
 	void PeerNetwork::BroadcastMsg(int64_t type, const std::string &data) {
-		broadcast_.Send(type, data);
+		broadcast_.Send(type, Broadcast::Digest(data), data);
+	}
+
+	void PeerNetwork::BroadcastMsg(int64_t type, const BroadcastDigest &digest, const std::string &data) {
+		broadcast_.Send(type, digest, data);
 	}
 
-	bool PeerNetwork::ReceiveBroadcastMsg(int64_t type, const std::string &data, int64_t peer_id) {
-		return broadcast_.Add(type, data, peer_id);
+	bool PeerNetwork::ReceiveBroadcastMsg(int64_t type, const BroadcastDigest &digest, int64_t peer_id) {
+		return broadcast_.Add(type, digest, peer_id);
 	}
 
 	bool PeerNetwork::SendMsgToPeer(int64_t peer_id, WsMessagePointer message) {
@@ -858,6 +893,27 @@ namespace CEG {
 		return false;
 	}
 
+	size_t PeerNetwork::SendRequests(const std::vector<int64_t> &peer_ids, int64_t type, const std::string &data) {
+		//The sequence of a request is only echoed by its response, and the broadcast messages have none.
+		//So every peer gets the same bytes, serialized once.
+		protocol::WsMessage message;
+		message.set_type(type);
+		message.set_request(true);
+		message.set_data(data);
+		std::string buffer = message.SerializeAsString();
+
+		size_t sent = 0;
+		utils::MutexGuard guard(conns_list_lock_);
+		for (size_t i = 0; i < peer_ids.size(); i++) {
+			Peer *peer = (Peer *)GetConnection(peer_ids[i]);
+			if (peer && peer->IsActive() && peer->SendByteMessage(buffer, last_ec_)) {
+				sent++;
+			}
+		}
+
+		return sent;
+	}
+
 	std::set<int64_t> PeerNetwork::GetActivePeerIds() {
 		std::set<int64_t> ids;
 		utils::MutexGuard guard(conns_list_lock_);
@@ -891,7 +947,7 @@ namespace CEG {
 		} while (false);
 		data["peer_cache_size"] = (Json::UInt64)db_peer_cache_.peers_size();
 		data["recv_peerlist_size"] = (Json::UInt64)received_peer_list_.size();
-		data["broad_record_size"] = (Json::UInt64)broadcast_.GetRecordSize();
+		broadcast_.GetModuleStatus(data);
 		int active_size = 0;
 		Json::Value peers;
 		do {
@@ -21,6 +21,7 @@
 #include <common/general.h>
 #include <common/private_key.h>
 #include <common/network.h>
+#include <glue/transaction_admission.h>
 #include "peer.h"
 #include "broadcast.h"
 
@@ -60,6 +61,10 @@ namespace CEG {
 		std::error_code last_ec_;
 		int64_t last_update_peercache_time_;
 
+		//Transactions received in one network poll, handed to the admission workers as one batch
+		std::vector<AdmissionItem> pending_txs_;
+		void FlushPendingTransactions();
+
 		void Clean();
 
  		bool ResolveSeeds(const utils::StringList &address_list, int32_t rank);
@@ -77,6 +82,8 @@ namespace CEG {
 		bool OnMethodTransaction(protocol::WsMessage &message, int64_t conn_id);
 		bool OnMethodGetLedgers(protocol::WsMessage &message, int64_t conn_id);
 		bool OnMethodLedgers(protocol::WsMessage &message, int64_t conn_id);
+		bool OnMethodGetSnapshot(protocol::WsMessage &message, int64_t conn_id);
+		bool OnMethodSnapshot(protocol::WsMessage &message, int64_t conn_id);
 		bool OnMethodPbft(protocol::WsMessage &message, int64_t conn_id);
 		bool OnMethodLedgerUpNotify(protocol::WsMessage &message, int64_t conn_id);
 		bool OnMethodHelloResponse(protocol::WsMessage &message, int64_t conn_id);
@@ -102,7 +109,8 @@ namespace CEG {
 
 		void AddReceivedPeers(const utils::StringMap &item);
 		void BroadcastMsg(int64_t type, const std::string &data);
-		bool ReceiveBroadcastMsg(int64_t type, const std::string &data, int64_t peer_id);
+		void BroadcastMsg(int64_t type, const BroadcastDigest &digest, const std::string &data);
+		bool ReceiveBroadcastMsg(int64_t type, const BroadcastDigest &digest, int64_t peer_id);
 
 		void GetPeers(Json::Value &peers);
 
@@ -112,6 +120,7 @@ namespace CEG {
 
 		virtual bool SendMsgToPeer(int64_t peer_id, WsMessagePointer msg);
 		virtual bool SendRequest(int64_t peer_id, int64_t type, const std::string &data);
+		virtual size_t SendRequests(const std::vector<int64_t> &peer_ids, int64_t type, const std::string &data);
 		virtual std::set<int64_t> GetActivePeerIds();
 
 		bool NodeExist(std::string node_address, int64_t peer_id);
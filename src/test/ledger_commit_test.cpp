@@ -0,0 +1,132 @@
+﻿/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include <signal.h>
+#include <gtest/gtest.h>
+#include <utils/file.h>
+#include <common/storage.h>
+#include <ledger/ledger_frm.h>
+#include <ledger/ledger_manager.h>
+
+namespace CEG {
+	class LedgerCommitTest : public testing::Test {
+	protected:
+		virtual void SetUp() {
+			//The child of a death test runs the test again from the beginning, so the path does not depend on the process
+			//and the parent writes nothing before the child is started
+			std::string test_home = utils::String::Format("%s/CEG_test", utils::File::GetTempDirectory().c_str());
+			root_ = utils::String::Format("%s/%s", test_home.c_str(), testing::UnitTest::GetInstance()->current_test_info()->name());
+			utils::File::DeleteFolder(root_);
+			utils::File::CreateDir(test_home);
+			utils::File::CreateDir(root_);
+
+			db_config_.keyvalue_db_path_ = root_ + "/keyvalue.db";
+			db_config_.ledger_db_path_ = root_ + "/ledger.db";
+			db_config_.account_db_path_ = root_ + "/account.db";
+		}
+
+		virtual void TearDown() {
+			Storage::Instance().Exit();
+			utils::File::DeleteFolder(root_);
+		}
+
+		//Write the databases in the order of LedgerManager::CommitLedger, and stop after the given number of batches
+		void CommitLedger(int64_t seq, int32_t written_batches) {
+			LedgerFrm ledger;
+			ledger.ProtoLedger().mutable_header()->set_seq(seq);
+
+			WRITE_BATCH ledger_db_batch;
+			ledger.PrepareDbBatch(ledger_db_batch);
+			WRITE_BATCH account_db_batch;
+			account_db_batch.Put(General::KEY_LEDGER_SEQ, utils::String::ToString(seq));
+
+			if (written_batches > 0) {
+				Storage::Instance().ledger_db()->WriteBatch(ledger_db_batch);
+			}
+			if (written_batches > 1) {
+				Storage::Instance().account_db()->WriteBatch(account_db_batch);
+			}
+		}
+
+		//Close ledger 1 completely, then kill the process while ledger 2 is being committed
+		void KillWhileCommitting(int32_t written_batches) {
+			if (!Storage::Instance().Initialize(db_config_, false)) {
+				exit(1);
+			}
+			CommitLedger(1, 2);
+			CommitLedger(2, written_batches);
+			raise(SIGKILL);
+		}
+
+		std::string LedgerDbSeq() {
+			std::string seq;
+			Storage::Instance().ledger_db()->Get(General::KEY_LEDGER_SEQ, seq);
+			return seq;
+		}
+
+		std::string AccountDbSeq() {
+			std::string seq;
+			Storage::Instance().account_db()->Get(General::KEY_LEDGER_SEQ, seq);
+			return seq;
+		}
+
+		std::string root_;
+		DbConfigure db_config_;
+	};
+
+	TEST_F(LedgerCommitTest, EmptyDatabases) {
+		ASSERT_TRUE(Storage::Instance().Initialize(db_config_, false));
+		EXPECT_TRUE(LedgerManager::CheckAndRepairLedgerSeq());
+	}
+
+	TEST_F(LedgerCommitTest, KilledBeforeLedgerDb) {
+		EXPECT_EXIT(KillWhileCommitting(0), testing::KilledBySignal(SIGKILL), "");
+
+		ASSERT_TRUE(Storage::Instance().Initialize(db_config_, false));
+		EXPECT_TRUE(LedgerManager::CheckAndRepairLedgerSeq());
+		EXPECT_EQ("1", LedgerDbSeq());
+		EXPECT_EQ("1", AccountDbSeq());
+	}
+
+	TEST_F(LedgerCommitTest, KilledBetweenLedgerDbAndAccountDb) {
+		EXPECT_EXIT(KillWhileCommitting(1), testing::KilledBySignal(SIGKILL), "");
+
+		ASSERT_TRUE(Storage::Instance().Initialize(db_config_, false));
+		ASSERT_EQ("2", LedgerDbSeq());
+		ASSERT_EQ("1", AccountDbSeq());
+
+		EXPECT_TRUE(LedgerManager::CheckAndRepairLedgerSeq());
+		EXPECT_EQ("1", LedgerDbSeq());
+		EXPECT_EQ("1", AccountDbSeq());
+	}
+
+	TEST_F(LedgerCommitTest, KilledAfterAccountDb) {
+		EXPECT_EXIT(KillWhileCommitting(2), testing::KilledBySignal(SIGKILL), "");
+
+		ASSERT_TRUE(Storage::Instance().Initialize(db_config_, false));
+		EXPECT_TRUE(LedgerManager::CheckAndRepairLedgerSeq());
+		EXPECT_EQ("2", LedgerDbSeq());
+		EXPECT_EQ("2", AccountDbSeq());
+	}
+
+	TEST_F(LedgerCommitTest, LedgerDbTooFarAhead) {
+		ASSERT_TRUE(Storage::Instance().Initialize(db_config_, false));
+		ASSERT_TRUE(Storage::Instance().ledger_db()->Put(General::KEY_LEDGER_SEQ, "3"));
+		ASSERT_TRUE(Storage::Instance().account_db()->Put(General::KEY_LEDGER_SEQ, "1"));
+
+		EXPECT_FALSE(LedgerManager::CheckAndRepairLedgerSeq());
+		EXPECT_EQ("3", LedgerDbSeq());
+	}
+}
@@ -0,0 +1,45 @@
+﻿/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include <gtest/gtest.h>
+#include <utils/logger.h>
+#include <common/storage.h>
+#include <main/configure.h>
+#include <ledger/ledger_manager.h>
+
+int main(int argc, char *argv[]) {
+	testing::InitGoogleTest(&argc, argv);
+
+	//The death tests write the databases in a child process, the threads of the parent are not forked
+	testing::FLAGS_gtest_death_test_style = "threadsafe";
+
+	CEG::Configure::InitInstance();
+	CEG::Storage::InitInstance();
+	CEG::Global::InitInstance();
+	utils::Logger::InitInstance();
+	utils::Logger::Instance().Initialize(utils::LOG_DEST_ERR, utils::LOG_LEVEL_ALL, "", true);
+	CEG::LedgerManager::InitInstance();
+	CEG::Global::Instance().Initialize();
+
+	int ret = RUN_ALL_TESTS();
+
+	CEG::LedgerManager::ExitInstance();
+	utils::Logger::Instance().Exit();
+	utils::Logger::ExitInstance();
+	CEG::Global::ExitInstance();
+	CEG::Storage::ExitInstance();
+	CEG::Configure::ExitInstance();
+	return ret;
+}
@@ -0,0 +1,169 @@
+﻿/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include <gtest/gtest.h>
+#include <utils/file.h>
+#include <common/storage.h>
+#include <common/private_key.h>
+#include <main/configure.h>
+#include <ledger/ledger_manager.h>
+#include <ledger/ledgercontext_manager.h>
+#include <ledger/parallel_apply.h>
+
+namespace CEG {
+	class ParallelApplyTest : public testing::Test {
+	protected:
+		static const int32_t ACCOUNT_COUNT = 32;
+		static const int64_t GAS_PRICE = 1000;
+		static const int64_t BASE_RESERVE = 10000000;
+		static const int64_t FEE_LIMIT = 10000000;
+		static const int64_t INIT_BALANCE = 100000000000;
+
+		virtual void SetUp() {
+			std::string test_home = utils::String::Format("%s/CEG_test", utils::File::GetTempDirectory().c_str());
+			root_ = utils::String::Format("%s/%s", test_home.c_str(), testing::UnitTest::GetInstance()->current_test_info()->name());
+			utils::File::DeleteFolder(root_);
+			utils::File::CreateDir(test_home);
+			utils::File::CreateDir(root_);
+
+			for (int32_t i = 0; i < ACCOUNT_COUNT; i++) {
+				keys_.push_back(std::make_shared<PrivateKey>(SIGNTYPE_ED25519));
+			}
+			genesis_key_ = std::make_shared<PrivateKey>(SIGNTYPE_ED25519);
+			PrivateKey validator_key(SIGNTYPE_ED25519);
+
+			//The apply pool starts empty, the values are executed serially first
+			Configure &config = Configure::Instance();
+			config.db_configure_.keyvalue_db_path_ = root_ + "/keyvalue.db";
+			config.db_configure_.ledger_db_path_ = root_ + "/ledger.db";
+			config.db_configure_.account_db_path_ = root_ + "/account.db";
+			config.ledger_configure_.apply_thread_count_ = 0;
+			config.ledger_configure_.snapshot_path_ = root_ + "/snapshot";
+			config.genesis_configure_.account_ = genesis_key_->GetEncAddress();
+			config.genesis_configure_.validators_.clear();
+			config.genesis_configure_.validators_.push_back(validator_key.GetEncAddress());
+			config.genesis_configure_.chain_id_ = 0;
+			config.genesis_configure_.fees_.gas_price_ = GAS_PRICE;
+			config.genesis_configure_.fees_.base_reserve_ = BASE_RESERVE;
+
+			ASSERT_TRUE(Storage::Instance().Initialize(config.db_configure_, false));
+			ASSERT_TRUE(LedgerManager::Instance().Initialize());
+		}
+
+		virtual void TearDown() {
+			LedgerManager::Instance().Exit();
+			Storage::Instance().Exit();
+			utils::File::DeleteFolder(root_);
+		}
+
+		//Put the accounts into the state of the last closed ledger, the way the genesis account is created
+		void CreateAccounts() {
+			LedgerManager &manager = LedgerManager::Instance();
+			utils::WriteLockGuard guard(manager.GetTreeMutex());
+			for (size_t i = 0; i < keys_.size(); i++) {
+				AccountFrm::pointer account = AccountFrm::CreatAccountFrm(keys_[i]->GetEncAddress(), INIT_BALANCE);
+				manager.tree_->Set(DecodeAddress(account->GetAccountAddress()), account->Serializer());
+			}
+			manager.tree_->UpdateHash();
+			ASSERT_TRUE(manager.tree_->AddToDB());
+		}
+
+		void AddPayCoin(protocol::ConsensusValue &value, const PrivateKey &key, int64_t nonce, const std::string &dest_address, int64_t amount) {
+			protocol::TransactionEnv *tran_env = value.mutable_txset()->add_txs();
+			protocol::Transaction *tran = tran_env->mutable_transaction();
+			tran->set_source_address(key.GetEncAddress());
+			tran->set_fee_limit(FEE_LIMIT);
+			tran->set_gas_price(GAS_PRICE);
+			tran->set_nonce(nonce);
+			tran->set_chain_id(General::GetSelfChainId());
+			protocol::Operation *ope = tran->add_operations();
+			ope->set_type(protocol::Operation_Type_PAY_COIN);
+			ope->mutable_pay_coin()->set_amount(amount);
+			ope->mutable_pay_coin()->set_dest_address(dest_address);
+
+			protocol::Signature *signpro = tran_env->add_signatures();
+			signpro->set_sign_data(key.Sign(tran->SerializeAsString()));
+			signpro->set_public_key(key.GetEncPublicKey());
+		}
+
+		//Execute the value on the last closed ledger and hash its changes in a trie of their own, the state is not changed
+		std::string Apply(const protocol::ConsensusValue &value, std::vector<int32_t> &error_codes) {
+			LedgerContext ledger_context(HashWrapper::Crypto(value.SerializeAsString()), value);
+			ledger_context.Do();
+			LedgerFrm::pointer closing_ledger = ledger_context.closing_ledger_;
+			EXPECT_TRUE(ledger_context.propose_result_.exec_result_);
+
+			error_codes.clear();
+			for (size_t i = 0; i < closing_ledger->apply_tx_frms_.size(); i++) {
+				error_codes.push_back(closing_ledger->apply_tx_frms_[i]->GetResult().code());
+			}
+
+			KVTrie trie;
+			trie.Init(Storage::Instance().account_db(), std::make_shared<WRITE_BATCH>(), General::ACCOUNT_PREFIX, 4);
+			int64_t new_count = 0, change_count = 0;
+			closing_ledger->Commit(&trie, new_count, change_count);
+			trie.UpdateHash();
+			return trie.GetRootHash();
+		}
+
+		std::string root_;
+		std::shared_ptr<PrivateKey> genesis_key_;
+		std::vector<std::shared_ptr<PrivateKey> > keys_;
+	};
+
+	TEST_F(ParallelApplyTest, SameStateAsSerial) {
+		CreateAccounts();
+
+		protocol::LedgerHeader lcl = LedgerManager::Instance().GetLastClosedLedger();
+		protocol::ConsensusValue value;
+		value.set_ledger_seq(lcl.seq() + 1);
+		value.set_close_time(lcl.close_time() + 1);
+		value.set_previous_ledger_hash(lcl.hash());
+
+		//Independent payments to new accounts, adopted from the speculations
+		std::vector<std::shared_ptr<PrivateKey> > dests;
+		for (int32_t i = 0; i < ACCOUNT_COUNT; i++) {
+			dests.push_back(std::make_shared<PrivateKey>(SIGNTYPE_ED25519));
+			AddPayCoin(value, *keys_[i], 1, dests[i]->GetEncAddress(), BASE_RESERVE * 2);
+		}
+
+		//Payments which read the accounts changed above, executed again serially
+		for (int32_t i = 0; i < 8; i++) {
+			AddPayCoin(value, *keys_[i], 2, keys_[i + 8]->GetEncAddress(), BASE_RESERVE);
+		}
+
+		//A payment which fails, with the same error in both runs
+		AddPayCoin(value, *keys_[16], 2, dests[0]->GetEncAddress(), INIT_BALANCE * 2);
+
+		std::vector<int32_t> serial_codes;
+		std::string serial_hash = Apply(value, serial_codes);
+
+		ASSERT_TRUE(LedgerManager::Instance().apply_pool_.Init("tx-apply", 4));
+		Json::Value before;
+		ParallelApplier::GetModuleStatus(before);
+
+		std::vector<int32_t> parallel_codes;
+		std::string parallel_hash = Apply(value, parallel_codes);
+
+		Json::Value after;
+		ParallelApplier::GetModuleStatus(after);
+		EXPECT_GT(after["adopted"].asInt64(), before["adopted"].asInt64());
+		EXPECT_GT(after["conflicted"].asInt64(), before["conflicted"].asInt64());
+
+		EXPECT_EQ(serial_codes, parallel_codes);
+		EXPECT_NE((int32_t)protocol::ERRCODE_SUCCESS, serial_codes.back());
+		EXPECT_EQ(utils::String::BinToHexString(serial_hash), utils::String::BinToHexString(parallel_hash));
+	}
+}
@@ -101,7 +101,8 @@ namespace utils
 					return false;
 				}
 
-				//can't be assigned directly, because itData->second.ptr_ is smart pointer
+				//can't be assigned directly, because itData->second.ptr_ is smart pointer.
+				//The copy is shallow for values which share their unchanged parts, as AccountFrm does
 				auto pv = std::make_shared<VALUE>(*(itData->second.ptr_));
 				if (!pv){
 					return false;
@@ -173,20 +174,34 @@ namespace utils
 
 	private:
 		bool CopyCommit(){
-			Map copyBuf = *data_;
+			//Back up only the records which are overwritten, instead of the whole data
+			Map backup;
 			try{
-				for (auto act : buff_){
-					copyBuf[act.first] = act.second;
+				for (auto& act : buff_){
+					auto itData = data_->find(act.first);
+					if (itData != data_->end()){
+						backup.insert(*itData);
+					}
+					else{
+						backup[act.first] = Record(MAX);
+					}
+					(*data_)[act.first] = act.second;
 				}
 			}
 			catch (std::exception& e){
 				LOG_ERROR("Catched an copy exception, detail: %s", e.what());
+				for (auto& bak : backup){
+					if (bak.second.type_ == MAX){
+						data_->erase(bak.first);
+					}
+					else{
+						(*data_)[bak.first] = bak.second;
+					}
+				}
 				buff_.clear();
 				return false;
 			}
 
-			data_->swap(copyBuf);
-
 			//CAUTION: now the pointers in buff_ and copyBuf_ are overlapped with data_,
 			//so it must be clear, otherwise the later modification to them will aslo directly act on data_.
 			buff_.clear(); 
@@ -195,7 +210,7 @@ namespace utils
 
 		bool DirectCommit(){
 			try{
-				for (auto act : buff_){
+				for (auto& act : buff_){
 					(*data_)[act.first] = act.second;
 				}
 			}
@@ -0,0 +1,135 @@
+/*
+	CEG is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	CEG is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with CEG.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UTILS_COW_MAP_H_
+#define UTILS_COW_MAP_H_
+
+#include <map>
+#include <memory>
+#include <functional>
+
+namespace utils {
+
+	//Ordered map which shares an immutable base between its copies.
+	//Writes go to a private delta, so copying costs the size of the delta and not of the whole map.
+	//The delta is folded into a new base once it grows over FOLD_SIZE.
+	template<class KEY, class VALUE, class Compare = std::less<KEY>>
+	class CowMap {
+	public:
+		typedef std::map<KEY, VALUE, Compare> Map;
+
+		static const size_t FOLD_SIZE = 16;
+
+	private:
+		std::shared_ptr<const Map> base_;
+		Map delta_;
+		size_t copied_;
+
+		void Fold() {
+			copied_ += SharedSize();
+			std::shared_ptr<Map> base = base_ ? std::make_shared<Map>(*base_) : std::make_shared<Map>();
+			for (auto it = delta_.begin(); it != delta_.end(); it++) {
+				(*base)[it->first] = it->second;
+			}
+			base_ = base;
+			delta_.clear();
+		}
+
+	public:
+		CowMap() :copied_(0) {}
+
+		CowMap(const CowMap &other) :base_(other.base_), delta_(other.delta_), copied_(other.delta_.size()) {
+			if (delta_.size() > FOLD_SIZE) {
+				Fold();
+			}
+		}
+
+		CowMap &operator=(const CowMap &other) {
+			base_ = other.base_;
+			delta_ = other.delta_;
+			copied_ = delta_.size();
+			if (delta_.size() > FOLD_SIZE) {
+				Fold();
+			}
+			return *this;
+		}
+
+		const VALUE *Find(const KEY &key) const {
+			auto it = delta_.find(key);
+			if (it != delta_.end()) {
+				return &it->second;
+			}
+
+			if (base_) {
+				auto itb = base_->find(key);
+				if (itb != base_->end()) {
+					return &itb->second;
+				}
+			}
+
+			return nullptr;
+		}
+
+		void Set(const KEY &key, const VALUE &value) {
+			delta_[key] = value;
+		}
+
+		//Insert only if the key is absent, as std::map::insert does
+		void Insert(const KEY &key, const VALUE &value) {
+			if (Find(key) == nullptr) {
+				delta_[key] = value;
+			}
+		}
+
+		//Visit every entry in key order, an entry of the delta hides the one of the base
+		void ForEach(const std::function<void(const KEY &key, const VALUE &value)> &visitor) const {
+			auto it = delta_.begin();
+			if (base_) {
+				for (auto itb = base_->begin(); itb != base_->end(); itb++) {
+					for (; it != delta_.end() && delta_.key_comp()(it->first, itb->first); it++) {
+						visitor(it->first, it->second);
+					}
+
+					if (it != delta_.end() && !delta_.key_comp()(itb->first, it->first)) {
+						visitor(it->first, it->second);
+						it++;
+					}
+					else {
+						visitor(itb->first, itb->second);
+					}
+				}
+			}
+
+			for (; it != delta_.end(); it++) {
+				visitor(it->first, it->second);
+			}
+		}
+
+		size_t SharedSize() const {
+			return base_ ? base_->size() : 0;
+		}
+
+		size_t DeltaSize() const {
+			return delta_.size();
+		}
+
+		//Entries copied by the last copy into this map
+		size_t CopiedSize() const {
+			return copied_;
+		}
+	};
+}
+
+#endif
@@ -115,6 +115,67 @@ namespace utils {
 	uint8_t Crc8(const std::string &data) {
 		return Crc8((uint8_t *)data.c_str(), data.length());
 	}
+
+#define SIPHASH_ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+#define SIPHASH_ROUND(v0, v1, v2, v3) \
+	do { \
+		v0 += v1; v1 = SIPHASH_ROTL(v1, 13); v1 ^= v0; v0 = SIPHASH_ROTL(v0, 32); \
+		v2 += v3; v3 = SIPHASH_ROTL(v3, 16); v3 ^= v2; \
+		v0 += v3; v3 = SIPHASH_ROTL(v3, 21); v3 ^= v0; \
+		v2 += v1; v1 = SIPHASH_ROTL(v1, 17); v1 ^= v2; v2 = SIPHASH_ROTL(v2, 32); \
+	} while (false)
+
+	static uint64_t SipHashLoad(const unsigned char *p) {
+		uint64_t v = 0;
+		for (int i = 7; i >= 0; i--) {
+			v = (v << 8) | p[i];
+		}
+		return v;
+	}
+
+	void SipHash::Hash128(const unsigned char key[KEY_SIZE], const void *data, size_t len, uint64_t out[2]) {
+		uint64_t k0 = SipHashLoad(key);
+		uint64_t k1 = SipHashLoad(key + 8);
+		uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+		uint64_t v1 = k1 ^ 0x646f72616e646f6dULL ^ 0xee;
+		uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+		uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+		const unsigned char *p = (const unsigned char *)data;
+		const unsigned char *end = p + (len - len % 8);
+		for (; p != end; p += 8) {
+			uint64_t m = SipHashLoad(p);
+			v3 ^= m;
+			SIPHASH_ROUND(v0, v1, v2, v3);
+			SIPHASH_ROUND(v0, v1, v2, v3);
+			v0 ^= m;
+		}
+
+		uint64_t b = ((uint64_t)len) << 56;
+		for (int i = (int)(len % 8) - 1; i >= 0; i--) {
+			b |= ((uint64_t)p[i]) << (8 * i);
+		}
+
+		v3 ^= b;
+		SIPHASH_ROUND(v0, v1, v2, v3);
+		SIPHASH_ROUND(v0, v1, v2, v3);
+		v0 ^= b;
+
+		v2 ^= 0xee;
+		for (int i = 0; i < 4; i++) {
+			SIPHASH_ROUND(v0, v1, v2, v3);
+		}
+		out[0] = v0 ^ v1 ^ v2 ^ v3;
+
+		v1 ^= 0xdd;
+		for (int i = 0; i < 4; i++) {
+			SIPHASH_ROUND(v0, v1, v2, v3);
+		}
+		out[1] = v0 ^ v1 ^ v2 ^ v3;
+	}
+
+#undef SIPHASH_ROUND
+#undef SIPHASH_ROTL
 	//get CRC16
 	//puchMsg:array to be checked
 	//usDataLen:array length
@@ -114,6 +114,14 @@ namespace utils {
 	};
 
 
+	//Keyed SipHash-2-4 with the 128 bits output, a fast hash for the tables whose keys come from the network.
+	//It is not a replacement of the hashes used in consensus.
+	class SipHash {
+	public:
+		static const int KEY_SIZE = 16;
+		static void Hash128(const unsigned char key[KEY_SIZE], const void *data, size_t len, uint64_t out[2]);
+	};
+
 	class AesCtr {
 		struct ctr_state {
 			unsigned char ivec[AES_BLOCK_SIZE];
@@ -87,6 +87,45 @@ bool utils::LogWriter::Write(
 		return false;
 	}
 
+	CheckRotate(logger, current_time);
+	if (file_ptr_ == NULL) {
+		return false;
+	}
+
+	fprintf(file_ptr_, "[%s - %s] <%lX> ", current_time, GetLogPrefix(logLevel).c_str(), utils::Thread::current_thread_id());
+	fprintf(file_ptr_, "%s(%d):", file, lineNum);
+	//fprintf(file_ptr_, "%s(%s:%d):", file, funcName, lineNum);
+	// under linux, va_list can't been reused
+#ifdef WIN32
+	vfprintf(file_ptr_, fmt, ap);
+#else
+	va_list copy_ap;
+	va_copy(copy_ap, ap);
+	vfprintf(file_ptr_, fmt, copy_ap);
+	va_end(copy_ap);
+#endif
+	fprintf(file_ptr_, "\n");
+	fflush(file_ptr_);
+	return true;
+}
+
+bool utils::LogWriter::WriteBuffer(Logger *logger, const char *current_time, const std::string &buffer) {
+	if (file_ptr_ == NULL) {
+		utils::set_error_code(ERROR_NOT_READY);
+		return false;
+	}
+
+	CheckRotate(logger, current_time);
+	if (file_ptr_ == NULL) {
+		return false;
+	}
+
+	fwrite(buffer.c_str(), 1, buffer.size(), file_ptr_);
+	fflush(file_ptr_);
+	return true;
+}
+
+void utils::LogWriter::CheckRotate(Logger *logger, const char *current_time) {
 	if (dest_ == LOG_DEST_FILE) {
 		size_ = ftell64(file_ptr_);
 
@@ -154,22 +193,6 @@ bool utils::LogWriter::Write(
 			}
 		}
 	}
-
-	fprintf(file_ptr_, "[%s - %s] <%lX> ", current_time, GetLogPrefix(logLevel).c_str(), utils::Thread::current_thread_id());
-	fprintf(file_ptr_, "%s(%d):", file, lineNum);
-	//fprintf(file_ptr_, "%s(%s:%d):", file, funcName, lineNum);
-	// under linux, va_list can't been reused
-#ifdef WIN32
-	vfprintf(file_ptr_, fmt, ap);
-#else
-	va_list copy_ap;
-	va_copy(copy_ap, ap);
-	vfprintf(file_ptr_, fmt, copy_ap);
-	va_end(copy_ap);
-#endif
-	fprintf(file_ptr_, "\n");
-	fflush(file_ptr_);
-	return true;
 }
 
 bool utils::LogWriter::Close() {
@@ -181,7 +204,84 @@ bool utils::LogWriter::Close() {
 	return true;
 }
 
+utils::LogRing::LogRing(size_t capacity, size_t thread_id)
+	:closed_(false), dropped_(0), capacity_(capacity), thread_id_(thread_id), head_(0), tail_(0) {
+	buffer_ = new char[capacity_];
+}
+
+utils::LogRing::~LogRing() {
+	delete[] buffer_;
+}
+
+bool utils::LogRing::Push(LogLevel level, const char *file, int line, int64_t time, const char *text, size_t text_size) {
+	size_t size = (sizeof(Record) + text_size + 7) & ~(size_t)7;
+	uint64_t head = head_.load(std::memory_order_relaxed);
+	uint64_t tail = tail_.load(std::memory_order_acquire);
+
+	//A record does not wrap, the end of the ring is skipped if it does not fit
+	size_t offset = (size_t)(head % capacity_);
+	size_t padding = (capacity_ - offset < size) ? capacity_ - offset : 0;
+	if (size + padding > capacity_ - (size_t)(head - tail)) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	if (padding > 0) {
+		Record *pad = (Record *)(buffer_ + offset);
+		pad->size_ = (uint32_t)padding;
+		pad->level_ = LOG_LEVEL_NONE;
+		head += padding;
+		offset = 0;
+	}
+
+	Record *record = (Record *)(buffer_ + offset);
+	record->size_ = (uint32_t)size;
+	record->level_ = level;
+	record->line_ = line;
+	record->text_size_ = (uint32_t)text_size;
+	record->time_ = time;
+	record->file_ = file;
+	memcpy(buffer_ + offset + sizeof(Record), text, text_size);
+
+	head_.store(head + size, std::memory_order_release);
+	return true;
+}
+
+void utils::LogRing::Pop(const std::function<void(const Record &record, const char *text)> &visitor) {
+	uint64_t tail = tail_.load(std::memory_order_relaxed);
+	uint64_t head = head_.load(std::memory_order_acquire);
+	while (tail < head) {
+		size_t offset = (size_t)(tail % capacity_);
+		const Record *record = (const Record *)(buffer_ + offset);
+		if (record->level_ != LOG_LEVEL_NONE) {
+			visitor(*record, buffer_ + offset + sizeof(Record));
+		}
+		tail += record->size_;
+	}
+	tail_.store(tail, std::memory_order_release);
+}
+
+bool utils::LogRing::IsEmpty() const {
+	return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+}
+
+//The ring of the thread, marked closed when the thread exits so that the flusher frees it
+struct ThreadLogRing {
+	std::shared_ptr<utils::LogRing> ring_;
+	~ThreadLogRing() {
+		if (ring_) {
+			ring_->closed_ = true;
+		}
+	}
+};
+static thread_local ThreadLogRing thread_log_ring;
+
 utils::Logger::Logger() {
+	async_ = false;
+	ring_size_ = 0;
+	flusher_ = NULL;
+	closed_dropped_ = 0;
+	reported_dropped_ = 0;
 	log_dest_ = (LogDest)(utils::LOG_DEST_OUT | utils::LOG_DEST_ERR);
 	log_level_ = (LogLevel)(utils::LOG_LEVEL_ALL & ~utils::LOG_LEVEL_TRACE);
 	time_capacity_ = utils::SECOND_UNITS_PER_DAY;
@@ -231,7 +331,189 @@ bool utils::Logger::Initialize(utils::LogDest log_dest, utils::LogLevel log_leve
 	return true;
 }
 
+bool utils::Logger::StartAsync(size_t ring_size) {
+	if (async_ || ring_size == 0) {
+		return false;
+	}
+
+	//Power of two, so that the offsets stay aligned when the counters wrap
+	ring_size_ = 4096;
+	while (ring_size_ < ring_size) {
+		ring_size_ <<= 1;
+	}
+
+	flusher_ = new utils::Thread(this);
+	if (!flusher_->Start("log-flusher")) {
+		delete flusher_;
+		flusher_ = NULL;
+		return false;
+	}
+
+	async_ = true;
+	return true;
+}
+
+utils::LogRing *utils::Logger::GetThreadRing() {
+	LogRing *ring = thread_log_ring.ring_.get();
+	if (ring == NULL) {
+		thread_log_ring.ring_ = std::make_shared<LogRing>(ring_size_, utils::Thread::current_thread_id());
+		ring = thread_log_ring.ring_.get();
+
+		utils::MutexGuard guard(rings_mutex_);
+		rings_.push_back(thread_log_ring.ring_);
+	}
+	return ring;
+}
+
+void utils::Logger::Run(Thread *this_thread) {
+	while (this_thread->enabled()) {
+		size_t count = Drain();
+		CheckExpiredLogFiles();
+		//Keep up with a burst, otherwise let the lines gather into larger writes
+		if (count == 0) {
+			utils::Sleep(10);
+		}
+	}
+}
+
+size_t utils::Logger::Drain() {
+	struct PendingLine {
+		int64_t time_;
+		LogLevel level_;
+		std::string text_;
+	};
+
+	utils::MutexGuard drain_guard(drain_mutex_);
+	std::vector<std::shared_ptr<LogRing>> rings;
+	do {
+		utils::MutexGuard guard(rings_mutex_);
+		rings = rings_;
+	} while (false);
+
+	std::vector<PendingLine> lines;
+	std::vector<LogRing *> closed_rings;
+	//The local time of a second is computed once, the milliseconds are added to it
+	int64_t cached_second = -1;
+	std::string cached_time;
+	char time_string_buffer[64];
+	for (size_t i = 0; i < rings.size(); i++) {
+		LogRing *ring = rings[i].get();
+		//Read it before the records, the thread writes nothing after closing it
+		bool closed = ring->closed_;
+		ring->Pop([&](const LogRing::Record &record, const char *text) {
+			int64_t second = record.time_ / utils::MICRO_UNITS_PER_SEC;
+			if (second != cached_second) {
+				cached_time = utils::Timestamp(second * utils::MICRO_UNITS_PER_SEC).Format(false);
+				cached_time.resize(cached_time.size() - 7);
+				cached_second = second;
+			}
+			snprintf(time_string_buffer, sizeof(time_string_buffer), "%s.%03d", cached_time.c_str(),
+				(int)(record.time_ % utils::MICRO_UNITS_PER_SEC / 1000));
+
+			PendingLine line;
+			line.time_ = record.time_;
+			line.level_ = (LogLevel)record.level_;
+			line.text_ = utils::String::Format("[%s - %s] <%lX> %s(%d):", time_string_buffer,
+				LogWriter::GetLogPrefix(line.level_).c_str(), ring->thread_id(), utils::File::GetFileFromPath(record.file_).c_str(), record.line_);
+			line.text_.append(text, record.text_size_);
+			line.text_.append("\n");
+			lines.push_back(line);
+		});
+
+		if (closed) {
+			closed_rings.push_back(ring);
+		}
+	}
+
+	int64_t dropped = 0;
+	do {
+		utils::MutexGuard guard(rings_mutex_);
+		for (size_t i = 0; i < closed_rings.size(); i++) {
+			for (auto iter = rings_.begin(); iter != rings_.end(); iter++) {
+				if (iter->get() == closed_rings[i]) {
+					closed_dropped_ += closed_rings[i]->dropped_;
+					rings_.erase(iter);
+					break;
+				}
+			}
+		}
+
+		dropped = closed_dropped_;
+		for (size_t i = 0; i < rings_.size(); i++) {
+			dropped += rings_[i]->dropped_;
+		}
+	} while (false);
+
+	std::string time_string = utils::Timestamp::Now().Format(true);
+	if (dropped > reported_dropped_) {
+		PendingLine line;
+		line.time_ = utils::Timestamp::Now().timestamp();
+		line.level_ = LOG_LEVEL_WARN;
+		line.text_ = utils::String::Format("[%s - %s] Log::Dropped " FMT_I64 " lines, the buffer of a thread was full (" FMT_I64 " in total)\n",
+			time_string.c_str(), LogWriter::GetLogPrefix(LOG_LEVEL_WARN).c_str(), dropped - reported_dropped_, dropped);
+		lines.push_back(line);
+		reported_dropped_ = dropped;
+	}
+
+	if (lines.empty()) {
+		return 0;
+	}
+
+	//The rings are drained one after the other, put the lines of the threads back in time order
+	std::stable_sort(lines.begin(), lines.end(), [](const PendingLine &a, const PendingLine &b) {
+		return a.time_ < b.time_;
+	});
+
+	std::string buffers[LOG_DEST_COUNT];
+	for (size_t i = 0; i < lines.size(); i++) {
+		const PendingLine &line = lines[i];
+		if (log_dest_ & LOG_DEST_FILE) {
+			buffers[line.level_ <= LOG_LEVEL_INFO ? LOG_DEST_FILE_OUT_ID : LOG_DEST_FILE_ERR_ID].append(line.text_);
+		}
+
+		if (line.level_ < LOG_LEVEL_WARN && log_dest_ & LOG_DEST_OUT) {
+			buffers[LOG_DEST_OUT_ID].append(line.text_);
+		}
+
+		if (line.level_ >= LOG_LEVEL_WARN && log_dest_ & LOG_DEST_ERR) {
+			buffers[LOG_DEST_ERR_ID].append(line.text_);
+		}
+	}
+
+	utils::MutexGuard guard(mutex_);
+	for (size_t i = 0; i < LOG_DEST_COUNT; i++) {
+		if (!buffers[i].empty()) {
+			log_writers_[i].WriteBuffer(this, time_string.c_str(), buffers[i]);
+		}
+	}
+	return lines.size();
+}
+
+void utils::Logger::Flush() {
+	if (async_) {
+		Drain();
+	}
+}
+
+int64_t utils::Logger::GetDroppedCount() {
+	utils::MutexGuard guard(rings_mutex_);
+	int64_t dropped = closed_dropped_;
+	for (size_t i = 0; i < rings_.size(); i++) {
+		dropped += rings_[i]->dropped_;
+	}
+	return dropped;
+}
+
 bool utils::Logger::Exit() {
+	if (flusher_ != NULL) {
+		flusher_->JoinWithStop();
+		delete flusher_;
+		flusher_ = NULL;
+		async_ = false;
+		//The lines logged while the flusher stopped
+		Drain();
+	}
+
 	for (size_t i = 0; i < utils::LOG_DEST_COUNT; i++) {
 		log_writers_[i].Close();
 	}
@@ -300,6 +582,36 @@ int utils::Logger::LogStub(utils::LogLevel log_Level,
 		return 0;
 	}
 
+	if (async_) {
+		//Format on the calling thread and leave the rest to the flusher
+		char text[4096];
+		va_list copy_ap;
+		va_copy(copy_ap, ap);
+		int size = vsnprintf(text, sizeof(text), fmt, copy_ap);
+		va_end(copy_ap);
+
+		std::string long_text;
+		const char *data = text;
+		if (size < 0) {
+			size = 0;
+		}
+		else if ((size_t)size >= sizeof(text)) {
+			//A line takes a quarter of the ring at most
+			size_t max_size = ring_size_ / 4;
+			if ((size_t)size > max_size) {
+				size = (int)max_size;
+			}
+			long_text.resize(size + 1);
+			va_copy(copy_ap, ap);
+			vsnprintf(&long_text[0], long_text.size(), fmt, copy_ap);
+			va_end(copy_ap);
+			data = long_text.c_str();
+		}
+
+		GetThreadRing()->Push(log_Level, file, lineNum, utils::Timestamp::Now().timestamp(), data, size);
+		return ret_val;
+	}
+
 	utils::MutexGuard _access_(mutex_);
 
 	std::string time_string = utils::Timestamp::Now().Format(true);
@@ -326,6 +638,13 @@ int utils::Logger::LogStub(utils::LogLevel log_Level,
 }
 
 void utils::Logger::CheckExpiredLog() {
+	//The flusher does it in the async mode
+	if (!async_) {
+		CheckExpiredLogFiles();
+	}
+}
+
+void utils::Logger::CheckExpiredLogFiles() {
 	int64_t nNextCheckTime = m_nCheckRunLogTime + int64_t(utils::SECOND_UNITS_PER_HOUR) * utils::MICRO_UNITS_PER_SEC;
 	if (nNextCheckTime > utils::Timestamp::HighResolution()) {
 		return;
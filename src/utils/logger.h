@@ -16,6 +16,8 @@
 #ifndef UTILS_LOGGER_H_
 #define UTILS_LOGGER_H_
 
+#include <atomic>
+#include <memory>
 #include "common.h"
 #include "singleton.h"
 #include "thread.h"
@@ -44,8 +46,8 @@
 #define STD_ERR_DESC utils::error_desc().c_str() 
 
 
-#define PROCESS_EXIT(fmt, ...) { utils::Logger::Instance().LogStubVm(utils::LOG_LEVEL_ERROR,__FILE__,__func__, __LINE__ , fmt , ## __VA_ARGS__); exit(-1); }
-#define PROCESS_EXIT_ERRNO(fmt, ...) { utils::Logger::Instance().LogStubVm(utils::LOG_LEVEL_ERROR,__FILE__,__func__, __LINE__ , fmt" (%u:%s)" , ## __VA_ARGS__); exit(-1); }
+#define PROCESS_EXIT(fmt, ...) { utils::Logger::Instance().LogStubVm(utils::LOG_LEVEL_ERROR,__FILE__,__func__, __LINE__ , fmt , ## __VA_ARGS__); utils::Logger::Instance().Flush(); exit(-1); }
+#define PROCESS_EXIT_ERRNO(fmt, ...) { utils::Logger::Instance().LogStubVm(utils::LOG_LEVEL_ERROR,__FILE__,__func__, __LINE__ , fmt" (%u:%s)" , ## __VA_ARGS__); utils::Logger::Instance().Flush(); exit(-1); }
 
 namespace utils {
 
@@ -77,6 +79,44 @@ namespace utils {
 	}LogLevel;
 
 	class Logger;
+
+	//Lines of one thread waiting for the flusher in the async mode.
+	//Lock free ring with a single producer, the owning thread, and a single consumer, the flusher.
+	class LogRing {
+	public:
+		//Header of a line in the ring, the text follows it
+		struct Record {
+			uint32_t size_;       //Bytes of the record with the header and the alignment
+			uint32_t level_;      //LOG_LEVEL_NONE for the padding up to the end of the ring
+			int32_t line_;
+			uint32_t text_size_;
+			int64_t time_;
+			const char *file_;
+		};
+
+		LogRing(size_t capacity, size_t thread_id);
+		~LogRing();
+
+		//Return false and count a drop if the ring is full
+		bool Push(LogLevel level, const char *file, int line, int64_t time, const char *text, size_t text_size);
+		//Visit the pending records in order, then release them
+		void Pop(const std::function<void(const Record &record, const char *text)> &visitor);
+		bool IsEmpty() const;
+		size_t Capacity() const { return capacity_; }
+		size_t thread_id() const { return thread_id_; }
+
+		std::atomic<bool> closed_;
+		std::atomic<int64_t> dropped_;
+
+	private:
+		UTILS_DISALLOW_EVIL_CONSTRUCTORS(LogRing);
+		char *buffer_;
+		size_t capacity_;
+		size_t thread_id_;
+		std::atomic<uint64_t> head_;
+		std::atomic<uint64_t> tail_;
+	};
+
 	class LogWriter {
 	private:
 		LogDest dest_;
@@ -94,20 +134,27 @@ namespace utils {
 			const char *current_time,
 			const char* file, const char* funcName, const int lineNum,
 			const char* fmt, va_list ap);
+		//Write lines formatted by the flusher in one call
+		bool WriteBuffer(Logger *logger, const char *current_time, const std::string &buffer);
 		bool Close();
 		LogDest log_dest();
 
 		static std::string GetLogPrefix(const LogLevel logLevel);
 
+	private:
+		//Move the file to a backup once it is over the capacity
+		void CheckRotate(Logger *logger, const char *current_time);
 	};
 
-	class Logger : public Singleton<Logger> {
+	class Logger : public Singleton<Logger>, public Runnable {
 		friend class Singleton<Logger>;
 		friend class LogWriter;
 	private:
 		Logger();
 		~Logger();
 
+		virtual void Run(Thread *this_thread) override;
+
 	public:
 		bool Initialize(utils::LogDest log_dest, utils::LogLevel log_level, const std::string &file_name, bool open_mode);
 		bool Exit();
@@ -127,6 +174,13 @@ namespace utils {
 			const char* funcName, const int lineNum,
 			const char* fmt, va_list ap);
 
+		//Hand the lines to a flusher thread, each thread formats into its own ring of ring_size bytes
+		bool StartAsync(size_t ring_size);
+		//Write the pending lines of the async mode now
+		void Flush();
+		bool IsAsync() const { return async_; }
+		int64_t GetDroppedCount();
+
 		void SetCapacity(uint32_t time_cap, uint64_t size_cap);
 		void SetExpireDays(uint32_t expire_days);
 		void SetLogLevel(LogLevel log_level);
@@ -146,6 +200,21 @@ namespace utils {
 
 		std::string log_path_;
 		int64_t m_nCheckRunLogTime;
+
+		//Async mode
+		std::atomic<bool> async_;
+		size_t ring_size_;
+		utils::Thread *flusher_;
+		utils::Mutex rings_mutex_;
+		std::vector<std::shared_ptr<LogRing>> rings_;
+		//One drain at a time, by the flusher, Flush or Exit
+		utils::Mutex drain_mutex_;
+		int64_t closed_dropped_;
+		int64_t reported_dropped_;
+
+		LogRing *GetThreadRing();
+		size_t Drain();
+		void CheckExpiredLogFiles();
 	};
 
 }
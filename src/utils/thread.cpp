@@ -331,13 +331,19 @@ bool utils::Semaphore::Wait(uint32_t millisecond) {
 		ret = sem_wait(&sem_);
 	}
 	else {
+		//sem_timedwait takes an absolute time
 		struct timespec ts = { 0, 0 };
-		//TimeUtil::getAbsTimespec(&ts, millisecond);
-
-		ts.tv_sec = millisecond / 1000;
-		ts.tv_nsec = millisecond % 1000;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += millisecond / 1000;
+		ts.tv_nsec += (long)(millisecond % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
 
-		ret = sem_timedwait(&sem_, &ts);
+		do {
+			ret = sem_timedwait(&sem_, &ts);
+		} while (-1 == ret && EINTR == errno);
 	}
 
 	return -1 != ret;
@@ -427,6 +433,7 @@ bool utils::ThreadPool::Init(const std::string &name, int threadNum) {
 
 bool utils::ThreadPool::Exit() {
 	enabled_ = false;
+	WakeAll();
 	for (size_t i = 0; i < threads_.size(); i++) {
 		if (threads_[i]) threads_[i]->JoinWithStop();
 	}
@@ -436,10 +443,12 @@ bool utils::ThreadPool::Exit() {
 
 void utils::ThreadPool::AddTask(Runnable *task) {
 	tasks_.Put(task);
+	task_signal_.Signal();
 }
 
 void utils::ThreadPool::JoinwWithStop() {
 	enabled_ = false;
+	WakeAll();
 	for (ThreadVector::const_iterator it = threads_.begin(); it != threads_.end(); ++it) {
 		(*it)->JoinWithStop();
 	}
@@ -452,6 +461,7 @@ bool utils::ThreadPool::WaitAndJoin() {
 		Sleep(1);
 
 	enabled_ = false;
+	WakeAll();
 	for (size_t i = 0; i < threads_.size(); i++) {
 		if (threads_[i]) threads_[i]->JoinWithStop();
 	}
@@ -488,7 +498,13 @@ void utils::ThreadPool::Run(Thread *this_thread) {
 	while (enabled_) {
 		utils::Runnable *task = tasks_.Get();
 		if (task) task->Run(this_thread);
-		else utils::Sleep(1);
+		else task_signal_.Wait(kIdleWaitTime);
+	}
+}
+
+void utils::ThreadPool::WakeAll() {
+	for (size_t i = 0; i < threads_.size(); i++) {
+		task_signal_.Signal();
 	}
 }
 
@@ -327,13 +327,17 @@ namespace utils {
 		bool AddWorker(int threadNum);
 
 		void Run(Thread *this_thread);
+		void WakeAll();
 
 		ThreadVector threads_;
 		ThreadTaskQueue tasks_;
+		//Signaled for each task, the idle workers wait on it instead of polling
+		Semaphore task_signal_;
 		bool enabled_;
 		std::string name_;
 
 		static const int32_t kDefaultThreadNum = 10;
+		static const uint32_t kIdleWaitTime = 100;
 	};
 
 }
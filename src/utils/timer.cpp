@@ -19,17 +19,21 @@ namespace utils {
 	TimerElement::TimerElement(int64_t id, int64_t data, int64_t expire_time, std::function<void(int64_t)> const &func) :
 		id_(id), data_(data), expire_time_(expire_time), func_(func) {}
 
-	int64_t TimerElement::GetIndex() {
+	int64_t TimerElement::GetIndex() const {
 		return id_;
 	}
 
+	int64_t TimerElement::GetExpireTime() const {
+		return expire_time_;
+	}
+
 	void TimerElement::Excute() {
 		func_(data_);
 	}
 
-	Timer::Timer() :check_interval_(100 * utils::MICRO_UNITS_PER_MILLI),
-		global_element_id_(1),
-		last_check_time_(0) {}
+	Timer::Timer() :global_element_id_(1),
+		base_time_(utils::Timestamp::HighResolution()),
+		current_tick_(0) {}
 
 	Timer::~Timer() {}
 
@@ -41,56 +45,121 @@ namespace utils {
 		return true;
 	}
 
+	int64_t Timer::GetTick(int64_t time) const {
+		if (time <= base_time_) {
+			return 0;
+		}
+
+		//Round up, an element never expires before its time
+		return (time - base_time_ + TICK - 1) / TICK;
+	}
+
+	void Timer::Place(const TimerElement &element) {
+		int64_t expire_tick = GetTick(element.GetExpireTime());
+		if (expire_tick < current_tick_) {
+			expire_tick = current_tick_;
+		}
+
+		int64_t delay = expire_tick - current_tick_;
+		int32_t level = 0;
+		while (level < LEVEL_COUNT - 1 && delay >= ((int64_t)1 << (LEVEL_BITS * (level + 1)))) {
+			level++;
+		}
+
+		//Beyond the top level, park it in the farthest slot, it is placed again when that slot cascades
+		int64_t max_delay = ((int64_t)1 << (LEVEL_BITS * LEVEL_COUNT)) - 1;
+		if (delay > max_delay) {
+			expire_tick = current_tick_ + max_delay;
+		}
+
+		int32_t slot = (int32_t)((expire_tick >> (LEVEL_BITS * level)) & (SLOT_COUNT - 1));
+		Slot &list = wheel_[level][slot];
+		list.push_back(element);
+
+		Location &location = locations_[element.GetIndex()];
+		location.level_ = level;
+		location.slot_ = slot;
+		location.iter_ = --list.end();
+	}
+
+	void Timer::Cascade(int32_t level) {
+		int32_t slot = (int32_t)((current_tick_ >> (LEVEL_BITS * level)) & (SLOT_COUNT - 1));
+		Slot list;
+		list.swap(wheel_[level][slot]);
+		for (Slot::iterator iter = list.begin(); iter != list.end(); iter++) {
+			Place(*iter);
+		}
+	}
+
 	int64_t Timer::AddTimer(int64_t micro_time, int64_t data, std::function<void(int64_t)> const &func) {
 		utils::MutexGuard guard(lock_);
 		int64_t expire_time = utils::Timestamp::HighResolution() + micro_time;
 		TimerElement element(global_element_id_++, data, expire_time, func);
 
-		time_ele_.insert(std::make_pair(expire_time, element));
+		Place(element);
 		return element.GetIndex();
 	}
 
 	bool Timer::DelTimer(int64_t index) {
 		utils::MutexGuard guard(lock_);
-		for (std::multimap<int64_t, TimerElement>::iterator iter = time_ele_.begin();
-			iter != time_ele_.end();
-			iter++) {
-			TimerElement &ele = iter->second;
-			if (ele.GetIndex() == index) {
-				time_ele_.erase(iter);
-				return true;
-			}
+		std::unordered_map<int64_t, Location>::iterator iter = locations_.find(index);
+		if (iter == locations_.end()) {
+			return false;
 		}
 
-		return false;
+		const Location &location = iter->second;
+		wheel_[location.level_][location.slot_].erase(location.iter_);
+		locations_.erase(iter);
+		return true;
 	}
 
 	void Timer::OnTimer(int64_t current_time) {
-		if (current_time > last_check_time_ + check_interval_) {
-			CheckExpire(current_time);
-
-			for (std::list<TimerElement>::iterator iter = exeute_list_.begin(); iter != exeute_list_.end(); iter++) {
-				iter->Excute();
-			}
-			exeute_list_.clear();
+		CheckExpire(current_time);
 
-			last_check_time_ = current_time;
+		for (std::list<TimerElement>::iterator iter = exeute_list_.begin(); iter != exeute_list_.end(); iter++) {
+			iter->Excute();
 		}
+		exeute_list_.clear();
 	}
 
 	void Timer::CheckExpire(int64_t cur_time) {
 		utils::MutexGuard guard(lock_);
-		for (std::multimap<int64_t, TimerElement>::iterator iter = time_ele_.begin();
-			iter != time_ele_.end();
-			) {
-			TimerElement ele = iter->second;
-			if (iter->first > cur_time) {
-				break;
+		int64_t target_tick = GetTick(cur_time);
+		if (locations_.empty()) {
+			//Nothing to expire, skip the idle ticks
+			if (current_tick_ <= target_tick) {
+				current_tick_ = target_tick + 1;
+			}
+			return;
+		}
+
+		for (; current_tick_ <= target_tick; current_tick_++) {
+			//Move the elements of the next slot of each upper level down when the level below wraps
+			for (int32_t level = 1; level < LEVEL_COUNT; level++) {
+				if ((current_tick_ & (((int64_t)1 << (LEVEL_BITS * level)) - 1)) != 0) {
+					break;
+				}
+				Cascade(level);
 			}
 
-			time_ele_.erase(iter++);
-			exeute_list_.push_back(ele);
+			Slot &list = wheel_[0][current_tick_ & (SLOT_COUNT - 1)];
+			while (!list.empty()) {
+				TimerElement ele = list.front();
+				list.pop_front();
+				locations_.erase(ele.GetIndex());
+
+				//Parked beyond the top level
+				if (GetTick(ele.GetExpireTime()) > current_tick_) {
+					Place(ele);
+					continue;
+				}
+				exeute_list_.push_back(ele);
+			}
 		}
 	}
 
+	size_t Timer::GetSize() {
+		utils::MutexGuard guard(lock_);
+		return locations_.size();
+	}
 }
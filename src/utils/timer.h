@@ -16,6 +16,7 @@
 #ifndef TIMER_H_
 #define TIMER_H_
 
+#include <unordered_map>
 #include "singleton.h"
 #include "thread.h"
 #include "utils.h"
@@ -32,19 +33,43 @@ namespace utils {
 	public:
 		TimerElement(int64_t id_, int64_t data_, int64_t expire_time_, std::function<void(int64_t)> const &func);
 		~TimerElement() {};
-		int64_t GetIndex();
+		int64_t GetIndex() const;
+		int64_t GetExpireTime() const;
 		void Excute();
 	};
 
+	//One shot timers of the main thread, in a hierarchical timing wheel.
+	//Each level has SLOT_COUNT slots, a slot of level 0 spans one tick and a slot of level n spans SLOT_COUNT^n ticks.
+	//An element is placed at the lowest level which covers its delay, and moved down a level each time the
+	//lower level wraps, so adding, deleting and expiring an element cost O(1) whatever the number of timers.
 	class Timer : public Singleton<Timer> {
 		friend class Singleton<Timer>;
+	public:
+		static const int64_t TICK = 10 * MICRO_UNITS_PER_MILLI;
 	private:
-		std::multimap<int64_t, TimerElement> time_ele_;
+		static const int32_t LEVEL_BITS = 6;
+		static const int32_t SLOT_COUNT = 1 << LEVEL_BITS;
+		static const int32_t LEVEL_COUNT = 4;
+
+		typedef std::list<TimerElement> Slot;
+		struct Location {
+			int32_t level_;
+			int32_t slot_;
+			Slot::iterator iter_;
+		};
+
+		Slot wheel_[LEVEL_COUNT][SLOT_COUNT];
+		std::unordered_map<int64_t, Location> locations_;
 		std::list<TimerElement> exeute_list_;
 		utils::Mutex lock_;
 		int64_t global_element_id_;
-		int64_t check_interval_;
-		int64_t last_check_time_;
+		int64_t base_time_;
+		//The next tick to expire
+		int64_t current_tick_;
+
+		int64_t GetTick(int64_t time) const;
+		void Place(const TimerElement &element);
+		void Cascade(int32_t level);
 	public:
 		Timer();
 		virtual ~Timer();
@@ -56,6 +81,7 @@ namespace utils {
 		int64_t AddTimer(int64_t micro_time, int64_t data, std::function<void(int64_t)> const &func); /* msec unit: millisecond (1/1000);*/
 		bool DelTimer(int64_t index);
 		void CheckExpire(int64_t cur_time);
+		size_t GetSize();
 	};
 }
-#endif 
\ No newline at end of file
+#endif 
@@ -137,6 +137,22 @@ namespace utils {
 	}
 #endif
 
+#ifdef WIN32
+	inline LONGLONG AtomicAdd(volatile LONGLONG *value, LONGLONG amount) {
+		return InterlockedAdd64(value, amount);
+	}
+#elif defined OS_LINUX
+	inline int64_t AtomicAdd(volatile int64_t *value, int64_t amount) {
+		__sync_fetch_and_add(value, amount);
+		return *value;
+	}
+#elif defined OS_MAC
+	inline int64_t AtomicAdd(volatile int64_t *value, int64_t amount) {
+		__sync_fetch_and_add(value, amount);
+		return *value;
+	}
+#endif
+
 
 	template<typename T>
 	class AtomicInteger {